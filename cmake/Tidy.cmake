@@ -13,6 +13,8 @@ set(
   ${SHARDS_DIR}/include/wire_dsl.hpp
   ${SHARDS_DIR}/src/core/runtime.cpp
   ${SHARDS_DIR}/src/core/ops_internal.cpp
+  ${SHARDS_DIR}/src/core/artifact.cpp
+  ${SHARDS_DIR}/src/core/artifact.hpp
   ${SHARDS_DIR}/src/core/runtime.hpp
   ${SHARDS_DIR}/src/core/foundation.hpp
   ${SHARDS_DIR}/src/core/ops_internal.hpp
@@ -46,6 +48,7 @@ set(
   ${SHARDS_DIR}/src/extra/desktop.capture.win.hpp
   ${SHARDS_DIR}/src/mal/SHCore.cpp
   ${SHARDS_DIR}/src/core/shards/serialization.cpp
+  ${SHARDS_DIR}/src/core/shards/compression.cpp
   ${SHARDS_DIR}/src/core/shards/time.cpp
   ${SHARDS_DIR}/src/core/shards/os.cpp
   ${SHARDS_DIR}/src/core/shards/strings.cpp
@@ -55,6 +58,7 @@ set(
   ${SHARDS_DIR}/src/core/edn/eval.cpp
   ${SHARDS_DIR}/src/extra/snappy.cpp
   ${SHARDS_DIR}/src/extra/brotli.cpp
+  ${SHARDS_DIR}/src/extra/zstd.cpp
   ${SHARDS_DIR}/src/extra/xr.cpp
   ${SHARDS_DIR}/src/core/shards/ws.cpp
   ${SHARDS_DIR}/src/core/shards/bigint.cpp
@@ -7,6 +7,7 @@
 #include "shards.h"
 #include "common_types.hpp"
 #include <cassert>
+#include <iterator>
 #include <map>
 #include <vector>
 
@@ -21,6 +22,18 @@ enum class NumberType {
   Int64,
   Float32,
   Float64,
+  // Not mapped to any SHType, used for 16 bits images
+  UInt16,
+};
+
+enum class NumberConversionMode {
+  // Plain C cast, same as convertOne
+  Cast,
+  // Clamps to the destination range, NaN becomes 0 when converting to integers
+  Saturate,
+  // Integers are mapped to [0, 1] (unsigned) or [-1, 1] (signed) when converting to or from floats,
+  // float to integer conversions are rounded to nearest and saturated
+  Normalize,
 };
 
 std::map<SHType, NumberType> getSHTypeToNumberTypeMap();
@@ -44,6 +57,11 @@ typedef void (*NumberConvertOneFunction)(const void *src, void *dst);
 // Throws NumberConversionOutOfRangeEx false on out of range index
 typedef void (*NumberConvertMultipleSeqFunction)(const void *src, void *dst, size_t srcLen, const SHSeq &sequence);
 
+// Converts count elements in bulk
+// Strides are in bytes, so that number payloads inside SHVar arrays can be gathered/scattered directly,
+// contiguous buffers take the vectorized path
+typedef void (*NumberConvertManyFunction)(const void *src, size_t srcStride, void *dst, size_t dstStride, size_t count);
+
 typedef void (*NumberConvertParse)(void *dst, const char *input, char **inputEnd);
 
 struct NumberConversion {
@@ -51,6 +69,12 @@ struct NumberConversion {
   size_t outStride;
   NumberConvertOneFunction convertOne;
   NumberConvertMultipleSeqFunction convertMultipleSeq;
+  NumberConvertManyFunction convertMany[3];
+
+  NumberConvertManyFunction getConvertMany(NumberConversionMode mode) const {
+    shassert((size_t)mode < std::size(convertMany));
+    return convertMany[(size_t)mode];
+  }
 };
 
 struct NumberConversionTable {
@@ -114,6 +138,17 @@ private:
   void set(const NumberTypeTraits &traits);
 };
 
+// Bulk converts count numbers from one buffer to another, see NumberConvertManyFunction for the stride semantics
+void convertNumbers(NumberType srcType, const void *src, size_t srcStride, NumberType dstType, void *dst, size_t dstStride,
+                    size_t count, NumberConversionMode mode = NumberConversionMode::Cast);
+
+// Contiguous buffers
+inline void convertNumbers(NumberType srcType, const void *src, NumberType dstType, void *dst, size_t count,
+                           NumberConversionMode mode = NumberConversionMode::Cast) {
+  auto &lookup = NumberTypeLookup::getInstance();
+  convertNumbers(srcType, src, lookup.get(srcType)->size, dstType, dst, lookup.get(dstType)->size, count, mode);
+}
+
 struct VectorTypeTraits {
   size_t dimension = 0;
   bool isInteger;
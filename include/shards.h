@@ -627,6 +627,12 @@ struct SHVarPayload {
 // this marks a variable external and even if references are counted
 // it won't be destroyed automatically
 #define SHVAR_FLAGS_EXTERNAL (1 << 2)
+// this marks a sequence variable that has a hash index built on it,
+// in place mutations must invalidate it
+#define SHVAR_FLAGS_INDEXED (1 << 3)
+// this marks a constant whose contents are never mutated in place,
+// the hash of such sequences and tables is computed once and cached
+#define SHVAR_FLAGS_FROZEN (1 << 4)
 
 struct SHVar {
   struct SHVarPayload payload;
@@ -1092,6 +1092,9 @@ public:
   Wire &unsafe(bool unsafe);
   Wire &stackSize(size_t size);
   Wire &name(std::string_view name);
+  // seconds of CPU time a resume may take before the mesh records an overrun
+  Wire &budget(double seconds);
+  Wire &priority(int priority);
 
   SHWire *operator->() { return _wire.get(); }
   SHWire *get() { return _wire.get(); }
@@ -228,7 +228,10 @@ private:
 public:
   TParamVar() {}
 
-  explicit TParamVar(SHVar initialValue) { SH_CORE::cloneVar(_v, initialValue); }
+  explicit TParamVar(SHVar initialValue) {
+    SH_CORE::cloneVar(_v, initialValue);
+    _v.flags |= SHVAR_FLAGS_FROZEN;
+  }
 
   TParamVar(const TParamVar &other) = delete;
   TParamVar &operator=(const TParamVar &other) = delete;
@@ -273,6 +276,8 @@ public:
   SHVar &operator=(const SHVar &value) {
     cleanup();
     SH_CORE::cloneVar(_v, value);
+    // constant parameters only change through here
+    _v.flags |= SHVAR_FLAGS_FROZEN;
     return _v;
   }
 
@@ -0,0 +1,324 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2022 Fragcolor Pte. Ltd. */
+
+#include "artifact.hpp"
+#include <boost/filesystem.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <unordered_set>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace shards {
+namespace artifact {
+namespace {
+constexpr uint8_t Magic[4] = {'S', 'H', 'W', 'A'};
+constexpr uint32_t Version = 1;
+
+struct Header {
+  uint8_t magic[4];
+  uint32_t version;
+  uint32_t abi;
+  uint32_t dependencies;
+  uint64_t key;
+  // of everything after the header
+  uint64_t size;
+  uint64_t checksum;
+};
+static_assert(sizeof(Header) == 40, "Unexpected artifact header size");
+
+// Read only view of a whole file, memory mapped where the platform allows it
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path) {
+#if defined(_WIN32)
+    auto file = CreateFileW(fs::path(path).wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return;
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size)) {
+      _open = true;
+      _size = size_t(size.QuadPart);
+      if (_size > 0) {
+        // the view keeps the file and the mapping alive
+        auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+          _data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+          CloseHandle(mapping);
+        }
+        _open = _data != nullptr;
+      }
+    }
+    CloseHandle(file);
+#elif !defined(__EMSCRIPTEN__)
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+      return;
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+      _open = true;
+      _size = size_t(st.st_size);
+      if (_size > 0) {
+        auto data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        _data = data != MAP_FAILED ? (const uint8_t *)data : nullptr;
+        _open = _data != nullptr;
+      }
+    }
+    close(fd);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+      return;
+    _buffer.assign(std::istreambuf_iterator<char>(file), {});
+    _open = true;
+    _data = _buffer.data();
+    _size = _buffer.size();
+#endif
+  }
+
+  ~MappedFile() {
+#if defined(_WIN32)
+    if (_data)
+      UnmapViewOfFile(_data);
+#elif !defined(__EMSCRIPTEN__)
+    if (_data)
+      munmap((void *)_data, _size);
+#endif
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  explicit operator bool() const { return _open; }
+  const uint8_t *data() const { return _data; }
+  size_t size() const { return _size; }
+
+private:
+  bool _open{false};
+  const uint8_t *_data{nullptr};
+  size_t _size{0};
+#ifdef __EMSCRIPTEN__
+  std::vector<uint8_t> _buffer;
+#endif
+};
+
+struct Cursor {
+  const uint8_t *data;
+  size_t size;
+  size_t offset{0};
+
+  void operator()(uint8_t *buf, size_t len) {
+    if (size - offset < len)
+      throw SHException("Wire artifact truncated");
+    memcpy(buf, data + offset, len);
+    offset += len;
+  }
+};
+
+struct Writer {
+  std::vector<uint8_t> &buffer;
+
+  void operator()(const uint8_t *buf, size_t len) { buffer.insert(buffer.end(), buf, buf + len); }
+};
+
+// nullopt if the file can't be read
+std::optional<uint64_t> hashFile(const std::string &path) {
+  MappedFile file(path);
+  if (!file)
+    return std::nullopt;
+  return XXH3_64bits(file.data(), file.size());
+}
+
+// directories a store failed to write to
+std::mutex unwritableMutex;
+std::unordered_set<std::string> unwritable;
+} // namespace
+
+bool enabled() {
+  static const bool value = std::getenv("SHARDS_NO_ARTIFACT_CACHE") == nullptr;
+  return value;
+}
+
+uint64_t key(std::string_view source, std::string_view extra) {
+  XXH3_state_t state;
+  XXH3_INITSTATE(&state);
+  XXH3_64bits_reset(&state);
+  XXH3_64bits_update(&state, source.data(), source.size());
+  // so that moving characters between source and extra changes the key
+  const uint64_t sourceSize = source.size();
+  XXH3_64bits_update(&state, &sourceSize, sizeof(uint64_t));
+  XXH3_64bits_update(&state, extra.data(), extra.size());
+  return XXH3_64bits_digest(&state);
+}
+
+std::string pathOf(const std::string &scriptPath, std::string_view flavor) {
+  boost::system::error_code ec;
+  auto absolute = fs::absolute(scriptPath, ec).string();
+  if (ec)
+    absolute = scriptPath;
+  auto stem = fs::path(scriptPath).stem().string();
+  if (!flavor.empty())
+    stem = fmt::format("{}-{}", stem, flavor);
+  const auto name = fmt::format("{}-{:016x}.shc", stem, XXH3_64bits(absolute.data(), absolute.size()));
+  return (fs::path(GetGlobals().RootPath) / ".shards-cache" / name).string();
+}
+
+bool loadVar(const std::string &path, uint64_t key, SHVar &output) {
+  if (!enabled())
+    return false;
+
+  MappedFile file(path);
+  if (!file)
+    return false;
+
+  Header header;
+  if (file.size() < sizeof(Header) || memcmp(file.data(), Magic, sizeof(Magic)) != 0) {
+    SHLOG_WARNING("Not an artifact: {}", path);
+    return false;
+  }
+  memcpy(&header, file.data(), sizeof(Header));
+  if (header.version != Version || header.abi != SHARDS_CURRENT_ABI || header.key != key) {
+    SHLOG_DEBUG("Stale artifact: {}", path);
+    return false;
+  }
+
+  Cursor read{file.data() + sizeof(Header), file.size() - sizeof(Header)};
+  if (header.size != read.size || XXH3_64bits(read.data, read.size) != header.checksum) {
+    SHLOG_WARNING("Corrupted artifact: {}", path);
+    return false;
+  }
+
+  try {
+    for (uint32_t i = 0; i < header.dependencies; i++) {
+      uint32_t len;
+      read((uint8_t *)&len, sizeof(uint32_t));
+      std::string dependency(len, '\0');
+      read((uint8_t *)dependency.data(), len);
+      uint64_t hash;
+      read((uint8_t *)&hash, sizeof(uint64_t));
+      if (hashFile(dependency) != hash) {
+        SHLOG_DEBUG("Stale artifact: {}, {} changed", path, dependency);
+        return false;
+      }
+    }
+
+    Serialization serialization;
+    serialization.deserialize(read, output);
+    return true;
+  } catch (const std::exception &e) {
+    // most likely a shard changed since the artifact was written
+    SHLOG_DEBUG("Stale artifact: {}, {}", path, e.what());
+    return false;
+  }
+}
+
+std::shared_ptr<SHWire> load(const std::string &path, uint64_t key) {
+  SHVar output{};
+  if (!loadVar(path, key, output))
+    return nullptr;
+  DEFER(Serialization::varFree(output));
+  if (output.valueType != SHType::Wire) {
+    SHLOG_WARNING("Not a wire artifact: {}", path);
+    return nullptr;
+  }
+  return SHWire::sharedFromRef(output.payload.wireValue);
+}
+
+bool storeVar(const std::string &path, uint64_t key, const SHVar &var, const std::vector<std::string> &dependencies) {
+  if (!enabled())
+    return false;
+
+  const fs::path target(path);
+  const auto directory = target.parent_path().string();
+  {
+    std::scoped_lock lock(unwritableMutex);
+    if (unwritable.count(directory))
+      return false;
+  }
+
+  std::vector<uint8_t> buffer(sizeof(Header));
+  Writer write{buffer};
+  uint32_t count = 0;
+  for (auto &dependency : dependencies) {
+    const auto hash = hashFile(dependency);
+    if (!hash) {
+      SHLOG_DEBUG("Not storing artifact: {}, can't read {}", path, dependency);
+      return false;
+    }
+    const auto len = uint32_t(dependency.size());
+    write((const uint8_t *)&len, sizeof(uint32_t));
+    write((const uint8_t *)dependency.data(), len);
+    write((const uint8_t *)&*hash, sizeof(uint64_t));
+    count++;
+  }
+
+  try {
+    Serialization serialization;
+    serialization.serialize(var, write);
+  } catch (const std::exception &e) {
+    SHLOG_DEBUG("Not storing artifact: {}, {}", path, e.what());
+    return false;
+  }
+
+  Header header{};
+  memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.abi = SHARDS_CURRENT_ABI;
+  header.dependencies = count;
+  header.key = key;
+  header.size = buffer.size() - sizeof(Header);
+  header.checksum = XXH3_64bits(buffer.data() + sizeof(Header), buffer.size() - sizeof(Header));
+  memcpy(buffer.data(), &header, sizeof(Header));
+
+  // a read only tree or a missing permission is not an error, we just run without the cache
+  const auto skip = [&](const std::string &why) {
+    SHLOG_DEBUG("Not storing artifacts in {}, {}", directory, why);
+    std::scoped_lock lock(unwritableMutex);
+    unwritable.insert(directory);
+    return false;
+  };
+
+  // readers either see the old artifact or the new one
+  boost::system::error_code ec;
+  if (!directory.empty()) {
+    fs::create_directories(target.parent_path(), ec);
+    if (ec)
+      return skip(ec.message());
+  }
+  const auto temp = target.parent_path() / fs::unique_path(target.filename().string() + ".%%%%-%%%%.tmp", ec);
+  if (ec)
+    return skip(ec.message());
+  {
+    std::ofstream file(temp.string(), std::ios::binary | std::ios::trunc);
+    file.write((const char *)buffer.data(), std::streamsize(buffer.size()));
+    if (!file) {
+      fs::remove(temp, ec);
+      return skip(fmt::format("can't write {}", temp.string()));
+    }
+  }
+  fs::rename(temp, target, ec);
+  if (ec) {
+    const auto why = ec.message();
+    fs::remove(temp, ec);
+    return skip(why);
+  }
+  return true;
+}
+
+bool store(const std::string &path, uint64_t key, const std::shared_ptr<SHWire> &wire,
+           const std::vector<std::string> &dependencies) {
+  return storeVar(path, key, Var(wire), dependencies);
+}
+} // namespace artifact
+} // namespace shards
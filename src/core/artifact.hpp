@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2022 Fragcolor Pte. Ltd. */
+
+#ifndef SH_CORE_ARTIFACT
+#define SH_CORE_ARTIFACT
+
+#include "runtime.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shards {
+// Compiled wire artifacts
+// A script evaluating to a wire can be cached as the serialized wire it built: later loads memory map the artifact and
+// deserialize the wire straight from it, skipping parsing and evaluation. Wires still need to be composed once loaded.
+// An artifact is keyed by a hash of what the evaluation read, the source and whatever the caller passes along, plus the
+// content of the files it depends on. A different key, format version or runtime ABI, a changed dependency or a shard
+// whose hash changed all make an artifact stale, load returns null then and the caller rebuilds it.
+// Setting SHARDS_NO_ARTIFACT_CACHE in the environment turns artifacts off, nothing is loaded nor stored then.
+namespace artifact {
+bool enabled();
+
+uint64_t key(std::string_view source, std::string_view extra = {});
+
+// Where the artifact of a script lives, under the root path, flavor tells apart artifacts built differently from the
+// same script
+std::string pathOf(const std::string &scriptPath, std::string_view flavor = {});
+
+// Null if there is no valid artifact at path for key
+std::shared_ptr<SHWire> load(const std::string &path, uint64_t key);
+
+// Same as load for artifacts holding any var, output must be released with Serialization::varFree
+bool loadVar(const std::string &path, uint64_t key, SHVar &output);
+
+// Replaces the artifact at path atomically, dependencies are the paths of the files the evaluation read besides the
+// source. Returns false, logging why, if the wire could not be serialized or written. A directory that can't be written
+// is not retried for the rest of the run.
+bool store(const std::string &path, uint64_t key, const std::shared_ptr<SHWire> &wire,
+           const std::vector<std::string> &dependencies = {});
+
+bool storeVar(const std::string &path, uint64_t key, const SHVar &var, const std::vector<std::string> &dependencies = {});
+} // namespace artifact
+} // namespace shards
+
+#endif // SH_CORE_ARTIFACT
@@ -155,8 +155,9 @@ public:
 
   static Value eval(form::Form ast, std::shared_ptr<Environment> env, int *line);
 
+  // Evaluating a changed version of the same script only re-reads the top level forms that changed
   Value eval(const std::string &code) {
-    auto forms = read(code);
+    auto forms = read(code, _readCache);
     auto last = forms.back();
     int line = 0;
     for (auto &form : forms) {
@@ -168,6 +169,7 @@ public:
 private:
   std::string _directory;
   std::shared_ptr<Environment> _rootEnv;
+  ReadCache _readCache;
 };
 
 class BuiltIn {
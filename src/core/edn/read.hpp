@@ -3,16 +3,20 @@
 #ifndef SH_LSP_READ_HPP
 #define SH_LSP_READ_HPP
 
+#include <algorithm>
 #include <boost/container/map.hpp>
 #include <boost/container/set.hpp>
 #include <boost/foreach.hpp>
+#include <charconv>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <list>
 #include <map>
 #include <optional>
-#include <regex>
 #include <set>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
 #include <vector>
@@ -36,18 +40,6 @@ enum Type { BOOL, CHAR, LONG, DOUBLE, STRING };
 
 } // namespace value
 
-const std::regex REGEX("([\\s,]+)|"                                // type::WHITESPACE
-                       "(~@|#\\{)|"                                // type::SPECIAL_CHARS
-                       "([\\[\\]{}()\'`~^@])|"                     // type::SPECIAL_CHAR
-                       "(\"(?:\\\\.|[^\\\\\"])*\"?)|"              // type::STRING
-                       "(#\"(?:\\\\.|[^\\\\\"])*\"?)|"             // type::RAW_STRING
-                       "(;.*)|"                                    // type::COMMENT
-                       "(0[xX][0-9a-fA-F]+)|"                      // type::HEX
-                       "([-+]?[0-9]*\\.[0-9]+([eE][-+]?[0-9]+)?)|" // type::DOUBLE
-                       "([-+]?\\d+)|"                              // type::INT
-                       "([^\\s\\[\\]{}(\'\"`,;)]+)"                // type::SYMBOL
-);
-
 struct Token {
   value::Value value;
   type::Type type;
@@ -127,16 +119,242 @@ namespace edn {
 
 namespace token {
 
-inline value::Value parse(std::string value, type::Type type) {
+// A raw token, a view into the source buffer
+struct Lexeme {
+  std::string_view text;
+  type::Type type;
+  int line;
+  int column;
+};
+
+// Hand-written single pass lexer, accepts the same language the old
+// regex based tokenizer did (alternatives are tried in the same order)
+class Lexer {
+public:
+  Lexer(std::string_view input) : _input(input) {}
+
+  // Returns false when the input is exhausted
+  // whitespace and comments are reported too, callers can skip them
+  bool next(Lexeme &lexeme) {
+    if (_pos >= _input.size())
+      return false;
+
+    const auto start = _pos;
+    const auto line = _line;
+    const auto column = int(start - _lineStart) + 1;
+    const auto type = scan();
+    lexeme = Lexeme{_input.substr(start, _pos - start), type, line, column};
+    return true;
+  }
+
+  size_t position() const { return _pos; }
+
+  static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r'; }
+
+  static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+  static bool isHexDigit(char c) { return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+  static bool isSymbolChar(char c) {
+    switch (c) {
+    case '[':
+    case ']':
+    case '{':
+    case '}':
+    case '(':
+    case '\'':
+    case '"':
+    case '`':
+    case ',':
+    case ';':
+    case ')':
+      return false;
+    default:
+      return !isSpace(c);
+    }
+  }
+
+private:
+  char peek(size_t offset = 0) const { return _pos + offset < _input.size() ? _input[_pos + offset] : '\0'; }
+
+  void advance(size_t n = 1) {
+    for (size_t i = 0; i < n && _pos < _input.size(); i++) {
+      if (_input[_pos] == '\n') {
+        _line++;
+        _lineStart = _pos + 1;
+      }
+      _pos++;
+    }
+  }
+
+  // body of a string after the opening quote, includes the closing quote if any
+  void scanString() {
+    while (_pos < _input.size()) {
+      const auto c = _input[_pos];
+      if (c == '\\') {
+        // an escape can't span a line terminator or the end of the input
+        // in that case the string ends right before the backslash
+        if (_pos + 1 >= _input.size() || _input[_pos + 1] == '\n' || _input[_pos + 1] == '\r')
+          return;
+        advance(2);
+      } else if (c == '"') {
+        advance();
+        return;
+      } else {
+        advance();
+      }
+    }
+  }
+
+  // [-+]?[0-9]*\.[0-9]+([eE][-+]?[0-9]+)?
+  size_t matchDouble() const {
+    size_t i = 0;
+    if (peek(i) == '-' || peek(i) == '+')
+      i++;
+    while (isDigit(peek(i)))
+      i++;
+    if (peek(i) != '.' || !isDigit(peek(i + 1)))
+      return 0;
+    i++;
+    while (isDigit(peek(i)))
+      i++;
+    if (peek(i) == 'e' || peek(i) == 'E') {
+      size_t j = i + 1;
+      if (peek(j) == '-' || peek(j) == '+')
+        j++;
+      if (isDigit(peek(j))) {
+        while (isDigit(peek(j)))
+          j++;
+        i = j;
+      }
+    }
+    return i;
+  }
+
+  // [-+]?\d+
+  size_t matchInt() const {
+    size_t i = 0;
+    if (peek(i) == '-' || peek(i) == '+')
+      i++;
+    if (!isDigit(peek(i)))
+      return 0;
+    while (isDigit(peek(i)))
+      i++;
+    return i;
+  }
+
+  type::Type scan() {
+    const auto c = peek();
+
+    if (isSpace(c) || c == ',') {
+      while (_pos < _input.size() && (isSpace(_input[_pos]) || _input[_pos] == ','))
+        advance();
+      return type::WHITESPACE;
+    }
+
+    if ((c == '~' && peek(1) == '@') || (c == '#' && peek(1) == '{')) {
+      advance(2);
+      return type::SPECIAL_CHARS;
+    }
+
+    switch (c) {
+    case '[':
+    case ']':
+    case '{':
+    case '}':
+    case '(':
+    case ')':
+    case '\'':
+    case '`':
+    case '~':
+    case '^':
+    case '@':
+      advance();
+      return type::SPECIAL_CHAR;
+    case '"':
+      advance();
+      scanString();
+      return type::STRING;
+    case ';':
+      while (_pos < _input.size() && _input[_pos] != '\n' && _input[_pos] != '\r')
+        advance();
+      return type::COMMENT;
+    default:
+      break;
+    }
+
+    if (c == '#' && peek(1) == '"') {
+      advance(2);
+      scanString();
+      return type::RAW_STRING;
+    }
+
+    if (c == '0' && (peek(1) == 'x' || peek(1) == 'X') && isHexDigit(peek(2))) {
+      advance(2);
+      while (isHexDigit(peek()))
+        advance();
+      return type::HEX;
+    }
+
+    if (auto len = matchDouble()) {
+      advance(len);
+      return type::DOUBLE;
+    }
+
+    if (auto len = matchInt()) {
+      advance(len);
+      return type::INT;
+    }
+
+    // everything else is a symbol, which always consumes at least one char
+    // (the special chars that are not symbol chars were handled above)
+    advance();
+    while (_pos < _input.size() && isSymbolChar(_input[_pos]))
+      advance();
+    return type::SYMBOL;
+  }
+
+  std::string_view _input;
+  size_t _pos{0};
+  size_t _lineStart{0};
+  int _line{1};
+};
+
+template <typename T> inline T parseInteger(std::string_view value, int base) {
+  if (value.size() > 0 && value[0] == '+')
+    value.remove_prefix(1);
+  if (base == 16 && value.size() > 2 && value[0] == '0' && (value[1] == 'x' || value[1] == 'X'))
+    value.remove_prefix(2);
+  T result{};
+  auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result, base);
+  if (ec == std::errc::result_out_of_range)
+    throw std::out_of_range("integer literal out of range: " + std::string(value));
+  if (ec != std::errc() || ptr != value.data() + value.size())
+    throw std::invalid_argument("invalid integer literal: " + std::string(value));
+  return result;
+}
+
+inline double parseDouble(std::string_view value) {
+  // numeric tokens are short, avoid allocating to get a null terminated string
+  char buffer[64];
+  if (value.size() < sizeof(buffer)) {
+    memcpy(buffer, value.data(), value.size());
+    buffer[value.size()] = '\0';
+    return std::strtod(buffer, nullptr);
+  }
+  return std::stod(std::string(value));
+}
+
+inline value::Value parse(std::string_view value, type::Type type) {
   switch (type) {
   case type::SPECIAL_CHAR:
     return value[0];
   case type::HEX:
-    return (int64_t)std::stoll(value, nullptr, 16);
+    return parseInteger<int64_t>(value, 16);
   case type::INT:
-    return (int64_t)std::stoll(value);
+    return parseInteger<int64_t>(value, 10);
   case type::DOUBLE:
-    return std::stod(value);
+    return parseDouble(value);
   case type::SYMBOL:
     if (value == "true") {
       return true;
@@ -144,33 +362,26 @@ inline value::Value parse(std::string value, type::Type type) {
       return false;
     }
   default:
-    return value;
+    return std::string(value);
   }
 }
 
-inline std::list<Token> tokenize(std::string input) {
-  std::sregex_iterator begin(input.begin(), input.end(), REGEX);
-  std::sregex_iterator end;
+using Tokens = std::vector<Token>;
 
-  std::list<Token> tokens;
-
-  int line = 1;
-
-  for (auto it = begin; it != end; ++it) {
-    std::smatch match = *it;
-    for (size_t i = 1; i < match.size(); ++i) {
-      if (!match[i].str().empty()) {
-        std::string value_str = match.str();
-        type::Type type = static_cast<type::Type>(i - 1);
-        value::Value value = parse(value_str, type);
-        int column = match.position() + 1;
-        tokens.push_back(Token{value, type, line, column});
-        line += std::count(value_str.begin(), value_str.end(), '\n');
-        break;
-      }
-    }
+inline void tokenize(std::string_view input, Tokens &tokens) {
+  Lexer lexer(input);
+  Lexeme lexeme;
+  while (lexer.next(lexeme)) {
+    // the reader never looks at those
+    if (lexeme.type == type::WHITESPACE || lexeme.type == type::COMMENT)
+      continue;
+    tokens.emplace_back(parse(lexeme.text, lexeme.type), lexeme.type, lexeme.line, lexeme.column);
   }
+}
 
+inline Tokens tokenize(std::string_view input) {
+  Tokens tokens;
+  tokenize(input, tokens);
   return tokens;
 }
 
@@ -340,12 +551,12 @@ const std::unordered_map<std::variant<char, std::string>, form::Type> DELIMITER_
 const std::unordered_map<form::Type, char> TYPE_TO_DELIMITER = {
     {form::LIST, ')'}, {form::VECTOR, ']'}, {form::MAP, '}'}, {form::SET, '}'}};
 
-inline std::pair<form::Form, std::list<token::Token>::const_iterator> read_form(const std::list<token::Token> *tokens,
-                                                                                std::list<token::Token>::const_iterator it);
-inline std::optional<std::pair<form::Form, std::list<token::Token>::const_iterator>>
-read_useful_form(const std::list<token::Token> *tokens, std::list<token::Token>::const_iterator it);
-inline std::optional<std::pair<token::Token, std::list<token::Token>::const_iterator>>
-read_useful_token(const std::list<token::Token> *tokens, std::list<token::Token>::const_iterator it);
+inline std::pair<form::Form, token::Tokens::const_iterator> read_form(const token::Tokens *tokens,
+                                                                     token::Tokens::const_iterator it);
+inline std::optional<std::pair<form::Form, token::Tokens::const_iterator>>
+read_useful_form(const token::Tokens *tokens, token::Tokens::const_iterator it);
+inline std::optional<std::pair<token::Token, token::Tokens::const_iterator>>
+read_useful_token(const token::Tokens *tokens, token::Tokens::const_iterator it);
 
 inline form::Form list_to_vector(const std::list<form::FormWrapper> list) {
   return std::vector<form::FormWrapper>{std::make_move_iterator(std::begin(list)), std::make_move_iterator(std::end(list))};
@@ -378,8 +589,8 @@ inline form::Form list_to_set(const std::list<form::FormWrapper> list) {
   return s;
 }
 
-inline std::pair<form::Form, std::list<token::Token>::const_iterator>
-read_coll(const std::list<token::Token> *tokens, std::list<token::Token>::const_iterator it, form::Type form_type) {
+inline std::pair<form::Form, token::Tokens::const_iterator>
+read_coll(const token::Tokens *tokens, token::Tokens::const_iterator it, form::Type form_type) {
   char end_delimiter = TYPE_TO_DELIMITER.at(form_type);
   std::list<form::FormWrapper> forms;
   while (auto ret_opt = read_useful_token(tokens, it)) {
@@ -416,8 +627,8 @@ read_coll(const std::list<token::Token> *tokens, std::list<token::Token>::const_
                         tokens->end());
 }
 
-inline std::pair<form::Form, std::list<token::Token>::const_iterator>
-expand_quoted_form(const std::list<token::Token> *tokens, std::list<token::Token>::const_iterator it, token::Token token) {
+inline std::pair<form::Form, token::Tokens::const_iterator>
+expand_quoted_form(const token::Tokens *tokens, token::Tokens::const_iterator it, token::Token token) {
   if (auto ret_opt = read_useful_form(tokens, it)) {
     auto ret = ret_opt.value();
     std::list<form::FormWrapper> list{form::FormWrapper{token}, ret.first};
@@ -427,8 +638,8 @@ expand_quoted_form(const std::list<token::Token> *tokens, std::list<token::Token
   }
 }
 
-inline std::pair<form::Form, std::list<token::Token>::const_iterator>
-expand_meta_quoted_form(const std::list<token::Token> *tokens, std::list<token::Token>::const_iterator it, token::Token token) {
+inline std::pair<form::Form, token::Tokens::const_iterator>
+expand_meta_quoted_form(const token::Tokens *tokens, token::Tokens::const_iterator it, token::Token token) {
   if (auto ret_opt = read_useful_form(tokens, it)) {
     auto ret = ret_opt.value();
     if (auto ret_opt2 = read_useful_form(tokens, ret.second)) {
@@ -469,8 +680,8 @@ inline std::string &unescape(std::string &in) {
   return in;
 }
 
-inline std::pair<form::Form, std::list<token::Token>::const_iterator> read_form(const std::list<token::Token> *tokens,
-                                                                                std::list<token::Token>::const_iterator it) {
+inline std::pair<form::Form, token::Tokens::const_iterator> read_form(const token::Tokens *tokens,
+                                                                     token::Tokens::const_iterator it) {
   auto token = *it;
   switch (token.type) {
   case token::type::SPECIAL_CHARS: {
@@ -529,8 +740,8 @@ inline std::pair<form::Form, std::list<token::Token>::const_iterator> read_form(
   return std::make_pair(token, ++it);
 }
 
-inline std::optional<std::pair<token::Token, std::list<token::Token>::const_iterator>>
-read_useful_token(const std::list<token::Token> *tokens, std::list<token::Token>::const_iterator it) {
+inline std::optional<std::pair<token::Token, token::Tokens::const_iterator>>
+read_useful_token(const token::Tokens *tokens, token::Tokens::const_iterator it) {
   while (it != tokens->end()) {
     auto token = *it;
     switch (token.type) {
@@ -545,8 +756,8 @@ read_useful_token(const std::list<token::Token> *tokens, std::list<token::Token>
   return std::nullopt;
 }
 
-inline std::optional<std::pair<form::Form, std::list<token::Token>::const_iterator>>
-read_useful_form(const std::list<token::Token> *tokens, std::list<token::Token>::const_iterator it) {
+inline std::optional<std::pair<form::Form, token::Tokens::const_iterator>>
+read_useful_form(const token::Tokens *tokens, token::Tokens::const_iterator it) {
   if (auto ret_opt = read_useful_token(tokens, it)) {
     auto ret = ret_opt.value();
     return read_form(tokens, ret.second);
@@ -555,9 +766,9 @@ read_useful_form(const std::list<token::Token> *tokens, std::list<token::Token>:
   }
 }
 
-inline std::list<form::Form> read_forms(const std::list<token::Token> *tokens) {
+inline std::list<form::Form> read_forms(const token::Tokens *tokens) {
   std::list<form::Form> forms;
-  std::list<token::Token>::const_iterator it = tokens->begin();
+  token::Tokens::const_iterator it = tokens->begin();
   while (auto ret_opt = read_useful_form(tokens, it)) {
     auto ret = ret_opt.value();
     forms.push_back(ret.first);
@@ -566,12 +777,178 @@ inline std::list<form::Form> read_forms(const std::list<token::Token> *tokens) {
   return forms;
 }
 
-inline std::list<form::Form> read(const std::string input) {
+inline std::list<form::Form> read(std::string_view input) {
   auto tokens = token::tokenize(input);
   auto forms = read_forms(&tokens);
   return forms;
 }
 
+// Moves all the tokens of a form by lineDelta lines
+// notice lines don't take part in comparisons, so keys of maps/sets can be patched in place
+inline void relocate(form::Form &form, int lineDelta) {
+  switch (form.index()) {
+  case form::SPECIAL: {
+    auto &special = std::get<form::Special>(form);
+    if (special.token)
+      special.token->line += lineDelta;
+  } break;
+  case form::TOKEN:
+    std::get<token::Token>(form).line += lineDelta;
+    break;
+  case form::LIST:
+    for (auto &item : std::get<std::list<form::FormWrapper>>(form))
+      relocate(item.form, lineDelta);
+    break;
+  case form::VECTOR:
+    for (auto &item : std::get<std::vector<form::FormWrapper>>(form))
+      relocate(item.form, lineDelta);
+    break;
+  case form::MAP:
+    for (auto &item : std::get<form::FormWrapperMap>(form)) {
+      relocate(const_cast<form::Form &>(item.first.form), lineDelta);
+      relocate(item.second.form, lineDelta);
+    }
+    break;
+  case form::SET:
+    for (auto &item : std::get<form::FormWrapperSet>(form))
+      relocate(const_cast<form::Form &>(item.form), lineDelta);
+    break;
+  }
+}
+
+// Keeps the top level forms of a previous read around, keyed by their source text
+// used to re-read scripts on hot reload parsing only the forms that changed
+struct ReadCache {
+  struct Entry {
+    std::list<form::Form> forms;
+    int line;
+    int column;
+    uint64_t generation;
+  };
+
+  std::unordered_map<std::string, Entry> entries;
+  uint64_t generation{0};
+  // stats of the last read
+  size_t hits{0};
+  size_t misses{0};
+};
+
+// Same as read(input) but reuses the forms of unchanged top level forms from the cache
+inline std::list<form::Form> read(std::string_view input, ReadCache &cache) {
+  using namespace token;
+
+  std::list<form::Form> forms;
+  Tokens tokens;
+  Lexer lexer(input);
+  Lexeme lexeme;
+
+  cache.generation++;
+  cache.hits = 0;
+  cache.misses = 0;
+
+  // split the input into top level forms
+  size_t chunkStart = 0;
+  int chunkLine = 0, chunkColumn = 0;
+  int depth = 0, needed = 0;
+  std::vector<Lexeme> chunk;
+
+  const auto flush = [&](size_t chunkEnd) -> bool {
+    const auto text = input.substr(chunkStart, chunkEnd - chunkStart);
+    auto it = cache.entries.find(std::string(text));
+    if (it != cache.entries.end() && it->second.column == chunkColumn) {
+      auto &entry = it->second;
+      if (entry.line != chunkLine) {
+        for (auto &form : entry.forms)
+          relocate(form, chunkLine - entry.line);
+        entry.line = chunkLine;
+      }
+      entry.generation = cache.generation;
+      forms.insert(forms.end(), entry.forms.begin(), entry.forms.end());
+      cache.hits++;
+    } else {
+      tokens.clear();
+      for (auto &item : chunk)
+        tokens.emplace_back(parse(item.text, item.type), item.type, item.line, item.column);
+      auto chunkForms = read_forms(&tokens);
+      cache.misses++;
+      // like read, stop at the first reader error
+      const auto failed = !chunkForms.empty() && chunkForms.back().index() == form::SPECIAL;
+      forms.insert(forms.end(), chunkForms.begin(), chunkForms.end());
+      if (failed)
+        return false;
+      cache.entries[std::string(text)] = ReadCache::Entry{std::move(chunkForms), chunkLine, chunkColumn, cache.generation};
+    }
+    chunk.clear();
+    return true;
+  };
+
+  while (lexer.next(lexeme)) {
+    if (lexeme.type == type::WHITESPACE || lexeme.type == type::COMMENT)
+      continue;
+
+    if (chunk.empty()) {
+      chunkStart = size_t(lexeme.text.data() - input.data());
+      chunkLine = lexeme.line;
+      chunkColumn = lexeme.column;
+      depth = 0;
+      needed = 1;
+    }
+    chunk.push_back(lexeme);
+
+    if (lexeme.type == type::SPECIAL_CHARS) {
+      if (lexeme.text == "#{")
+        depth++;
+      // ~@ just wraps the next form
+    } else if (lexeme.type == type::SPECIAL_CHAR) {
+      switch (lexeme.text[0]) {
+      case '(':
+      case '[':
+      case '{':
+        depth++;
+        break;
+      case ')':
+      case ']':
+      case '}':
+        depth--;
+        if (depth <= 0) {
+          // depth < 0 is an unmatched delimiter, let the reader report it
+          needed = depth < 0 ? 0 : needed - 1;
+        }
+        break;
+      case '^':
+        // metadata + form
+        if (depth == 0)
+          needed++;
+        break;
+      default:
+        // quotes just wrap the next form
+        break;
+      }
+    } else if (depth == 0) {
+      needed--;
+    }
+
+    if (needed == 0 && !flush(lexer.position())) {
+      chunk.clear();
+      break;
+    }
+  }
+
+  // incomplete trailing form, the reader will report the error
+  if (!chunk.empty())
+    flush(input.size());
+
+  // forget forms that are gone
+  for (auto it = cache.entries.begin(); it != cache.entries.end();) {
+    if (it->second.generation != cache.generation)
+      it = cache.entries.erase(it);
+    else
+      ++it;
+  }
+
+  return forms;
+}
+
 } // namespace edn
 } // namespace shards
 
@@ -47,6 +47,13 @@ const unsigned __tsan_switch_to_fiber_no_sync = 1 << 0;
 // Needed specially for win32/32bit
 #include <boost/align/aligned_allocator.hpp>
 
+// __rdtsc, see shards::CycleClock
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif (defined(__x86_64__) || defined(__i386__)) && !defined(__EMSCRIPTEN__)
+#include <x86intrin.h>
+#endif
+
 // TODO make it into a run-time param
 #ifndef NDEBUG
 #define SH_BASE_STACK_SIZE 1024 * 1024
@@ -144,6 +151,11 @@ void setSharedVariable(const char *name, const SHVar &value);
 void unsetSharedVariable(const char *name);
 SHVar getSharedVariable(const char *name);
 SHWireState suspend(SHContext *context, double seconds);
+// Suspends until flag is set, without resuming the wire in between
+// whoever sets the flag must then call CompletionSignal::notify
+SHWireState suspendUntil(SHContext *context, const std::atomic_bool &flag);
+// Same but also resumes once seconds elapsed
+SHWireState suspendUntil(SHContext *context, const std::atomic_bool &flag, double seconds);
 
 Shard *createShard(std::string_view name);
 void registerCoreShards();
@@ -256,6 +268,52 @@ private:
 };
 } // namespace shards
 
+namespace shards {
+struct DirectRun;
+
+// Cheap timestamps for CPU time accounting, a handful of cycles per read:
+// the time stamp counter on x86 (invariant on any recent CPU), the virtual counter on arm64, the steady clock elsewhere
+struct CycleClock {
+  static uint64_t now() {
+#if defined(__EMSCRIPTEN__)
+    return uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+#elif defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+  }
+
+  // Calibrated once against the steady clock
+  static double secondsPerCycle();
+
+  static double seconds(uint64_t cycles) { return double(cycles) * secondsPerCycle(); }
+};
+
+// CPU time spent resuming a wire, accounted by shards::tick, times are CycleClock cycles
+struct WireStats {
+  uint64_t resumes{0};
+  uint64_t total{0};
+  uint64_t last{0};
+  uint64_t max{0};
+  // resumes that took longer than SHWire::budget
+  uint64_t overruns{0};
+  // ticks the mesh skipped this wire because its frame budget was spent
+  uint64_t deferrals{0};
+
+  void add(uint64_t cycles) {
+    resumes++;
+    total += cycles;
+    last = cycles;
+    max = std::max(max, cycles);
+  }
+};
+} // namespace shards
+
 #ifndef __EMSCRIPTEN__
 struct SHStackAllocator {
   size_t size{SH_BASE_STACK_SIZE};
@@ -327,9 +385,21 @@ struct SHWire : public std::enable_shared_from_this<SHWire> {
   bool unsafe{false};
   bool pure{false};
 
+  // Scheduling, see SHMesh::tick
+  // seconds of CPU time a single resume may take before the mesh records an overrun, 0 means no budget
+  double budget{0.0};
+  // higher priorities are resumed earlier in the tick and never deferred by the mesh frame budget
+  int priority{0};
+  shards::WireStats stats;
+
   std::string name;
 
   std::optional<SHCoro> coro;
+  // set by composeWire when none of the shards of the wire can suspend it,
+  // such wires are prepared without coroutine and run on the stack of whoever ticks them
+  mutable bool nonSuspending{false};
+  // replaces coro for wires prepared without coroutine, see shards::prepare
+  std::shared_ptr<shards::DirectRun> directRun;
 #ifdef SH_USE_TSAN
   void *tsan_coro{nullptr};
 #endif
@@ -843,6 +913,8 @@ inline void swap(SHVar &v1, SHVar &v2) {
 namespace shards {
 NO_INLINE void _destroyVarSlow(SHVar &var);
 NO_INLINE void _cloneVarSlow(SHVar &dst, const SHVar &src);
+// drops the cached hash of a frozen container
+void _evictHash(const SHVar &var);
 
 ALWAYS_INLINE inline void destroyVar(SHVar &var) {
   switch (var.valueType) {
@@ -1,8 +1,16 @@
 #include "number_types.hpp"
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <type_traits>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 namespace shards {
 
 std::map<SHType, NumberType> getSHTypeToNumberTypeMap() {
@@ -23,21 +31,201 @@ std::map<SHType, NumberType> getSHTypeToNumberTypeMap() {
   // clang-format on
 };
 
+template <typename TOut, typename TIn> inline TOut saturateNumber(TIn v) {
+  using InLimits = std::numeric_limits<TIn>;
+  using OutLimits = std::numeric_limits<TOut>;
+  if constexpr (std::is_integral_v<TOut> && std::is_floating_point_v<TIn>) {
+    constexpr TIn lo = TIn(OutLimits::min());
+    constexpr TIn hi = TIn(OutLimits::max());
+    v = v == v ? v : TIn(0);
+    if constexpr (OutLimits::digits <= InLimits::digits) {
+      // Bounds are exact, branch-free clamp
+      v = v < lo ? lo : v;
+      v = v > hi ? hi : v;
+      return TOut(v);
+    } else {
+      // hi got rounded up to the next power of two
+      if (v >= hi)
+        return OutLimits::max();
+      return v <= lo ? OutLimits::min() : TOut(v);
+    }
+  } else if constexpr (std::is_integral_v<TOut>) {
+    // All our integer types fit in int64_t
+    constexpr int64_t lo = std::max<int64_t>(OutLimits::min(), InLimits::min());
+    constexpr int64_t hi = std::min<int64_t>(OutLimits::max(), InLimits::max());
+    if constexpr (lo > int64_t(InLimits::min()))
+      v = v < TIn(lo) ? TIn(lo) : v;
+    if constexpr (hi < int64_t(InLimits::max()))
+      v = v > TIn(hi) ? TIn(hi) : v;
+    return TOut(v);
+  } else if constexpr (std::is_floating_point_v<TIn> && sizeof(TOut) < sizeof(TIn)) {
+    constexpr TIn lo = TIn(OutLimits::lowest());
+    constexpr TIn hi = TIn(OutLimits::max());
+    v = v < lo ? lo : v;
+    v = v > hi ? hi : v;
+    return TOut(v);
+  } else {
+    return TOut(v);
+  }
+}
+
+template <typename TOut, typename TIn> inline TOut normalizeNumber(TIn v) {
+  if constexpr (std::is_integral_v<TIn> && std::is_floating_point_v<TOut>) {
+    TOut r = TOut(v) / TOut(std::numeric_limits<TIn>::max());
+    if constexpr (std::is_signed_v<TIn>)
+      r = r < TOut(-1) ? TOut(-1) : r;
+    return r;
+  } else if constexpr (std::is_floating_point_v<TIn> && std::is_integral_v<TOut>) {
+    constexpr TIn lo = std::is_signed_v<TOut> ? TIn(-1) : TIn(0);
+    v = v == v ? v : TIn(0);
+    v = v < lo ? lo : v;
+    v = v > TIn(1) ? TIn(1) : v;
+    v = v * TIn(std::numeric_limits<TOut>::max());
+    v += v < TIn(0) ? TIn(-0.5) : TIn(0.5);
+    return saturateNumber<TOut>(v);
+  } else {
+    return saturateNumber<TOut>(v);
+  }
+}
+
+template <typename TIn, typename TOut, NumberConversionMode Mode> struct TNumberKernel {
+  static inline TOut convert(TIn v) {
+    if constexpr (Mode == NumberConversionMode::Cast) {
+      return (TOut)v;
+    } else if constexpr (Mode == NumberConversionMode::Saturate) {
+      return saturateNumber<TOut>(v);
+    } else {
+      return normalizeNumber<TOut>(v);
+    }
+  }
+
+  // Written to be auto-vectorized, hot pairs are specialized below
+  static void contiguous(const TIn *__restrict src, TOut *__restrict dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      dst[i] = convert(src[i]);
+    }
+  }
+
+  static void run(const void *src, size_t srcStride, void *dst, size_t dstStride, size_t count) {
+    if (srcStride == sizeof(TIn) && dstStride == sizeof(TOut)) {
+      contiguous((const TIn *)src, (TOut *)dst, count);
+    } else {
+      const uint8_t *in = (const uint8_t *)src;
+      uint8_t *out = (uint8_t *)dst;
+      for (size_t i = 0; i < count; i++) {
+        TIn v;
+        memcpy(&v, in, sizeof(TIn));
+        TOut r = convert(v);
+        memcpy(out, &r, sizeof(TOut));
+        in += srcStride;
+        out += dstStride;
+      }
+    }
+  }
+};
+
+#if defined(__AVX2__)
+template <>
+void TNumberKernel<uint8_t, float, NumberConversionMode::Normalize>::contiguous(const uint8_t *__restrict src,
+                                                                              float *__restrict dst, size_t count) {
+  const __m256 scale = _mm256_set1_ps(255.0f);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i u8 = _mm_loadl_epi64((const __m128i *)(src + i));
+    __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(u8));
+    _mm256_storeu_ps(dst + i, _mm256_div_ps(f, scale));
+  }
+  for (; i < count; i++) {
+    dst[i] = convert(src[i]);
+  }
+}
+
+template <>
+void TNumberKernel<float, uint8_t, NumberConversionMode::Normalize>::contiguous(const float *__restrict src,
+                                                                              uint8_t *__restrict dst, size_t count) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 scale = _mm256_set1_ps(255.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    // max first so that NaN becomes 0 like the scalar path
+    __m256 f = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zero), one);
+    __m256i i32 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(f, scale), half));
+    __m128i i16 = _mm_packus_epi32(_mm256_castsi256_si128(i32), _mm256_extracti128_si256(i32, 1));
+    _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(i16, i16));
+  }
+  for (; i < count; i++) {
+    dst[i] = convert(src[i]);
+  }
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+template <>
+void TNumberKernel<uint8_t, float, NumberConversionMode::Normalize>::contiguous(const uint8_t *__restrict src,
+                                                                              float *__restrict dst, size_t count) {
+  const float32x4_t scale = vdupq_n_f32(255.0f);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t u16 = vmovl_u8(vld1_u8(src + i));
+    vst1q_f32(dst + i, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(u16))), scale));
+    vst1q_f32(dst + i + 4, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(u16))), scale));
+  }
+  for (; i < count; i++) {
+    dst[i] = convert(src[i]);
+  }
+}
+
+template <>
+void TNumberKernel<float, uint8_t, NumberConversionMode::Normalize>::contiguous(const float *__restrict src,
+                                                                              uint8_t *__restrict dst, size_t count) {
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t scale = vdupq_n_f32(255.0f);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  const auto toU16 = [&](float32x4_t f) {
+    // maxnm turns NaN into 0 like the scalar path
+    f = vminq_f32(vmaxnmq_f32(f, zero), one);
+    return vmovn_u32(vcvtq_u32_f32(vaddq_f32(vmulq_f32(f, scale), half)));
+  };
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t u16 = vcombine_u16(toU16(vld1q_f32(src + i)), toU16(vld1q_f32(src + i + 4)));
+    vst1_u8(dst + i, vmovn_u16(u16));
+  }
+  for (; i < count; i++) {
+    dst[i] = convert(src[i]);
+  }
+}
+#endif
+
 template <typename TIn, typename TOut> struct TNumberConversion : NumberConversion {
   TNumberConversion() {
     inStride = sizeof(TIn);
     outStride = sizeof(TOut);
     convertOne = [](const void *src, void *dst) { ((TOut *)dst)[0] = (TOut)((TIn *)src)[0]; };
     convertMultipleSeq = [](const void *src, void *dst, size_t srcLen, const SHSeq &sequence) {
+      // Validate all the indices upfront so that the copy loop is check free
+      bool outOfRange = false;
       for (size_t dstIndex = 0; dstIndex < sequence.len; dstIndex++) {
-        SHInt srcIndex = sequence.elements[dstIndex].payload.intValue;
-        if (srcIndex >= (SHInt)srcLen || srcIndex < 0) {
-          throw NumberConversionOutOfRangeEx(srcIndex);
+        outOfRange |= uint64_t(sequence.elements[dstIndex].payload.intValue) >= uint64_t(srcLen);
+      }
+      if (outOfRange) {
+        for (size_t dstIndex = 0; dstIndex < sequence.len; dstIndex++) {
+          SHInt srcIndex = sequence.elements[dstIndex].payload.intValue;
+          if (srcIndex >= (SHInt)srcLen || srcIndex < 0) {
+            throw NumberConversionOutOfRangeEx(srcIndex);
+          }
         }
+      }
 
+      for (size_t dstIndex = 0; dstIndex < sequence.len; dstIndex++) {
+        SHInt srcIndex = sequence.elements[dstIndex].payload.intValue;
         ((TOut *)dst)[dstIndex] = (TOut)((TIn *)src)[srcIndex];
       }
     };
+    convertMany[(size_t)NumberConversionMode::Cast] = &TNumberKernel<TIn, TOut, NumberConversionMode::Cast>::run;
+    convertMany[(size_t)NumberConversionMode::Saturate] = &TNumberKernel<TIn, TOut, NumberConversionMode::Saturate>::run;
+    convertMany[(size_t)NumberConversionMode::Normalize] = &TNumberKernel<TIn, TOut, NumberConversionMode::Normalize>::run;
   }
 };
 
@@ -50,6 +238,7 @@ template <typename TIn> struct TNumberConversionTable : public NumberConversionT
     set(NumberType::Int64, TNumberConversion<TIn, int64_t>());
     set(NumberType::Float32, TNumberConversion<TIn, float>());
     set(NumberType::Float64, TNumberConversion<TIn, double>());
+    set(NumberType::UInt16, TNumberConversion<TIn, uint16_t>());
   }
 
   void set(const NumberType &numberType, const NumberConversion &numberConversion) {
@@ -68,6 +257,10 @@ template <> struct TNumberStringOperations<int8_t> {
   static void parse(int8_t *out, const char *input, char **inputEnd) { out[0] = (int8_t)std::strtol(input, inputEnd, 10); }
 };
 
+template <> struct TNumberStringOperations<uint16_t> {
+  static void parse(uint16_t *out, const char *input, char **inputEnd) { out[0] = (uint16_t)std::strtoul(input, inputEnd, 10); }
+};
+
 template <> struct TNumberStringOperations<int16_t> {
   static void parse(int16_t *out, const char *input, char **inputEnd) { out[0] = (int16_t)std::strtoul(input, inputEnd, 10); }
 };
@@ -109,6 +302,7 @@ NUMBER_TYPE_TRAITS(NumberType::Int32, int32_t);
 NUMBER_TYPE_TRAITS(NumberType::Int64, int64_t);
 NUMBER_TYPE_TRAITS(NumberType::Float32, float);
 NUMBER_TYPE_TRAITS(NumberType::Float64, double);
+NUMBER_TYPE_TRAITS(NumberType::UInt16, uint16_t);
 
 #undef NUMBER_TYPE_TRAITS
 
@@ -173,6 +367,7 @@ NumberTypeLookup::NumberTypeLookup() {
   set(TNumberTypeTraits<NumberType::Int64>());
   set(TNumberTypeTraits<NumberType::Float32>());
   set(TNumberTypeTraits<NumberType::Float64>());
+  set(TNumberTypeTraits<NumberType::UInt16>());
   buildConversionInfo();
 }
 
@@ -239,6 +434,13 @@ const VectorTypeTraits *VectorTypeLookup::findCompatibleType(bool isInteger, siz
   return nullptr;
 }
 
+void convertNumbers(NumberType srcType, const void *src, size_t srcStride, NumberType dstType, void *dst, size_t dstStride,
+                    size_t count, NumberConversionMode mode) {
+  const NumberConversion *conversion = NumberTypeLookup::getInstance().getConversion(srcType, dstType);
+  shassert(conversion);
+  conversion->getConvertMany(mode)(src, srcStride, dst, dstStride, count);
+}
+
 const std::vector<NumberType> &getSHTypeToNumberTypeArrayMap() {
   static std::vector<NumberType> result = []() {
     std::vector<NumberType> result;
@@ -0,0 +1,228 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2019 Fragcolor Pte. Ltd. */
+
+#include "runtime.hpp"
+#include <cstring>
+#include <random>
+
+namespace shards {
+namespace {
+constexpr char LogMagic[4] = {'S', 'H', 'R', 'R'};
+constexpr uint8_t LogVersion = 2;
+
+const char *kindName(uint8_t kind) {
+  switch (Recorder::Kind(kind)) {
+  case Recorder::Kind::Clock:
+    return "Clock";
+  case Recorder::Kind::Time:
+    return "Time";
+  case Recorder::Kind::Epoch:
+    return "Epoch";
+  case Recorder::Kind::Seed:
+    return "Seed";
+  case Recorder::Kind::Completion:
+    return "Completion";
+  case Recorder::Kind::Receive:
+    return "Receive";
+  case Recorder::Kind::Data:
+    return "Data";
+  }
+  return "Unknown";
+}
+} // namespace
+
+std::shared_ptr<Recorder> Recorder::record(const std::string &path) {
+  std::shared_ptr<Recorder> recorder(new Recorder(Mode::Record));
+  recorder->_file.open(path, std::ios::trunc | std::ios::binary);
+  if (!recorder->_file)
+    throw SHException("Failed to open recording file: " + path);
+  recorder->putBytes(LogMagic, sizeof(LogMagic));
+  recorder->putByte(LogVersion);
+  return recorder;
+}
+
+std::shared_ptr<Recorder> Recorder::replay(const std::string &path) {
+  std::shared_ptr<Recorder> recorder(new Recorder(Mode::Replay));
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    throw SHException("Failed to open recording file: " + path);
+  recorder->_log.assign(std::istreambuf_iterator<char>(file), {});
+  if (recorder->_log.size() < sizeof(LogMagic) + 1 || memcmp(recorder->_log.data(), LogMagic, sizeof(LogMagic)) != 0)
+    throw SHException("Not a recording file: " + path);
+  if (recorder->_log[sizeof(LogMagic)] != LogVersion)
+    throw SHException("Unsupported recording version: " + path);
+  recorder->_cursor = sizeof(LogMagic) + 1;
+  return recorder;
+}
+
+Recorder::~Recorder() { flush(); }
+
+void Recorder::flush() {
+  if (_mode != Mode::Record || _log.empty())
+    return;
+  _file.write((const char *)_log.data(), std::streamsize(_log.size()));
+  _file.flush();
+  _log.clear();
+}
+
+SHClock::time_point Recorder::clock() {
+  int64_t ns;
+  if (_mode == Mode::Record) {
+    ns = std::chrono::duration_cast<std::chrono::nanoseconds>(SHClock::now().time_since_epoch()).count();
+    put(Kind::Clock);
+    putZigzag(ns - _lastClock);
+  } else {
+    expect(Kind::Clock);
+    ns = _lastClock + getZigzag();
+  }
+  _lastClock = ns;
+  // both sides go through nanoseconds so they see the exact same value
+  return SHClock::time_point(std::chrono::duration_cast<SHClock::duration>(std::chrono::nanoseconds(ns)));
+}
+
+double Recorder::time(double live) {
+  if (_mode == Mode::Record) {
+    put(Kind::Time);
+    putBytes(&live, sizeof(double));
+    return live;
+  }
+  expect(Kind::Time);
+  double value;
+  memcpy(&value, getBytes(sizeof(double)), sizeof(double));
+  return value;
+}
+
+int64_t Recorder::epoch(int64_t live) {
+  if (_mode == Mode::Record) {
+    put(Kind::Epoch);
+    putZigzag(live);
+    return live;
+  }
+  expect(Kind::Epoch);
+  return getZigzag();
+}
+
+uint64_t Recorder::seed() {
+  if (!_seeded) {
+    if (_mode == Mode::Record) {
+      std::random_device rd;
+      _seed = (uint64_t(rd()) << 32) | uint64_t(rd());
+      put(Kind::Seed);
+      putVarint(_seed);
+    } else {
+      expect(Kind::Seed);
+      _seed = getVarint();
+    }
+    _seeded = true;
+  }
+  return _seed;
+}
+
+bool Recorder::completed(const std::atomic_bool &flag) {
+  // parked wires are checked on every tick, only the check that resumes one is logged, along with the count of
+  // checks that found work pending since the previous entry
+  if (_mode == Mode::Record) {
+    if (!flag.load(std::memory_order_acquire)) {
+      _pendingChecks++;
+      return false;
+    }
+    const auto pending = _pendingChecks;
+    put(Kind::Completion);
+    putVarint(pending);
+    return true;
+  }
+
+  if (_cursor >= _log.size() || _log[_cursor] != uint8_t(Kind::Completion)) {
+    _pendingChecks++;
+    return false;
+  }
+  const auto entry = _cursor++;
+  if (getVarint() != _pendingChecks) {
+    // a later check resumes the wire
+    _cursor = entry;
+    _pendingChecks++;
+    return false;
+  }
+  _pendingChecks = 0;
+  // the work completed at this point of the recording, it must complete now too
+  while (!flag.load(std::memory_order_acquire)) {
+    const auto generation = CompletionSignal::generation();
+    if (flag.load(std::memory_order_acquire))
+      break;
+    CompletionSignal::wait(generation, SHDuration(0.1));
+  }
+  return true;
+}
+
+void Recorder::putVarint(uint64_t value) {
+  while (value >= 0x80) {
+    putByte(uint8_t(value) | 0x80);
+    value >>= 7;
+  }
+  putByte(uint8_t(value));
+}
+
+void Recorder::putBytes(const void *data, size_t size) {
+  const auto bytes = (const uint8_t *)data;
+  _log.insert(_log.end(), bytes, bytes + size);
+  if (unlikely(_log.size() >= FlushSize))
+    flush();
+}
+
+void Recorder::putVar(const SHVar &var) {
+  std::vector<uint8_t> buffer;
+  Serialization serial;
+  auto write = [&](const uint8_t *data, size_t size) { buffer.insert(buffer.end(), data, data + size); };
+  serial.serialize(var, write);
+  putVarint(buffer.size());
+  putBytes(buffer.data(), buffer.size());
+}
+
+void Recorder::expect(Kind kind) {
+  if (unlikely(_cursor >= _log.size()))
+    throw ActivationError(std::string("Replay diverged, expected ") + kindName(uint8_t(kind)) + " but the recording ended");
+  const auto found = _log[_cursor++];
+  _pendingChecks = 0;
+  if (unlikely(found != uint8_t(kind)))
+    throw ActivationError(std::string("Replay diverged, expected ") + kindName(uint8_t(kind)) + " but the recording has " +
+                          kindName(found));
+}
+
+uint8_t Recorder::getByte() { return uint8_t(*getBytes(1)); }
+
+uint64_t Recorder::getVarint() {
+  uint64_t value = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    const auto byte = getByte();
+    value |= uint64_t(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+      break;
+  }
+  return value;
+}
+
+const char *Recorder::getBytes(size_t size) {
+  if (unlikely(_log.size() - _cursor < size))
+    throw ActivationError("Replay diverged, the recording is truncated");
+  const auto data = (const char *)_log.data() + _cursor;
+  _cursor += size;
+  return data;
+}
+
+void Recorder::getVar(SHVar &var) {
+  const auto size = getVarint();
+  const auto data = (const uint8_t *)getBytes(size);
+  size_t offset = 0;
+  Serialization serial;
+  SHVar tmp{};
+  auto read = [&](uint8_t *buf, size_t len) {
+    if (offset + len > size)
+      throw ActivationError("Replay diverged, invalid recorded value");
+    memcpy(buf, data + offset, len);
+    offset += len;
+  };
+  serial.deserialize(read, tmp);
+  cloneVar(var, tmp);
+  Serialization::varFree(tmp);
+}
+} // namespace shards
@@ -0,0 +1,187 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2019 Fragcolor Pte. Ltd. */
+
+#ifndef SH_CORE_REPLAY
+#define SH_CORE_REPLAY
+
+// included by runtime.hpp, after the clock types
+#include "shards.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace shards {
+// Deterministic record and replay of mesh executions
+// A Recorder attached to a mesh logs every nondeterministic input its wires consume: clock reads, random seeds,
+// completions of offloaded work, channel receives and I/O results. Replaying the log feeds the same inputs back
+// so that a run can be reproduced bit for bit offline, sockets and child processes are still opened during a replay
+// but the data they deliver comes from the log.
+// The recorder is current on the thread ticking its mesh for the duration of each tick, inputs consumed by work
+// offloaded to other threads are not recorded, only its results as they re-enter the wire.
+class Recorder {
+public:
+  enum class Mode { Record, Replay };
+
+  enum class Kind : uint8_t {
+    Clock = 1,  // SHClock reads, delta coded nanoseconds
+    Time,       // Time shards outputs (seconds or milliseconds)
+    Epoch,      // system clock reads in milliseconds
+    Seed,       // random generator seeds
+    Completion, // offloaded work completions resuming a wire
+    Receive,    // channel receives
+    Data,       // I/O results
+  };
+
+  enum class Received : uint8_t { Empty, Value, Closed };
+
+  static std::shared_ptr<Recorder> record(const std::string &path);
+  static std::shared_ptr<Recorder> replay(const std::string &path);
+
+  ~Recorder();
+
+  Mode mode() const { return _mode; }
+  bool replaying() const { return _mode == Mode::Replay; }
+  // a replay ran out of log, the recording ended here
+  bool exhausted() const { return _mode == Mode::Replay && _cursor >= _log.size(); }
+
+  static Recorder *current() { return _current; }
+
+  // Makes recorder current on this thread until destroyed, a null recorder keeps the current one (nested meshes)
+  struct Scope {
+    Scope(Recorder *recorder) : _previous(_current) {
+      if (recorder)
+        _current = recorder;
+    }
+    ~Scope() { _current = _previous; }
+
+  private:
+    Recorder *_previous;
+  };
+
+  SHClock::time_point clock();
+  double time(double live);
+  int64_t epoch(int64_t live);
+  // one seed per recorder, random generators reseed when they see a new id
+  uint64_t seed();
+  uint64_t id() const { return _id; }
+  // Returns if flag was seen set, a replay waits for flag if it was
+  bool completed(const std::atomic_bool &flag);
+
+  // poll tries to receive into output returning Empty, Value or Closed, it's not called when replaying
+  // replayed values are cloned into output, the caller owns them
+  template <typename Poll> Received receive(SHVar &output, Poll poll) {
+    if (_mode == Mode::Record) {
+      const auto received = poll(output);
+      put(Kind::Receive);
+      putByte(uint8_t(received));
+      if (received == Received::Value)
+        putVar(output);
+      return received;
+    }
+    expect(Kind::Receive);
+    const auto received = Received(getByte());
+    if (received == Received::Value)
+      getVar(output);
+    return received;
+  }
+
+  // live fills data and returns true, or returns false if there was nothing (end of stream etc), it's not called when
+  // replaying
+  template <typename Live> bool data(std::string &data, Live live) {
+    if (_mode == Mode::Record) {
+      const auto ok = live();
+      put(Kind::Data);
+      putByte(ok ? 1 : 0);
+      if (ok) {
+        putVarint(data.size());
+        putBytes(data.data(), data.size());
+      }
+      return ok;
+    }
+    expect(Kind::Data);
+    if (getByte() == 0)
+      return false;
+    const auto size = getVarint();
+    data.assign(getBytes(size), size);
+    return true;
+  }
+
+  void flush();
+
+private:
+  Recorder(Mode mode) : _mode(mode), _id(_nextId.fetch_add(1)) {}
+
+  void put(Kind kind) {
+    _pendingChecks = 0;
+    putByte(uint8_t(kind));
+  }
+  void putByte(uint8_t value) {
+    _log.push_back(value);
+    if (unlikely(_log.size() >= FlushSize))
+      flush();
+  }
+  void putVarint(uint64_t value);
+  void putZigzag(int64_t value) { putVarint((uint64_t(value) << 1) ^ uint64_t(value >> 63)); }
+  void putBytes(const void *data, size_t size);
+  void putVar(const SHVar &var);
+
+  void expect(Kind kind);
+  uint8_t getByte();
+  uint64_t getVarint();
+  int64_t getZigzag() {
+    const auto value = getVarint();
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+  }
+  const char *getBytes(size_t size);
+  void getVar(SHVar &var);
+
+  static constexpr size_t FlushSize = 64 * 1024;
+
+  static inline thread_local Recorder *_current{nullptr};
+  static inline std::atomic_uint64_t _nextId{1};
+
+  Mode _mode;
+  uint64_t _id;
+  // record: pending bytes, replay: the whole log
+  std::vector<uint8_t> _log;
+  size_t _cursor{0};
+  std::ofstream _file;
+  int64_t _lastClock{0};
+  // completion checks that found the work pending since the last entry
+  uint64_t _pendingChecks{0};
+  bool _seeded{false};
+  uint64_t _seed{0};
+};
+
+// The clock wires see, recorded or replayed when a Recorder is current
+inline SHClock::time_point clockNow() {
+  auto recorder = Recorder::current();
+  if (likely(recorder == nullptr))
+    return SHClock::now();
+  return recorder->clock();
+}
+
+// Records (or replays) a Time shard output
+inline double recordTime(double live) {
+  auto recorder = Recorder::current();
+  return likely(recorder == nullptr) ? live : recorder->time(live);
+}
+
+// Records (or replays) a system clock read in milliseconds
+inline int64_t recordEpoch(int64_t live) {
+  auto recorder = Recorder::current();
+  return likely(recorder == nullptr) ? live : recorder->epoch(live);
+}
+
+// Records (or replays) an I/O result, see Recorder::data
+template <typename Live> bool recordData(std::string &data, Live live) {
+  auto recorder = Recorder::current();
+  return likely(recorder == nullptr) ? live() : recorder->data(data, live);
+}
+} // namespace shards
+
+#endif // SH_CORE_REPLAY
@@ -7,14 +7,23 @@
 #include <boost/asio/thread_pool.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/stacktrace.hpp>
+#include <climits>
+#include <condition_variable>
 #include <csignal>
 #include <cstdarg>
 #include <pdqsort.h>
 #include <set>
+#include <shared_mutex>
 #include <string.h>
 #include <unordered_set>
 #include <log/log.hpp>
 
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace fs = boost::filesystem;
 
 using namespace shards;
@@ -642,7 +651,7 @@ SHWireState suspend(SHContext *context, double seconds) {
   if (seconds <= 0) {
     context->next = SHDuration(0);
   } else {
-    context->next = SHClock::now().time_since_epoch() + SHDuration(seconds);
+    context->next = clockNow().time_since_epoch() + SHDuration(seconds);
   }
 
 #ifdef SH_USE_TSAN
@@ -663,6 +672,77 @@ SHWireState suspend(SHContext *context, double seconds) {
   return context->getState();
 }
 
+SHWireState suspendUntil(SHContext *context, const std::atomic_bool &flag) {
+  // never due by time, tick resumes us once flag is set
+  return suspendUntil(context, flag, std::numeric_limits<double>::infinity());
+}
+
+SHWireState suspendUntil(SHContext *context, const std::atomic_bool &flag, double seconds) {
+  context->awaiting = &flag;
+  DEFER(context->awaiting = nullptr);
+  return suspend(context, seconds);
+}
+
+#if !defined(__linux__)
+namespace {
+std::mutex completionMutex;
+std::condition_variable completionCond;
+} // namespace
+#endif
+
+void CompletionSignal::notify() {
+  // seq_cst pairs with the waiters increment in wait, either we see the waiter or it sees the new generation
+  _generation.fetch_add(1);
+  if (_waiters.load() == 0)
+    return;
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&_generation), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+  { std::scoped_lock lock(completionMutex); }
+  completionCond.notify_all();
+#endif
+}
+
+void CompletionSignal::wait(uint32_t seen, SHDuration timeout) {
+  // keep timeouts representable
+  const auto seconds = std::min(timeout.count(), 3600.0);
+  if (!(seconds > 0.0))
+    return;
+
+  _waiters.fetch_add(1);
+  DEFER(_waiters.fetch_sub(1));
+#if defined(__linux__)
+  if (_generation.load() != seen)
+    return;
+  struct timespec ts;
+  ts.tv_sec = decltype(ts.tv_sec)(seconds);
+  ts.tv_nsec = decltype(ts.tv_nsec)((seconds - double(ts.tv_sec)) * 1000000000.0);
+  // returns right away if the generation already moved, spurious wakeups are fine
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&_generation), FUTEX_WAIT_PRIVATE, seen, &ts, nullptr, 0);
+#else
+  std::unique_lock lock(completionMutex);
+  completionCond.wait_for(lock, SHDuration(seconds), [&]() { return _generation.load() != seen; });
+#endif
+}
+
+namespace {
+// taken at load time, by the first tick the calibration window usually elapsed already
+const auto calibrationCycles = CycleClock::now();
+const auto calibrationTime = std::chrono::steady_clock::now();
+} // namespace
+
+double CycleClock::secondsPerCycle() {
+  static const double value = []() {
+    // counts cycles over at least 10ms of steady clock
+    auto elapsed = std::chrono::steady_clock::now() - calibrationTime;
+    while (elapsed < std::chrono::milliseconds(10))
+      elapsed = std::chrono::steady_clock::now() - calibrationTime;
+    const auto cycles = CycleClock::now() - calibrationCycles;
+    return std::chrono::duration<double>(elapsed).count() / double(std::max(cycles, uint64_t(1)));
+  }();
+  return value;
+}
+
 void hash_update(const SHVar &var, void *state);
 
 std::unordered_set<const SHWire *> &gatheringWires() {
@@ -1319,6 +1399,44 @@ SHComposeResult composeWire(const std::vector<Shard *> &wire, SHValidationCallba
   return result;
 }
 
+namespace {
+// Shards known to never suspend the wire running them, anything else (including every extension shard) is assumed
+// to possibly suspend. Shards nested in these are checked too as gatherShards visits them.
+bool neverSuspends(const Shard *shard) {
+  static const std::unordered_set<std::string_view> names{
+      "Const", "Set", "Ref", "Update", "Push", "Sequence", "Table", "Get", "Swap", "Clear", "Pop", "PopFront", "Drop",
+      "DropFront", "Count", "Take", "RTake", "Slice", "Limit", "Sort", "Remove", "Erase", "AppendTo", "PrependTo", "Assoc",
+      "Replace", "Reverse", "Flatten", "IndexOf", "IsIn", "IndexIn", "Distinct", "GroupBy", "Join", "And", "Or", "Not", "Is",
+      "IsNot", "IsMore", "IsLess", "IsMoreEqual", "IsLessEqual", "Any", "All", "AnyNot", "AllNot", "AnyMore", "AllMore",
+      "AnyLess", "AllLess", "AnyMoreEqual", "AllMoreEqual", "AnyLessEqual", "AllLessEqual", "IsValidNumber", "IsNone",
+      "IsNotNone", "NaNTo0", "Input", "Pass", "Comment", "Hash", "Once", "Repeat", "ForEach", "ForRange", "Map", "Reduce", "When",
+      "WhenNot", "If", "Match", "Cond", "Maybe", "Sub", "Hashed", "Do", "Dispatch", "Return", "Restart", "Fail", "Log", "Msg",
+      "ToInt", "ToInt2", "ToInt3", "ToInt4", "ToInt8", "ToInt16", "ToColor", "ToFloat", "ToFloat2", "ToFloat3", "ToFloat4",
+      "ToString", "ToHex", "ToBase64", "FromBase64", "HexToBytes", "ParseInt", "ParseFloat", "BytesToInts", "BytesToString",
+      "IntsToBytes", "StringToBytes", "RandomInt", "RandomFloat", "RandomBytes", "RandomInts", "RandomFloats", "RandomNormal",
+      "RandomExponential", "RandomChoice", "Time.Now", "Time.NowMs", "Time.Delta", "Time.DeltaMs", "Time.EpochMs"};
+  static const std::string_view prefixes[] = {"Math.", "Expect", "Assert.", "String.", "Regex.", "BigInt"};
+
+  std::string_view name(const_cast<Shard *>(shard)->name(const_cast<Shard *>(shard)));
+  const auto prefixed = std::any_of(std::begin(prefixes), std::end(prefixes),
+                                    [&](auto prefix) { return name.substr(0, prefix.size()) == prefix; });
+  if (!prefixed && names.count(name) == 0)
+    return false;
+
+  if (name == "Do" || name == "Dispatch") {
+    // a wire in a variable is not visible at compose time
+    auto wire = const_cast<Shard *>(shard)->getParam(const_cast<Shard *>(shard), 0);
+    return wire.valueType == SHType::Wire;
+  }
+  if (name == "Sort") {
+    // a parallel sort awaits its worker threads on large sequences
+    auto parallel = const_cast<Shard *>(shard)->getParam(const_cast<Shard *>(shard), 4);
+    return !parallel.payload.boolValue;
+  }
+  return true;
+}
+} // namespace
+
 SHComposeResult composeWire(const SHWire *wire, SHValidationCallback callback, void *userData, SHInstanceData data) {
   // settle input type of wire before compose
   if (wire->shards.size() > 0 && !std::any_of(wire->shards.begin(), wire->shards.end(),
@@ -1351,6 +1469,9 @@ SHComposeResult composeWire(const SHWire *wire, SHValidationCallback callback, v
       blk.shard->composed(const_cast<Shard *>(blk.shard), wire, &res);
   }
 
+  // such wires don't need a coroutine, see prepare
+  wire->nonSuspending = std::all_of(allShards.begin(), allShards.end(), [](auto &info) { return neverSuspends(info.shard); });
+
   return res;
 }
 
@@ -1838,6 +1959,16 @@ Wire &Wire::name(std::string_view name) {
   return *this;
 }
 
+Wire &Wire::budget(double seconds) {
+  _wire->budget = seconds;
+  return *this;
+}
+
+Wire &Wire::priority(int priority) {
+  _wire->priority = priority;
+  return *this;
+}
+
 Wire &Wire::shard(std::string_view name, std::vector<Var> params) {
   auto blk = createShard(name.data());
   if (!blk) {
@@ -1911,6 +2042,74 @@ SHRunWireOutput runWire(SHWire *wire, SHContext *context, const SHVar &wireInput
   return {wire->previousOutput, Running};
 }
 
+namespace {
+// Runs one iteration of the wire, returns false if the wire must end
+bool iterateWire(SHWire *wire, SHContext &context) {
+  // reset context state
+  context.continueFlow();
+
+  // call optional nextFrame calls here
+  for (auto blk : context.nextFrameCallbacks()) {
+    auto shard = const_cast<Shard *>(blk);
+    if (shard->nextFrame) {
+      shard->nextFrame(shard, &context);
+    }
+  }
+
+  auto runRes = runWire(wire, &context, wire->rootTickInput);
+  if (unlikely(runRes.state == Failed)) {
+    SHLOG_DEBUG("Wire {} failed", wire->name);
+    wire->state = SHWire::State::Failed;
+    context.stopFlow(runRes.output);
+    return false;
+  } else if (unlikely(runRes.state == Stopped)) {
+    SHLOG_DEBUG("Wire {} stopped", wire->name);
+    context.stopFlow(runRes.output);
+    // also replace the previous output with actual output
+    // as it's likely coming from flowStorage of context!
+    wire->previousOutput = runRes.output;
+    return false;
+  } else if (unlikely(runRes.state == Restarted)) {
+    // must clone over rootTickInput!
+    // restart overwrites rootTickInput on purpose
+    cloneVar(wire->rootTickInput, context.getFlowStorage());
+  }
+  return true;
+}
+
+void endWire(SHWire *wire, SHContext &context) {
+  wire->finishedOutput = wire->previousOutput;
+  if (context.failed()) {
+    wire->finishedError = context.getErrorMessage();
+    if (wire->finishedError.empty()) {
+      wire->finishedError = "Generic error";
+    }
+  }
+
+  // run cleanup on all the shards
+  // ensure stop state is set
+  context.stopFlow(wire->previousOutput);
+  wire->cleanup(true);
+
+  // Need to take care that we might have stopped the wire very early due to
+  // errors and the next eventual stop() should avoid resuming
+  if (wire->state != SHWire::State::Failed)
+    wire->state = SHWire::State::Ended;
+
+  SHLOG_TRACE("wire {} ended", wire->name);
+}
+
+void inheritWireStack(SHWire *wire, SHContext &context) {
+  // if the wire had a context (Stepped wires in wires.cpp)
+  // copy some stuff from it
+  if (wire->context) {
+    context.wireStack = wire->context->wireStack;
+    // need to add back ourself
+    context.wireStack.push_back(wire);
+  }
+}
+} // namespace
+
 #ifndef __EMSCRIPTEN__
 boost::context::continuation run(SHWire *wire, SHFlow *flow, boost::context::continuation &&sink)
 #else
@@ -1934,13 +2133,7 @@ void run(SHWire *wire, SHFlow *flow, SHCoro *coro)
   SHContext context(coro, wire, flow ? flow : &anonFlow);
 #endif
 
-  // if the wire had a context (Stepped wires in wires.cpp)
-  // copy some stuff from it
-  if (wire->context) {
-    context.wireStack = wire->context->wireStack;
-    // need to add back ourself
-    context.wireStack.push_back(wire);
-  }
+  inheritWireStack(wire, context);
 
 #ifdef SH_USE_TSAN
   context.tsan_handle = wire->tsan_coro;
@@ -1977,35 +2170,9 @@ void run(SHWire *wire, SHFlow *flow, SHCoro *coro)
 
   while (running) {
     running = wire->looped;
-    // reset context state
-    context.continueFlow();
-
-    // call optional nextFrame calls here
-    for (auto blk : context.nextFrameCallbacks()) {
-      auto shard = const_cast<Shard *>(blk);
-      if (shard->nextFrame) {
-        shard->nextFrame(shard, &context);
-      }
-    }
 
-    auto runRes = runWire(wire, &context, wire->rootTickInput);
-    if (unlikely(runRes.state == Failed)) {
-      SHLOG_DEBUG("Wire {} failed", wire->name);
-      wire->state = SHWire::State::Failed;
-      context.stopFlow(runRes.output);
-      break;
-    } else if (unlikely(runRes.state == Stopped)) {
-      SHLOG_DEBUG("Wire {} stopped", wire->name);
-      context.stopFlow(runRes.output);
-      // also replace the previous output with actual output
-      // as it's likely coming from flowStorage of context!
-      wire->previousOutput = runRes.output;
+    if (!iterateWire(wire, context))
       break;
-    } else if (unlikely(runRes.state == Restarted)) {
-      // must clone over rootTickInput!
-      // restart overwrites rootTickInput on purpose
-      cloneVar(wire->rootTickInput, context.getFlowStorage());
-    }
 
     if (!wire->unsafe && wire->looped) {
       // Ensure no while(true), yield anyway every run
@@ -2024,31 +2191,61 @@ void run(SHWire *wire, SHFlow *flow, SHCoro *coro)
   }
 
 endOfWire:
-  wire->finishedOutput = wire->previousOutput;
-  if (context.failed()) {
-    wire->finishedError = context.getErrorMessage();
-    if (wire->finishedError.empty()) {
-      wire->finishedError = "Generic error";
-    }
-  }
+  endWire(wire, context);
 
-  // run cleanup on all the shards
-  // ensure stop state is set
-  context.stopFlow(wire->previousOutput);
-  wire->cleanup(true);
+#ifndef __EMSCRIPTEN__
+  return std::move(context.continuation);
+#else
+  context.continuation->yield();
+#endif
+}
 
-  // Need to take care that we might have stopped the wire very early due to
-  // errors and the next eventual stop() should avoid resuming
-  if (wire->state != SHWire::State::Failed)
-    wire->state = SHWire::State::Ended;
+void prepareDirect(SHWire *wire, SHFlow *flow) {
+  SHLOG_TRACE("wire {} rolling without coroutine", wire->name);
 
-  SHLOG_TRACE("wire {} ended", wire->name);
+  // Reset state
+  wire->state = SHWire::State::Prepared;
+  wire->finishedOutput = Var::Empty;
+  wire->finishedError.clear();
 
+  auto direct = std::make_shared<DirectRun>();
+  direct->anonFlow.wire = wire;
 #ifndef __EMSCRIPTEN__
-  return std::move(context.continuation);
+  auto &context = direct->context.emplace(std::move(direct->sink), wire, flow ? flow : &direct->anonFlow);
 #else
-  context.continuation->yield();
+  auto &context = direct->context.emplace(nullptr, wire, flow ? flow : &direct->anonFlow);
 #endif
+
+  inheritWireStack(wire, context);
+  wire->context = &context;
+  wire->directRun = direct;
+  direct->alive = true;
+
+  try {
+    wire->warmup(&context);
+  } catch (...) {
+    // inside warmup we re-throw, we handle logging and such there
+    wire->state = SHWire::State::Failed;
+    SHLOG_ERROR("Wire {} warmup failed", wire->name);
+    endWire(wire, context);
+    direct->alive = false;
+  }
+}
+
+void resumeDirect(SHWire *wire) {
+  auto &direct = *wire->directRun;
+  auto &context = *direct.context;
+  // same steps as a coroutine resumed after warmup or after an iteration, minus the context switches
+  if (!context.shouldStop()) {
+    if (iterateWire(wire, context) && wire->looped) {
+      context.next = SHDuration(0);
+      return;
+    }
+  } else {
+    SHLOG_DEBUG("Wire {} aborted on resume", wire->name);
+  }
+  endWire(wire, context);
+  direct.alive = false;
 }
 
 Globals &GetGlobals() {
@@ -2057,6 +2254,9 @@ Globals &GetGlobals() {
 }
 
 NO_INLINE void _destroyVarSlow(SHVar &var) {
+  if (unlikely((var.flags & SHVAR_FLAGS_FROZEN) == SHVAR_FLAGS_FROZEN))
+    _evictHash(var);
+
   switch (var.valueType) {
   case Seq: {
     // notice we use .cap! because we make sure to 0 new empty elements
@@ -2083,6 +2283,10 @@ NO_INLINE void _destroyVarSlow(SHVar &var) {
 }
 
 NO_INLINE void _cloneVarSlow(SHVar &dst, const SHVar &src) {
+  // storage might be reused in place
+  if (unlikely((dst.flags & SHVAR_FLAGS_FROZEN) == SHVAR_FLAGS_FROZEN))
+    _evictHash(dst);
+
   switch (src.valueType) {
   case Seq: {
     uint32_t srcLen = src.payload.seqValue.len;
@@ -2355,6 +2559,149 @@ void gatherShards(const ShardsCollection &coll, std::vector<ShardInfo> &out) {
   _gatherShards(coll, out);
 }
 
+namespace {
+// Digests of frozen containers (see SHVAR_FLAGS_FROZEN) keyed by their storage
+// Entries are evicted when the storage is destroyed or overwritten, the length is also checked
+// so that appending to data that should not have been frozen can't return a stale digest.
+struct HashCache {
+  static constexpr uint32_t MinItems = 8;
+
+  struct Entry {
+    SHType type;
+    uint32_t len;
+    XXH128_hash_t digest;
+  };
+
+  std::shared_mutex mutex;
+  std::unordered_map<const void *, Entry> entries;
+
+  static HashCache &get() {
+    static HashCache cache;
+    return cache;
+  }
+};
+
+// bumped when hashing values whose hash is not a pure function of their content
+thread_local uint64_t uncacheableHashes = 0;
+
+const void *containerStorage(const SHVar &var) {
+  switch (var.valueType) {
+  case SHType::Seq:
+    return var.payload.seqValue.elements;
+  case SHType::Table:
+    return var.payload.tableValue.opaque;
+  case SHType::Set:
+    return var.payload.setValue.opaque;
+  default:
+    return nullptr;
+  }
+}
+
+uint32_t containerLen(const SHVar &var) {
+  switch (var.valueType) {
+  case SHType::Seq:
+    return var.payload.seqValue.len;
+  case SHType::Table:
+    return uint32_t(var.payload.tableValue.api->tableSize(var.payload.tableValue));
+  case SHType::Set:
+    return uint32_t(var.payload.setValue.api->setSize(var.payload.setValue));
+  default:
+    return 0;
+  }
+}
+
+void hashContents(const SHVar &var, XXH3_state_s *state) {
+  switch (var.valueType) {
+  case SHType::Seq: {
+    for (uint32_t i = 0; i < var.payload.seqValue.len; i++) {
+      hash_update(var.payload.seqValue.elements[i], state);
+    }
+  } break;
+  case SHType::Table: {
+    // this is unsafe because allocates on the stack
+    // but we need to sort hashes
+    std::vector<std::pair<std::pair<uint64_t, uint64_t>, SHString>,
+                stack_allocator<std::pair<std::pair<uint64_t, uint64_t>, SHString>>>
+        hashes;
+
+    auto &t = var.payload.tableValue;
+    SHTableIterator it;
+    t.api->tableGetIterator(t, &it);
+    SHString key;
+    SHVar value;
+    while (t.api->tableNext(t, &it, &key, &value)) {
+      const auto h = hash(value);
+      hashes.emplace_back(std::make_pair(uint64_t(h.payload.int2Value[0]), uint64_t(h.payload.int2Value[1])), key);
+    }
+
+    pdqsort(hashes.begin(), hashes.end());
+    for (const auto &pair : hashes) {
+      auto error = XXH3_128bits_update(state, pair.second, strlen(pair.second));
+      assert(error == XXH_OK);
+      XXH3_128bits_update(state, &pair.first, sizeof(std::pair<uint64_t, uint64_t>));
+    }
+  } break;
+  case SHType::Set: {
+    // this is unsafe because allocates on the stack
+    // but we need to sort hashes
+    std::vector<std::pair<uint64_t, uint64_t>, stack_allocator<std::pair<uint64_t, uint64_t>>> hashes;
+
+    // just store hashes, sort and actually combine later
+    auto &s = var.payload.setValue;
+    SHSetIterator it;
+    s.api->setGetIterator(s, &it);
+    SHVar value;
+    while (s.api->setNext(s, &it, &value)) {
+      const auto h = hash(value);
+      hashes.emplace_back(uint64_t(h.payload.int2Value[0]), uint64_t(h.payload.int2Value[1]));
+    }
+
+    pdqsort(hashes.begin(), hashes.end());
+    for (const auto &hash : hashes) {
+      XXH3_128bits_update(state, &hash, sizeof(uint64_t));
+    }
+  } break;
+  default:
+    break;
+  }
+}
+
+XXH128_hash_t containerDigest(const SHVar &var) {
+  const auto storage = containerStorage(var);
+  const auto len = containerLen(var);
+  const bool cacheable = (var.flags & SHVAR_FLAGS_FROZEN) == SHVAR_FLAGS_FROZEN && storage && len >= HashCache::MinItems;
+
+  auto &cache = HashCache::get();
+  if (cacheable) {
+    std::shared_lock lock(cache.mutex);
+    auto it = cache.entries.find(storage);
+    if (it != cache.entries.end() && it->second.type == var.valueType && it->second.len == len)
+      return it->second.digest;
+  }
+
+  XXH3_state_s state;
+  XXH3_INITSTATE(&state);
+  XXH3_128bits_reset_withSecret(&state, CUSTOM_XXH3_kSecret, XXH_SECRET_DEFAULT_SIZE);
+  const auto uncacheable = uncacheableHashes;
+  hashContents(var, &state);
+  const auto digest = XXH3_128bits_digest(&state);
+
+  if (cacheable && uncacheable == uncacheableHashes) {
+    std::unique_lock lock(cache.mutex);
+    cache.entries[storage] = HashCache::Entry{var.valueType, len, digest};
+  }
+  return digest;
+}
+} // namespace
+
+void _evictHash(const SHVar &var) {
+  if (const auto storage = containerStorage(var)) {
+    auto &cache = HashCache::get();
+    std::unique_lock lock(cache.mutex);
+    cache.entries.erase(storage);
+  }
+}
+
 SHVar hash(const SHVar &var) {
   gatheringWires().clear();
 
@@ -2408,11 +2755,6 @@ void hash_update(const SHVar &var, void *state) {
                                 size_t(var.payload.audioValue.channels * var.payload.audioValue.nsamples * sizeof(float)));
     assert(error == XXH_OK);
   } break;
-  case SHType::Seq: {
-    for (uint32_t i = 0; i < var.payload.seqValue.len; i++) {
-      hash_update(var.payload.seqValue.elements[i], state);
-    }
-  } break;
   case SHType::Array: {
     for (uint32_t i = 0; i < var.payload.arrayValue.len; i++) {
       SHVar tmp; // only of blittable types and hash uses just type, so no init
@@ -2422,51 +2764,17 @@ void hash_update(const SHVar &var, void *state) {
       hash_update(tmp, state);
     }
   } break;
-  case SHType::Table: {
-    // this is unsafe because allocates on the stack
-    // but we need to sort hashes
-    std::vector<std::pair<std::pair<uint64_t, uint64_t>, SHString>,
-                stack_allocator<std::pair<std::pair<uint64_t, uint64_t>, SHString>>>
-        hashes;
-
-    auto &t = var.payload.tableValue;
-    SHTableIterator it;
-    t.api->tableGetIterator(t, &it);
-    SHString key;
-    SHVar value;
-    while (t.api->tableNext(t, &it, &key, &value)) {
-      const auto h = hash(value);
-      hashes.emplace_back(std::make_pair(uint64_t(h.payload.int2Value[0]), uint64_t(h.payload.int2Value[1])), key);
-    }
-
-    pdqsort(hashes.begin(), hashes.end());
-    for (const auto &pair : hashes) {
-      error = XXH3_128bits_update(hashState, pair.second, strlen(pair.second));
-      assert(error == XXH_OK);
-      XXH3_128bits_update(hashState, &pair.first, sizeof(std::pair<uint64_t, uint64_t>));
-    }
-  } break;
+  case SHType::Seq:
+  case SHType::Table:
   case SHType::Set: {
-    // this is unsafe because allocates on the stack
-    // but we need to sort hashes
-    std::vector<std::pair<uint64_t, uint64_t>, stack_allocator<std::pair<uint64_t, uint64_t>>> hashes;
-
-    // just store hashes, sort and actually combine later
-    auto &s = var.payload.setValue;
-    SHSetIterator it;
-    s.api->setGetIterator(s, &it);
-    SHVar value;
-    while (s.api->setNext(s, &it, &value)) {
-      const auto h = hash(value);
-      hashes.emplace_back(uint64_t(h.payload.int2Value[0]), uint64_t(h.payload.int2Value[1]));
-    }
-
-    pdqsort(hashes.begin(), hashes.end());
-    for (const auto &hash : hashes) {
-      XXH3_128bits_update(hashState, &hash, sizeof(uint64_t));
-    }
+    // containers contribute their own digest so that frozen ones are only walked once
+    const auto digest = containerDigest(var);
+    error = XXH3_128bits_update(hashState, &digest, sizeof(digest));
+    assert(error == XXH_OK);
   } break;
   case SHType::ShardRef: {
+    // parameters and state can change at any time
+    uncacheableHashes++;
     auto blk = var.payload.shardValue;
     auto name = blk->name(blk);
     auto error = XXH3_128bits_update(hashState, name, strlen(name));
@@ -2484,6 +2792,8 @@ void hash_update(const SHVar &var, void *state) {
     }
   } break;
   case SHType::Wire: {
+    // depends on the wires already gathered
+    uncacheableHashes++;
     auto wire = SHWire::sharedFromRef(var.payload.wireValue);
     if (gatheringWires().count(wire.get()) == 0) {
       gatheringWires().insert(wire.get());
@@ -2768,6 +3078,53 @@ void SHWire::cleanup(bool force) {
   }
 }
 
+void SHMesh::account(SHWire *wire, SHDuration now) {
+  const auto cycles = wire->stats.last;
+  if (cycles > _heaviestCycles) {
+    _heaviest = wire;
+    _heaviestCycles = cycles;
+  }
+
+  if (wire->budget > 0.0) {
+    const auto cpu = shards::CycleClock::seconds(cycles);
+    if (unlikely(cpu > wire->budget)) {
+      wire->stats.overruns++;
+      record({wire->name, now.count(), cpu, wire->budget, false}, wire->stats.overruns);
+    }
+  }
+}
+
+void SHMesh::endFrame(SHDuration now, uint64_t cycles) {
+  stats.frames++;
+  stats.lastFrame = cycles;
+  stats.maxFrame = std::max(stats.maxFrame, cycles);
+
+  if (frameBudget > 0.0) {
+    const auto cpu = shards::CycleClock::seconds(cycles);
+    if (unlikely(cpu > frameBudget)) {
+      stats.overruns++;
+      record({_heaviest ? _heaviest->name : std::string(), now.count(), cpu, frameBudget, true}, stats.overruns);
+    }
+  }
+}
+
+void SHMesh::record(Overrun &&overrun, uint64_t count) {
+  // a hog overruns every tick, log only the 1st, 2nd, 4th, 8th... time
+  if ((count & (count - 1)) == 0) {
+    if (overrun.frame) {
+      SHLOG_WARNING("Tick took {:.3f}ms, over the mesh budget of {:.3f}ms ({} times so far), heaviest wire: {}",
+                    overrun.cpu * 1000.0, overrun.budget * 1000.0, count, overrun.wire);
+    } else {
+      SHLOG_WARNING("Wire {} ran for {:.3f}ms, over its budget of {:.3f}ms ({} times so far)", overrun.wire,
+                    overrun.cpu * 1000.0, overrun.budget * 1000.0, count);
+    }
+  }
+
+  if (overruns.size() == MaxOverruns)
+    overruns.pop_front();
+  overruns.emplace_back(std::move(overrun));
+}
+
 #ifndef OVERRIDE_REGISTER_ALL_SHARDS
 void shRegisterAllShards() { shards::registerCoreShards(); }
 #endif
@@ -19,6 +19,7 @@
 
 #include <chrono>
 #include <iostream>
+#include <limits>
 #include <list>
 #include <map>
 #include <string>
@@ -30,6 +31,8 @@ using SHTime = decltype(SHClock::now());
 using SHDuration = std::chrono::duration<double>;
 using SHTimeDiff = decltype(SHClock::now() - SHDuration(0.0));
 
+#include "replay.hpp"
+
 // For sleep
 #if _WIN32
 #include <Windows.h>
@@ -86,6 +89,8 @@ struct SHContext {
   SHCoro *continuation{nullptr};
 #endif
   SHDuration next{};
+  // set while parked in suspendUntil, the wire is resumed once it becomes true
+  const std::atomic_bool *awaiting{nullptr};
 #ifdef SH_USE_TSAN
   void *tsan_handle = nullptr;
 #endif
@@ -151,6 +156,8 @@ namespace shards {
 [[nodiscard]] SHComposeResult composeWire(const SHWire *wire, SHValidationCallback callback, void *userData, SHInstanceData data);
 
 bool validateSetParam(Shard *shard, int index, const SHVar &value, SHValidationCallback callback, void *userData);
+
+template <typename F> inline void parallelFor(size_t count, F &&fn);
 } // namespace shards
 
 #include "shards/core.hpp"
@@ -235,10 +242,42 @@ boost::context::continuation run(SHWire *wire, SHFlow *flow, boost::context::con
 void run(SHWire *wire, SHFlow *flow, SHCoro *coro);
 #endif
 
+// The context of a wire prepared without coroutine, it lives here instead of on the coroutine stack
+struct DirectRun {
+#ifndef __EMSCRIPTEN__
+  // never resumed, suspending a direct wire fails it
+  boost::context::continuation sink;
+#endif
+  SHFlow anonFlow{};
+  std::optional<SHContext> context;
+  // false once the wire ended, like a finished coroutine
+  bool alive{false};
+};
+
+// Warms up wire without coroutine, its ticks then run on the caller stack
+void prepareDirect(SHWire *wire, SHFlow *flow);
+// Runs one iteration of a direct wire, like resuming its coroutine would
+void resumeDirect(SHWire *wire);
+
+inline bool isPrepared(SHWire *wire) { return wire->coro || wire->directRun; }
+
+// If the wire can still be resumed
+inline bool isAlive(SHWire *wire) {
+  if (wire->directRun)
+    return wire->directRun->alive;
+  return wire->coro && (*wire->coro);
+}
+
 inline void prepare(SHWire *wire, SHFlow *flow) {
-  if (wire->coro)
+  if (isPrepared(wire))
     return;
 
+  // unsafe wires never yield between iterations, they keep their coroutine for the sake of simplicity
+  if (wire->nonSuspending && !wire->unsafe) {
+    prepareDirect(wire, flow);
+    return;
+  }
+
 #ifdef SH_USE_TSAN
   auto curr = __tsan_get_current_fiber();
   if (wire->tsan_coro)
@@ -271,8 +310,8 @@ inline void start(SHWire *wire, SHVar input = {}) {
     return;
   }
 
-  if (!wire->coro || !(*wire->coro))
-    return; // check if not null and bool operator also to see if alive!
+  if (!isAlive(wire))
+    return;
 
   shards::cloneVar(wire->rootTickInput, input);
   wire->state = SHWire::State::Starting;
@@ -316,6 +355,16 @@ inline bool stop(SHWire *wire, SHVar *result = nullptr) {
 
     // delete also the coro ptr
     wire->coro.reset();
+  } else if (wire->directRun) {
+    if (wire->directRun->alive && wire->state > SHWire::State::Stopped && wire->state < SHWire::State::Failed) {
+      wire->context->stopFlow(shards::Var::Empty);
+      wire->context->onLastResume = true;
+      // ends the wire, like the last resume of a coroutine
+      resumeDirect(wire);
+    }
+    wire->directRun.reset();
+    // it was pointing into directRun
+    wire->context = nullptr;
   } else {
     // if we had a coro this will run inside it!
     wire->cleanup(true);
@@ -338,19 +387,54 @@ inline bool stop(SHWire *wire, SHVar *result = nullptr) {
   return res;
 }
 
+// Signals the completion of work offloaded to other threads (see suspendUntil)
+// Threads with nothing to run block in wait instead of spinning, on linux this is a futex on the generation.
+struct CompletionSignal {
+  static uint32_t generation() { return _generation.load(); }
+
+  // Call after publishing the completion
+  static void notify();
+
+  // Returns once notify was called after generation() returned seen, or after timeout
+  static void wait(uint32_t seen, SHDuration timeout);
+
+private:
+  static inline std::atomic_uint32_t _generation{0};
+  static inline std::atomic_uint32_t _waiters{0};
+};
+
 inline bool isRunning(SHWire *wire) {
   const auto state = wire->state.load(); // atomic
   return state >= SHWire::State::Starting && state <= SHWire::State::IterationEnded;
 }
 
+inline bool isDue(const SHContext *context, SHDuration now) {
+  if (now >= context->next)
+    return true;
+  if (!context->awaiting)
+    return false;
+  // when the offloaded work completes is up to other threads
+  auto recorder = Recorder::current();
+  if (unlikely(recorder != nullptr))
+    return recorder->completed(*context->awaiting);
+  return context->awaiting->load(std::memory_order_acquire);
+}
+
 inline bool tick(SHWire *wire, SHDuration now, SHVar rootInput = {}) {
-  if (!wire->context || !wire->coro || !(*wire->coro) || !(isRunning(wire)))
-    return false; // check if not null and bool operator also to see if alive!
+  if (!wire->context || !isAlive(wire) || !(isRunning(wire)))
+    return false;
 
-  if (now >= wire->context->next) {
+  if (isDue(wire->context, now)) {
     if (rootInput != shards::Var::Empty) {
       cloneVar(wire->rootTickInput, rootInput);
     }
+
+    const auto start = CycleClock::now();
+    if (wire->directRun) {
+      resumeDirect(wire);
+      wire->stats.add(CycleClock::now() - start);
+      return true;
+    }
 #ifdef SH_USE_TSAN
     auto curr = __tsan_get_current_fiber();
     __tsan_switch_to_fiber(wire->tsan_coro, 0);
@@ -365,6 +449,7 @@ inline bool tick(SHWire *wire, SHDuration now, SHVar rootInput = {}) {
 #ifdef SH_USE_TSAN
     __tsan_switch_to_fiber(curr, 0);
 #endif
+    wire->stats.add(CycleClock::now() - start);
   }
   return true;
 }
@@ -455,6 +540,9 @@ struct SHMesh : public std::enable_shared_from_this<SHMesh> {
       throw shards::SHException("Multiple wire schedule");
     }
 
+    // warmups read clocks too
+    shards::Recorder::Scope recording(recorder.get());
+
     // this is to avoid recursion during compose
     visitedWires.clear();
 
@@ -490,8 +578,10 @@ struct SHMesh : public std::enable_shared_from_this<SHMesh> {
     }
 
     observer.before_prepare(wire.get());
-    // create a flow as well
-    shards::prepare(wire.get(), _flows.emplace_back(new SHFlow{wire.get()}).get());
+    wire->stats = {};
+    // create a flow as well, flows are kept sorted by priority
+    auto pos = std::find_if(_flows.begin(), _flows.end(), [&](auto &flow) { return flow->wire->priority < wire->priority; });
+    shards::prepare(wire.get(), _flows.emplace(pos, new SHFlow{wire.get()})->get());
     observer.before_start(wire.get());
     shards::start(wire.get(), input);
 
@@ -509,36 +599,68 @@ struct SHMesh : public std::enable_shared_from_this<SHMesh> {
     auto noErrors = true;
     _errors.clear();
     _failedWires.clear();
+    // completions from now on must cut idle short
+    _idleGeneration = shards::CompletionSignal::generation();
+    _nextDue = SHDuration::max();
+
+    shards::Recorder::Scope recording(recorder.get());
 
     if (shards::GetGlobals().SigIntTerm > 0) {
       terminate();
+    } else if (unlikely(recorder && recorder->exhausted())) {
+      SHLOG_INFO("Replay finished");
+      terminate();
     } else {
-      SHDuration now = SHClock::now().time_since_epoch();
-      for (auto it = _flows.begin(); it != _flows.end();) {
-        auto &flow = *it;
-        observer.before_tick(flow->wire);
-        shards::tick(flow->wire, now, input);
-        if (unlikely(!shards::isRunning(flow->wire))) {
-          if (flow->wire->finishedError.size() > 0) {
-            _errors.emplace_back(flow->wire->finishedError);
-          }
-
-          if (flow->wire->state == SHWire::State::Failed) {
-            _failedWires.emplace_back(flow->wire);
-            noErrors = false;
-          }
+      SHDuration now = shards::clockNow().time_since_epoch();
+      const auto frameStart = shards::CycleClock::now();
+      // deferring depends on how long wires run, recordings must replay without it
+      const uint64_t frameBudgetCycles =
+          frameBudget > 0.0 && !recorder ? uint64_t(frameBudget / shards::CycleClock::secondsPerCycle()) : 0;
+      _heaviest = nullptr;
+      _heaviestCycles = 0;
+
+      // wires deferred by the previous tick go first, so no wire is deferred twice in a row
+      const auto deferred = std::move(_deferred);
+      _deferred.clear();
+      if (unlikely(!deferred.empty())) {
+        for (auto it = _flows.begin(); it != _flows.end();) {
+          if (deferred.count((*it)->wire))
+            it = tickFlow(observer, it, now, input, noErrors);
+          else
+            ++it;
+        }
+      }
 
-          observer.before_stop(flow->wire);
-          if (!shards::stop(flow->wire)) {
-            noErrors = false;
-          }
+      // the frame budget is spent and the wire would be resumed
+      auto deferrable = [&](SHWire *wire) {
+        return wire->priority <= 0 && shards::CycleClock::now() - frameStart > frameBudgetCycles && wire->context &&
+               shards::isRunning(wire) && shards::isDue(wire->context, now);
+      };
 
-          flow->wire->mesh.reset();
-          it = _flows.erase(it);
-        } else {
+      auto sorted = true;
+      auto previousPriority = std::numeric_limits<int>::max();
+      for (auto it = _flows.begin(); it != _flows.end();) {
+        auto wire = (*it)->wire;
+        sorted = sorted && wire->priority <= previousPriority;
+        previousPriority = wire->priority;
+        if (unlikely(!deferred.empty() && deferred.count(wire))) {
           ++it;
+        } else if (unlikely(frameBudgetCycles && deferrable(wire))) {
+          // resumed first next tick
+          wire->stats.deferrals++;
+          _deferred.insert(wire);
+          _nextDue = std::min(_nextDue, now);
+          ++it;
+        } else {
+          it = tickFlow(observer, it, now, input, noErrors);
         }
       }
+
+      // priorities changed since the wires were scheduled, list::sort is stable
+      if (unlikely(!sorted))
+        _flows.sort([](auto &a, auto &b) { return a->wire->priority > b->wire->priority; });
+
+      endFrame(now, shards::CycleClock::now() - frameStart);
     }
     return noErrors;
   }
@@ -548,6 +670,18 @@ struct SHMesh : public std::enable_shared_from_this<SHMesh> {
     return tick(obs, input);
   }
 
+  // Call between ticks, sleeps while every wire is suspended or parked waiting for a completion,
+  // at most until the earliest suspended wire is due or maxWait elapsed
+  void idle(SHDuration maxWait) {
+    // replays run as fast as possible, time comes from the recording
+    if (replaying())
+      return;
+    const SHDuration now = SHClock::now().time_since_epoch();
+    if (_nextDue <= now)
+      return;
+    shards::CompletionSignal::wait(_idleGeneration, std::min(_nextDue - now, maxWait));
+  }
+
   void terminate() {
     for (auto wire : scheduled) {
       shards::stop(wire.get());
@@ -555,6 +689,7 @@ struct SHMesh : public std::enable_shared_from_this<SHMesh> {
     }
 
     _flows.clear();
+    _deferred.clear();
 
     // release all wires
     scheduled.clear();
@@ -569,11 +704,15 @@ struct SHMesh : public std::enable_shared_from_this<SHMesh> {
 
     // whichever shard uses refs must clean them
     refs.clear();
+
+    if (recorder)
+      recorder->flush();
   }
 
   void remove(const std::shared_ptr<SHWire> &wire) {
     shards::stop(wire.get());
     _flows.remove_if([wire](auto &flow) { return flow->wire == wire.get(); });
+    _deferred.erase(wire.get());
     wire->mesh.reset();
     visitedWires.erase(wire.get());
     scheduled.erase(wire);
@@ -581,6 +720,8 @@ struct SHMesh : public std::enable_shared_from_this<SHMesh> {
 
   bool empty() { return _flows.empty(); }
 
+  bool replaying() const { return recorder && recorder->replaying(); }
+
   const std::vector<std::string> &errors() { return _errors; }
 
   const std::vector<SHWire *> &failedWires() { return _failedWires; }
@@ -597,10 +738,87 @@ struct SHMesh : public std::enable_shared_from_this<SHMesh> {
 
   SHInstanceData instanceData{};
 
+  // Records the nondeterministic inputs of every tick, or replays them (see shards::Recorder)
+  std::shared_ptr<shards::Recorder> recorder;
+
+  // Seconds of CPU time a tick may take, 0 means no budget
+  // Once it is spent the remaining due wires with a priority of 0 or less are deferred to the next tick,
+  // wires are never preempted so a single hog still runs over it. Ignored while recording or replaying.
+  double frameBudget{0.0};
+
+  // Ticks accounting, times are shards::CycleClock cycles
+  struct Stats {
+    uint64_t frames{0};
+    uint64_t lastFrame{0};
+    uint64_t maxFrame{0};
+    // ticks that took longer than frameBudget
+    uint64_t overruns{0};
+  } stats;
+
+  // A watchdog record, either a wire resume longer than the wire budget
+  // or a tick longer than frameBudget, then wire is the one that took the largest share of it
+  struct Overrun {
+    std::string wire;
+    // seconds since the SHClock epoch
+    double time;
+    // CPU time of the resume or of the whole tick
+    double cpu;
+    double budget;
+    bool frame;
+  };
+
+  // The latest watchdog records, oldest first
+  std::deque<Overrun> overruns;
+  static constexpr size_t MaxOverruns = 64;
+
 private:
+  template <class Observer>
+  std::list<std::shared_ptr<SHFlow>>::iterator tickFlow(Observer &observer, std::list<std::shared_ptr<SHFlow>>::iterator it,
+                                                        SHDuration now, SHVar input, bool &noErrors) {
+    auto &flow = *it;
+    observer.before_tick(flow->wire);
+    const auto resumes = flow->wire->stats.resumes;
+    shards::tick(flow->wire, now, input);
+    if (flow->wire->stats.resumes != resumes) {
+      account(flow->wire, now);
+    }
+    if (likely(shards::isRunning(flow->wire)) && flow->wire->context) {
+      _nextDue = std::min(_nextDue, flow->wire->context->next);
+    }
+    if (unlikely(!shards::isRunning(flow->wire))) {
+      if (flow->wire->finishedError.size() > 0) {
+        _errors.emplace_back(flow->wire->finishedError);
+      }
+
+      if (flow->wire->state == SHWire::State::Failed) {
+        _failedWires.emplace_back(flow->wire);
+        noErrors = false;
+      }
+
+      observer.before_stop(flow->wire);
+      if (!shards::stop(flow->wire)) {
+        noErrors = false;
+      }
+
+      flow->wire->mesh.reset();
+      return _flows.erase(it);
+    }
+    return ++it;
+  }
+
+  // Watchdog, checks the latest resume of wire against its budget
+  void account(SHWire *wire, SHDuration now);
+  void endFrame(SHDuration now, uint64_t cycles);
+  void record(Overrun &&overrun, uint64_t count);
+
   std::list<std::shared_ptr<SHFlow>> _flows;
+  std::unordered_set<SHWire *> _deferred;
+  SHWire *_heaviest{nullptr};
+  uint64_t _heaviestCycles{0};
   std::vector<std::string> _errors;
   std::vector<SHWire *> _failedWires;
+  uint32_t _idleGeneration{0};
+  SHDuration _nextDue{};
   SHMesh() = default;
 };
 
@@ -1380,12 +1598,14 @@ inline SHVar awaitne(SHContext *context, FUNC &&func, CANCELLATION &&cancel) noe
       exp = std::current_exception();
     }
     complete = true;
+    // this frame might be gone already, only touch globals from here
+    shards::CompletionSignal::notify();
   });
 
   // SHLOG_TRACE("Awaitne: waiting for completion {}", reinterpret_cast<void *>(&func));
 
   while (!complete && context->shouldContinue()) {
-    if (shards::suspend(context, 0) != SHWireState::Continue)
+    if (shards::suspendUntil(context, complete) != SHWireState::Continue)
       break;
   }
 
@@ -1425,12 +1645,14 @@ template <typename FUNC, typename CANCELLATION> inline void await(SHContext *con
       exp = std::current_exception();
     }
     complete = true;
+    // this frame might be gone already, only touch globals from here
+    shards::CompletionSignal::notify();
   });
 
   // SHLOG_TRACE("Await: waiting for completion {}", reinterpret_cast<void *>(&func));
 
   while (!complete && context->shouldContinue()) {
-    if (shards::suspend(context, 0) != SHWireState::Continue)
+    if (shards::suspendUntil(context, complete) != SHWireState::Continue)
       break;
   }
 
@@ -1446,6 +1668,56 @@ template <typename FUNC, typename CANCELLATION> inline void await(SHContext *con
   }
 #endif
 }
+
+// Runs fn(0) ... fn(count - 1) on the SharedThreadPool and waits for completion, rethrowing the first exception
+// The calling thread takes part in the work, so this is safe to use from within the pool too
+template <typename F> inline void parallelFor(size_t count, F &&fn) {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  for (size_t i = 0; i < count; i++)
+    fn(i);
+#else
+  if (count < 2) {
+    if (count == 1)
+      fn(0);
+    return;
+  }
+
+  // work is claimed through an atomic counter so the calling thread is always making progress,
+  // even if the pool is busy (or we are already running inside the pool)
+  struct State {
+    std::atomic_size_t next{0};
+    std::atomic_size_t done{0};
+    std::exception_ptr exp{nullptr};
+    std::atomic_flag expLock = ATOMIC_FLAG_INIT;
+  };
+  auto state = std::make_shared<State>();
+  auto worker = [state, count, &fn]() {
+    size_t i;
+    while ((i = state->next.fetch_add(1)) < count) {
+      try {
+        fn(i);
+      } catch (...) {
+        if (!state->expLock.test_and_set())
+          state->exp = std::current_exception();
+      }
+      state->done.fetch_add(1, std::memory_order_release);
+    }
+  };
+
+  const auto helpers = std::min(count, size_t(SharedThreadPoolConcurrency::get())) - 1;
+  for (size_t t = 0; t < helpers; t++) {
+    // late helpers only touch the shared state, never fn
+    boost::asio::post(SharedThreadPool(), worker);
+  }
+  worker();
+  while (state->done.load(std::memory_order_acquire) < count) {
+    std::this_thread::yield();
+  }
+
+  if (state->exp)
+    std::rethrow_exception(state->exp);
+#endif
+}
 } // namespace shards
 
 #endif // SH_CORE_RUNTIME
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: BSD-3-Clause */
 /* Copyright © 2020 Fragcolor Pte. Ltd. */
 
+#include "bigint.hpp"
 #include "math.h"
 #include "shared.hpp"
 
@@ -18,6 +19,14 @@ inline Var to_var(const cpp_int &bi, std::vector<uint8_t> &buffer) {
   return Var(&buffer.front(), buffer.size());
 }
 
+// The fixed width fast path, false if the value does not fit
+inline bool from_var(const SHVar &op, Fixed &res) { return Fixed::load(op.payload.bytesValue, op.payload.bytesSize, res); }
+
+inline Var to_var(const Fixed &fixed, std::vector<uint8_t> &buffer) {
+  fixed.store(buffer);
+  return Var(&buffer.front(), buffer.size());
+}
+
 inline cpp_int from_var(const SHVar &op) {
   cpp_int bib;
   import_bits(bib, op.payload.bytesValue + 1, op.payload.bytesValue + op.payload.bytesSize);
@@ -36,6 +45,24 @@ struct ToBigInt {
   static SHOptionalString outputHelp() { return SHCCSTR("Big integer represented as bytes."); }
 
   SHVar activate(SHContext *context, const SHVar &input) {
+    Fixed fixed;
+    switch (input.valueType) {
+    case Int:
+      return to_var(Fixed::fromInt(input.payload.intValue), _buffer);
+    case String: {
+      // plain decimals, cpp_int also parses signs, hex and octal (a leading 0)
+      const auto str = SHSTRVIEW(input);
+      if ((str.size() == 1 || str[0] != '0') && U256::fromString(str, fixed.magnitude))
+        return to_var(fixed, _buffer);
+    } break;
+    case Bytes: {
+      if (U256::fromBytes(input.payload.bytesValue, input.payload.bytesSize, fixed.magnitude))
+        return to_var(fixed, _buffer);
+    } break;
+    default:
+      break;
+    }
+
     cpp_int bi;
     switch (input.valueType) {
     case Int: {
@@ -116,7 +143,8 @@ template <typename T> struct BigIntBinaryOp : public ::shards::Math::BinaryOpera
   }
 };
 
-#define BIGINT_MATH_OP(__NAME__, __OP__)                                                    \
+// Operands fitting 256 bits go through the fixed width engine, the rest (and overflows) through cpp_int
+#define BIGINT_MATH_OP(__NAME__, __OP__, __FIXED__)                                         \
   struct __NAME__ : public BigIntBinaryOp<__NAME__> {                                       \
     void operator()(SHVar &output, const SHVar &input, const SHVar &operand, void *pself) { \
       auto self = reinterpret_cast<__NAME__ *>(pself);                                      \
@@ -126,10 +154,15 @@ template <typename T> struct BigIntBinaryOp : public ::shards::Math::BinaryOpera
       } else {                                                                              \
         buffer = &self->_buffers[_offset];                                                  \
       }                                                                                     \
-      cpp_int bia = from_var(input);                                                        \
-      cpp_int bib = from_var(operand);                                                      \
-      cpp_int bres = bia __OP__ bib;                                                        \
-      output = to_var(bres, *buffer);                                                       \
+      Fixed fa, fb, fres;                                                                   \
+      if (from_var(input, fa) && from_var(operand, fb) && __FIXED__(fa, fb, fres)) {        \
+        output = to_var(fres, *buffer);                                                     \
+      } else {                                                                              \
+        cpp_int bia = from_var(input);                                                      \
+        cpp_int bib = from_var(operand);                                                    \
+        cpp_int bres = bia __OP__ bib;                                                      \
+        output = to_var(bres, *buffer);                                                     \
+      }                                                                                     \
       _offset++;                                                                            \
     }                                                                                       \
   };
@@ -199,14 +232,15 @@ struct RegOperandBase {
   }
 };
 
-BIGINT_MATH_OP(Add, +);
-BIGINT_MATH_OP(Subtract, -);
-BIGINT_MATH_OP(Multiply, *);
-BIGINT_MATH_OP(Divide, /);
-BIGINT_MATH_OP(Xor, ^);
-BIGINT_MATH_OP(And, &);
-BIGINT_MATH_OP(Or, |);
-BIGINT_MATH_OP(Mod, %);
+// division by zero is left to cpp_int, which throws
+BIGINT_MATH_OP(Add, +, add);
+BIGINT_MATH_OP(Subtract, -, sub);
+BIGINT_MATH_OP(Multiply, *, mul);
+BIGINT_MATH_OP(Divide, /, div);
+BIGINT_MATH_OP(Xor, ^, bitXor);
+BIGINT_MATH_OP(And, &, bitAnd);
+BIGINT_MATH_OP(Or, |, bitOr);
+BIGINT_MATH_OP(Mod, %, mod);
 
 #define BIGINT_LOGIC_OP(__NAME__, __OP__)                                                                                      \
   struct __NAME__ : public BigOperandBase {                                                                                    \
@@ -214,8 +248,11 @@ BIGINT_MATH_OP(Mod, %);
     static SHOptionalString outputHelp() { return SHCCSTR("A boolean value repesenting the result of the logic operation."); } \
                                                                                                                                \
     SHVar activate(SHContext *context, const SHVar &input) {                                                                   \
-      cpp_int bia = from_var(input);                                                                                           \
       auto op = getOperand();                                                                                                  \
+      Fixed fa, fb;                                                                                                            \
+      if (from_var(input, fa) && from_var(op, fb))                                                                             \
+        return Var(compare(fa, fb) __OP__ 0);                                                                                  \
+      cpp_int bia = from_var(input);                                                                                           \
       cpp_int bib = from_var(op);                                                                                              \
       bool res = bia __OP__ bib;                                                                                               \
       return Var(res);                                                                                                         \
@@ -229,7 +266,7 @@ BIGINT_LOGIC_OP(IsLess, <);
 BIGINT_LOGIC_OP(IsMoreEqual, >=);
 BIGINT_LOGIC_OP(IsLessEqual, <=);
 
-#define BIGINT_BINARY_OP(__NAME__, __OP__)                                                  \
+#define BIGINT_BINARY_OP(__NAME__, __OP__, __CMP__)                                         \
   struct __NAME__ : public BigIntBinaryOp<__NAME__> {                                       \
     void operator()(SHVar &output, const SHVar &input, const SHVar &operand, void *pself) { \
       auto self = reinterpret_cast<__NAME__ *>(pself);                                      \
@@ -239,27 +276,36 @@ BIGINT_LOGIC_OP(IsLessEqual, <=);
       } else {                                                                              \
         buffer = &self->_buffers[_offset];                                                  \
       }                                                                                     \
-      cpp_int bia = from_var(input);                                                        \
-      cpp_int bib = from_var(operand);                                                      \
-      cpp_int bres = __OP__(bia, bib);                                                      \
-      output = to_var(bres, *buffer);                                                       \
+      Fixed fa, fb;                                                                         \
+      if (from_var(input, fa) && from_var(operand, fb)) {                                   \
+        output = to_var(compare(fa, fb) __CMP__ 0 ? fb : fa, *buffer);                      \
+      } else {                                                                              \
+        cpp_int bia = from_var(input);                                                      \
+        cpp_int bib = from_var(operand);                                                    \
+        cpp_int bres = __OP__(bia, bib);                                                    \
+        output = to_var(bres, *buffer);                                                     \
+      }                                                                                     \
       _offset++;                                                                            \
     }                                                                                       \
   };
 
-BIGINT_BINARY_OP(Min, std::min);
-BIGINT_BINARY_OP(Max, std::max);
-
-#define BIGINT_REG_BINARY_OP(__NAME__, __OP__)                 \
-  struct __NAME__ : public RegOperandBase {                    \
-    SHVar activate(SHContext *context, const SHVar &input) {   \
-      cpp_int bia = from_var(input);                           \
-      auto op = getOperand();                                  \
-      if (op.valueType != Int)                                 \
-        throw ActivationError("Pow operand should be an Int"); \
-      cpp_int bres = __OP__(bia, op.payload.intValue);         \
-      return to_var(bres, _buffer);                            \
-    }                                                          \
+// __CMP__ tells when the operand is the result
+BIGINT_BINARY_OP(Min, std::min, >);
+BIGINT_BINARY_OP(Max, std::max, <);
+
+#define BIGINT_REG_BINARY_OP(__NAME__, __OP__)                          \
+  struct __NAME__ : public RegOperandBase {                             \
+    SHVar activate(SHContext *context, const SHVar &input) {            \
+      auto op = getOperand();                                           \
+      if (op.valueType != Int)                                          \
+        throw ActivationError("Pow operand should be an Int");          \
+      Fixed fa, fres;                                                   \
+      if (from_var(input, fa) && __OP__(fa, op.payload.intValue, fres)) \
+        return to_var(fres, _buffer);                                   \
+      cpp_int bia = from_var(input);                                    \
+      cpp_int bres = __OP__(bia, op.payload.intValue);                  \
+      return to_var(bres, _buffer);                                     \
+    }                                                                   \
   }
 
 BIGINT_REG_BINARY_OP(Pow, pow);
@@ -305,6 +351,10 @@ struct Shift : public ShiftBase {
   }
 
   SHVar activate(SHContext *context, const SHVar &input) {
+    Fixed fixed, fres;
+    if (from_var(input, fixed) && shift10(fixed, _shift.get().payload.intValue, fres))
+      return to_var(fres, _buffer);
+
     cpp_int bi = from_var(input);
     cpp_dec_float_100 bf(bi);
 
@@ -335,10 +385,16 @@ struct ToFloat : public ShiftBase {
   }
 
   SHVar activate(SHContext *context, const SHVar &input) {
+    const auto shift = _shift.get().payload.intValue;
+    Fixed fixed;
+    double value;
+    if (from_var(input, fixed) && fixed.toDouble(shift, value))
+      return Var(value);
+
     cpp_int bi = from_var(input);
     cpp_dec_float_100 bf(bi);
 
-    cpp_dec_float_100 bshift(_shift.get().payload.intValue);
+    cpp_dec_float_100 bshift(shift);
     bshift = pow(cpp_dec_float_100(10), bshift);
 
     auto bres = bf * bshift;
@@ -357,6 +413,10 @@ struct ToInt {
   static SHOptionalString outputHelp() { return SHCCSTR("Integer representation of the big integer value."); }
 
   SHVar activate(SHContext *context, const SHVar &input) {
+    Fixed fixed;
+    if (from_var(input, fixed) && fixed.magnitude.bits() < 64)
+      return Var(fixed.negative ? -int64_t(fixed.magnitude.limbs[0]) : int64_t(fixed.magnitude.limbs[0]));
+
     cpp_int bi = from_var(input);
     return Var(bi.convert_to<int64_t>());
   }
@@ -404,8 +464,13 @@ struct ToString {
   static SHOptionalString outputHelp() { return SHCCSTR("String representation of the big integer value."); }
 
   SHVar activate(SHContext *context, const SHVar &input) {
-    cpp_int bi = from_var(input);
-    _buffer = bi.str();
+    Fixed fixed;
+    if (from_var(input, fixed)) {
+      _buffer = fixed.toString();
+    } else {
+      cpp_int bi = from_var(input);
+      _buffer = bi.str();
+    }
     return Var(_buffer);
   }
 
@@ -445,6 +510,20 @@ struct ToBytes {
       fixedInput.payload.bytesSize--;
       return fixedInput;
     } else {
+      // msb throws on 0, leave it to cpp_int
+      Fixed fixed;
+      if (from_var(input, fixed) && !fixed.magnitude.isZero()) {
+        const auto usedBits = fixed.magnitude.bits();
+        if (usedBits > bits) {
+          throw ActivationError("The number of used bits is higher than the requested bits");
+        }
+        const auto padding = bits - usedBits;
+        _buffer.clear();
+        _buffer.insert(_buffer.begin(), padding / 8, 0);
+        fixed.magnitude.appendBytes(_buffer);
+        return Var(_buffer);
+      }
+
       cpp_int bi = from_var(input);
       const auto usedBits = msb(bi) + 1;
       if (usedBits > bits) {
@@ -491,6 +570,10 @@ struct Abs {
   static SHOptionalString outputHelp() { return SHCCSTR("Big integer represented as bytes."); }
 
   SHVar activate(SHContext *context, const SHVar &input) {
+    Fixed fixed;
+    if (from_var(input, fixed))
+      return to_var(Fixed(false, fixed.magnitude), _buffer);
+
     cpp_int bi = from_var(input);
     cpp_int abi = abs(bi);
     return to_var(abi, _buffer);
@@ -500,6 +583,108 @@ private:
   std::vector<uint8_t> _buffer;
 };
 
+struct ModBase {
+  std::vector<uint8_t> _buffer;
+  ParamVar _operand{};
+  ParamVar _modulus{};
+
+  static SHTypesInfo inputTypes() { return CoreInfo::BytesType; }
+  static SHOptionalString inputHelp() { return SHCCSTR("Big integer represented as bytes."); }
+  static SHTypesInfo outputTypes() { return CoreInfo::BytesType; }
+  static SHOptionalString outputHelp() { return SHCCSTR("Big integer represented as bytes."); }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _operand = value;
+      break;
+    case 1:
+      _modulus = value;
+      break;
+    default:
+      break;
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return _operand;
+    case 1:
+      return _modulus;
+    default:
+      return Var::Empty;
+    }
+  }
+
+  void cleanup() {
+    _operand.cleanup();
+    _modulus.cleanup();
+  }
+
+  void warmup(SHContext *context) {
+    _operand.warmup(context);
+    _modulus.warmup(context);
+  }
+
+  static const SHVar &checked(ParamVar &param, const char *name) {
+    SHVar &value = param.get();
+    if (value.valueType == None) {
+      throw ActivationError(fmt::format("{} is None, should be valid bigint bytes", name));
+    }
+    return value;
+  }
+
+  // the fixed width path only handles non negative values and a non zero modulus
+  template <typename OP> SHVar activate(const SHVar &input, const char *operandName, OP op) {
+    const auto &operand = checked(_operand, operandName);
+    const auto &modulus = checked(_modulus, "Modulus");
+    Fixed fa, fb, fm;
+    U256 res;
+    if (from_var(input, fa) && from_var(operand, fb) && from_var(modulus, fm) && !fa.negative && !fb.negative &&
+        !fm.negative && op(fa.magnitude, fb.magnitude, fm.magnitude, res)) {
+      return to_var(Fixed(false, res), _buffer);
+    }
+    return to_var(op(from_var(input), from_var(operand), from_var(modulus)), _buffer);
+  }
+};
+
+struct MulMod : public ModBase {
+  static SHOptionalString help() {
+    return SHCCSTR("Multiplies the input by the operand modulo the modulus, the intermediate product never overflows.");
+  }
+
+  SHParametersInfo parameters() {
+    static Parameters params{{"Operand", SHCCSTR("The bytes variable representing the operand"), {CoreInfo::BytesVarType}},
+                             {"Modulus", SHCCSTR("The bytes variable representing the modulus"), {CoreInfo::BytesVarType}}};
+    return params;
+  }
+
+  struct Op {
+    bool operator()(const U256 &a, const U256 &b, const U256 &m, U256 &res) const { return mulmod(a, b, m, res); }
+    cpp_int operator()(const cpp_int &a, const cpp_int &b, const cpp_int &m) const { return (a * b) % m; }
+  };
+
+  SHVar activate(SHContext *context, const SHVar &input) { return ModBase::activate(input, "Operand", Op{}); }
+};
+
+struct PowMod : public ModBase {
+  static SHOptionalString help() { return SHCCSTR("Raises the input to the power of the exponent modulo the modulus."); }
+
+  SHParametersInfo parameters() {
+    static Parameters params{{"Exponent", SHCCSTR("The bytes variable representing the exponent"), {CoreInfo::BytesVarType}},
+                             {"Modulus", SHCCSTR("The bytes variable representing the modulus"), {CoreInfo::BytesVarType}}};
+    return params;
+  }
+
+  struct Op {
+    bool operator()(const U256 &a, const U256 &b, const U256 &m, U256 &res) const { return powmod(a, b, m, res); }
+    cpp_int operator()(const cpp_int &a, const cpp_int &b, const cpp_int &m) const { return powm(a, b, m); }
+  };
+
+  SHVar activate(SHContext *context, const SHVar &input) { return ModBase::activate(input, "Exponent", Op{}); }
+};
+
 void registerShards() {
   REGISTER_SHARD("BigInt", ToBigInt);
   REGISTER_SHARD("BigInt.Add", Add);
@@ -528,6 +713,8 @@ void registerShards() {
   REGISTER_SHARD("BigInt.Pow", Pow);
   REGISTER_SHARD("BigInt.Abs", Abs);
   REGISTER_SHARD("BigInt.Sqrt", Sqrt);
+  REGISTER_SHARD("BigInt.MulMod", MulMod);
+  REGISTER_SHARD("BigInt.PowMod", PowMod);
 }
 } // namespace BigInt
 } // namespace shards
@@ -0,0 +1,604 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2022 Fragcolor Pte. Ltd. */
+
+#ifndef SH_CORE_SHARDS_BIGINT
+#define SH_CORE_SHARDS_BIGINT
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace shards {
+namespace BigInt {
+// 64 bits limb primitives, compiled to adc/sbb and mul/mulx where the target has them
+namespace limb {
+#if defined(__SIZEOF_INT128__)
+using u128 = unsigned __int128;
+
+inline uint64_t addc(uint64_t a, uint64_t b, uint64_t &carry) {
+  u128 res = u128(a) + b + carry;
+  carry = uint64_t(res >> 64);
+  return uint64_t(res);
+}
+
+inline uint64_t mul(uint64_t a, uint64_t b, uint64_t &hi) {
+  u128 res = u128(a) * b;
+  hi = uint64_t(res >> 64);
+  return uint64_t(res);
+}
+
+// hi must be less than d
+inline uint64_t div(uint64_t hi, uint64_t lo, uint64_t d, uint64_t &rem) {
+  u128 n = (u128(hi) << 64) | lo;
+  rem = uint64_t(n % d);
+  return uint64_t(n / d);
+}
+#elif defined(_MSC_VER) && defined(_M_X64)
+inline uint64_t addc(uint64_t a, uint64_t b, uint64_t &carry) {
+  uint64_t res;
+  carry = _addcarry_u64((unsigned char)carry, a, b, &res);
+  return res;
+}
+
+inline uint64_t mul(uint64_t a, uint64_t b, uint64_t &hi) { return _umul128(a, b, &hi); }
+
+inline uint64_t div(uint64_t hi, uint64_t lo, uint64_t d, uint64_t &rem) { return _udiv128(hi, lo, d, &rem); }
+#else
+// 32 bits targets
+inline uint64_t addc(uint64_t a, uint64_t b, uint64_t &carry) {
+  uint64_t res = a + b;
+  uint64_t c = res < a;
+  res += carry;
+  carry = c | (res < carry);
+  return res;
+}
+
+inline uint64_t mul(uint64_t a, uint64_t b, uint64_t &hi) {
+  const uint64_t al = uint32_t(a), ah = a >> 32, bl = uint32_t(b), bh = b >> 32;
+  const uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+  const uint64_t mid = (ll >> 32) + uint32_t(lh) + uint32_t(hl);
+  hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  return (mid << 32) | uint32_t(ll);
+}
+
+// Hacker's Delight divlu, hi must be less than d
+inline uint64_t div(uint64_t hi, uint64_t lo, uint64_t d, uint64_t &rem) {
+  int s = 0;
+  while (!(d & (uint64_t(1) << 63))) {
+    d <<= 1;
+    s++;
+  }
+  if (s) {
+    hi = (hi << s) | (lo >> (64 - s));
+    lo <<= s;
+  }
+  const uint64_t dh = d >> 32, dl = uint32_t(d);
+  const uint64_t l1 = lo >> 32, l0 = uint32_t(lo);
+  uint64_t q1 = hi / dh, r = hi - q1 * dh;
+  while (q1 >> 32 || q1 * dl > ((r << 32) | l1)) {
+    q1--;
+    r += dh;
+    if (r >> 32)
+      break;
+  }
+  const uint64_t mid = (hi << 32) + l1 - q1 * d;
+  uint64_t q0 = mid / dh;
+  r = mid - q0 * dh;
+  while (q0 >> 32 || q0 * dl > ((r << 32) | l0)) {
+    q0--;
+    r += dh;
+    if (r >> 32)
+      break;
+  }
+  rem = (((mid << 32) + l0) - q0 * d) >> s;
+  return (q1 << 32) | q0;
+}
+#endif
+
+inline uint64_t subb(uint64_t a, uint64_t b, uint64_t &borrow) {
+  uint64_t res = a - b;
+  uint64_t c = a < b;
+  uint64_t res2 = res - borrow;
+  borrow = c | (res < borrow);
+  return res2;
+}
+
+inline int clz(uint64_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+#if defined(_M_X64)
+  _BitScanReverse64(&index, x);
+  return 63 - int(index);
+#else
+  if (x >> 32) {
+    _BitScanReverse(&index, (unsigned long)(x >> 32));
+    return 31 - int(index);
+  }
+  _BitScanReverse(&index, (unsigned long)x);
+  return 63 - int(index);
+#endif
+#else
+  return __builtin_clzll(x);
+#endif
+}
+
+// Knuth's algorithm D: q = u / v and r = u % v, u has m limbs, v has n limbs with a non zero top limb, m >= n, m <= 8
+inline void divmod(const uint64_t *u, int m, const uint64_t *v, int n, uint64_t *q, uint64_t *r) {
+  if (n == 1) {
+    uint64_t rem = 0;
+    for (int j = m - 1; j >= 0; j--)
+      q[j] = div(rem, u[j], v[0], rem);
+    r[0] = rem;
+    return;
+  }
+
+  // normalize so that the top limb of v has its high bit set
+  const int s = clz(v[n - 1]);
+  uint64_t vn[8], un[9];
+  for (int i = n - 1; i > 0; i--)
+    vn[i] = (v[i] << s) | (s ? v[i - 1] >> (64 - s) : 0);
+  vn[0] = v[0] << s;
+  un[m] = s ? u[m - 1] >> (64 - s) : 0;
+  for (int i = m - 1; i > 0; i--)
+    un[i] = (u[i] << s) | (s ? u[i - 1] >> (64 - s) : 0);
+  un[0] = u[0] << s;
+
+  for (int j = m - n; j >= 0; j--) {
+    // estimate the quotient limb, it is at most 2 too big
+    uint64_t qhat, rhat;
+    bool rhatOverflow = false;
+    if (un[j + n] >= vn[n - 1]) {
+      qhat = ~uint64_t(0);
+      uint64_t carry = 0;
+      rhat = addc(un[j + n - 1], vn[n - 1], carry);
+      rhatOverflow = carry != 0;
+    } else {
+      qhat = div(un[j + n], un[j + n - 1], vn[n - 1], rhat);
+    }
+    while (!rhatOverflow) {
+      uint64_t hi, lo = mul(qhat, vn[n - 2], hi);
+      if (hi < rhat || (hi == rhat && lo <= un[j + n - 2]))
+        break;
+      qhat--;
+      uint64_t carry = 0;
+      rhat = addc(rhat, vn[n - 1], carry);
+      rhatOverflow = carry != 0;
+    }
+
+    // multiply and subtract
+    uint64_t borrow = 0, carry = 0;
+    for (int i = 0; i < n; i++) {
+      uint64_t hi, lo = mul(qhat, vn[i], hi);
+      uint64_t c = 0;
+      lo = addc(lo, carry, c);
+      carry = hi + c;
+      un[i + j] = subb(un[i + j], lo, borrow);
+    }
+    un[j + n] = subb(un[j + n], carry, borrow);
+
+    // rarely the estimate was still one too big, add back
+    if (borrow) {
+      qhat--;
+      carry = 0;
+      for (int i = 0; i < n; i++)
+        un[i + j] = addc(un[i + j], vn[i], carry);
+      un[j + n] += carry;
+    }
+    q[j] = qhat;
+  }
+
+  for (int i = 0; i < n; i++)
+    r[i] = (un[i] >> s) | (s ? un[i + 1] << (64 - s) : 0);
+}
+} // namespace limb
+
+// Unsigned 256 bits integer, little endian limbs
+struct U256 {
+  static constexpr int Limbs = 4;
+  uint64_t limbs[Limbs]{};
+
+  U256() = default;
+  U256(uint64_t value) : limbs{value, 0, 0, 0} {}
+
+  bool isZero() const { return (limbs[0] | limbs[1] | limbs[2] | limbs[3]) == 0; }
+
+  // limbs actually used
+  int size() const {
+    int n = Limbs;
+    while (n > 0 && limbs[n - 1] == 0)
+      n--;
+    return n;
+  }
+
+  int bits() const {
+    const int n = size();
+    return n == 0 ? 0 : n * 64 - limb::clz(limbs[n - 1]);
+  }
+
+  friend int compare(const U256 &a, const U256 &b) {
+    for (int i = Limbs - 1; i >= 0; i--) {
+      if (a.limbs[i] != b.limbs[i])
+        return a.limbs[i] < b.limbs[i] ? -1 : 1;
+    }
+    return 0;
+  }
+
+  // false on overflow
+  friend bool add(const U256 &a, const U256 &b, U256 &res) {
+    uint64_t carry = 0;
+    for (int i = 0; i < Limbs; i++)
+      res.limbs[i] = limb::addc(a.limbs[i], b.limbs[i], carry);
+    return carry == 0;
+  }
+
+  // false if b > a
+  friend bool sub(const U256 &a, const U256 &b, U256 &res) {
+    uint64_t borrow = 0;
+    for (int i = 0; i < Limbs; i++)
+      res.limbs[i] = limb::subb(a.limbs[i], b.limbs[i], borrow);
+    return borrow == 0;
+  }
+
+  // the full 512 bits product
+  friend void mul(const U256 &a, const U256 &b, uint64_t (&res)[8]) {
+    for (auto &l : res)
+      l = 0;
+    const int na = a.size(), nb = b.size();
+    for (int i = 0; i < na; i++) {
+      uint64_t carry = 0;
+      for (int j = 0; j < nb; j++) {
+        uint64_t hi, lo = limb::mul(a.limbs[i], b.limbs[j], hi);
+        uint64_t c = 0;
+        lo = limb::addc(lo, carry, c);
+        hi += c;
+        c = 0;
+        res[i + j] = limb::addc(res[i + j], lo, c);
+        carry = hi + c;
+      }
+      res[i + nb] = carry;
+    }
+  }
+
+  // false on overflow
+  friend bool mul(const U256 &a, const U256 &b, U256 &res) {
+    if (a.bits() + b.bits() > 257)
+      return false;
+    uint64_t full[8];
+    mul(a, b, full);
+    if (full[4] | full[5] | full[6] | full[7])
+      return false;
+    for (int i = 0; i < Limbs; i++)
+      res.limbs[i] = full[i];
+    return true;
+  }
+
+  // u (of m limbs) / d, false if d is 0
+  static bool divmodLimbs(const uint64_t *u, int m, const U256 &d, uint64_t *q, U256 &r) {
+    const int n = d.size();
+    if (n == 0)
+      return false;
+    while (m > 0 && u[m - 1] == 0)
+      m--;
+    r = U256();
+    if (m < n) {
+      for (int i = 0; i < m; i++) {
+        r.limbs[i] = u[i];
+        q[i] = 0;
+      }
+      return true;
+    }
+    limb::divmod(u, m, d.limbs, n, q, r.limbs);
+    return true;
+  }
+
+  friend bool divmod(const U256 &a, const U256 &b, U256 &q, U256 &r) {
+    q = U256();
+    return divmodLimbs(a.limbs, Limbs, b, q.limbs, r);
+  }
+
+  // (a * b) % m, without overflowing, false if m is 0
+  friend bool mulmod(const U256 &a, const U256 &b, const U256 &m, U256 &res) {
+    uint64_t full[8], q[8];
+    mul(a, b, full);
+    return divmodLimbs(full, 8, m, q, res);
+  }
+
+  // (base ^ exp) % m, false if m is 0
+  friend bool powmod(const U256 &base, const U256 &exp, const U256 &m, U256 &res) {
+    U256 b, q;
+    if (!divmod(base, m, q, b))
+      return false;
+    // m == 1 leaves 0
+    U256 result(1);
+    if (compare(m, U256(1)) == 0)
+      result = U256();
+    for (int i = exp.bits() - 1; i >= 0; i--) {
+      mulmod(result, result, m, result);
+      if ((exp.limbs[i / 64] >> (i % 64)) & 1)
+        mulmod(result, b, m, result);
+    }
+    res = result;
+    return true;
+  }
+
+  U256 operator&(const U256 &o) const { return bitwise(o, [](uint64_t a, uint64_t b) { return a & b; }); }
+  U256 operator|(const U256 &o) const { return bitwise(o, [](uint64_t a, uint64_t b) { return a | b; }); }
+  U256 operator^(const U256 &o) const { return bitwise(o, [](uint64_t a, uint64_t b) { return a ^ b; }); }
+
+  // nearest double
+  double toDouble() const {
+    const int n = bits();
+    if (n <= 64)
+      return double(limbs[0]);
+    // the top 64 bits, any bit below sticks to the lowest so the conversion rounds correctly
+    const int shift = n - 64;
+    const int l = shift / 64, s = shift % 64;
+    uint64_t top = s ? (limbs[l] >> s) | (limbs[l + 1] << (64 - s)) : limbs[l];
+    bool sticky = s ? (limbs[l] << (64 - s)) != 0 : false;
+    for (int i = 0; i < l; i++)
+      sticky |= limbs[i] != 0;
+    return ldexp(double(top | uint64_t(sticky)), shift);
+  }
+
+  // 10^exponent, exponent <= 77
+  static const U256 &pow10(int exponent) {
+    static const std::vector<U256> table = [] {
+      std::vector<U256> res(MaxPow10 + 1);
+      res[0] = U256(1);
+      for (int i = 1; i <= MaxPow10; i++)
+        mul(res[i - 1], U256(10), res[i]);
+      return res;
+    }();
+    return table[exponent];
+  }
+  static constexpr int MaxPow10 = 77;
+
+  std::string toString() const {
+    // 19 decimal digits at a time
+    constexpr uint64_t Chunk = 10000000000000000000ull;
+    std::string res;
+    U256 value = *this;
+    do {
+      uint64_t q[Limbs]{};
+      U256 r;
+      divmodLimbs(value.limbs, Limbs, U256(Chunk), q, r);
+      uint64_t digits = r.limbs[0];
+      for (int i = 0; i < Limbs; i++)
+        value.limbs[i] = q[i];
+      const bool last = value.isZero();
+      for (int i = 0; i < 19 && (!last || digits != 0); i++) {
+        res.push_back(char('0' + digits % 10));
+        digits /= 10;
+      }
+    } while (!value.isZero());
+    if (res.empty())
+      res.push_back('0');
+    return std::string(res.rbegin(), res.rend());
+  }
+
+  // plain decimal digits only, false if anything else or if it overflows
+  static bool fromString(std::string_view str, U256 &res) {
+    if (str.empty())
+      return false;
+    res = U256();
+    // 19 decimal digits at a time
+    for (size_t pos = 0; pos < str.size(); pos += 19) {
+      const auto chunk = str.substr(pos, 19);
+      uint64_t digits = 0;
+      for (auto c : chunk) {
+        if (c < '0' || c > '9')
+          return false;
+        digits = digits * 10 + uint64_t(c - '0');
+      }
+      if (!mul(res, pow10(int(chunk.size())), res) || !add(res, U256(digits), res))
+        return false;
+    }
+    return true;
+  }
+
+  // big endian, false if it does not fit
+  static bool fromBytes(const uint8_t *data, size_t size, U256 &res) {
+    while (size > 0 && *data == 0) {
+      data++;
+      size--;
+    }
+    if (size > 32)
+      return false;
+    res = U256();
+    for (size_t i = 0; i < size; i++) {
+      const size_t bit = (size - 1 - i) * 8;
+      res.limbs[bit / 64] |= uint64_t(data[i]) << (bit % 64);
+    }
+    return true;
+  }
+
+  // big endian without leading zeros, at least one byte
+  void appendBytes(std::vector<uint8_t> &out) const {
+    const int n = std::max(1, (bits() + 7) / 8);
+    for (int i = n - 1; i >= 0; i--)
+      out.push_back(uint8_t(limbs[i / 8] >> ((i % 8) * 8)));
+  }
+
+private:
+  template <typename OP> U256 bitwise(const U256 &o, OP op) const {
+    U256 res;
+    for (int i = 0; i < Limbs; i++)
+      res.limbs[i] = op(limbs[i], o.limbs[i]);
+    return res;
+  }
+};
+
+// A BigInt that fits 256 bits, in sign and magnitude like the bytes layout: a sign byte then the big endian magnitude.
+// Operations return false when the result does not fit (or is undefined), the caller falls back to arbitrary precision.
+struct Fixed {
+  bool negative{false};
+  U256 magnitude;
+
+  Fixed() = default;
+  Fixed(bool negative, const U256 &magnitude) : negative(negative && !magnitude.isZero()), magnitude(magnitude) {}
+
+  static Fixed fromInt(int64_t value) {
+    // careful with the most negative value
+    return value < 0 ? Fixed(true, U256(uint64_t(-(value + 1)) + 1)) : Fixed(false, U256(uint64_t(value)));
+  }
+
+  static bool load(const uint8_t *data, size_t size, Fixed &res) {
+    if (size == 0 || !U256::fromBytes(data + 1, size - 1, res.magnitude))
+      return false;
+    res.negative = data[0] != 0 && !res.magnitude.isZero();
+    return true;
+  }
+
+  void store(std::vector<uint8_t> &out) const {
+    out.clear();
+    out.push_back(uint8_t(negative));
+    magnitude.appendBytes(out);
+  }
+
+  friend int compare(const Fixed &a, const Fixed &b) {
+    if (a.negative != b.negative)
+      return a.negative ? -1 : 1;
+    const auto res = compare(a.magnitude, b.magnitude);
+    return a.negative ? -res : res;
+  }
+
+  friend bool add(const Fixed &a, const Fixed &b, Fixed &res) {
+    U256 magnitude;
+    if (a.negative == b.negative) {
+      if (!add(a.magnitude, b.magnitude, magnitude))
+        return false;
+      res = Fixed(a.negative, magnitude);
+    } else if (compare(a.magnitude, b.magnitude) >= 0) {
+      sub(a.magnitude, b.magnitude, magnitude);
+      res = Fixed(a.negative, magnitude);
+    } else {
+      sub(b.magnitude, a.magnitude, magnitude);
+      res = Fixed(b.negative, magnitude);
+    }
+    return true;
+  }
+
+  friend bool sub(const Fixed &a, const Fixed &b, Fixed &res) { return add(a, Fixed(!b.negative, b.magnitude), res); }
+
+  friend bool mul(const Fixed &a, const Fixed &b, Fixed &res) {
+    U256 magnitude;
+    if (!mul(a.magnitude, b.magnitude, magnitude))
+      return false;
+    res = Fixed(a.negative != b.negative, magnitude);
+    return true;
+  }
+
+  // truncates like cpp_int, the remainder takes the sign of the dividend
+  friend bool div(const Fixed &a, const Fixed &b, Fixed &res) {
+    U256 q, r;
+    if (!divmod(a.magnitude, b.magnitude, q, r))
+      return false;
+    res = Fixed(a.negative != b.negative, q);
+    return true;
+  }
+
+  friend bool mod(const Fixed &a, const Fixed &b, Fixed &res) {
+    U256 q, r;
+    if (!divmod(a.magnitude, b.magnitude, q, r))
+      return false;
+    res = Fixed(a.negative, r);
+    return true;
+  }
+
+  // bitwise operations are only done here on non negative values, cpp_int handles the rest
+  friend bool bitAnd(const Fixed &a, const Fixed &b, Fixed &res) {
+    if (a.negative || b.negative)
+      return false;
+    res = Fixed(false, a.magnitude & b.magnitude);
+    return true;
+  }
+
+  friend bool bitOr(const Fixed &a, const Fixed &b, Fixed &res) {
+    if (a.negative || b.negative)
+      return false;
+    res = Fixed(false, a.magnitude | b.magnitude);
+    return true;
+  }
+
+  friend bool bitXor(const Fixed &a, const Fixed &b, Fixed &res) {
+    if (a.negative || b.negative)
+      return false;
+    res = Fixed(false, a.magnitude ^ b.magnitude);
+    return true;
+  }
+
+  friend bool pow(const Fixed &a, int64_t exponent, Fixed &res) {
+    if (exponent < 0)
+      return false;
+    U256 result(1), base = a.magnitude;
+    for (auto e = uint64_t(exponent); e; e >>= 1) {
+      if ((e & 1) && !mul(result, base, result))
+        return false;
+      if ((e >> 1) && !mul(base, base, base))
+        return false;
+    }
+    res = Fixed(a.negative && (exponent & 1), result);
+    return true;
+  }
+
+  // multiplies by 10^exponent, negative exponents divide and truncate
+  friend bool shift10(const Fixed &a, int64_t exponent, Fixed &res) {
+    U256 magnitude;
+    if (exponent >= 0) {
+      if (exponent > U256::MaxPow10 || !mul(a.magnitude, U256::pow10(int(exponent)), magnitude))
+        return false;
+    } else if (exponent < -U256::MaxPow10) {
+      // 10^78 is more than 2^256
+      magnitude = U256();
+    } else {
+      U256 r;
+      divmod(a.magnitude, U256::pow10(int(-exponent)), magnitude, r);
+    }
+    res = Fixed(a.negative, magnitude);
+    return true;
+  }
+
+  // The nearest double to this * 10^exponent, rounded once from the exact value
+  // false if the exact product (or a quotient precise enough) does not fit
+  bool toDouble(int64_t exponent, double &res) const {
+    U256 value;
+    int scale = 0;
+    if (exponent >= 0) {
+      if (exponent > U256::MaxPow10 || !mul(magnitude, U256::pow10(int(exponent)), value))
+        return false;
+    } else {
+      if (exponent < -U256::MaxPow10)
+        return false;
+      // scaled by 2^scale the quotient has at least 66 bits, the 53 of a double, a guard bit and more
+      const auto &divisor = U256::pow10(int(-exponent));
+      scale = std::max(0, 66 + divisor.bits() - magnitude.bits());
+      if (scale >= 256)
+        return false;
+      U256 power, scaled, r;
+      power.limbs[scale / 64] = uint64_t(1) << (scale % 64);
+      if (!mul(magnitude, power, scaled) || !divmod(scaled, divisor, value, r))
+        return false;
+      // a nonzero remainder sticks to the lowest bit, far below the rounding position
+      if (!r.isZero())
+        value.limbs[0] |= 1;
+    }
+    // exact, the results are far from the subnormal range
+    const auto abs = std::ldexp(value.toDouble(), -scale);
+    res = negative ? -abs : abs;
+    return true;
+  }
+
+  std::string toString() const { return negative ? "-" + magnitude.toString() : magnitude.toString(); }
+};
+} // namespace BigInt
+} // namespace shards
+
+#endif // SH_CORE_SHARDS_BIGINT
@@ -7,7 +7,6 @@
 #include <boost/algorithm/hex.hpp>
 namespace shards {
 struct FromImage {
-  // TODO SIMD this
   template <SHType OF> void toSeq(std::vector<Var> &output, const SHVar &input) {
     if constexpr (OF == SHType::Float) {
       // assume we want 0-1 normalized values
@@ -16,30 +15,19 @@ struct FromImage {
 
       auto pixsize = getPixelSize(input);
 
-      const int w = int(input.payload.imageValue.width);
-      const int h = int(input.payload.imageValue.height);
-      const int c = int(input.payload.imageValue.channels);
-      const int flatsize = w * h * c * pixsize;
+      const size_t w = size_t(input.payload.imageValue.width);
+      const size_t h = size_t(input.payload.imageValue.height);
+      const size_t c = size_t(input.payload.imageValue.channels);
+      const size_t flatsize = w * h * c;
 
       output.resize(flatsize, Var(0.0));
+      if (flatsize == 0)
+        return;
 
-      if (pixsize == 1) {
-        for (int i = 0; i < flatsize; i++) {
-          const auto fval = double(input.payload.imageValue.data[i]) / 255.0;
-          output[i].payload.floatValue = fval;
-        }
-      } else if (pixsize == 2) {
-        const auto u16 = reinterpret_cast<uint16_t *>(input.payload.imageValue.data);
-        for (int i = 0; i < flatsize; i++) {
-          const auto fval = double(u16[i]) / 65535.0;
-          output[i].payload.floatValue = fval;
-        }
-      } else if (pixsize == 4) {
-        const auto f32 = reinterpret_cast<float *>(input.payload.imageValue.data);
-        for (int i = 0; i < flatsize; i++) {
-          output[i].payload.floatValue = f32[i];
-        }
-      }
+      // scatter straight into the payloads of the output vars
+      NumberType srcType = pixsize == 1 ? NumberType::UInt8 : pixsize == 2 ? NumberType::UInt16 : NumberType::Float32;
+      convertNumbers(srcType, input.payload.imageValue.data, pixsize, NumberType::Float64, &output[0].payload.floatValue,
+                     sizeof(SHVar), flatsize, NumberConversionMode::Normalize);
     } else {
       throw ActivationError("Conversion pair not implemented yet.");
     }
@@ -48,7 +36,6 @@ struct FromImage {
 
 struct FromSeq {
   template <SHType OF> void toImage(std::vector<uint8_t> &buffer, int w, int h, int c, const SHVar &input) {
-    // TODO SIMD this
     if (input.payload.seqValue.len == 0)
       throw ActivationError("Input sequence was empty.");
 
@@ -56,30 +43,32 @@ struct FromSeq {
     buffer.resize(flatsize);
 
     if constexpr (OF == SHType::Float) {
-      // assuming it's scaled 0-1
-      for (int i = 0; i < flatsize; i++) {
-        buffer[i] = uint8_t(input.payload.seqValue.elements[i].payload.floatValue * 255.0);
-      }
+      // assuming it's scaled 0-1, gather from the payloads of the input vars
+      convertNumbers(NumberType::Float64, &input.payload.seqValue.elements[0].payload.floatValue, sizeof(SHVar),
+                     NumberType::UInt8, buffer.data(), 1, size_t(flatsize), NumberConversionMode::Normalize);
     } else {
       throw ActivationError("Conversion pair not implemented yet.");
     }
   }
 
   template <SHType OF> void toBytes(std::vector<uint8_t> &buffer, const SHVar &input) {
-    // TODO SIMD this
     if (input.payload.seqValue.len == 0)
       throw ActivationError("Input sequence was empty.");
 
-    buffer.resize(size_t(input.payload.seqValue.len));
+    const auto &seq = input.payload.seqValue;
+    buffer.resize(size_t(seq.len));
 
     if constexpr (OF == SHType::Int) {
-      for (uint32_t i = 0; i < input.payload.seqValue.len; i++) {
-        const auto val = input.payload.seqValue.elements[i].payload.intValue;
-        if (val > UINT8_MAX || val < 0)
-          throw ActivationError("Value out of byte range (0~255)");
-
-        buffer[i] = uint8_t(val);
+      // validate first, keeps the conversion loop branch free
+      bool outOfRange = false;
+      for (uint32_t i = 0; i < seq.len; i++) {
+        outOfRange |= uint64_t(seq.elements[i].payload.intValue) > UINT8_MAX;
       }
+      if (outOfRange)
+        throw ActivationError("Value out of byte range (0~255)");
+
+      convertNumbers(NumberType::Int64, &seq.elements[0].payload.intValue, sizeof(SHVar), NumberType::UInt8, buffer.data(), 1,
+                     size_t(seq.len));
     } else {
       throw ActivationError("Conversion pair not implemented yet.");
     }
@@ -89,16 +78,15 @@ struct FromSeq {
 struct FromBytes {
   template <SHType OF> void toSeq(std::vector<Var> &output, const SHVar &input) {
     if constexpr (OF == SHType::Int) {
-      // assume we want 0-1 normalized values
       if (input.valueType != SHType::Bytes)
         throw ActivationError("Expected Bytes type.");
 
-      output.resize(input.payload.bytesSize);
+      output.resize(input.payload.bytesSize, Var(int64_t(0)));
+      if (input.payload.bytesSize == 0)
+        return;
 
-      for (uint32_t i = 0; i < input.payload.bytesSize; i++) {
-        const auto b = int64_t(input.payload.bytesValue[i]);
-        output[i] = Var(b);
-      }
+      convertNumbers(NumberType::UInt8, input.payload.bytesValue, 1, NumberType::Int64, &output[0].payload.intValue,
+                     sizeof(SHVar), size_t(input.payload.bytesSize));
     } else {
       throw ActivationError("Conversion pair not implemented yet.");
     }
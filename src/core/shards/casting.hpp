@@ -92,16 +92,9 @@ template <SHType ToType> struct ToNumber {
             : NumberTypeLookup::getInstance().getConversion(inputVectorType->numberType, _outputVectorType->numberType);
     shassert(conversion);
 
-    // Can reduce call overhead by adding a single ConvertMultiple function with
-    // in/out lengths
-    uint8_t *srcPtr = (uint8_t *)&input.payload;
-    uint8_t *dstPtr = (uint8_t *)&output.payload;
     size_t numToConvert = std::min(_outputVectorType->dimension, inputVectorType->dimension);
-    for (size_t i = 0; i < numToConvert; i++) {
-      conversion->convertOne(srcPtr, dstPtr);
-      srcPtr += conversion->inStride;
-      dstPtr += conversion->outStride;
-    }
+    conversion->getConvertMany(NumberConversionMode::Cast)(&input.payload, conversion->inStride, &output.payload,
+                                                           conversion->outStride, numToConvert);
   }
 
   void parseSeqElements(SHVar &output, const SHSeq &sequence) {
@@ -159,12 +152,12 @@ template <SHType ToType> struct ToNumber {
     SHVar output{};
     output.valueType = _outputVectorType->shType;
 
-    uint8_t *dstPtr = (uint8_t *)&output.payload;
-    for (size_t i = 0; i < sequence.len; i++) {
-      const SHVar &elem = sequence.elements[i];
-
-      _numberConversion->convertOne(&elem.payload, dstPtr);
-      dstPtr += _numberConversion->outStride;
+    // gather the element payloads in one go
+    size_t numToConvert = std::min(size_t(sequence.len), _outputVectorType->dimension);
+    if (numToConvert > 0) {
+      _numberConversion->getConvertMany(NumberConversionMode::Cast)(&sequence.elements[0].payload, sizeof(SHVar),
+                                                                    &output.payload, _numberConversion->outStride,
+                                                                    numToConvert);
     }
 
     return output;
@@ -2,20 +2,17 @@
 /* Copyright © 2020 Fragcolor Pte. Ltd. */
 
 #include "shared.hpp"
+#include "channels.hpp"
 #include <atomic>
 #include <boost/lockfree/queue.hpp>
 #include <boost/lockfree/stack.hpp>
 #include <mutex>
+#include <thread>
 #include <variant>
 
 namespace shards {
 namespace channels {
 
-struct ChannelShared {
-  SHTypeInfo type;
-  std::atomic_bool closed;
-};
-
 struct DummyChannel : public ChannelShared {};
 
 struct MPMCChannel : public ChannelShared {
@@ -43,23 +40,172 @@ private:
   bool _noCopy;
 };
 
-struct Broadcast;
-class BroadcastChannel : public ChannelShared {
-public:
-  BroadcastChannel(bool noCopy) : ChannelShared(), _noCopy(noCopy) {}
+BroadcastChannel::BroadcastChannel(bool noCopy, size_t capacity, BroadcastLag lag)
+    : ChannelShared(), _noCopy(noCopy), _lag(lag), _subscribers(new Subscribers()) {
+  size_t size = 1;
+  while (size < capacity)
+    size <<= 1;
+  _mask = size - 1;
+  _slots.reset(new Slot[size]);
+}
 
-  MPMCChannel &subscribe() {
-    // we automatically cleanup based on the closed flag of the inner channel
-    std::scoped_lock<std::mutex> lock(submutex);
-    return subscribers.emplace_back(_noCopy);
+BroadcastChannel::~BroadcastChannel() {
+  for (uint64_t i = 0; i <= _mask; i++) {
+    auto message = _slots[i].message.load();
+    if (message)
+      release(message);
   }
+  // values still held by listeners are gone with them
+  if (!_noCopy) {
+    for (auto &message : _messages) {
+      destroyVar(message->value);
+    }
+  }
+  delete _subscribers.load();
+}
 
-protected:
-  friend struct Broadcast;
-  std::mutex submutex;
-  std::list<MPMCChannel> subscribers;
-  bool _noCopy = false;
-};
+std::unique_ptr<BroadcastChannel::Subscriber> BroadcastChannel::subscribe() {
+  auto subscriber = std::make_unique<Subscriber>();
+  // producers that see it before it settles its cursor below keep room from here on
+  subscriber->cursor = _head.load();
+  {
+    std::scoped_lock<std::mutex> lock(_subscribersMutex);
+    auto current = _subscribers.load();
+    auto next = new Subscribers{current->list};
+    next->list.push_back(subscriber.get());
+    _subscribers.store(next);
+    synchronize();
+    delete current;
+  }
+  // producers that could not see it are done, whatever they published since is not for it
+  subscriber->cursor = _head.load();
+  return subscriber;
+}
+
+void BroadcastChannel::unsubscribe(Subscriber *subscriber) {
+  std::scoped_lock<std::mutex> lock(_subscribersMutex);
+  auto current = _subscribers.load();
+  auto next = new Subscribers{current->list};
+  next->list.erase(std::remove(next->list.begin(), next->list.end(), subscriber), next->list.end());
+  _subscribers.store(next);
+  synchronize();
+  delete current;
+}
+
+bool BroadcastChannel::publish(const SHVar &value) {
+  const auto capacity = _mask + 1;
+  auto position = _head.load();
+  do {
+    // the cached bound is usually enough, the listeners are scanned only when the ring looks full
+    if (_lag == BroadcastLag::Block && position - _slowest.load() >= capacity && position - slowestCursor(position) >= capacity)
+      return false;
+  } while (!_head.compare_exchange_weak(position, position + 1));
+
+  auto &slot = _slots[position & _mask];
+  // the producer of the previous lap might still be replacing this slot
+  const auto previous = position > _mask ? position - _mask : 0;
+  while (slot.sequence.load() != previous)
+    std::this_thread::yield();
+
+  auto message = acquire();
+  if (_noCopy) {
+    message->value = value;
+  } else {
+    // this internally will reuse memory
+    cloneVar(message->value, value);
+  }
+  // the slot reference
+  message->refs = 1;
+
+  slot.sequence = Busy;
+  auto replaced = slot.message.exchange(message);
+  slot.sequence = position + 1;
+  if (replaced)
+    release(replaced);
+  return true;
+}
+
+bool BroadcastChannel::read(Subscriber &subscriber, Message *&message) {
+  const auto capacity = _mask + 1;
+  while (true) {
+    const auto cursor = subscriber.cursor.load(std::memory_order_relaxed);
+    auto &slot = _slots[cursor & _mask];
+    const auto sequence = slot.sequence.load();
+    if (sequence == cursor + 1) {
+      auto candidate = slot.message.load();
+      if (retain(candidate)) {
+        // still the same message, it was not replaced while we took our reference
+        if (slot.sequence.load() == sequence) {
+          subscriber.cursor.store(cursor + 1);
+          message = candidate;
+          return true;
+        }
+        release(candidate);
+      }
+      continue;
+    }
+
+    const auto head = _head.load();
+    const auto lagged = (sequence != Busy && sequence > cursor + 1) || head > cursor + capacity;
+    if (!lagged)
+      return false; // not published yet
+
+    // DropOldest overwrote it, skip to the oldest value still there
+    const auto next = std::max(head - capacity, cursor + 1);
+    subscriber.dropped += next - cursor;
+    subscriber.cursor.store(next);
+  }
+}
+
+void BroadcastChannel::release(Message *message) {
+  if (message->refs.fetch_sub(1) == 1)
+    _pool.push(message);
+}
+
+BroadcastChannel::Message *BroadcastChannel::acquire() {
+  Message *message;
+  if (_pool.pop(message))
+    return message;
+  std::scoped_lock<std::mutex> lock(_poolMutex);
+  return _messages.emplace_back(new Message()).get();
+}
+
+bool BroadcastChannel::retain(Message *message) {
+  // messages are never freed, only pooled with no references, a pooled message must not be revived
+  auto refs = message->refs.load();
+  while (refs != 0) {
+    if (message->refs.compare_exchange_weak(refs, refs + 1))
+      return true;
+  }
+  return false;
+}
+
+uint64_t BroadcastChannel::slowestCursor(uint64_t head) {
+  uint64_t epoch;
+  while (true) {
+    epoch = _epoch.load();
+    _readers[epoch & 1]++;
+    if (_epoch.load() == epoch)
+      break;
+    _readers[epoch & 1]--;
+  }
+
+  auto slowest = head;
+  for (auto subscriber : _subscribers.load()->list) {
+    slowest = std::min(slowest, subscriber->cursor.load());
+  }
+
+  _readers[epoch & 1]--;
+  _slowest = slowest;
+  return slowest;
+}
+
+void BroadcastChannel::synchronize() {
+  // scans that started before the flip may still be using the previous array
+  const auto epoch = _epoch.fetch_add(1);
+  while (_readers[epoch & 1].load() != 0)
+    std::this_thread::yield();
+}
 
 using Channel = std::variant<DummyChannel, MPMCChannel, BroadcastChannel>;
 
@@ -79,6 +225,9 @@ struct Base {
   Channel *_channel = nullptr;
   std::string _name;
   bool _noCopy = false;
+  compression::Compressor _compressor;
+  Serialization _serial;
+  std::vector<uint8_t> _serialized;
 
   static inline Parameters producerParams{{"Name", SHCCSTR("The name of the channel."), {CoreInfo::StringType}},
                                           {"NoCopy!!",
@@ -90,6 +239,12 @@ struct Base {
       {"Name", SHCCSTR("The name of the channel."), {CoreInfo::StringType}},
       {"Buffer", SHCCSTR("The amount of values to buffer before outputting them."), {CoreInfo::IntType}}};
 
+  // Name, NoCopy!! and the compression parameters
+  static Parameters &producerAndCompressionParams() {
+    static Parameters params{producerParams, compression::Compressor::params._infos};
+    return params;
+  }
+
   void setParam(int index, const SHVar &value) {
     switch (index) {
     case 0: {
@@ -98,6 +253,11 @@ struct Base {
     case 1: {
       _noCopy = value.payload.boolValue;
     } break;
+    case 2:
+    case 3:
+    case 4:
+      _compressor.setParam(index - 2, value);
+      break;
     default:
       break;
     }
@@ -109,15 +269,52 @@ struct Base {
       return Var(_name);
     case 1:
       return Var(_noCopy);
+    case 2:
+    case 3:
+    case 4:
+      return _compressor.getParam(index - 2);
     }
     return SHVar();
   }
 
+  void warmup(SHContext *context) { _compressor.warmup(context); }
+
+  void cleanup() { _compressor.cleanup(); }
+
   template <typename T> void verifyInputType(T &channel, const SHInstanceData &data) {
     if (channel.type.basicType != SHType::None && channel.type != data.inputType) {
       throw SHException("Produce attempted to change produced type: " + _name);
     }
   }
+
+  void composeCompression() {
+    _compressor.compose();
+    if (_noCopy && _compressor.enabled())
+      throw ComposeError("NoCopy!! values can't be compressed: " + _name);
+  }
+
+  void verifyCompression(const ChannelShared &channel) {
+    if (channel.codec != _compressor.codec)
+      throw ComposeError("All the producers of a channel must use the same compression: " + _name);
+  }
+
+  struct Writer {
+    std::vector<uint8_t> &_buffer;
+    Writer(std::vector<uint8_t> &buffer) : _buffer(buffer) {}
+    void operator()(const uint8_t *buf, size_t size) { _buffer.insert(_buffer.end(), buf, buf + size); }
+  };
+
+  // What goes through the channel, the frames of the serialized input when compressing
+  SHVar payload(SHContext *context, const SHVar &input) {
+    if (!_compressor.enabled())
+      return input;
+
+    Writer w(_serialized);
+    _serialized.clear();
+    _serial.reset();
+    _serial.serialize(input, w);
+    return _compressor.compress(context, _serialized.data(), _serialized.size());
+  }
 };
 
 struct Produce : public Base {
@@ -127,9 +324,11 @@ struct Produce : public Base {
 
   static SHTypesInfo outputTypes() { return CoreInfo::AnyType; }
 
-  static SHParametersInfo parameters() { return producerParams; }
+  static SHParametersInfo parameters() { return producerAndCompressionParams(); }
 
   SHTypeInfo compose(const SHInstanceData &data) {
+    composeCompression();
+
     auto &vchannel = Globals::get(_name);
     switch (vchannel.index()) {
     case 0: {
@@ -137,11 +336,13 @@ struct Produce : public Base {
       auto &channel = std::get<MPMCChannel>(vchannel);
       // no cloning here, this is potentially dangerous if the type is dynamic
       channel.type = data.inputType;
+      channel.codec = _compressor.codec;
       _mpchannel = &channel;
     } break;
     case 1: {
       auto &channel = std::get<MPMCChannel>(vchannel);
       verifyInputType(channel, data);
+      verifyCompression(channel);
       _mpchannel = &channel;
     } break;
     default:
@@ -165,7 +366,7 @@ struct Produce : public Base {
     } else {
       // this internally will reuse memory
       // yet it can be still slow for big vars
-      cloneVar(tmp, input);
+      cloneVar(tmp, payload(context, input));
     }
 
     // enqueue for the stealing
@@ -176,32 +377,81 @@ struct Produce : public Base {
 };
 
 struct Broadcast : public Base {
-  BroadcastChannel *_mpchannel;
+  REGISTER_ENUM(BroadcastLag, 'bcLg');
+
+  BroadcastChannel *_bchannel;
+  int64_t _capacity = 64;
+  BroadcastLag _lag = BroadcastLag::Block;
 
   static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
 
   static SHTypesInfo outputTypes() { return CoreInfo::AnyType; }
 
-  static SHParametersInfo parameters() { return producerParams; }
+  static SHParametersInfo parameters() {
+    static Parameters params{
+        producerAndCompressionParams(),
+        {{"Capacity",
+          SHCCSTR("The amount of values the channel keeps for its listeners, rounded up to a power of two. Only the "
+                  "broadcast creating the channel sets it."),
+          {CoreInfo::IntType}},
+         {"Lag",
+          SHCCSTR("What to do when the slowest listener is Capacity values behind: Block suspends the broadcasting wire until "
+                  "it catches up, DropOldest overwrites and that listener skips the values it missed. Only the broadcast "
+                  "creating the channel sets it."),
+          {BroadcastLagType}}}};
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 5:
+      _capacity = value.payload.intValue;
+      break;
+    case 6:
+      _lag = BroadcastLag(value.payload.enumValue);
+      break;
+    default:
+      Base::setParam(index, value);
+      break;
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 5:
+      return Var(_capacity);
+    case 6:
+      return Var::Enum(_lag, CoreCC, BroadcastLagCC);
+    default:
+      return Base::getParam(index);
+    }
+  }
 
   SHTypeInfo compose(const SHInstanceData &data) {
+    if (_capacity < 1)
+      throw ComposeError("Broadcast: Capacity must be positive");
+
+    composeCompression();
+
     auto &vchannel = Globals::get(_name);
     switch (vchannel.index()) {
     case 0: {
       SHLOG_TRACE("Creating broadcast channel: {}", _name);
 
-      vchannel.emplace<BroadcastChannel>(_noCopy);
+      vchannel.emplace<BroadcastChannel>(_noCopy, size_t(_capacity), _lag);
       auto &channel = std::get<BroadcastChannel>(vchannel);
       // no cloning here, this is potentially dangerous if the type is dynamic
       channel.type = data.inputType;
-      _mpchannel = &channel;
+      channel.codec = _compressor.codec;
+      _bchannel = &channel;
     } break;
     case 2: {
       SHLOG_TRACE("Subscribing to broadcast channel: {}", _name);
 
       auto &channel = std::get<BroadcastChannel>(vchannel);
       verifyInputType(channel, data);
-      _mpchannel = &channel;
+      verifyCompression(channel);
+      _bchannel = &channel;
     } break;
     default:
       throw SHException("Broadcast: channel type expected.");
@@ -210,35 +460,13 @@ struct Broadcast : public Base {
   }
 
   SHVar activate(SHContext *context, const SHVar &input) {
-    assert(_mpchannel);
-
-    // we need to support subscriptions during run-time
-    // so we need to lock this operation
-    // furthermore we allow multiple broadcasters so the erase needs this
-    std::scoped_lock<std::mutex> lock(_mpchannel->submutex);
-    for (auto it = _mpchannel->subscribers.begin(); it != _mpchannel->subscribers.end();) {
-      if (it->closed) {
-        it = _mpchannel->subscribers.erase(it);
-      } else {
-        SHVar tmp{};
-
-        // try to get from recycle bin
-        // this might fail but we don't care//
-        // if it fails will just allocate a brand new
-        it->recycle.pop(tmp);
-
-        if (_noCopy) {
-          tmp = input;
-        } else {
-          // this internally will reuse memory
-          cloneVar(tmp, input);
-        }
-
-        // enqueue for the stealing
-        it->data.push(tmp);
+    assert(_bchannel);
 
-        ++it;
-      }
+    // the value is cloned once in the channel ring, whatever the number of listeners
+    const auto value = payload(context, input);
+    while (!_bchannel->publish(value)) {
+      // Block lag policy, the slowest listener is a whole ring behind
+      SH_SUSPEND(context, 0);
     }
 
     return input;
@@ -249,13 +477,19 @@ struct BufferedConsumer {
   // utility to recycle memory and buffer
   // recycling is only for non blittable types basically
   std::vector<SHVar> buffer;
+  // replayed values are our own, they don't go to the channel
+  bool replayed = false;
 
-  void recycle(MPMCChannel *channel) {
-    // send previous values to recycle
+  // gives the previous values back to the channel
+  template <typename Recycle> void recycle(Recycle recycle) {
     for (auto &var : buffer) {
-      channel->recycle.push(var);
+      if (replayed)
+        destroyVar(var);
+      else
+        recycle(var);
     }
     buffer.clear();
+    replayed = false;
   }
 
   void add(SHVar &var) { buffer.push_back(var); }
@@ -278,12 +512,20 @@ struct BufferedConsumer {
 };
 
 struct Consumers : public Base {
-  MPMCChannel *_mpchannel;
   BufferedConsumer _storage;
   int64_t _bufferSize = 1;
   int64_t _current = 1;
   SHTypeInfo _outType{};
   SHTypeInfo _seqType{};
+  // the values of compressed channels, decompressed and deserialized
+  compression::Frames _frames;
+  std::vector<SHVar> _decoded;
+
+  void destroy() {
+    for (auto &var : _decoded) {
+      Serialization::varFree(var);
+    }
+  }
 
   static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
 
@@ -305,54 +547,50 @@ struct Consumers : public Base {
       return Var(_bufferSize);
   }
 
-  void cleanup() {
-    // reset buffer counter
-    _current = _bufferSize;
-    // cleanup storage
-    if (_mpchannel)
-      _storage.recycle(_mpchannel);
-  }
-};
-
-struct Consume : public Consumers {
-  SHTypeInfo compose(const SHInstanceData &data) {
-    auto &vchannel = Globals::get(_name);
-    switch (vchannel.index()) {
-    case 1: {
-      auto &channel = std::get<MPMCChannel>(vchannel);
-      _mpchannel = &channel;
-      _outType = channel.type;
-      if (_bufferSize == 1) {
-        return _outType;
-      } else {
-        _seqType.basicType = Seq;
-        _seqType.seqTypes.elements = &_outType;
-        _seqType.seqTypes.len = 1;
-        return _seqType;
-      }
-    };
-    default:
-      throw SHException("Produce/Consume channel type expected.");
+  SHTypeInfo outputType(const ChannelShared &channel) {
+    _outType = channel.type;
+    if (_bufferSize == 1) {
+      return _outType;
+    } else {
+      _seqType.basicType = Seq;
+      _seqType.seqTypes.elements = &_outType;
+      _seqType.seqTypes.len = 1;
+      return _seqType;
     }
   }
 
-  SHVar activate(SHContext *context, const SHVar &input) {
-    assert(_mpchannel);
+  // Pops the next value, when a Recorder is current receives are recorded or replayed
+  template <typename Pop> Recorder::Received receive(SHVar &output, const ChannelShared &source, Pop pop) {
+    auto poll = [&](SHVar &into) {
+      // read before popping, values sent before completing are never missed
+      const bool closed = source.closed;
+      if (pop(into))
+        return Recorder::Received::Value;
+      // check also for channel completion
+      return closed ? Recorder::Received::Closed : Recorder::Received::Empty;
+    };
 
-    // send previous values to recycle
-    _storage.recycle(_mpchannel);
+    auto recorder = Recorder::current();
+    if (likely(recorder == nullptr))
+      return poll(output);
+    if (recorder->replaying())
+      _storage.replayed = true;
+    return recorder->receive(output, poll);
+  }
 
+  // Fills the buffer suspending until enough values are received
+  template <typename Pop> SHVar consume(SHContext *context, const ChannelShared &source, Pop pop) {
     // reset buffer
     _current = _bufferSize;
 
     // everytime we are scheduled we try to pop a value
     while (_current--) {
       SHVar output{};
-      while (!_mpchannel->data.pop(output)) {
-        // check also for channel completion
-        if (_mpchannel->closed) {
+      Recorder::Received received;
+      while ((received = receive(output, source, pop)) != Recorder::Received::Value) {
+        if (received == Recorder::Received::Closed) {
           if (!_storage.empty()) {
-            return _storage;
+            return result(context, source);
           } else {
             context->stopFlow(Var::Empty);
             return Var::Empty;
@@ -365,25 +603,97 @@ struct Consume : public Consumers {
       _storage.add(output);
     }
 
-    return _storage;
+    return result(context, source);
+  }
+
+  struct Reader {
+    const std::vector<uint8_t> &_buffer;
+    size_t _offset{0};
+    Reader(const std::vector<uint8_t> &buffer) : _buffer(buffer) {}
+    void operator()(uint8_t *buf, size_t size) {
+      if (_buffer.size() < _offset + size) {
+        throw ActivationError("Channel value buffer underrun");
+      }
+
+      memcpy(buf, _buffer.data() + _offset, size);
+      _offset += size;
+    }
+  };
+
+  SHVar result(SHContext *context, const ChannelShared &source) {
+    if (source.codec == compression::Codec::None)
+      return _storage;
+
+    auto &frames = _storage.buffer;
+    if (_decoded.size() < frames.size())
+      _decoded.resize(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+      auto &bytes = _frames.decompress(context, frames[i].payload.bytesValue, frames[i].payload.bytesSize);
+      Reader r(bytes);
+      _serial.reset();
+      _serial.deserialize(r, _decoded[i]);
+    }
+
+    if (frames.size() > 1) {
+      SHVar res{};
+      res.valueType = Seq;
+      res.payload.seqValue.elements = &_decoded[0];
+      res.payload.seqValue.len = uint32_t(frames.size());
+      return res;
+    } else {
+      return _decoded[0];
+    }
+  }
+};
+
+struct Consume : public Consumers {
+  MPMCChannel *_mpchannel = nullptr;
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    auto &vchannel = Globals::get(_name);
+    switch (vchannel.index()) {
+    case 1: {
+      auto &channel = std::get<MPMCChannel>(vchannel);
+      _mpchannel = &channel;
+      return outputType(channel);
+    };
+    default:
+      throw SHException("Produce/Consume channel type expected.");
+    }
+  }
+
+  void cleanup() {
+    // reset buffer counter
+    _current = _bufferSize;
+    // cleanup storage
+    if (_mpchannel)
+      recycle();
+  }
+
+  void recycle() {
+    _storage.recycle([&](SHVar &var) { _mpchannel->recycle.push(var); });
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    assert(_mpchannel);
+
+    // send previous values to recycle
+    recycle();
+
+    return consume(context, *_mpchannel, [&](SHVar &into) { return _mpchannel->data.pop(into); });
   }
 };
 
 struct Listen : public Consumers {
-  BroadcastChannel *_bchannel;
+  BroadcastChannel *_bchannel = nullptr;
+  std::unique_ptr<BroadcastChannel::Subscriber> _subscriber;
+  // the messages our output points into
+  std::vector<BroadcastChannel::Message *> _held;
+  uint64_t _dropped = 0;
 
   void destroy() {
-    if (_mpchannel) {
-      _mpchannel->closed = true;
-      // also try clear here, to make broadcast removal faster
-      SHVar tmp{};
-      while (_mpchannel->data.pop(tmp)) {
-        destroyVar(tmp);
-      }
-      while (_mpchannel->recycle.pop(tmp)) {
-        destroyVar(tmp);
-      }
-    }
+    unsubscribe();
+    Consumers::destroy();
   }
 
   SHTypeInfo compose(const SHInstanceData &data) {
@@ -393,55 +703,75 @@ struct Listen : public Consumers {
       SHLOG_TRACE("Listening broadcast channel: {}", _name);
 
       auto &channel = std::get<BroadcastChannel>(vchannel);
-      auto &sub = channel.subscribe();
-      _bchannel = &channel;
-      _mpchannel = &sub;
-      _outType = channel.type;
-      if (_bufferSize == 1) {
-        return _outType;
-      } else {
-        _seqType.basicType = Seq;
-        _seqType.seqTypes.elements = &_outType;
-        _seqType.seqTypes.len = 1;
-        return _seqType;
+      if (_bchannel != &channel) {
+        unsubscribe();
+        _bchannel = &channel;
       }
+      return outputType(channel);
     };
     default:
       throw SHException("Listen: channel type expected.");
     }
   }
 
-  SHVar activate(SHContext *context, const SHVar &input) {
-    assert(_bchannel);
-    assert(_mpchannel);
-
-    // send previous values to recycle
-    _storage.recycle(_mpchannel);
+  void warmup(SHContext *context) {
+    // subscribed only while running, a listener that is composed but never warmed up must not hold the broadcasters
+    // back, values broadcasted from now on are seen by the first activation
+    subscribe();
+  }
 
-    // reset buffer
+  void cleanup() {
+    // reset buffer counter
     _current = _bufferSize;
+    // a stopped listener must not hold the broadcasters back
+    unsubscribe();
+  }
 
-    // everytime we are scheduled we try to pop a value
-    while (_current--) {
-      SHVar output{};
-      while (!_mpchannel->data.pop(output)) {
-        // check also for channel completion
-        if (_bchannel->closed) {
-          if (!_storage.empty()) {
-            return _storage;
-          } else {
-            context->stopFlow(Var::Empty);
-            return Var::Empty;
-          }
-        }
-        SH_SUSPEND(context, 0);
+  void subscribe() {
+    if (!_subscriber) {
+      _subscriber = _bchannel->subscribe();
+      _dropped = 0;
+    }
+  }
+
+  void unsubscribe() {
+    if (_bchannel) {
+      release();
+      if (_subscriber) {
+        _bchannel->unsubscribe(_subscriber.get());
+        _subscriber.reset();
       }
+    }
+  }
 
-      // keep for recycling
-      _storage.add(output);
+  void release() {
+    _storage.recycle([](SHVar &) {});
+    for (auto message : _held) {
+      _bchannel->release(message);
     }
+    _held.clear();
+  }
 
-    return _storage;
+  SHVar activate(SHContext *context, const SHVar &input) {
+    assert(_bchannel);
+    assert(_subscriber);
+
+    // give the previous values back
+    release();
+
+    return consume(context, *_bchannel, [&](SHVar &into) {
+      BroadcastChannel::Message *message;
+      if (!_bchannel->read(*_subscriber, message))
+        return false;
+      if (unlikely(_subscriber->dropped != _dropped)) {
+        SHLOG_DEBUG("Listen: lagging behind broadcast channel {}, skipped {} values", _name, _subscriber->dropped - _dropped);
+        _dropped = _subscriber->dropped;
+      }
+      _held.emplace_back(message);
+      // no copy, the message is ours until the next activation
+      into = message->value;
+      return true;
+    });
   }
 };
 
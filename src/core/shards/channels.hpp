@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2020 Fragcolor Pte. Ltd. */
+
+#ifndef SH_CORE_SHARDS_CHANNELS
+#define SH_CORE_SHARDS_CHANNELS
+
+#include "compression.hpp"
+#include "shards.h"
+#include <atomic>
+#include <boost/lockfree/stack.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace shards {
+namespace channels {
+struct ChannelShared {
+  SHTypeInfo type;
+  std::atomic_bool closed;
+  // when not None values go through the channel serialized and compressed
+  compression::Codec codec{compression::Codec::None};
+};
+
+// What broadcasting does once the slowest listener is a whole ring behind
+enum class BroadcastLag {
+  // wait until it catches up, no listener misses a value
+  Block,
+  // overwrite, the listener skips to the oldest value still in the ring
+  DropOldest
+};
+
+// One producer side ring shared by every listener, values are cloned once whatever the number of listeners.
+// Listeners read at their own cursor and hold the values they output by reference: values are reference counted
+// messages that go back to a pool once released, their memory is reused but never freed while the channel lives.
+// Publishing and reading are lock free. Listeners are kept in an immutable array replaced on (un)subscribe and
+// reclaimed once no producer can still be scanning it (a minimal two phases RCU), so subscriptions never stall
+// producers, only Block producers look at the listeners, when the ring looks full.
+class BroadcastChannel : public ChannelShared {
+public:
+  struct Message {
+    std::atomic_uint32_t refs{0};
+    SHVar value{};
+  };
+
+  struct Subscriber {
+    // position of the next value to read
+    std::atomic_uint64_t cursor{0};
+    // values skipped because of DropOldest
+    uint64_t dropped{0};
+  };
+
+  BroadcastChannel(bool noCopy, size_t capacity = 64, BroadcastLag lag = BroadcastLag::Block);
+  ~BroadcastChannel();
+
+  BroadcastChannel(const BroadcastChannel &) = delete;
+  BroadcastChannel &operator=(const BroadcastChannel &) = delete;
+
+  // The subscriber only sees values published after this call
+  std::unique_ptr<Subscriber> subscribe();
+  // Returns once no producer can see the subscriber anymore
+  void unsubscribe(Subscriber *subscriber);
+
+  // False if the lag policy is Block and the ring is full, nothing was published then
+  bool publish(const SHVar &value);
+
+  // False if nothing new was published, otherwise message holds a reference to the value at the cursor of subscriber
+  // and the cursor moves past it, the caller must release it once done with it.
+  // A subscriber overtaken by DropOldest skips to the oldest value still in the ring.
+  bool read(Subscriber &subscriber, Message *&message);
+  void release(Message *message);
+
+  size_t capacity() const { return _mask + 1; }
+  BroadcastLag lag() const { return _lag; }
+
+private:
+  struct Slot {
+    // position + 1 of the message in the slot, Busy while it is being replaced
+    std::atomic_uint64_t sequence{0};
+    std::atomic<Message *> message{nullptr};
+  };
+
+  struct Subscribers {
+    std::vector<Subscriber *> list;
+  };
+
+  static constexpr uint64_t Busy = ~uint64_t(0);
+
+  Message *acquire();
+  bool retain(Message *message);
+  uint64_t slowestCursor(uint64_t head);
+  void synchronize();
+
+  bool _noCopy;
+  BroadcastLag _lag;
+  uint64_t _mask;
+  std::unique_ptr<Slot[]> _slots;
+  // next position to publish
+  std::atomic_uint64_t _head{0};
+  // a lower bound of every subscriber cursor, cursors only move forward
+  std::atomic_uint64_t _slowest{0};
+
+  std::mutex _poolMutex;
+  std::vector<std::unique_ptr<Message>> _messages;
+  boost::lockfree::stack<Message *> _pool{64};
+
+  std::mutex _subscribersMutex;
+  std::atomic<Subscribers *> _subscribers;
+  std::atomic_uint64_t _epoch{0};
+  std::atomic_uint32_t _readers[2]{};
+};
+} // namespace channels
+} // namespace shards
+
+#endif // SH_CORE_SHARDS_CHANNELS
@@ -0,0 +1,308 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2022 Fragcolor Pte. Ltd. */
+
+#include "compression.hpp"
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+namespace shards {
+namespace compression {
+namespace {
+struct Registry {
+  struct Entry {
+    Factory factory;
+    bool dictionaries{false};
+  };
+
+  std::mutex mutex;
+  std::unordered_map<int, Entry> codecs;
+  std::unordered_map<uint32_t, std::shared_ptr<const Dictionary>> dictionaries;
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+constexpr uint8_t Magic[4] = {0xC5, 'S', 'H', 'Z'};
+constexpr uint8_t Version = 1;
+
+// the first byte of a serialized value is its type, which never collides with Magic
+struct Header {
+  uint8_t magic[4];
+  uint8_t codec;
+  uint8_t version;
+  uint16_t reserved;
+  uint32_t dictionary;
+  uint32_t blockSize;
+  uint32_t blocks;
+  uint32_t originalSize;
+};
+static_assert(sizeof(Header) == 24, "Unexpected frame header size");
+
+size_t blocksOf(size_t size, size_t blockSize) { return std::max(size_t(1), (size + blockSize - 1) / blockSize); }
+
+size_t lanesOf(size_t blocks) { return std::min(blocks, std::max(size_t(1), size_t(SharedThreadPoolConcurrency::get()))); }
+} // namespace
+
+void registerCodec(Codec codec, Factory factory, bool dictionaries) {
+  auto &reg = registry();
+  std::scoped_lock lock(reg.mutex);
+  reg.codecs[int(codec)] = Registry::Entry{std::move(factory), dictionaries};
+}
+
+bool available(Codec codec) {
+  auto &reg = registry();
+  std::scoped_lock lock(reg.mutex);
+  return reg.codecs.count(int(codec)) != 0;
+}
+
+bool supportsDictionaries(Codec codec) {
+  auto &reg = registry();
+  std::scoped_lock lock(reg.mutex);
+  auto it = reg.codecs.find(int(codec));
+  return it != reg.codecs.end() && it->second.dictionaries;
+}
+
+std::unique_ptr<Context> makeContext(Codec codec, const Options &options) {
+  Factory factory;
+  {
+    auto &reg = registry();
+    std::scoped_lock lock(reg.mutex);
+    auto it = reg.codecs.find(int(codec));
+    if (it == reg.codecs.end())
+      throw SHException(fmt::format("Compression: codec {} is not available", magic_enum::enum_name(codec)));
+    if (options.dictionary && !it->second.dictionaries)
+      throw SHException(fmt::format("Compression: codec {} does not support dictionaries", magic_enum::enum_name(codec)));
+    factory = it->second.factory;
+  }
+  return factory(options);
+}
+
+std::shared_ptr<const Dictionary> addDictionary(const uint8_t *data, size_t size) {
+  auto id = uint32_t(XXH32(data, size, 0));
+  // 0 means no dictionary
+  if (id == 0)
+    id = 1;
+
+  auto &reg = registry();
+  std::scoped_lock lock(reg.mutex);
+  auto &dictionary = reg.dictionaries[id];
+  if (!dictionary) {
+    dictionary = std::make_shared<const Dictionary>(Dictionary{id, std::vector<uint8_t>(data, data + size)});
+  } else if (dictionary->data.size() != size || memcmp(dictionary->data.data(), data, size) != 0) {
+    throw SHException("Compression: dictionary id collision");
+  }
+  return dictionary;
+}
+
+std::shared_ptr<const Dictionary> findDictionary(uint32_t id) {
+  auto &reg = registry();
+  std::scoped_lock lock(reg.mutex);
+  auto it = reg.dictionaries.find(id);
+  return it != reg.dictionaries.end() ? it->second : nullptr;
+}
+
+void Frames::configure(Codec codec, int level) {
+  if (codec != _codec || level != _options.level) {
+    _codec = codec;
+    _options.level = level;
+    _encoders.clear();
+  }
+}
+
+void Frames::setDictionary(const uint8_t *data, size_t size) {
+  if (data == _dictionaryData && size == _dictionarySize)
+    return;
+
+  _dictionaryData = data;
+  _dictionarySize = size;
+  auto dictionary = size > 0 ? addDictionary(data, size) : nullptr;
+  if (dictionary != _options.dictionary) {
+    _options.dictionary = dictionary;
+    _encoders.clear();
+  }
+}
+
+bool Frames::isFrame(const uint8_t *data, size_t size) {
+  return size >= sizeof(Header) && memcmp(data, Magic, sizeof(Magic)) == 0;
+}
+
+const std::vector<uint8_t> &Frames::compress(const uint8_t *data, size_t size) {
+  if (_codec == Codec::None)
+    throw SHException("Compression: no codec set");
+  if (size > std::numeric_limits<uint32_t>::max())
+    throw SHException("Compression: value too big");
+
+  const auto blocks = blocksOf(size, BlockSize);
+  const auto lanes = lanesOf(blocks);
+  while (_encoders.size() < lanes) {
+    _encoders.emplace_back(makeContext(_codec, _options));
+  }
+
+  // compress every block in its own slot, then pack them
+  const auto bound = _encoders[0]->bound(std::min(size, BlockSize));
+  const auto blocksOffset = sizeof(Header) + blocks * sizeof(uint32_t);
+  _sizes.resize(blocks);
+  _output.resize(blocksOffset + blocks * bound);
+  parallelFor(lanes, [&](size_t lane) {
+    auto &encoder = *_encoders[lane];
+    for (size_t block = lane; block < blocks; block += lanes) {
+      const auto offset = block * BlockSize;
+      const auto len = std::min(BlockSize, size - offset);
+      _sizes[block] = uint32_t(encoder.compress(data + offset, len, &_output[blocksOffset + block * bound], bound));
+    }
+  });
+
+  auto pos = blocksOffset;
+  for (size_t block = 0; block < blocks; block++) {
+    memmove(&_output[pos], &_output[blocksOffset + block * bound], _sizes[block]);
+    pos += _sizes[block];
+  }
+  _output.resize(pos);
+
+  Header header{};
+  memcpy(header.magic, Magic, sizeof(Magic));
+  header.codec = uint8_t(_codec);
+  header.version = Version;
+  header.dictionary = _options.dictionary ? _options.dictionary->id : 0;
+  header.blockSize = uint32_t(BlockSize);
+  header.blocks = uint32_t(blocks);
+  header.originalSize = uint32_t(size);
+  memcpy(&_output[0], &header, sizeof(Header));
+  memcpy(&_output[sizeof(Header)], _sizes.data(), blocks * sizeof(uint32_t));
+  return _output;
+}
+
+const std::vector<uint8_t> &Frames::decompress(const uint8_t *data, size_t size) {
+  if (!isFrame(data, size))
+    throw SHException("Compression: not a compressed frame");
+
+  Header header;
+  memcpy(&header, data, sizeof(Header));
+  if (header.version != Version)
+    throw SHException("Compression: unsupported frame version");
+  if (header.blockSize == 0 || header.blocks != blocksOf(header.originalSize, header.blockSize))
+    throw SHException("Compression: invalid frame");
+  if (header.originalSize > _maxSize)
+    throw SHException(
+        fmt::format("Compression: the frame holds {} bytes, more than the limit of {}", header.originalSize, _maxSize));
+
+  const size_t blocks = header.blocks;
+  const auto blocksOffset = sizeof(Header) + blocks * sizeof(uint32_t);
+  if (size < blocksOffset)
+    throw SHException("Compression: truncated frame");
+
+  _sizes.resize(blocks);
+  _offsets.resize(blocks);
+  memcpy(_sizes.data(), data + sizeof(Header), blocks * sizeof(uint32_t));
+  auto pos = blocksOffset;
+  for (size_t block = 0; block < blocks; block++) {
+    _offsets[block] = pos;
+    pos += _sizes[block];
+  }
+  if (pos != size)
+    throw SHException("Compression: truncated frame");
+
+  const auto codec = Codec(header.codec);
+  const auto dictionaryId = _decodingOptions.dictionary ? _decodingOptions.dictionary->id : 0;
+  if (codec != _decoding || header.dictionary != dictionaryId) {
+    _decodingOptions.dictionary = nullptr;
+    if (header.dictionary != 0) {
+      _decodingOptions.dictionary = findDictionary(header.dictionary);
+      if (!_decodingOptions.dictionary)
+        throw SHException("Compression: the frame dictionary was not registered");
+    }
+    _decoding = codec;
+    _decoders.clear();
+  }
+
+  const auto lanes = lanesOf(blocks);
+  while (_decoders.size() < lanes) {
+    _decoders.emplace_back(makeContext(_decoding, _decodingOptions));
+  }
+
+  _output.resize(header.originalSize);
+  parallelFor(lanes, [&](size_t lane) {
+    auto &decoder = *_decoders[lane];
+    for (size_t block = lane; block < blocks; block += lanes) {
+      const auto offset = block * header.blockSize;
+      const auto len = std::min(size_t(header.blockSize), size_t(header.originalSize) - offset);
+      decoder.decompress(data + _offsets[block], _sizes[block], _output.data() + offset, len);
+    }
+  });
+  return _output;
+}
+
+const std::vector<uint8_t> &Frames::compress(SHContext *context, const uint8_t *data, size_t size) {
+  if (size <= BlockSize)
+    return compress(data, size);
+
+  await(
+      context, [&]() { compress(data, size); }, [] {});
+  return _output;
+}
+
+const std::vector<uint8_t> &Frames::decompress(SHContext *context, const uint8_t *data, size_t size) {
+  if (size <= BlockSize)
+    return decompress(data, size);
+
+  await(
+      context, [&]() { decompress(data, size); }, [] {});
+  return _output;
+}
+
+void Compressor::setParam(int index, const SHVar &value) {
+  switch (index) {
+  case 0:
+    codec = Codec(value.payload.enumValue);
+    break;
+  case 1:
+    level = value.payload.intValue;
+    break;
+  case 2:
+    dictionary = value;
+    break;
+  default:
+    break;
+  }
+}
+
+SHVar Compressor::getParam(int index) {
+  switch (index) {
+  case 0:
+    return Var::Enum(codec, CoreCC, CodecCC);
+  case 1:
+    return Var(level);
+  case 2:
+    return dictionary;
+  default:
+    return Var::Empty;
+  }
+}
+
+void Compressor::compose() {
+  if (!enabled())
+    return;
+
+  if (!available(codec))
+    throw ComposeError(fmt::format("Compression codec {} is not available in this build", magic_enum::enum_name(codec)));
+
+  if (dictionary->valueType != SHType::None && !supportsDictionaries(codec))
+    throw ComposeError(fmt::format("Compression codec {} does not support dictionaries", magic_enum::enum_name(codec)));
+}
+
+SHVar Compressor::compress(SHContext *context, const uint8_t *data, size_t size) {
+  _frames.configure(codec, int(level));
+  auto &dict = dictionary.get();
+  if (dict.valueType == SHType::Bytes)
+    _frames.setDictionary(dict.payload.bytesValue, dict.payload.bytesSize);
+  else
+    _frames.setDictionary(nullptr, 0);
+
+  auto &frame = _frames.compress(context, data, size);
+  return Var((uint8_t *)frame.data(), uint32_t(frame.size()));
+}
+} // namespace compression
+} // namespace shards
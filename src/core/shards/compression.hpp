@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2022 Fragcolor Pte. Ltd. */
+
+#ifndef SH_CORE_SHARDS_COMPRESSION
+#define SH_CORE_SHARDS_COMPRESSION
+
+#include "shared.hpp"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace shards {
+namespace compression {
+enum class Codec { None, Snappy, Brotli, Zstd };
+
+struct Dictionary {
+  // a hash of data, never 0
+  uint32_t id;
+  std::vector<uint8_t> data;
+};
+
+struct Options {
+  // 0 is the codec default
+  int level{0};
+  std::shared_ptr<const Dictionary> dictionary;
+};
+
+// The state of a codec, kept around to avoid reallocating it for every value, not thread safe
+class Context {
+public:
+  virtual ~Context() = default;
+  // the worst case compressed size of size bytes
+  virtual size_t bound(size_t size) const = 0;
+  // returns the compressed size, throws on failure
+  virtual size_t compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity) = 0;
+  // fills exactly originalSize bytes of dst, throws on failure or if the sizes don't match
+  virtual void decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t originalSize) = 0;
+};
+
+using Factory = std::function<std::unique_ptr<Context>(const Options &options)>;
+
+// Codecs are registered by the modules linking them (see the extra shards), so availability depends on the build
+void registerCodec(Codec codec, Factory factory, bool dictionaries);
+bool available(Codec codec);
+bool supportsDictionaries(Codec codec);
+std::unique_ptr<Context> makeContext(Codec codec, const Options &options);
+
+// Dictionaries are kept for the whole process, registering the same data twice returns the same dictionary.
+// Frames only carry the dictionary id, a dictionary must be registered before decompressing what it compressed.
+std::shared_ptr<const Dictionary> addDictionary(const uint8_t *data, size_t size);
+std::shared_ptr<const Dictionary> findDictionary(uint32_t id);
+
+// Self describing compressed frames: a header, the compressed size of each block and the blocks.
+// Blocks are independent, payloads spanning several blocks are (de)compressed in parallel.
+class Frames {
+public:
+  static constexpr size_t BlockSize = 1 << 20;
+  // frames declaring more are rejected before allocating, the sizes in a frame can't be trusted
+  static constexpr size_t DefaultMaxSize = 256 << 20;
+
+  // The contexts are recreated only when the settings change
+  void configure(Codec codec, int level);
+  // Registers and compresses with the dictionary, none if size is 0
+  void setDictionary(const uint8_t *data, size_t size);
+  void setMaxSize(size_t maxSize) { _maxSize = maxSize; }
+
+  static bool isFrame(const uint8_t *data, size_t size);
+
+  // The output is valid until the next call
+  const std::vector<uint8_t> &compress(const uint8_t *data, size_t size);
+  const std::vector<uint8_t> &decompress(const uint8_t *data, size_t size);
+
+  // Same but payloads spanning several blocks are processed off the wire thread, suspending it meanwhile
+  const std::vector<uint8_t> &compress(SHContext *context, const uint8_t *data, size_t size);
+  const std::vector<uint8_t> &decompress(SHContext *context, const uint8_t *data, size_t size);
+
+private:
+  Codec _codec{Codec::None};
+  Options _options;
+  const uint8_t *_dictionaryData{nullptr};
+  size_t _dictionarySize{0};
+  std::vector<std::unique_ptr<Context>> _encoders;
+
+  // decoding follows the frames
+  Codec _decoding{Codec::None};
+  Options _decodingOptions;
+  std::vector<std::unique_ptr<Context>> _decoders;
+
+  size_t _maxSize{DefaultMaxSize};
+  std::vector<uint32_t> _sizes;
+  std::vector<size_t> _offsets;
+  std::vector<uint8_t> _output;
+};
+
+// The parameters and state of the shards optionally compressing the values they output or send
+struct Compressor {
+  REGISTER_ENUM(Codec, 'shCd');
+
+  static inline Parameters params{
+      {"Compression", SHCCSTR("The codec compressing the serialized value, None to not compress it."), {CodecType}},
+      {"Level", SHCCSTR("The compression level, 0 = the codec default."), {CoreInfo::IntType}},
+      {"Dictionary",
+       SHCCSTR("An optional dictionary (see Zstd.TrainDictionary) to compress small and repetitive values better, only Zstd "
+               "supports dictionaries."),
+       {CoreInfo::NoneType, CoreInfo::BytesType, CoreInfo::BytesVarType}}};
+
+  Codec codec{Codec::None};
+  int64_t level{0};
+  ParamVar dictionary{};
+
+  bool enabled() const { return codec != Codec::None; }
+
+  // index is relative to the first compression parameter
+  void setParam(int index, const SHVar &value);
+  SHVar getParam(int index);
+
+  void compose();
+  void warmup(SHContext *context) { dictionary.warmup(context); }
+  void cleanup() { dictionary.cleanup(); }
+
+  // Frames of data, valid until the next call
+  SHVar compress(SHContext *context, const uint8_t *data, size_t size);
+
+private:
+  Frames _frames;
+};
+} // namespace compression
+} // namespace shards
+
+#endif // SH_CORE_SHARDS_COMPRESSION
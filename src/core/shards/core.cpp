@@ -3,6 +3,7 @@
 
 #include "../runtime.hpp"
 #include "pdqsort.h"
+#include "sort.hpp"
 #include "utility.hpp"
 #include <boost/algorithm/string.hpp>
 #include <chrono>
@@ -126,10 +127,12 @@ struct ActionJointOp : public JointOp {
 };
 
 struct Sort : public ActionJointOp {
-  std::vector<SHVar> _multiSortKeys;
-  bool _desc = false;
+  static constexpr size_t ParallelThreshold = 1 << 16;
 
-  void setup() { shardsKeyFn._bu = this; }
+  bool _desc = false;
+  bool _parallel = false;
+  std::vector<OwnedVar> _keys;
+  SeqSorter _sorter;
 
   static SHOptionalString help() {
     return SHCCSTR("Sorts the elements of a sequence. Can also move around the elements of a joined sequence in alignment with "
@@ -146,7 +149,11 @@ struct Sort : public ActionJointOp {
        {"Key",
         SHCCSTR("The shards to use to transform the collection's items "
                 "before they are compared. Can be None."),
-        {CoreInfo::ShardsOrNone}}}};
+        {CoreInfo::ShardsOrNone}},
+       {"Parallel",
+        SHCCSTR("If large sequences should be sorted using multiple threads. Keys are still computed on the wire's "
+                "thread."),
+        {CoreInfo::BoolType}}}};
 
   static SHParametersInfo parameters() { return paramsInfo; }
 
@@ -161,6 +168,9 @@ struct Sort : public ActionJointOp {
     case 3:
       _blks = value;
       break;
+    case 4:
+      _parallel = value.payload.boolValue;
+      break;
     default:
       break;
     }
@@ -175,6 +185,8 @@ struct Sort : public ActionJointOp {
       return Var(_desc);
     case 3:
       return _blks;
+    case 4:
+      return Var(_parallel);
     default:
       break;
     }
@@ -206,88 +218,52 @@ struct Sort : public ActionJointOp {
     return inputType;
   }
 
-  struct {
-    bool operator()(const SHVar &a, const SHVar &b) const { return a > b; }
-  } sortAsc;
-
-  struct {
-    bool operator()(const SHVar &a, const SHVar &b) const { return a < b; }
-  } sortDesc;
-
-  struct {
-    const SHVar &operator()(const SHVar &a) { return a; }
-  } noopKeyFn;
-
-  struct {
-    Sort *_bu;
-    SHContext *_ctx;
-    SHVar _o;
-
-    const SHVar &operator()(const SHVar &a) {
-      _bu->_blks.activate(_ctx, a, _o);
-      return _o;
-    }
-  } shardsKeyFn;
-
-  template <class Compare, class KeyFn> void insertSort(SHVar seq[], int64_t n, Compare comp, KeyFn keyfn) {
-    int64_t i, j;
-    SHVar key{};
-    for (i = 1; i < n; i++) {
-      // main
-      key = seq[i];
-      // joined seqs
-      _multiSortKeys.clear();
-      for (const auto &seqVar : _multiSortColumns) {
-        const auto &col = seqVar->payload.seqValue;
-        if (col.len != n) {
-          throw ActivationError("Sort: All the sequences to be processed must have "
-                                "the same length as the input sequence.");
-        }
-        _multiSortKeys.push_back(col.elements[i]);
-      }
-      j = i - 1;
-      // notice no &, we WANT to copy
-      auto b = keyfn(key);
-      while (j >= 0 && comp(keyfn(seq[j]), b)) {
-        // main
-        seq[j + 1] = seq[j];
-        // joined seqs
-        for (const auto &seqVar : _multiSortColumns) {
-          const auto &col = seqVar->payload.seqValue;
-          col.elements[j + 1] = col.elements[j];
-        }
-        // main + join
-        j = j - 1;
-      }
-      // main
-      seq[j + 1] = key;
-      // joined seq
-      auto z = 0;
-      for (const auto &seqVar : _multiSortColumns) {
-        const auto &col = seqVar->payload.seqValue;
-        col.elements[j + 1] = _multiSortKeys[z++];
-      }
-    }
+  void cleanup() {
+    _keys.clear();
+    ActionJointOp::cleanup();
   }
 
   SHVar activate(SHContext *context, const SHVar &input) {
     JointOp::ensureJoinSetup(context);
-    // Sort in plac
-    int64_t len = int64_t(_input->payload.seqValue.len);
+
+    auto &seq = _input->payload.seqValue;
+    const size_t len = seq.len;
+
+    // decorate: run the key shards exactly once per element
+    const SHVar *keys = seq.elements;
     if (_blks) {
-      shardsKeyFn._ctx = context;
-      if (!_desc) {
-        insertSort(_input->payload.seqValue.elements, len, sortAsc, shardsKeyFn);
-      } else {
-        insertSort(_input->payload.seqValue.elements, len, sortDesc, shardsKeyFn);
+      _keys.resize(len);
+      SHVar output{};
+      for (size_t i = 0; i < len; i++) {
+        _blks.activate(context, seq.elements[i], output);
+        _keys[i] = output;
       }
+      keys = _keys.data();
+    }
+
+    invalidateSeqIndex(*_input);
+    for (const auto &seqVar : _multiSortColumns)
+      invalidateSeqIndex(*seqVar);
+
+    // sort
+    if (_parallel && len >= ParallelThreshold) {
+      await(
+          context, [&]() { _sorter.sort(keys, len, _desc, true); }, [] {});
     } else {
-      if (!_desc) {
-        insertSort(_input->payload.seqValue.elements, len, sortAsc, noopKeyFn);
-      } else {
-        insertSort(_input->payload.seqValue.elements, len, sortDesc, noopKeyFn);
+      _sorter.sort(keys, len, _desc, false);
+    }
+
+    // undecorate: move the main and joined sequences in place
+    _sorter.apply(seq);
+    for (const auto &seqVar : _multiSortColumns) {
+      auto &col = seqVar->payload.seqValue;
+      if (col.len != len) {
+        throw ActivationError("Sort: All the sequences to be processed must have "
+                              "the same length as the input sequence.");
       }
+      _sorter.apply(col);
     }
+
     return *_input;
   }
 };
@@ -379,6 +355,7 @@ struct Remove : public ActionJointOp {
     JointOp::ensureJoinSetup(context);
     // Remove in place, will possibly remove any sorting!
     SHVar output{};
+    bool invalidated = false;
     const uint32_t len = _input->payload.seqValue.len;
     for (uint32_t i = len; i > 0; i--) {
       const auto &var = _input->payload.seqValue.elements[i - 1];
@@ -387,6 +364,12 @@ struct Remove : public ActionJointOp {
         return *_input;
 
       if (output == Var::True) {
+        if (unlikely(!invalidated)) {
+          invalidateSeqIndex(*_input);
+          for (const auto &seqVar : _multiSortColumns)
+            invalidateSeqIndex(*seqVar);
+          invalidated = true;
+        }
         // this is acceptable cos del ops don't call free or grow
         if (_fast)
           arrayDelFast(_input->payload.seqValue, i - 1);
@@ -596,6 +579,7 @@ struct PrependTo : public XpendTo {
     case Seq: {
       auto &arr = collection.payload.seqValue;
       const auto len = arr.len;
+      invalidateSeqIndex(collection);
       shards::arrayResize(arr, len + 1);
       memmove(&arr.elements[1], &arr.elements[0], sizeof(*arr.elements) * len);
       cloneVar(arr.elements[0], input);
@@ -975,13 +959,16 @@ struct Erase : SeqUser {
         }
       }
     } else {
+      invalidateSeqIndex(*_target);
       if (indices.valueType == Int) {
         const auto index = indices.payload.intValue;
         arrayDel(_target->payload.seqValue, index);
       } else {
-        _sorter.insertSort(indices.payload.seqValue.elements, indices.payload.seqValue.len, _sorter.sortDesc, _sorter.noopKeyFn);
-        for (auto &idx : indices) {
-          const auto index = idx.payload.intValue;
+        // delete from the highest index down
+        const auto &seq = indices.payload.seqValue;
+        _sorter.sort(seq.elements, seq.len, true, false);
+        for (auto i : _sorter.order) {
+          const auto index = seq.elements[i].payload.intValue;
           arrayDel(_target->payload.seqValue, index);
         }
       }
@@ -990,7 +977,7 @@ struct Erase : SeqUser {
   }
 
 private:
-  Sort _sorter{};
+  SeqSorter _sorter;
   ParamVar _indices{};
   static inline Parameters _params = {
       {"Indices", SHCCSTR("One or multiple indices to filter from a sequence."), CoreInfo::TakeTypes},
@@ -1097,6 +1084,7 @@ struct Assoc : public VariableBase {
       auto n = input.payload.seqValue.len / 2;
 
       if (_cell->valueType == Seq) {
+        invalidateSeqIndex(*_cell);
         auto &s = _cell->payload.seqValue;
         for (uint32_t i = 0; i < n; i++) {
           auto &idx = input.payload.seqValue.elements[(i * 2) + 0];
@@ -1714,7 +1702,6 @@ RUNTIME_SHARD_END(Repeat);
 
 // Register Sort
 RUNTIME_CORE_SHARD(Sort);
-RUNTIME_SHARD_setup(Sort);
 RUNTIME_SHARD_help(Sort);
 RUNTIME_SHARD_inputTypes(Sort);
 RUNTIME_SHARD_inputHelp(Sort);
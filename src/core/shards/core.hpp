@@ -11,6 +11,7 @@
 #include "shards.hpp"
 #include "common_types.hpp"
 #include "number_types.hpp"
+#include "seq_index.hpp"
 #include <cassert>
 #include <cmath>
 #include <sstream>
@@ -46,7 +47,11 @@ struct Const {
 
   static SHParametersInfo parameters() { return SHParametersInfo(constParamsInfo); }
 
-  void setParam(int index, const SHVar &value) { _value = value; }
+  void setParam(int index, const SHVar &value) {
+    _value = value;
+    // outputs are shallow copies of _value, they carry the flag and share its cached hash
+    _value.flags |= SHVAR_FLAGS_FROZEN;
+  }
 
   SHVar getParam(int index) { return _value; }
 
@@ -705,6 +710,7 @@ struct SetBase : public VariableBase {
 
   ALWAYS_INLINE SHVar activate(SHContext *context, const SHVar &input) {
     if (likely(_cell != nullptr)) {
+      invalidateSeqIndex(*_cell);
       cloneVar(*_cell, input);
       return input;
     }
@@ -731,6 +737,7 @@ struct SetBase : public VariableBase {
       if (!_key.isVariable())
         _cell = vptr;
     } else {
+      invalidateSeqIndex(*_target);
       // Clone will try to recycle memory and such
       cloneVar(*_target, input);
 
@@ -1269,6 +1276,8 @@ struct Swap {
   }
 
   ALWAYS_INLINE SHVar activate(SHContext *context, const SHVar &input) {
+    invalidateSeqIndex(*_targetA);
+    invalidateSeqIndex(*_targetB);
     auto tmp = *_targetA;
     *_targetA = *_targetB;
     *_targetB = tmp;
@@ -1466,6 +1475,7 @@ struct Push : public SeqBase {
     }
 
     if (_clear && _firstPush) {
+      invalidateSeqIndex(*_cell);
       shards::arrayResize(_cell->payload.seqValue, 0);
     }
     const auto len = _cell->payload.seqValue.len;
@@ -1679,6 +1689,7 @@ struct Sequence : public SeqBase {
 
     if (_clear) {
       auto &seq = *_cell;
+      invalidateSeqIndex(seq);
       shards::arrayResize(seq.payload.seqValue, 0);
     }
 
@@ -2062,6 +2073,7 @@ struct Clear : SeqUser {
     }
 
     if (likely(_cell->valueType == Seq)) {
+      invalidateSeqIndex(*_cell);
       // notice this is fine because destroyVar will destroy .cap later
       // so we make sure we are not leaking Vars
       shards::arrayResize(_cell->payload.seqValue, 0);
@@ -2094,6 +2106,7 @@ struct Drop : SeqUser {
 
     if (likely(_cell->valueType == Seq)) {
       auto len = _cell->payload.seqValue.len;
+      invalidateSeqIndex(*_cell);
       // notice this is fine because destroyVar will destroy .cap later
       // so we make sure we are not leaking Vars
       if (len > 0) {
@@ -2130,6 +2143,7 @@ struct DropFront : SeqUser {
 
     if (likely(_cell->valueType == Seq) && _cell->payload.seqValue.len > 0) {
       auto &arr = _cell->payload.seqValue;
+      invalidateSeqIndex(*_cell);
       shards::arrayDel(arr, 0);
       // sometimes we might have as input the same _cell!
       // this is kind of a hack but helps UX
@@ -2211,6 +2225,7 @@ struct Pop : SeqUser {
       throw ActivationError("Pop: sequence was empty.");
     }
 
+    invalidateSeqIndex(*_cell);
     // Clone
     auto pops = shards::arrayPop<SHSeq, SHVar>(_cell->payload.seqValue);
     cloneVar(_output, pops);
@@ -2285,6 +2300,7 @@ struct PopFront : SeqUser {
       throw ActivationError("Pop: sequence was empty.");
     }
 
+    invalidateSeqIndex(*_cell);
     auto &arr = _cell->payload.seqValue;
     const auto len = arr.len - 1;
     // store to put back at end
@@ -3326,7 +3342,7 @@ struct Once {
 
   void warmup(SHContext *ctx) {
     _blks.warmup(ctx);
-    current = SHClock::now();
+    current = clockNow();
     dsleep = SHDuration(_repeatTime);
     next = current + SHDuration(0.0);
   }
@@ -3384,7 +3400,7 @@ struct Once {
   ALWAYS_INLINE SHVar activate(SHContext *context, const SHVar &input) {
     if (_repeat) {
       // monitor and reset timer if expired
-      current = SHClock::now();
+      current = clockNow();
       if (current >= next) {
         _done = false;
       }
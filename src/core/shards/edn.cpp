@@ -13,6 +13,8 @@ struct Uglify {
   std::vector<ShardsVar> _actions;
   std::vector<SHVar> _full;
   SHContext *_context{nullptr};
+  // an input that keeps changing (a live edited script) only re-reads the top level forms that changed
+  ReadCache _cache;
 
   static inline Parameters params{{"Hooks",
                                    SHCCSTR("A list of pairs to hook, [<symbol name> <shards to execute>], "
@@ -292,13 +294,12 @@ struct Uglify {
       if (action)
         action.cleanup();
     }
+    _cache = {};
   }
 
   SHVar activate(SHContext *context, const SHVar &input) {
     _context = context;
-    const auto s = input.payload.stringLen > 0 ? std::string(input.payload.stringValue, input.payload.stringLen)
-                                               : std::string(input.payload.stringValue);
-    auto forms = read(s);
+    auto forms = read(SHSTRVIEW(input), _cache);
     if (_cases.size())
       find_symbols(forms);
     _output.assign(print(forms));
@@ -1110,10 +1110,11 @@ struct Worker {
         exp = std::current_exception();
       }
       complete = true;
+      shards::CompletionSignal::notify();
     });
 
     while (!complete && context->shouldContinue()) {
-      if (shards::suspend(context, 0) != SHWireState::Continue)
+      if (shards::suspendUntil(context, complete) != SHWireState::Continue)
         break;
     }
 
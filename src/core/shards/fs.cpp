@@ -179,7 +179,7 @@ struct Filename {
 };
 
 struct Read {
-  std::vector<uint8_t> _buffer;
+  std::string _buffer;
   bool _binary = false;
 
   static SHTypesInfo inputTypes() { return CoreInfo::StringType; }
@@ -214,20 +214,23 @@ struct Read {
   SHVar activate(SHContext *context, const SHVar &input) {
     _buffer.clear();
     fs::path p(input.payload.stringValue);
-    if (!fs::exists(p)) {
+    // the file contents are recorded, replays don't need the file
+    const auto found = recordData(_buffer, [&]() {
+      if (!fs::exists(p))
+        return false;
+      std::ifstream file(p.string(), std::ios::binary);
+      _buffer.assign(std::istreambuf_iterator<char>(file), {});
+      return true;
+    });
+    if (!found) {
       SHLOG_ERROR("File is missing: {}", p);
       throw ActivationError("FS.Read, file does not exist.");
     }
 
     if (_binary) {
-      std::ifstream file(p.string(), std::ios::binary);
-      _buffer.assign(std::istreambuf_iterator<char>(file), {});
-      return Var(_buffer.data(), uint32_t(_buffer.size()));
+      return Var((uint8_t *)_buffer.data(), uint32_t(_buffer.size()));
     } else {
-      std::ifstream file(p.string(), std::ios::binary);
-      _buffer.assign(std::istreambuf_iterator<char>(file), {});
-      _buffer.push_back(0);
-      return Var((const char *)_buffer.data());
+      return Var(_buffer.c_str());
     }
   }
 };
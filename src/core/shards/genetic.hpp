@@ -8,10 +8,10 @@
 #include "shards.h"
 #include "shards.hpp"
 #include "shared.hpp"
+#include <algorithm>
 #include <limits>
 #include <pdqsort.h>
 #include <random>
-#include <sstream>
 #include <taskflow/taskflow.hpp>
 
 namespace shards {
@@ -64,7 +64,16 @@ struct Evolve {
       _threads = std::max(int64_t(1), value.payload.intValue);
       break;
     case 8:
-      _coros = value.payload.intValue;
+      _coros = std::max(int64_t(1), value.payload.intValue);
+      break;
+    case 9:
+      _nislands = std::max(int64_t(0), value.payload.intValue);
+      break;
+    case 10:
+      _migrationInterval = std::max(int64_t(1), value.payload.intValue);
+      break;
+    case 11:
+      _migrationRate = value.payload.floatValue;
       break;
     default:
       break;
@@ -91,6 +100,12 @@ struct Evolve {
       return shards::Var(_threads);
     case 8:
       return shards::Var(_coros);
+    case 9:
+      return shards::Var(_nislands);
+    case 10:
+      return shards::Var(_migrationInterval);
+    case 11:
+      return shards::Var(_migrationRate);
     default:
       return shards::Var::Empty;
     }
@@ -139,19 +154,31 @@ struct Evolve {
     arrayFree(res.exposedInfo);
     arrayFree(res.requiredInfo);
 
+    // Individuals are cloned from these snapshots of the composed wires
+    snapshot(_baseWire, _wireSnapshot);
+    snapshot(_fitnessWire, _fitnessSnapshot);
+
     return _outputType;
   }
 
   struct Writer {
-    std::stringstream &_stream;
-    Writer(std::stringstream &stream) : _stream(stream) {}
-    void operator()(const uint8_t *buf, size_t size) { _stream.write((const char *)buf, size); }
+    std::vector<uint8_t> &_buffer;
+    Writer(std::vector<uint8_t> &buffer) : _buffer(buffer) {}
+    void operator()(const uint8_t *buf, size_t size) { _buffer.insert(_buffer.end(), buf, buf + size); }
   };
 
   struct Reader {
-    std::stringstream &_stream;
-    Reader(std::stringstream &stream) : _stream(stream) {}
-    void operator()(uint8_t *buf, size_t size) { _stream.read((char *)buf, size); }
+    const std::vector<uint8_t> &_buffer;
+    size_t _offset{0};
+    Reader(const std::vector<uint8_t> &buffer) : _buffer(buffer) {}
+    void operator()(uint8_t *buf, size_t size) {
+      if (_buffer.size() < _offset + size) {
+        throw ActivationError("Evolve: snapshot buffer underrun");
+      }
+
+      memcpy(buf, _buffer.data() + _offset, size);
+      _offset += size;
+    }
   };
 
   void warmup(SHContext *context) {
@@ -162,22 +189,27 @@ struct Evolve {
   }
 
   void cleanup() {
-    if (_population.size() > 0) {
+    if (_islands.size() > 0) {
       tf::Taskflow cleanupFlow;
-      cleanupFlow.for_each_dynamic(_population.begin(), _population.end(), [&](Individual &i) {
-        // Free and release wire
-        i.mesh->terminate();
-        auto wire = SHWire::sharedFromRef(i.wire.payload.wireValue);
-        stop(wire.get());
-        Serialization::varFree(i.wire);
-        auto fitwire = SHWire::sharedFromRef(i.fitnessWire.payload.wireValue);
-        stop(fitwire.get());
-        Serialization::varFree(i.fitnessWire);
-      });
+      cleanupFlow.for_each_dynamic(
+          _islands.begin(), _islands.end(),
+          [](Island &island) {
+            for (auto &i : island.population) {
+              // Free and release wire
+              i.mesh->terminate();
+              auto wire = SHWire::sharedFromRef(i.wire.payload.wireValue);
+              stop(wire.get());
+              Serialization::varFree(i.wire);
+              auto fitwire = SHWire::sharedFromRef(i.fitnessWire.payload.wireValue);
+              stop(fitwire.get());
+              Serialization::varFree(i.fitnessWire);
+            }
+          },
+          1);
       _exec->run(cleanupFlow).get();
       _exec.reset(nullptr);
-      _sortedPopulation.clear();
-      _population.clear();
+      _islands.clear();
+      _best = nullptr;
     }
   }
 
@@ -186,310 +218,50 @@ struct Evolve {
         context,
         [&]() {
           // Init on the first run!
-          // We reuse those wires for every era
+          // We reuse those wires and meshes for every era
           // Only the DNA changes
-          if (_population.size() == 0) {
+          if (_islands.size() == 0) {
             SHLOG_TRACE("Evolve, first run, init");
-
-            Serialization serial;
-            std::stringstream wireStream;
-            Writer w1(wireStream);
-            serial.reset();
-            serial.serialize(_baseWire, w1);
-            auto wireStr = wireStream.str();
-
-            std::stringstream fitnessStream;
-            Writer w2(fitnessStream);
-            serial.reset();
-            serial.serialize(_fitnessWire, w2);
-            auto fitnessStr = fitnessStream.str();
-
-            _population.resize(_popsize);
-            _nkills = size_t(double(_popsize) * _extinction);
-            _nelites = size_t(double(_popsize) * _elitism);
-
-            tf::Taskflow initFlow;
-            initFlow.for_each_dynamic(_population.begin(), _population.end(), [&](Individual &i) {
-              Serialization deserial;
-              std::stringstream i1Stream(wireStr);
-              Reader r1(i1Stream);
-              deserial.reset();
-              deserial.deserialize(r1, i.wire);
-              auto wire = SHWire::sharedFromRef(i.wire.payload.wireValue);
-              gatherMutants(wire.get(), i.mutants);
-              resetState(i);
-
-              std::stringstream i2Stream(fitnessStr);
-              Reader r2(i2Stream);
-              deserial.reset();
-              deserial.deserialize(r2, i.fitnessWire);
-            });
-            _exec->run(initFlow).get();
-
-            size_t idx = 0;
-            for (auto &i : _population) {
-              i.idx = idx;
-              _sortedPopulation.emplace_back(&i);
-              idx++;
-            }
-
-            _era = 0;
+            init();
           } else {
-            SHLOG_TRACE("Evolve, crossover");
-
-            // do crossover here, populating tasks properly
-            tf::Taskflow crossoverFlow;
-            _crossingOver.clear();
-            int currentIdx = 0;
-            for (auto &ind : _sortedPopulation) {
-              ind->crossoverTask.reset();
-              if (Random::nextDouble() < _crossover) {
-                // In this case this individual
-                // becomes the child between two other individuals
-                // there is a chance also to keep current values
-                // so this is effectively tree way crossover
-                // Select from high fitness individuals
-                const auto parent0Idx = int(std::pow(Random::nextDouble(), 4) * double(_popsize));
-                auto parent0 = _sortedPopulation[parent0Idx];
-
-                const auto parent1Idx = int(std::pow(Random::nextDouble(), 4) * double(_popsize));
-                auto parent1 = _sortedPopulation[parent1Idx];
-
-                if (currentIdx != parent0Idx && currentIdx != parent1Idx && parent0Idx != parent1Idx &&
-                    parent0->parent0Idx != currentIdx && parent0->parent1Idx != currentIdx && parent1->parent0Idx != currentIdx &&
-                    parent1->parent1Idx != currentIdx) {
-                  ind->crossoverTask =
-                      crossoverFlow.emplace([this, ind, parent0, parent1]() { crossover(*ind, *parent0, *parent1); });
-#if 0
-              ind.get().crossoverTask.name(std::to_string(currentIdx) + " = " +
-                                           std::to_string(parent0Idx) + " + " +
-                                           std::to_string(parent1Idx));
-#endif
-                  _crossingOver.emplace_back(ind, parent0, parent1);
-                  ind->parent0Idx = parent0Idx;
-                  ind->parent1Idx = parent1Idx;
-                }
-              }
-              currentIdx++;
-            }
-
-            for (auto [a, b, c] : _crossingOver) {
-              auto &atask = a->crossoverTask;
-              auto &btask = b->crossoverTask;
-              auto &ctask = c->crossoverTask;
-              if (!btask.empty())
-                btask.precede(atask);
-              if (!ctask.empty())
-                ctask.precede(atask);
-            }
-#if 0
-        crossoverFlow.dump(std::cout);
-#endif
-            _exec->run(crossoverFlow).get();
-
-            _era++;
-
             // hack/fix
             // it is likely possible that the best wire we outputted
             // was used and so warmedup
-            auto best = SHWire::sharedFromRef(_sortedPopulation.front()->wire.payload.wireValue);
-            best->cleanup(true);
-            best->composedHash = Var::Empty;
-            best->wireUsers.clear();
+            releaseBest();
           }
 
-#if 1
-          // We run wires up to completion
-          // From validation to end, every iteration/era
-          // We run in such a way to allow coroutines + threads properly
-          SHLOG_TRACE("Evolve, schedule wires");
+          // Islands are independent between migrations, so each one runs a whole era
+          // (crossover, evaluation, sorting and mutations) as a single task on its own thread
+          SHLOG_TRACE("Evolve, run islands");
           {
             tf::Taskflow flow;
-
-            flow.for_each_dynamic(
-                _era == 0 ? _sortedPopulation.begin() : _sortedPopulation.begin() + _nelites, _sortedPopulation.end(),
-                [](auto &i) {
-                  // Evaluate our brain wire
-                  auto wire = SHWire::sharedFromRef(i->wire.payload.wireValue);
-                  i->mesh->schedule(wire);
-                },
-                _coros);
-
+            flow.for_each_dynamic(_islands.begin(), _islands.end(), [this](Island &island) { evolve(island); }, 1);
             _exec->run(flow).get();
           }
-          SHLOG_TRACE("Evolve, run wires");
-          {
-            tf::Taskflow flow;
-
-            flow.for_each_dynamic(
-                _era == 0 ? _sortedPopulation.begin() : _sortedPopulation.begin() + _nelites, _sortedPopulation.end(),
-                [](auto &i) {
-                  if (!i->mesh->empty())
-                    i->mesh->tick();
-                },
-                _coros);
-
-            _exec
-                ->run_until(flow,
-                            [&]() {
-                              size_t ended = 0;
-                              for (auto &p : _population) {
-                                if (p.mesh->empty())
-                                  ended++;
-                              }
-                              return ended == _population.size();
-                            })
-                .get();
-          }
-          SHLOG_TRACE("Evolve, schedule fitness");
-          {
-            tf::Taskflow flow;
 
-            flow.for_each_dynamic(
-                _era == 0 ? _sortedPopulation.begin() : _sortedPopulation.begin() + _nelites, _sortedPopulation.end(),
-                [](auto &i) {
-                  // reset fitness
-                  i->fitness = -std::numeric_limits<float>::max();
-                  // avoid scheduling if errors
-                  if (!i->mesh->errors().empty())
-                    return;
-                  // compute the fitness
-                  TickObserver obs{*i};
-                  auto fitwire = SHWire::sharedFromRef(i->fitnessWire.payload.wireValue);
-                  auto wire = SHWire::sharedFromRef(i->wire.payload.wireValue);
-                  i->mesh->schedule(obs, fitwire, wire->finishedOutput);
-                },
-                _coros);
+          _era++;
 
-            _exec->run(flow).get();
-          }
-          SHLOG_TRACE("Evolve, run fitness");
-          {
-            tf::Taskflow flow;
-
-            flow.for_each_dynamic(
-                _era == 0 ? _sortedPopulation.begin() : _sortedPopulation.begin() + _nelites, _sortedPopulation.end(),
-                [](auto &i) {
-                  if (!i->mesh->empty()) {
-                    TickObserver obs{*i};
-                    i->mesh->tick(obs);
-                  }
-                },
-                _coros);
-
-            _exec
-                ->run_until(flow,
-                            [&]() {
-                              size_t ended = 0;
-                              for (auto &p : _population) {
-                                if (p.mesh->empty())
-                                  ended++;
-                              }
-                              return ended == _population.size();
-                            })
-                .get();
-          }
-#else
-          // The following is for reference and for full TSAN runs
-
-          // We run wires up to completion
-          // From validation to end, every iteration/era
-          {
-            tf::Taskflow runFlow;
-            runFlow.for_each_dynamic(_population.begin(), _population.end(), [&](Individual &i) {
-              TickObserver obs{i};
-
-              // Evaluate our brain wire
-              auto wire = SHWire::sharedFromRef(i.wire.payload.wireValue);
-              i.mesh->schedule(wire);
-              while (!mesh.empty()) {
-                i.mesh->tick();
-              }
-
-              // reset fitness
-              i->fitness = -std::numeric_limits<float>::max();
-              // avoid scheduling if errors
-              if (!i->mesh->errors().empty())
-                return;
-
-              // compute the fitness
-              auto fitwire = SHWire::sharedFromRef(i.fitnessWire.payload.wireValue);
-              i.mesh->schedule(obs, fitwire, wire->finishedOutput);
-              while (!i.mesh->empty()) {
-                i.mesh->tick(obs);
-              }
-            });
-            _exec->run(runFlow).get();
+          if (_islands.size() > 1 && _era % size_t(_migrationInterval) == 0) {
+            SHLOG_TRACE("Evolve, migration");
+            migrate();
           }
-#endif
-          SHLOG_TRACE("Evolve, stopping all wires");
-          { // Stop all the population wires
-            tf::Taskflow flow;
-
-            flow.for_each_dynamic(_population.begin(), _population.end(), [](Individual &i) {
-              auto wire = SHWire::sharedFromRef(i.wire.payload.wireValue);
-              auto fitwire = SHWire::sharedFromRef(i.fitnessWire.payload.wireValue);
-              stop(wire.get());
-              wire->composedHash = Var::Empty;
-              stop(fitwire.get());
-              fitwire->composedHash = Var::Empty;
-              i.mesh->terminate();
-            });
 
-            _exec->run(flow).get();
-          }
+          SHLOG_TRACE("Evolve, era done");
 
-          SHLOG_TRACE("Evolve, sorting");
-          // remove non normal fitness (sort needs this or crashes will happen)
-          std::for_each(_sortedPopulation.begin(), _sortedPopulation.end(), [](auto &i) {
-            if (!std::isnormal(i->fitness)) {
-              i->fitness = -std::numeric_limits<float>::max();
-            }
-          });
-          pdqsort(_sortedPopulation.begin(), _sortedPopulation.end(),
-                  [](const auto &a, const auto &b) { return a->fitness > b->fitness; });
-
-          SHLOG_TRACE("Evolve, resetting flags");
-          // reset flags
-          std::for_each(_sortedPopulation.begin(), _sortedPopulation.end() - _nkills, [](auto &i) {
-            i->extinct = false;
-            i->parent0Idx = -1;
-            i->parent1Idx = -1;
-          });
-          std::for_each(_sortedPopulation.end() - _nkills, _sortedPopulation.end(), [](auto &i) {
-            i->extinct = true;
-            i->parent0Idx = -1;
-            i->parent1Idx = -1;
-          });
-
-          SHLOG_TRACE("Evolve, run mutations");
-          // Do mutations at end, yet when contexts are still valid!
-          // since we might need them
-          {
-            tf::Taskflow mutFlow;
-            mutFlow.for_each_dynamic(_sortedPopulation.begin() + _nelites, _sortedPopulation.end(), [&](auto &i) {
-              // reset the individual if extinct
-              if (i->extinct) {
-                resetState(*i);
-              }
-              mutate(*i);
-            });
-            _exec->run(mutFlow).get();
+          _best = _islands.front().sortedPopulation.front();
+          for (auto &island : _islands) {
+            if (island.sortedPopulation.front()->fitness > _best->fitness)
+              _best = island.sortedPopulation.front();
           }
 
-          SHLOG_TRACE("Evolve, era done");
-
           // hack/fix
           // it is likely possible that the best wire we outputted
           // was used and so warmedup
-          auto best = SHWire::sharedFromRef(_sortedPopulation.front()->wire.payload.wireValue);
-          best->cleanup(true);
-          best->composedHash = Var::Empty;
-          best->wireUsers.clear();
+          releaseBest();
 
           _result.clear();
-          _result.emplace_back(shards::Var(_sortedPopulation.front()->fitness));
-          _result.emplace_back(_sortedPopulation.front()->wire);
+          _result.emplace_back(shards::Var(_best->fitness));
+          _result.emplace_back(_best->wire);
           return shards::Var(_result);
         },
         [] {
@@ -510,6 +282,8 @@ private:
 
   static inline void gatherMutants(SHWire *wire, std::vector<MutantInfo> &out);
 
+  enum class Crossing { None, Pending, Running };
+
   struct Individual {
     ~Individual() {
       Serialization::varFree(wire);
@@ -522,7 +296,7 @@ private:
     SHVar wire{};
     // We need many of them cos we use threads
     SHVar fitnessWire{};
-    // The mesh we run on
+    // The mesh we run on, also recycled
     std::shared_ptr<SHMesh> mesh{SHMesh::make()};
 
     // Keep track of mutants and push/pop mutations on wire
@@ -532,11 +306,21 @@ private:
 
     bool extinct = false;
 
-    tf::Task crossoverTask;
+    Crossing crossing = Crossing::None;
+    Individual *parent0 = nullptr;
+    Individual *parent1 = nullptr;
     int parent0Idx = -1;
     int parent1Idx = -1;
   };
 
+  // A sub population evolving on its own, only migrations mix islands
+  struct Island {
+    std::vector<Individual> population;
+    std::vector<Individual *> sortedPopulation;
+    size_t nkills = 0;
+    size_t nelites = 0;
+  };
+
   struct TickObserver {
     Individual &self;
 
@@ -559,7 +343,239 @@ private:
     }
   };
 
+  static void snapshot(const SHVar &wire, std::vector<uint8_t> &buffer) {
+    Serialization serial;
+    Writer w(buffer);
+    buffer.clear();
+    serial.serialize(wire, w);
+  }
+
+  void init() {
+    const auto nislands =
+        size_t(std::clamp(_nislands > 0 ? _nislands : _threads, int64_t(1), std::max(int64_t(1), _popsize / 2)));
+    _islands.resize(nislands);
+    size_t idx = 0;
+    for (size_t n = 0; n < nislands; n++) {
+      auto &island = _islands[n];
+      // the remainder goes to the first islands
+      const auto size = size_t(_popsize) / nislands + (n < size_t(_popsize) % nislands ? 1 : 0);
+      island.population.resize(size);
+      island.nkills = size_t(double(size) * _extinction);
+      island.nelites = size_t(double(size) * _elitism);
+      for (auto &i : island.population) {
+        i.idx = idx++;
+        island.sortedPopulation.emplace_back(&i);
+      }
+    }
+
+    tf::Taskflow initFlow;
+    initFlow.for_each_dynamic(
+        _islands.begin(), _islands.end(),
+        [this](Island &island) {
+          Serialization deserial;
+          for (auto &i : island.population) {
+            Reader r1(_wireSnapshot);
+            deserial.reset();
+            deserial.deserialize(r1, i.wire);
+            auto wire = SHWire::sharedFromRef(i.wire.payload.wireValue);
+            gatherMutants(wire.get(), i.mutants);
+            resetState(i);
+
+            Reader r2(_fitnessSnapshot);
+            deserial.reset();
+            deserial.deserialize(r2, i.fitnessWire);
+          }
+        },
+        1);
+    _exec->run(initFlow).get();
+
+    _era = 0;
+  }
+
+  void releaseBest() {
+    if (!_best)
+      return;
+
+    auto best = SHWire::sharedFromRef(_best->wire.payload.wireValue);
+    best->cleanup(true);
+    best->composedHash = Var::Empty;
+    best->wireUsers.clear();
+  }
+
+  void evolve(Island &island) {
+    auto &sorted = island.sortedPopulation;
+
+    if (_era > 0) {
+      SHLOG_TRACE("Evolve, crossover");
+      crossover(island);
+    }
+
+    // We run wires up to completion
+    // From validation to end, every iteration/era
+    SHLOG_TRACE("Evolve, run wires");
+    evaluate(island);
+
+    SHLOG_TRACE("Evolve, stopping all wires");
+    for (auto &i : island.population) {
+      auto wire = SHWire::sharedFromRef(i.wire.payload.wireValue);
+      auto fitwire = SHWire::sharedFromRef(i.fitnessWire.payload.wireValue);
+      stop(wire.get());
+      wire->composedHash = Var::Empty;
+      stop(fitwire.get());
+      fitwire->composedHash = Var::Empty;
+      i.mesh->terminate();
+    }
+
+    SHLOG_TRACE("Evolve, sorting");
+    // remove non normal fitness (sort needs this or crashes will happen)
+    std::for_each(sorted.begin(), sorted.end(), [](auto &i) {
+      if (!std::isnormal(i->fitness)) {
+        i->fitness = -std::numeric_limits<float>::max();
+      }
+    });
+    pdqsort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a->fitness > b->fitness; });
+
+    SHLOG_TRACE("Evolve, resetting flags");
+    // reset flags
+    std::for_each(sorted.begin(), sorted.end() - island.nkills, [](auto &i) {
+      i->extinct = false;
+      i->parent0Idx = -1;
+      i->parent1Idx = -1;
+    });
+    std::for_each(sorted.end() - island.nkills, sorted.end(), [](auto &i) {
+      i->extinct = true;
+      i->parent0Idx = -1;
+      i->parent1Idx = -1;
+    });
+
+    SHLOG_TRACE("Evolve, run mutations");
+    // Do mutations at end, yet when contexts are still valid!
+    // since we might need them
+    std::for_each(sorted.begin() + island.nelites, sorted.end(), [&](auto &i) {
+      // reset the individual if extinct
+      if (i->extinct) {
+        resetState(*i);
+      }
+      mutate(*i);
+    });
+  }
+
+  void crossover(Island &island) {
+    auto &sorted = island.sortedPopulation;
+    const auto size = double(sorted.size());
+    int currentIdx = 0;
+    for (auto &ind : sorted) {
+      if (Random::nextDouble() < _crossover) {
+        // In this case this individual
+        // becomes the child between two other individuals
+        // there is a chance also to keep current values
+        // so this is effectively tree way crossover
+        // Select from high fitness individuals
+        const auto parent0Idx = int(std::pow(Random::nextDouble(), 4) * size);
+        auto parent0 = sorted[parent0Idx];
+
+        const auto parent1Idx = int(std::pow(Random::nextDouble(), 4) * size);
+        auto parent1 = sorted[parent1Idx];
+
+        if (currentIdx != parent0Idx && currentIdx != parent1Idx && parent0Idx != parent1Idx &&
+            parent0->parent0Idx != currentIdx && parent0->parent1Idx != currentIdx && parent1->parent0Idx != currentIdx &&
+            parent1->parent1Idx != currentIdx) {
+          ind->crossing = Crossing::Pending;
+          ind->parent0 = parent0;
+          ind->parent1 = parent1;
+          ind->parent0Idx = parent0Idx;
+          ind->parent1Idx = parent1Idx;
+        }
+      }
+      currentIdx++;
+    }
+
+    // parents that are children too are crossed over first
+    for (auto &ind : sorted) {
+      crossoverPending(*ind);
+    }
+  }
+
+  void crossoverPending(Individual &child) {
+    if (child.crossing != Crossing::Pending)
+      return;
+
+    // Running breaks cycles, the parent then passes on its current genes
+    child.crossing = Crossing::Running;
+    crossoverPending(*child.parent0);
+    crossoverPending(*child.parent1);
+    crossover(child, *child.parent0, *child.parent1);
+    child.crossing = Crossing::None;
+  }
+
+  // Runs the wires and then the fitness wires of the island, up to Coroutines individuals at once
+  void evaluate(Island &island) {
+    auto &sorted = island.sortedPopulation;
+    auto it = _era == 0 ? sorted.begin() : sorted.begin() + island.nelites;
+    while (it != sorted.end()) {
+      const auto end = it + std::min(std::ptrdiff_t(_coros), std::distance(it, sorted.end()));
+
+      std::for_each(it, end, [](auto &i) {
+        // Evaluate our brain wire
+        auto wire = SHWire::sharedFromRef(i->wire.payload.wireValue);
+        i->mesh->schedule(wire);
+      });
+      tickAll(it, end, false);
+
+      std::for_each(it, end, [](auto &i) {
+        // reset fitness
+        i->fitness = -std::numeric_limits<float>::max();
+        // avoid scheduling if errors
+        if (!i->mesh->errors().empty())
+          return;
+        // compute the fitness
+        TickObserver obs{*i};
+        auto fitwire = SHWire::sharedFromRef(i->fitnessWire.payload.wireValue);
+        auto wire = SHWire::sharedFromRef(i->wire.payload.wireValue);
+        i->mesh->schedule(obs, fitwire, wire->finishedOutput);
+      });
+      tickAll(it, end, true);
+
+      it = end;
+    }
+  }
+
+  template <typename IT> static void tickAll(IT begin, IT end, bool fitness) {
+    bool running = true;
+    while (running) {
+      running = false;
+      std::for_each(begin, end, [&](auto &i) {
+        if (i->mesh->empty())
+          return;
+
+        if (fitness) {
+          TickObserver obs{*i};
+          i->mesh->tick(obs);
+        } else {
+          i->mesh->tick();
+        }
+        running = running || !i->mesh->empty();
+      });
+    }
+  }
+
+  // Ring migration, the best individuals of each island replace the worst ones of the next island
+  void migrate() {
+    for (size_t n = 0; n < _islands.size(); n++) {
+      auto &from = _islands[n].sortedPopulation;
+      auto &to = _islands[(n + 1) % _islands.size()];
+      const auto size = to.sortedPopulation.size();
+      // never overwrite elites nor the individuals the island itself sends away
+      const auto count = std::min({size_t(double(size) * _migrationRate), from.size() / 2, size / 2,
+                                   size - std::min(size, to.nelites)});
+      for (size_t m = 0; m < count; m++) {
+        immigrate(*to.sortedPopulation[size - 1 - m], *from[m]);
+      }
+    }
+  }
+
   inline void crossover(Individual &child, const Individual &parent0, const Individual &parent1);
+  inline void immigrate(Individual &immigrant, const Individual &emigrant);
   inline void mutate(Individual &individual);
   inline void resetState(Individual &individual);
 
@@ -575,7 +591,16 @@ private:
       {"Extinction", SHCCSTR("The rate of extinction, 0.1 = 10%."), {CoreInfo::FloatType}},
       {"Elitism", SHCCSTR("The rate of elitism, 0.1 = 10%."), {CoreInfo::FloatType}},
       {"Threads", SHCCSTR("The number of cpu threads to use."), {CoreInfo::IntType}},
-      {"Coroutines", SHCCSTR("The number of coroutines to run on each thread."), {CoreInfo::IntType}}};
+      {"Coroutines", SHCCSTR("The number of coroutines to run on each thread."), {CoreInfo::IntType}},
+      {"Islands",
+       SHCCSTR("The number of islands the population is split into, each island evolves on its own thread; "
+               "0 = as many as Threads."),
+       {CoreInfo::IntType}},
+      {"MigrationInterval",
+       SHCCSTR("The number of eras between migrations, when the best individuals of each island replace the worst of the "
+               "next island."),
+       {CoreInfo::IntType}},
+      {"MigrationRate", SHCCSTR("The rate of each island population migrating, 0.1 = 10%."), {CoreInfo::FloatType}}};
   static inline Types _outputTypes{{CoreInfo::FloatType, CoreInfo::WireType}};
   static inline Type _outputType{{SHType::Seq, {.seqTypes = _outputTypes}}};
 
@@ -583,19 +608,21 @@ private:
 
   OwnedVar _baseWire{};
   OwnedVar _fitnessWire{};
+  std::vector<uint8_t> _wireSnapshot;
+  std::vector<uint8_t> _fitnessSnapshot;
   std::vector<SHVar> _result;
-  std::vector<Individual> _population;
-  std::vector<Individual *> _sortedPopulation;
-  std::vector<std::tuple<Individual *, Individual *, Individual *>> _crossingOver;
+  std::vector<Island> _islands;
+  Individual *_best = nullptr;
   int64_t _popsize = 64;
   int64_t _coros = 8;
   int64_t _threads = 2;
+  int64_t _nislands = 0;
+  int64_t _migrationInterval = 5;
+  double _migrationRate = 0.1;
   double _mutation = 0.2;
   double _crossover = 0.2;
   double _extinction = 0.1;
-  size_t _nkills = 0;
   double _elitism = 0.1;
-  size_t _nelites = 0;
   size_t _era = 0;
 };
 
@@ -932,6 +959,31 @@ inline void Evolve::crossover(Individual &child, const Individual &parent0, cons
   }
 }
 
+inline void Evolve::immigrate(Individual &immigrant, const Individual &emigrant) {
+  auto imuts = immigrant.mutants.cbegin();
+  auto emuts = emigrant.mutants.cbegin();
+  for (; imuts != immigrant.mutants.end() && emuts != emigrant.mutants.end(); ++imuts, ++emuts) {
+    auto ib = imuts->shard.get().mutant();
+    auto eb = emuts->shard.get().mutant();
+    if (ib && eb) {
+      // copy the whole state if possible
+      if (ib->setState && eb->getState) {
+        auto state = eb->getState(eb);
+        ib->setState(ib, &state);
+      }
+      // and the mutant params
+      auto &indices = imuts->shard.get()._indices;
+      if (indices.valueType == Seq) {
+        for (auto &idx : indices) {
+          const auto i = int(idx.payload.intValue);
+          auto val = eb->getParam(eb, i);
+          ib->setParam(ib, i, &val);
+        }
+      }
+    }
+  }
+}
+
 inline void Evolve::mutate(Evolve::Individual &individual) {
   auto wire = SHWire::sharedFromRef(individual.wire.payload.wireValue);
   // we need to hack this in as we run out of context
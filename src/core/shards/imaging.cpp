@@ -5,12 +5,413 @@
 #define IMAGING_H
 
 #include "shared.hpp"
+#include "imaging.hpp"
+#include "number_types.hpp"
+#include <cmath>
 
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
-#include <stb_image_resize.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 namespace shards {
 namespace Imaging {
+namespace {
+// Accumulates the weights of one output of an AxisFilter over a dense range of input indices
+struct FilterBuilder {
+  AxisFilter filter;
+  std::vector<float> row;
+  uint32_t rowFirst{0};
+
+  FilterBuilder(uint32_t inSize, uint32_t outSize) {
+    filter.inSize = inSize;
+    filter.first.reserve(outSize);
+    filter.offsets.reserve(outSize + 1);
+    filter.offsets.push_back(0);
+  }
+
+  uint32_t clamp(int64_t index) const { return uint32_t(std::clamp<int64_t>(index, 0, int64_t(filter.inSize) - 1)); }
+
+  void begin(int64_t lo, int64_t hi) {
+    rowFirst = clamp(lo);
+    row.assign(clamp(hi) - rowFirst + 1, 0.0f);
+  }
+
+  void add(int64_t index, float weight) { row[clamp(index) - rowFirst] += weight; }
+
+  void end() {
+    // trim zero weights, keeping at least one tap
+    size_t lo = 0, hi = row.size();
+    while (hi - lo > 1 && row[lo] == 0.0f)
+      lo++;
+    while (hi - lo > 1 && row[hi - 1] == 0.0f)
+      hi--;
+    filter.first.push_back(rowFirst + uint32_t(lo));
+    filter.weights.insert(filter.weights.end(), row.begin() + lo, row.begin() + hi);
+    filter.offsets.push_back(uint32_t(filter.weights.size()));
+  }
+};
+
+// Cubic filters family, B = 0 C = 0.5 is Catmull-Rom and B = C = 1/3 is Mitchell
+float cubic(float x, float b, float c) {
+  x = std::abs(x);
+  if (x < 1.0f)
+    return ((12.0f - 9.0f * b - 6.0f * c) * x * x * x + (-18.0f + 12.0f * b + 6.0f * c) * x * x + (6.0f - 2.0f * b)) / 6.0f;
+  if (x < 2.0f)
+    return ((-b - 6.0f * c) * x * x * x + (6.0f * b + 30.0f * c) * x * x + (-12.0f * b - 48.0f * c) * x + (8.0f * b + 24.0f * c)) /
+           6.0f;
+  return 0.0f;
+}
+
+// sRGB transfer functions, tabulated and linearly interpolated
+struct SrgbTables {
+  static constexpr size_t Size = 4096;
+
+  float toLinear[Size + 1];
+  float toSrgb[Size + 1];
+
+  SrgbTables() {
+    for (size_t i = 0; i <= Size; i++) {
+      const float v = float(i) / float(Size);
+      toLinear[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+      toSrgb[i] = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+    }
+  }
+
+  static float lookup(const float *table, float v) {
+    v = std::clamp(v, 0.0f, 1.0f) * float(Size);
+    const auto i = std::min(size_t(v), Size - 1);
+    const float t = v - float(i);
+    return table[i] + (table[i + 1] - table[i]) * t;
+  }
+
+  static const SrgbTables &get() {
+    static SrgbTables tables;
+    return tables;
+  }
+};
+
+size_t pixelSizeOf(uint8_t flags) {
+  if ((flags & SHIMAGE_FLAGS_16BITS_INT) == SHIMAGE_FLAGS_16BITS_INT)
+    return 2;
+  else if ((flags & SHIMAGE_FLAGS_32BITS_FLOAT) == SHIMAGE_FLAGS_32BITS_FLOAT)
+    return 4;
+  return 1;
+}
+
+// Horizontal pass over one row of a tile, in holds the input pixels starting at column ix0
+template <uint32_t C>
+void filterRow(const AxisFilter &f, uint32_t ox0, uint32_t ox1, uint32_t ix0, const float *__restrict in, float *__restrict out) {
+  for (uint32_t ox = ox0; ox < ox1; ox++, out += C) {
+    const float *w = f.weightsOf(ox);
+    const float *src = in + size_t(f.first[ox] - ix0) * C;
+    const uint32_t n = f.taps(ox);
+    float acc[C]{};
+    for (uint32_t t = 0; t < n; t++, src += C) {
+      for (uint32_t ch = 0; ch < C; ch++)
+        acc[ch] += w[t] * src[ch];
+    }
+    for (uint32_t ch = 0; ch < C; ch++)
+      out[ch] = acc[ch];
+  }
+}
+
+#if defined(__AVX2__)
+template <>
+void filterRow<4>(const AxisFilter &f, uint32_t ox0, uint32_t ox1, uint32_t ix0, const float *__restrict in,
+                  float *__restrict out) {
+  for (uint32_t ox = ox0; ox < ox1; ox++, out += 4) {
+    const float *w = f.weightsOf(ox);
+    const float *src = in + size_t(f.first[ox] - ix0) * 4;
+    const uint32_t n = f.taps(ox);
+    __m128 acc = _mm_setzero_ps();
+    for (uint32_t t = 0; t < n; t++, src += 4)
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[t]), _mm_loadu_ps(src)));
+    _mm_storeu_ps(out, acc);
+  }
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+template <>
+void filterRow<4>(const AxisFilter &f, uint32_t ox0, uint32_t ox1, uint32_t ix0, const float *__restrict in,
+                  float *__restrict out) {
+  for (uint32_t ox = ox0; ox < ox1; ox++, out += 4) {
+    const float *w = f.weightsOf(ox);
+    const float *src = in + size_t(f.first[ox] - ix0) * 4;
+    const uint32_t n = f.taps(ox);
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (uint32_t t = 0; t < n; t++, src += 4)
+      acc = vfmaq_n_f32(acc, vld1q_f32(src), w[t]);
+    vst1q_f32(out, acc);
+  }
+}
+#endif
+
+void filterRow(const AxisFilter &f, uint32_t ox0, uint32_t ox1, uint32_t ix0, uint32_t c, const float *in, float *out) {
+  switch (c) {
+  case 1:
+    return filterRow<1>(f, ox0, ox1, ix0, in, out);
+  case 2:
+    return filterRow<2>(f, ox0, ox1, ix0, in, out);
+  case 3:
+    return filterRow<3>(f, ox0, ox1, ix0, in, out);
+  case 4:
+    return filterRow<4>(f, ox0, ox1, ix0, in, out);
+  default:
+    for (uint32_t ox = ox0; ox < ox1; ox++, out += c) {
+      const float *w = f.weightsOf(ox);
+      const float *src = in + size_t(f.first[ox] - ix0) * c;
+      std::fill(out, out + c, 0.0f);
+      for (uint32_t t = 0; t < f.taps(ox); t++, src += c) {
+        for (uint32_t ch = 0; ch < c; ch++)
+          out[ch] += w[t] * src[ch];
+      }
+    }
+  }
+}
+} // namespace
+
+bool AxisFilter::isIdentity() const {
+  if (outSize() != inSize)
+    return false;
+  for (uint32_t i = 0; i < inSize; i++) {
+    if (first[i] != i || taps(i) != 1 || weights[offsets[i]] != 1.0f)
+      return false;
+  }
+  return true;
+}
+
+AxisFilter AxisFilter::identity(uint32_t size) { return convolution(size, {1.0f}); }
+
+AxisFilter AxisFilter::convolution(uint32_t size, const std::vector<float> &taps) {
+  shassert(taps.size() % 2 == 1);
+  const int64_t radius = int64_t(taps.size() / 2);
+  FilterBuilder builder(size, size);
+  for (int64_t i = 0; i < int64_t(size); i++) {
+    builder.begin(i - radius, i + radius);
+    for (int64_t k = 0; k < int64_t(taps.size()); k++)
+      builder.add(i + k - radius, taps[k]);
+    builder.end();
+  }
+  return std::move(builder.filter);
+}
+
+AxisFilter AxisFilter::resampling(uint32_t inSize, uint32_t outSize) {
+  const float scale = float(inSize) / float(outSize);
+  // stretch the filter when downsampling so that it covers all the input
+  const float stretch = std::max(1.0f, scale);
+  const float support = 2.0f * stretch;
+  const bool down = scale > 1.0f;
+  const float b = down ? 1.0f / 3.0f : 0.0f;
+  const float c = down ? 1.0f / 3.0f : 0.5f;
+
+  FilterBuilder builder(inSize, outSize);
+  std::vector<float> raw;
+  for (uint32_t i = 0; i < outSize; i++) {
+    const float center = (float(i) + 0.5f) * scale - 0.5f;
+    const auto lo = int64_t(std::ceil(center - support));
+    const auto hi = int64_t(std::floor(center + support));
+    raw.resize(size_t(hi - lo + 1));
+    float sum = 0.0f;
+    for (int64_t j = lo; j <= hi; j++) {
+      const float w = cubic((float(j) - center) / stretch, b, c);
+      raw[j - lo] = w;
+      sum += w;
+    }
+    builder.begin(lo, hi);
+    for (int64_t j = lo; j <= hi; j++)
+      builder.add(j, raw[j - lo] / sum);
+    builder.end();
+  }
+  return std::move(builder.filter);
+}
+
+AxisFilter AxisFilter::then(const AxisFilter &next) const {
+  shassert(next.inSize == outSize());
+  FilterBuilder builder(inSize, next.outSize());
+  for (uint32_t j = 0; j < next.outSize(); j++) {
+    const uint32_t k0 = next.first[j];
+    const uint32_t k1 = k0 + next.taps(j);
+    uint32_t lo = first[k0], hi = 0;
+    for (uint32_t k = k0; k < k1; k++) {
+      lo = std::min(lo, first[k]);
+      hi = std::max(hi, first[k] + taps(k) - 1);
+    }
+    builder.begin(lo, hi);
+    const float *nw = next.weightsOf(j);
+    for (uint32_t k = k0; k < k1; k++) {
+      const float *w = weightsOf(k);
+      for (uint32_t t = 0; t < taps(k); t++)
+        builder.add(first[k] + t, nw[k - k0] * w[t]);
+    }
+    builder.end();
+  }
+  return std::move(builder.filter);
+}
+
+std::vector<float> boxKernel(uint32_t radius) { return std::vector<float>(radius * 2 + 1, 1.0f / float(radius * 2 + 1)); }
+
+std::vector<float> gaussianKernel(uint32_t radius) {
+  if (radius == 0)
+    return {1.0f};
+  const float sigma = float(radius) / 2.0f;
+  std::vector<float> taps(radius * 2 + 1);
+  float sum = 0.0f;
+  for (int64_t i = -int64_t(radius); i <= int64_t(radius); i++) {
+    const float w = std::exp(-float(i * i) / (2.0f * sigma * sigma));
+    taps[i + radius] = w;
+    sum += w;
+  }
+  for (auto &w : taps)
+    w /= sum;
+  return taps;
+}
+
+namespace {
+AxisFilter fuse(const AxisFilter &current, AxisFilter &&next) { return current.isIdentity() ? std::move(next) : current.then(next); }
+} // namespace
+
+void ImagePipeline::reset(uint32_t width, uint32_t height) {
+  _x = AxisFilter::identity(width);
+  _y = AxisFilter::identity(height);
+}
+
+void ImagePipeline::convolve(const std::vector<float> &horizontal, const std::vector<float> &vertical) {
+  _x = fuse(_x, AxisFilter::convolution(width(), horizontal));
+  _y = fuse(_y, AxisFilter::convolution(height(), vertical));
+}
+
+void ImagePipeline::boxBlur(uint32_t radius) {
+  const auto taps = boxKernel(radius);
+  convolve(taps, taps);
+}
+
+void ImagePipeline::gaussianBlur(uint32_t radius) {
+  const auto taps = gaussianKernel(radius);
+  convolve(taps, taps);
+}
+
+void ImagePipeline::resize(uint32_t width, uint32_t height) {
+  const uint32_t w = this->width();
+  const uint32_t h = this->height();
+  if (width == 0)
+    width = std::max(1u, uint32_t(float(w) * float(height) / float(h)));
+  else if (height == 0)
+    height = std::max(1u, uint32_t(float(h) * float(width) / float(w)));
+  if (width != w)
+    _x = fuse(_x, AxisFilter::resampling(w, width));
+  if (height != h)
+    _y = fuse(_y, AxisFilter::resampling(h, height));
+}
+
+void ImagePipeline::run(const SHImage &input, uint8_t *output, bool linearize) const {
+  shassert(input.width == inputWidth() && input.height == inputHeight());
+  const uint32_t c = input.channels;
+  const size_t pixsize = pixelSizeOf(input.flags);
+  const uint32_t inW = inputWidth();
+  const uint32_t outW = width();
+  const uint32_t outH = height();
+
+  if (_x.isIdentity() && _y.isIdentity()) {
+    memcpy(output, input.data, size_t(outW) * outH * c * pixsize);
+    return;
+  }
+
+  const auto type = pixsize == 1 ? NumberType::UInt8 : pixsize == 2 ? NumberType::UInt16 : NumberType::Float32;
+  auto &lookup = NumberTypeLookup::getInstance();
+  const auto load = lookup.getConversion(type, NumberType::Float32)->getConvertMany(NumberConversionMode::Normalize);
+  const auto store = lookup.getConversion(NumberType::Float32, type)->getConvertMany(NumberConversionMode::Normalize);
+  const size_t typeSize = pixsize;
+
+  const bool srgb = linearize && pixsize != 4;
+  const bool premultiply = c == 4 && (input.flags & SHIMAGE_FLAGS_PREMULTIPLIED_ALPHA) == 0;
+  // alpha is never sRGB encoded
+  const uint32_t colors = c == 4 ? 3 : c;
+  const auto &tables = SrgbTables::get();
+
+  const uint32_t tilesX = (outW + TileWidth - 1) / TileWidth;
+  const uint32_t tilesY = (outH + TileHeight - 1) / TileHeight;
+  parallelFor(size_t(tilesX) * tilesY, [&](size_t tile) {
+    thread_local std::vector<float> line;
+    thread_local std::vector<float> rows;
+    thread_local std::vector<float> acc;
+
+    const uint32_t ox0 = uint32_t(tile % tilesX) * TileWidth;
+    const uint32_t ox1 = std::min(outW, ox0 + TileWidth);
+    const uint32_t oy0 = uint32_t(tile / tilesX) * TileHeight;
+    const uint32_t oy1 = std::min(outH, oy0 + TileHeight);
+
+    // the input window this tile depends on
+    uint32_t ix0 = inW, ix1 = 0;
+    for (uint32_t ox = ox0; ox < ox1; ox++) {
+      ix0 = std::min(ix0, _x.first[ox]);
+      ix1 = std::max(ix1, _x.first[ox] + _x.taps(ox));
+    }
+    uint32_t iy0 = inputHeight(), iy1 = 0;
+    for (uint32_t oy = oy0; oy < oy1; oy++) {
+      iy0 = std::min(iy0, _y.first[oy]);
+      iy1 = std::max(iy1, _y.first[oy] + _y.taps(oy));
+    }
+
+    const size_t lineLen = size_t(ix1 - ix0) * c;
+    const size_t rowLen = size_t(ox1 - ox0) * c;
+    line.resize(lineLen);
+    rows.resize(size_t(iy1 - iy0) * rowLen);
+    acc.resize(rowLen);
+
+    // horizontal pass on the input rows of the window
+    for (uint32_t iy = iy0; iy < iy1; iy++) {
+      const uint8_t *src = input.data + (size_t(iy) * inW + ix0) * c * pixsize;
+      load(src, typeSize, line.data(), sizeof(float), lineLen);
+      if (srgb || premultiply) {
+        for (size_t i = 0; i < lineLen; i += c) {
+          float *px = &line[i];
+          if (srgb) {
+            for (uint32_t ch = 0; ch < colors; ch++)
+              px[ch] = SrgbTables::lookup(tables.toLinear, px[ch]);
+          }
+          if (premultiply) {
+            for (uint32_t ch = 0; ch < 3; ch++)
+              px[ch] *= px[3];
+          }
+        }
+      }
+      filterRow(_x, ox0, ox1, ix0, c, line.data(), &rows[size_t(iy - iy0) * rowLen]);
+    }
+
+    // vertical pass, written to be auto-vectorized
+    for (uint32_t oy = oy0; oy < oy1; oy++) {
+      float *__restrict out = acc.data();
+      std::fill(acc.begin(), acc.end(), 0.0f);
+      const float *w = _y.weightsOf(oy);
+      for (uint32_t t = 0; t < _y.taps(oy); t++) {
+        const float *__restrict row = &rows[size_t(_y.first[oy] + t - iy0) * rowLen];
+        const float weight = w[t];
+        for (size_t i = 0; i < rowLen; i++)
+          out[i] += weight * row[i];
+      }
+
+      if (srgb || premultiply) {
+        for (size_t i = 0; i < rowLen; i += c) {
+          float *px = &out[i];
+          if (premultiply && px[3] > 0.0f) {
+            const float inv = 1.0f / px[3];
+            for (uint32_t ch = 0; ch < 3; ch++)
+              px[ch] *= inv;
+          }
+          if (srgb) {
+            for (uint32_t ch = 0; ch < colors; ch++)
+              px[ch] = SrgbTables::lookup(tables.toSrgb, px[ch]);
+          }
+        }
+      }
+
+      uint8_t *dst = output + (size_t(oy) * outW + ox0) * c * pixsize;
+      store(out, sizeof(float), dst, typeSize, rowLen);
+    }
+  });
+}
+
 struct Convolve {
   static SHTypesInfo inputTypes() { return CoreInfo::ImageType; }
   static SHTypesInfo outputTypes() { return CoreInfo::ImageType; }
@@ -59,14 +460,18 @@ struct Convolve {
     const auto from = reinterpret_cast<T *>(pixels.payload.imageValue.data);
     auto to = reinterpret_cast<T *>(&_bytes[0]);
     for (int y = low; y <= high; y++) {
+      const auto idxy = std::clamp<int>(_yindex + y, 0, h - 1);
+      const T *row = from + size_t(w) * idxy * c;
+      if (_xindex + low >= 0 && _xindex + high < w) {
+        // the whole window row is inside the image
+        memcpy(&to[index], row + size_t(_xindex + low) * c, sizeof(T) * _kernel * c);
+        index += _kernel * c;
+        continue;
+      }
       for (int x = low; x <= high; x++) {
-        const int cidxx = _xindex + x;
-        const int cidxy = _yindex + y;
-        const auto idxx = std::clamp<int>(cidxx, 0, w - 1);
-        const auto idxy = std::clamp<int>(cidxy, 0, h - 1);
-        const int addr = ((w * idxy) + idxx) * c;
+        const auto idxx = std::clamp<int>(_xindex + x, 0, w - 1);
         for (int i = 0; i < c; i++) {
-          to[index++] = from[addr + i];
+          to[index++] = row[idxx * c + i];
         }
       }
     }
@@ -214,10 +619,43 @@ private:
   std::vector<uint8_t> _bytes;
 };
 
-struct Resize {
+// Base of the shards running an ImagePipeline, which is rebuilt only when the input size or the parameters change
+struct PipelineBase {
   static SHTypesInfo inputTypes() { return CoreInfo::ImageType; }
   static SHTypesInfo outputTypes() { return CoreInfo::ImageType; }
 
+  template <typename F> SHVar process(const SHVar &input, bool linearize, F build) {
+    const auto &image = input.payload.imageValue;
+    if (image.width == 0 || image.height == 0)
+      throw ActivationError("Empty image.");
+
+    if (_dirty || image.width != _pipeline.inputWidth() || image.height != _pipeline.inputHeight()) {
+      _pipeline.reset(image.width, image.height);
+      build(_pipeline);
+      if (_pipeline.width() == 0 || _pipeline.height() == 0 || _pipeline.width() > UINT16_MAX ||
+          _pipeline.height() > UINT16_MAX)
+        throw ActivationError("Invalid output image size.");
+      _dirty = false;
+    }
+
+    const auto w = _pipeline.width();
+    const auto h = _pipeline.height();
+    _bytes.resize(size_t(w) * h * image.channels * getPixelSize(input));
+    _pipeline.run(image, _bytes.data(), linearize);
+    return Var(_bytes.data(), uint16_t(w), uint16_t(h), image.channels, image.flags);
+  }
+
+protected:
+  ImagePipeline _pipeline;
+  std::vector<uint8_t> _bytes;
+  bool _dirty{true};
+};
+
+struct Resize : public PipelineBase {
+  static SHOptionalString help() {
+    return SHCCSTR("Resizes an image with a cubic filter. 8 and 16 bits images are resampled in linear light.");
+  }
+
   static inline Parameters _params{{"Width", SHCCSTR("The target width."), CoreInfo::IntOrIntVar},
                                    {"Height", SHCCSTR("How target height."), CoreInfo::IntOrIntVar}};
 
@@ -236,6 +674,7 @@ struct Resize {
     } else {
       _height = value;
     }
+    _dirty = true;
   }
 
   void warmup(SHContext *context) {
@@ -249,57 +688,212 @@ struct Resize {
   }
 
   SHVar activate(SHContext *context, const SHVar &input) {
-    int w = uint32_t(input.payload.imageValue.width);
-    int h = uint32_t(input.payload.imageValue.height);
-    int c = uint32_t(input.payload.imageValue.channels);
-
-    int width = int(_width.get().payload.intValue);
-    int height = int(_height.get().payload.intValue);
-    if (width == 0) {
-      width = int(float(w) * float(height) / float(h));
-    } else if (height == 0) {
-      height = int(float(h) * float(width) / float(w));
+    const auto width = uint32_t(std::max<int64_t>(0, _width.get().payload.intValue));
+    const auto height = uint32_t(std::max<int64_t>(0, _height.get().payload.intValue));
+    if (width == 0 && height == 0)
+      throw ActivationError("Width and Height cannot be both 0.");
+    if (width != _lastWidth || height != _lastHeight) {
+      _lastWidth = width;
+      _lastHeight = height;
+      _dirty = true;
     }
+    return process(input, true, [&](ImagePipeline &pipeline) { pipeline.resize(width, height); });
+  }
 
-    auto pixsize = getPixelSize(input);
+private:
+  ParamVar _width{Var(32)};
+  ParamVar _height{Var(32)};
+  uint32_t _lastWidth{0};
+  uint32_t _lastHeight{0};
+};
 
-    _bytes.resize(width * height * c * pixsize);
+struct Blur : public PipelineBase {
+  static SHOptionalString help() { return SHCCSTR("Blurs an image with a gaussian or a box filter."); }
 
-    int flags = 0;
-    if ((input.payload.imageValue.flags & SHIMAGE_FLAGS_PREMULTIPLIED_ALPHA) == SHIMAGE_FLAGS_PREMULTIPLIED_ALPHA)
-      flags = STBIR_FLAG_ALPHA_PREMULTIPLIED;
+  static inline Parameters _params{
+      {"Radius", SHCCSTR("The radius of the blur in pixels."), {CoreInfo::IntType}},
+      {"Box", SHCCSTR("If a box filter should be used instead of a gaussian one."), {CoreInfo::BoolType}}};
 
-    if (pixsize == 1) {
-      auto res = stbir_resize_uint8_generic(input.payload.imageValue.data, w, h, w * c, &_bytes.front(), width, height, width * c,
-                                            c, c == 4 ? 3 : STBIR_ALPHA_CHANNEL_NONE, flags, STBIR_EDGE_ZERO,
-                                            STBIR_FILTER_DEFAULT, STBIR_COLORSPACE_SRGB, nullptr);
-      if (res == 0) {
-        throw ActivationError("Failed to resize image!");
-      }
-    } else if (pixsize == 2) {
-      auto res = stbir_resize_uint16_generic(
-          (uint16_t *)input.payload.imageValue.data, w, h, w * c * 2, (uint16_t *)&_bytes.front(), width, height, width * c * 2,
-          c, c == 4 ? 3 : STBIR_ALPHA_CHANNEL_NONE, flags, STBIR_EDGE_ZERO, STBIR_FILTER_DEFAULT, STBIR_COLORSPACE_SRGB, nullptr);
-      if (res == 0) {
-        throw ActivationError("Failed to resize image!");
-      }
-    } else if (pixsize == 4) {
-      auto res = stbir_resize_float_generic((float *)input.payload.imageValue.data, w, h, w * c * 4, (float *)&_bytes.front(),
-                                            width, height, width * c * 4, c, c == 4 ? 3 : STBIR_ALPHA_CHANNEL_NONE, flags,
-                                            STBIR_EDGE_ZERO, STBIR_FILTER_DEFAULT, STBIR_COLORSPACE_LINEAR, nullptr);
-      if (res == 0) {
-        throw ActivationError("Failed to resize image!");
-      }
+  static SHParametersInfo parameters() { return _params; }
+
+  SHVar getParam(int index) {
+    if (index == 0)
+      return Var(int64_t(_radius));
+    else
+      return Var(_box);
+  }
+
+  void setParam(int index, const SHVar &value) {
+    if (index == 0)
+      _radius = uint32_t(std::max<int64_t>(0, value.payload.intValue));
+    else
+      _box = value.payload.boolValue;
+    _dirty = true;
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    return process(input, false, [&](ImagePipeline &pipeline) {
+      if (_box)
+        pipeline.boxBlur(_radius);
+      else
+        pipeline.gaussianBlur(_radius);
+    });
+  }
+
+private:
+  uint32_t _radius{1};
+  bool _box{false};
+};
+
+inline std::vector<float> kernelOf(const SHVar &taps) {
+  std::vector<float> res;
+  for (auto &tap : taps)
+    res.push_back(float(tap.payload.floatValue));
+  if (res.size() % 2 == 0)
+    throw ComposeError("Convolution kernels must have an odd number of taps.");
+  return res;
+}
+
+struct SeparableConvolve : public PipelineBase {
+  static SHOptionalString help() {
+    return SHCCSTR("Convolves an image with a separable kernel, first horizontally then vertically. Edges are clamped.");
+  }
+
+  static inline Parameters _params{
+      {"Kernel", SHCCSTR("The taps of the horizontal kernel, centered on each pixel."), {CoreInfo::FloatSeqType}},
+      {"Vertical", SHCCSTR("The taps of the vertical kernel, if None Kernel is used."), {CoreInfo::NoneType, CoreInfo::FloatSeqType}}};
+
+  static SHParametersInfo parameters() { return _params; }
+
+  SHVar getParam(int index) {
+    if (index == 0)
+      return _kernel;
+    else
+      return _vertical;
+  }
+
+  void setParam(int index, const SHVar &value) {
+    if (index == 0)
+      _kernel = value;
+    else
+      _vertical = value;
+    _dirty = true;
+  }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    _horizontalTaps = kernelOf(_kernel);
+    _verticalTaps = _vertical.valueType == Seq ? kernelOf(_vertical) : _horizontalTaps;
+    return data.inputType;
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    return process(input, false, [&](ImagePipeline &pipeline) { pipeline.convolve(_horizontalTaps, _verticalTaps); });
+  }
+
+private:
+  OwnedVar _kernel{Var(std::vector<Var>{Var(1.0)})};
+  OwnedVar _vertical{};
+  std::vector<float> _horizontalTaps;
+  std::vector<float> _verticalTaps;
+};
+
+struct Process : public PipelineBase {
+  struct Op {
+    enum class Kind { Blur, BoxBlur, Convolve, Resize };
+    Kind kind;
+    uint32_t radius{0};
+    std::vector<float> taps;
+    uint32_t width{0};
+    uint32_t height{0};
+  };
+
+  static SHOptionalString help() {
+    return SHCCSTR("Runs a chain of image operations fused together, no intermediate image is allocated. Each operation is a "
+                   "table with a single key: {\"Blur\" radius} {\"BoxBlur\" radius} {\"Convolve\" [taps]} or {\"Resize\" "
+                   "(Int2 width height)}.");
+  }
+
+  static inline Type OpsType = Type::SeqOf(CoreInfo::AnyTableType);
+
+  static inline Parameters _params{
+      {"Operations", SHCCSTR("The operations to apply, in order."), {OpsType}},
+      {"Linearize", SHCCSTR("If 8 and 16 bits images should be processed in linear light."), {CoreInfo::BoolType}}};
+
+  static SHParametersInfo parameters() { return _params; }
+
+  SHVar getParam(int index) {
+    if (index == 0)
+      return _operations;
+    else
+      return Var(_linearize);
+  }
+
+  void setParam(int index, const SHVar &value) {
+    if (index == 0)
+      _operations = value;
+    else
+      _linearize = value.payload.boolValue;
+    _dirty = true;
+  }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    _ops.clear();
+    if (_operations.valueType != Seq)
+      return data.inputType;
+
+    for (auto &operation : _operations) {
+      if (operation.payload.tableValue.api->tableSize(operation.payload.tableValue) != 1)
+        throw ComposeError("ProcessImage: each operation must be a table with a single key.");
+
+      ForEach(operation.payload.tableValue, [&](SHString key, const SHVar &value) {
+        const std::string_view name(key);
+        Op op;
+        if ((name == "Blur" || name == "BoxBlur") && value.valueType == Int) {
+          op.kind = name == "Blur" ? Op::Kind::Blur : Op::Kind::BoxBlur;
+          op.radius = uint32_t(std::max<int64_t>(0, value.payload.intValue));
+        } else if (name == "Convolve" && value.valueType == Seq) {
+          op.kind = Op::Kind::Convolve;
+          op.taps = kernelOf(value);
+        } else if (name == "Resize" && value.valueType == Int2) {
+          op.kind = Op::Kind::Resize;
+          op.width = uint32_t(std::max<int64_t>(0, value.payload.int2Value[0]));
+          op.height = uint32_t(std::max<int64_t>(0, value.payload.int2Value[1]));
+          if (op.width == 0 && op.height == 0)
+            throw ComposeError("ProcessImage: Resize width and height cannot be both 0.");
+        } else {
+          throw ComposeError("ProcessImage: invalid operation " + std::string(name) + ".");
+        }
+        _ops.emplace_back(std::move(op));
+      });
     }
+    return data.inputType;
+  }
 
-    return Var(&_bytes.front(), uint16_t(width), uint16_t(height), input.payload.imageValue.channels,
-               input.payload.imageValue.flags);
+  SHVar activate(SHContext *context, const SHVar &input) {
+    return process(input, _linearize, [&](ImagePipeline &pipeline) {
+      for (auto &op : _ops) {
+        switch (op.kind) {
+        case Op::Kind::Blur:
+          pipeline.gaussianBlur(op.radius);
+          break;
+        case Op::Kind::BoxBlur:
+          pipeline.boxBlur(op.radius);
+          break;
+        case Op::Kind::Convolve:
+          pipeline.convolve(op.taps, op.taps);
+          break;
+        case Op::Kind::Resize:
+          pipeline.resize(op.width, op.height);
+          break;
+        }
+      }
+    });
   }
 
 private:
-  std::vector<uint8_t> _bytes;
-  ParamVar _width{Var(32)};
-  ParamVar _height{Var(32)};
+  OwnedVar _operations{};
+  bool _linearize{false};
+  std::vector<Op> _ops;
 };
 
 void registerShards() {
@@ -307,6 +901,9 @@ void registerShards() {
   REGISTER_SHARD("StripAlpha", StripAlpha);
   REGISTER_SHARD("FillAlpha", FillAlpha);
   REGISTER_SHARD("ResizeImage", Resize);
+  REGISTER_SHARD("BlurImage", Blur);
+  REGISTER_SHARD("ConvolveImage", SeparableConvolve);
+  REGISTER_SHARD("ProcessImage", Process);
 }
 } // namespace Imaging
 } // namespace shards
@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2020 Fragcolor Pte. Ltd. */
+
+#pragma once
+
+#include "shards.h"
+#include <cstdint>
+#include <vector>
+
+namespace shards {
+namespace Imaging {
+// Linear filtering of one image axis, output[i] = sum(weights[i][k] * input[first[i] + k])
+// Out of range input indices are clamped to the edges when the filter is built.
+struct AxisFilter {
+  uint32_t inSize{0};
+  // first input index of each output
+  std::vector<uint32_t> first;
+  // weights of output i are weights[offsets[i], offsets[i + 1])
+  std::vector<uint32_t> offsets;
+  std::vector<float> weights;
+
+  uint32_t outSize() const { return uint32_t(first.size()); }
+  uint32_t taps(uint32_t i) const { return offsets[i + 1] - offsets[i]; }
+  const float *weightsOf(uint32_t i) const { return weights.data() + offsets[i]; }
+  bool isIdentity() const;
+
+  static AxisFilter identity(uint32_t size);
+  // taps must have an odd length, they are centered on each pixel
+  static AxisFilter convolution(uint32_t size, const std::vector<float> &taps);
+  // Cubic resampling (Catmull-Rom when upsampling, Mitchell when downsampling)
+  static AxisFilter resampling(uint32_t inSize, uint32_t outSize);
+
+  // Fuses this filter followed by next into a single filter
+  AxisFilter then(const AxisFilter &next) const;
+};
+
+std::vector<float> boxKernel(uint32_t radius);
+// sigma is radius / 2, the kernel is truncated at radius
+std::vector<float> gaussianKernel(uint32_t radius);
+
+// A chain of separable operations on an image, fused into one horizontal and one vertical filter
+// so that no intermediate image is ever allocated.
+// Images are processed in cache sized tiles, in parallel on the SharedThreadPool.
+class ImagePipeline {
+public:
+  static constexpr uint32_t TileWidth = 256;
+  static constexpr uint32_t TileHeight = 64;
+
+  void reset(uint32_t width, uint32_t height);
+
+  void convolve(const std::vector<float> &horizontal, const std::vector<float> &vertical);
+  void boxBlur(uint32_t radius);
+  void gaussianBlur(uint32_t radius);
+  // A zero width or height keeps the aspect ratio
+  void resize(uint32_t width, uint32_t height);
+
+  uint32_t inputWidth() const { return _x.inSize; }
+  uint32_t inputHeight() const { return _y.inSize; }
+  uint32_t width() const { return _x.outSize(); }
+  uint32_t height() const { return _y.outSize(); }
+
+  // Runs the fused chain on input, output must hold width() * height() pixels of the same format as input
+  // When linearize is true 8 and 16 bits images are converted from sRGB to linear light and back around filtering.
+  // 4 channels images are premultiplied around filtering unless they already are.
+  void run(const SHImage &input, uint8_t *output, bool linearize) const;
+
+private:
+  AxisFilter _x;
+  AxisFilter _y;
+};
+} // namespace Imaging
+} // namespace shards
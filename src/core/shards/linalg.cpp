@@ -6,6 +6,241 @@
 namespace shards {
 namespace Math {
 namespace LinAlg {
+namespace Batch {
+ALWAYS_INLINE inline const SHVarPayload &payloadOf(const SHVar &v) { return v.payload; }
+ALWAYS_INLINE inline const SHVarPayload &payloadOf(const SHVarPayload &p) { return p; }
+ALWAYS_INLINE inline SHVarPayload &payloadOf(SHVar &v) { return v.payload; }
+ALWAYS_INLINE inline SHVarPayload &payloadOf(SHVarPayload &p) { return p; }
+
+ALWAYS_INLINE inline void setType(SHVar &v, SHType type) { v.valueType = type; }
+ALWAYS_INLINE inline void setType(SHVarPayload &, SHType) {}
+
+// Float3 and Float4 payloads share the same 4 floats layout
+template <size_t Dim, typename E> ALWAYS_INLINE inline void gather(float (&lanes)[4][Lanes], const E *in, size_t k) {
+  for (size_t l = 0; l < k; l++) {
+    const auto &v = payloadOf(in[l]).float4Value;
+    for (size_t d = 0; d < Dim; d++)
+      lanes[d][l] = v[d];
+  }
+}
+
+template <size_t Dim, typename E>
+ALWAYS_INLINE inline void scatter(const float (&lanes)[4][Lanes], E *out, size_t k, SHType type) {
+  for (size_t l = 0; l < k; l++) {
+    auto &v = payloadOf(out[l]).float4Value;
+    for (size_t d = 0; d < Dim; d++)
+      v[d] = lanes[d][l];
+    setType(out[l], type);
+  }
+}
+
+template <typename F> ALWAYS_INLINE inline void forBlocks(size_t n, F &&fn) {
+  kernels::forRange(n, [&](size_t begin, size_t end) {
+    for (size_t base = begin; base < end; base += Lanes)
+      fn(base, std::min(Lanes, end - base));
+  });
+}
+
+template <size_t Dim, typename E>
+void transformDim(const linalg::aliases::float4x4 &m, SHType type, const E *in, E *out, size_t n) {
+  forBlocks(n, [&](size_t base, size_t k) {
+    float v[4][Lanes]{};
+    float r[4][Lanes];
+    gather<Dim>(v, in + base, k);
+    if constexpr (Dim == 3) {
+      for (size_t l = 0; l < Lanes; l++)
+        v[3][l] = 1.0f;
+    }
+    for (size_t row = 0; row < Dim; row++) {
+      for (size_t l = 0; l < Lanes; l++)
+        r[row][l] = m[0][row] * v[0][l] + m[1][row] * v[1][l] + m[2][row] * v[2][l] + m[3][row] * v[3][l];
+    }
+    scatter<Dim>(r, out + base, k, type);
+  });
+}
+
+template <typename E> void transform(const linalg::aliases::float4x4 &m, SHType type, const E *in, E *out, size_t n) {
+  if (type == Float3)
+    transformDim<3>(m, type, in, out, n);
+  else
+    transformDim<4>(m, type, in, out, n);
+}
+
+template void transform<SHVar>(const linalg::aliases::float4x4 &, SHType, const SHVar *, SHVar *, size_t);
+template void transform<SHVarPayload>(const linalg::aliases::float4x4 &, SHType, const SHVarPayload *, SHVarPayload *,
+                                      size_t);
+
+ALWAYS_INLINE inline void gatherMatrices(float (&lanes)[16][Lanes], const SHVar *in, size_t step, size_t k) {
+  for (size_t l = 0; l < k; l++) {
+    const auto columns = in[l * step].payload.seqValue.elements;
+    for (size_t c = 0; c < 4; c++) {
+      for (size_t r = 0; r < 4; r++)
+        lanes[c * 4 + r][l] = columns[c].payload.float4Value[r];
+    }
+  }
+}
+
+void mulMatrices(const SHVar *a, const SHVar *b, size_t bStep, SHVar *out, size_t n) {
+  forBlocks(n, [&](size_t base, size_t k) {
+    float la[16][Lanes]{};
+    float lb[16][Lanes]{};
+    float lc[16][Lanes];
+    gatherMatrices(la, a + base, 1, k);
+    gatherMatrices(lb, b + base * bStep, bStep, k);
+    // c[j] = sum a[i] * b[j][i] on columns
+    for (size_t c = 0; c < 4; c++) {
+      for (size_t r = 0; r < 4; r++) {
+        for (size_t l = 0; l < Lanes; l++) {
+          lc[c * 4 + r][l] = la[0 * 4 + r][l] * lb[c * 4 + 0][l] + la[1 * 4 + r][l] * lb[c * 4 + 1][l] +
+                             la[2 * 4 + r][l] * lb[c * 4 + 2][l] + la[3 * 4 + r][l] * lb[c * 4 + 3][l];
+        }
+      }
+    }
+    for (size_t l = 0; l < k; l++) {
+      auto columns = out[base + l].payload.seqValue.elements;
+      for (size_t c = 0; c < 4; c++) {
+        columns[c].valueType = Float4;
+        for (size_t r = 0; r < 4; r++)
+          columns[c].payload.float4Value[r] = lc[c * 4 + r][l];
+      }
+    }
+  });
+}
+
+void transposeMatrices(const SHVar *in, SHVar *out, size_t n) {
+  kernels::forRange(n, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const auto src = in[i].payload.seqValue.elements;
+      auto dst = out[i].payload.seqValue.elements;
+      for (size_t c = 0; c < 4; c++) {
+        dst[c].valueType = Float4;
+        for (size_t r = 0; r < 4; r++)
+          dst[c].payload.float4Value[r] = src[r].payload.float4Value[c];
+      }
+    }
+  });
+}
+
+template <size_t Dim> void dotDim(const SHVar *a, const SHVar *b, size_t bStep, SHVar *out, size_t n) {
+  forBlocks(n, [&](size_t base, size_t k) {
+    float va[4][Lanes]{};
+    float vb[4][Lanes]{};
+    double r[Lanes];
+    gather<Dim>(va, a + base, k);
+    if (bStep == 0) {
+      for (size_t d = 0; d < Dim; d++) {
+        for (size_t l = 0; l < Lanes; l++)
+          vb[d][l] = b->payload.float4Value[d];
+      }
+    } else {
+      gather<Dim>(vb, b + base, k);
+    }
+    for (size_t l = 0; l < Lanes; l++) {
+      double acc = va[0][l] * vb[0][l];
+      for (size_t d = 1; d < Dim; d++)
+        acc += va[d][l] * vb[d][l];
+      r[l] = acc;
+    }
+    for (size_t l = 0; l < k; l++) {
+      out[base + l].valueType = Float;
+      out[base + l].payload.floatValue = r[l];
+    }
+  });
+}
+
+void dot(SHType type, const SHVar *a, const SHVar *b, size_t bStep, SHVar *out, size_t n) {
+  if (type == Float3)
+    dotDim<3>(a, b, bStep, out, n);
+  else
+    dotDim<4>(a, b, bStep, out, n);
+}
+
+void cross(const SHVar *a, const SHVar *b, size_t bStep, SHVar *out, size_t n) {
+  forBlocks(n, [&](size_t base, size_t k) {
+    float va[4][Lanes]{};
+    float vb[4][Lanes]{};
+    float r[4][Lanes];
+    gather<3>(va, a + base, k);
+    if (bStep == 0) {
+      for (size_t d = 0; d < 3; d++) {
+        for (size_t l = 0; l < Lanes; l++)
+          vb[d][l] = b->payload.float3Value[d];
+      }
+    } else {
+      gather<3>(vb, b + base, k);
+    }
+    for (size_t l = 0; l < Lanes; l++) {
+      r[0][l] = va[1][l] * vb[2][l] - va[2][l] * vb[1][l];
+      r[1][l] = va[2][l] * vb[0][l] - va[0][l] * vb[2][l];
+      r[2][l] = va[0][l] * vb[1][l] - va[1][l] * vb[0][l];
+    }
+    scatter<3>(r, out + base, k, Float3);
+  });
+}
+
+template <size_t Dim> void lengthDim(const SHVar *in, SHVar *out, size_t n, bool squared) {
+  forBlocks(n, [&](size_t base, size_t k) {
+    float v[4][Lanes]{};
+    double r[Lanes];
+    gather<Dim>(v, in + base, k);
+    for (size_t l = 0; l < Lanes; l++) {
+      double acc = v[0][l] * v[0][l];
+      for (size_t d = 1; d < Dim; d++)
+        acc += v[d][l] * v[d][l];
+      r[l] = acc;
+    }
+    if (!squared) {
+      for (size_t l = 0; l < Lanes; l++)
+        r[l] = __builtin_sqrt(r[l]);
+    }
+    for (size_t l = 0; l < k; l++) {
+      out[base + l].valueType = Float;
+      out[base + l].payload.floatValue = r[l];
+    }
+  });
+}
+
+void length(SHType type, const SHVar *in, SHVar *out, size_t n, bool squared) {
+  if (type == Float3)
+    lengthDim<3>(in, out, n, squared);
+  else
+    lengthDim<4>(in, out, n, squared);
+}
+
+template <size_t Dim> void normalizeDim(SHType type, const SHVar *in, SHVar *out, size_t n, bool positiveOnly) {
+  forBlocks(n, [&](size_t base, size_t k) {
+    float v[4][Lanes]{};
+    float len[Lanes];
+    gather<Dim>(v, in + base, k);
+    for (size_t l = 0; l < Lanes; l++) {
+      double acc = v[0][l] * v[0][l];
+      for (size_t d = 1; d < Dim; d++)
+        acc += v[d][l] * v[d][l];
+      len[l] = float(__builtin_sqrt(acc));
+    }
+    if (positiveOnly) {
+      // zero length vectors are left untouched
+      for (size_t d = 0; d < Dim; d++) {
+        for (size_t l = 0; l < Lanes; l++)
+          v[d][l] = len[l] > 0 ? (v[d][l] / len[l] + 1.0f) / 2.0f : v[d][l];
+      }
+    } else {
+      for (size_t d = 0; d < Dim; d++) {
+        for (size_t l = 0; l < Lanes; l++)
+          v[d][l] = v[d][l] / len[l];
+      }
+    }
+    scatter<Dim>(v, out + base, k, type);
+  });
+}
+
+void normalize(SHType type, const SHVar *in, SHVar *out, size_t n, bool positiveOnly) {
+  if (type == Float3)
+    normalizeDim<3>(type, in, out, n, positiveOnly);
+  else
+    normalizeDim<4>(type, in, out, n, positiveOnly);
+}
+} // namespace Batch
 
 void Cross::Operation::operator()(SHVar &output, const SHVar &input, const SHVar &operand) {
   if (operand.valueType != Float3)
@@ -28,6 +263,8 @@ void Cross::Operation::operator()(SHVar &output, const SHVar &input, const SHVar
 }
 
 SHVar Cross::activate(SHContext *context, const SHVar &input) {
+  if (_batchType == Float3)
+    return doBatch(input, Batch::cross);
   const Operation op;
   return doActivate(context, input, op);
 }
@@ -61,6 +298,11 @@ void Dot::Operation::operator()(SHVar &output, const SHVar &input, const SHVar &
 }
 
 SHVar Dot::activate(SHContext *context, const SHVar &input) {
+  if (_batchType != SHType::None) {
+    return doBatch(input, [&](const SHVar *a, const SHVar *b, size_t bStep, SHVar *out, size_t n) {
+      Batch::dot(_batchType, a, b, bStep, out, n);
+    });
+  }
   const Operation op;
   return doActivate(context, input, op);
 }
@@ -116,6 +358,11 @@ void Normalize::Operation::operator()(SHVar &output, const SHVar &input) {
 }
 
 SHVar Normalize::activate(SHContext *context, const SHVar &input) {
+  if (_batchType != SHType::None) {
+    return doBatch(input, [&](const SHVar *in, SHVar *out, size_t n) {
+      Batch::normalize(_batchType, in, out, n, _positiveOnly);
+    });
+  }
   const Operation op{_positiveOnly};
   return doActivate(context, input, op);
 }
@@ -312,6 +559,137 @@ SHVar Transpose::activate(SHContext *context, const SHVar &input) {
   return _result;
 }
 
+SHTypeInfo BatchMatMul::compose(const SHInstanceData &data) {
+  if (_operand->valueType == SHType::None)
+    throw ComposeError("BatchMatMul: Operand is required");
+
+  // Arrays carry their inner type only at runtime, activate checks it
+  const auto &inputType = data.inputType;
+  _matrices = false;
+  if (inputType.basicType == Seq) {
+    if (inputType.seqTypes.len != 1)
+      throw ComposeError("BatchMatMul: expected a sequence of Float3, Float4 or 4x4 matrices as input");
+    const auto &itemType = inputType.seqTypes.elements[0];
+    _matrices = itemType.basicType == Seq;
+    if (_matrices ? !Batch::isMatrixType(itemType) : itemType.basicType != Float3 && itemType.basicType != Float4)
+      throw ComposeError("BatchMatMul: expected a sequence of Float3, Float4 or 4x4 matrices as input");
+  }
+
+  bool perItem;
+  if (_operand.isVariable()) {
+    const SHExposedTypeInfo *operandInfo = nullptr;
+    for (auto &share : data.shared) {
+      if (strcmp(share.name, _operand.variableName()) == 0) {
+        operandInfo = &share;
+        break;
+      }
+    }
+    if (!operandInfo)
+      throw ComposeError(fmt::format("BatchMatMul: Operand variable {} not found", _operand.variableName()));
+    const auto &operandType = operandInfo->exposedType;
+    perItem = operandType.basicType == Seq && operandType.seqTypes.len == 1 &&
+              Batch::isMatrixType(operandType.seqTypes.elements[0]);
+    if (!perItem && !Batch::isMatrixType(operandType))
+      throw ComposeError("BatchMatMul: expected a 4x4 matrix or a sequence of 4x4 matrices as Operand");
+  } else {
+    const SHVar &operand = _operand;
+    perItem = !Batch::isMatrix(operand);
+    if (perItem) {
+      if (operand.valueType != Seq)
+        throw ComposeError("BatchMatMul: expected a 4x4 matrix or a sequence of 4x4 matrices as Operand");
+      for (auto &item : operand) {
+        if (!Batch::isMatrix(item))
+          throw ComposeError("BatchMatMul: expected a 4x4 matrix or a sequence of 4x4 matrices as Operand");
+      }
+    }
+  }
+  if (perItem && !_matrices)
+    throw ComposeError("BatchMatMul: vectors can be transformed only by a single matrix");
+
+  return data.inputType;
+}
+
+SHVar BatchMatMul::activate(SHContext *context, const SHVar &input) {
+  auto &operand = _operand.get();
+  if (operand.valueType != Seq)
+    throw ActivationError("BatchMatMul: expected a 4x4 matrix or a sequence of 4x4 matrices as operand");
+  const SHVar *b = &operand;
+  size_t bStep = 0;
+  if (!Batch::isMatrix(operand)) {
+    // a matrix per item
+    for (uint32_t i = 0; i < operand.payload.seqValue.len; i++) {
+      if (!Batch::isMatrix(operand.payload.seqValue.elements[i]))
+        throw ActivationError("BatchMatMul: expected a 4x4 matrix or a sequence of 4x4 matrices as operand");
+    }
+    b = operand.payload.seqValue.elements;
+    bStep = 1;
+  }
+
+  if (input.valueType == SHType::Array) {
+    if (input.innerType != Float3 && input.innerType != Float4)
+      throw ActivationError("BatchMatMul: expected an array of Float3 or Float4");
+    if (bStep != 0)
+      throw ActivationError("BatchMatMul: vectors can be transformed only by a single matrix");
+    const auto &in = input.payload.arrayValue;
+    if (_result.valueType != SHType::Array) {
+      destroyVar(_result);
+      _result.valueType = SHType::Array;
+    }
+    _result.innerType = input.innerType;
+    shards::arrayResize(_result.payload.arrayValue, in.len);
+    Batch::transform(Batch::toMatrix(operand), input.innerType, in.elements, _result.payload.arrayValue.elements,
+                     in.len);
+    return _result;
+  }
+
+  const auto &in = input.payload.seqValue;
+  if (bStep != 0 && operand.payload.seqValue.len != in.len)
+    throw ActivationError("BatchMatMul: operand matrices count does not match the input");
+
+  if (_result.valueType != Seq) {
+    destroyVar(_result);
+    _result.valueType = Seq;
+  }
+
+  if (_matrices) {
+    for (uint32_t i = 0; i < in.len; i++) {
+      if (!Batch::isMatrix(in.elements[i]))
+        throw ActivationError("BatchMatMul: expected a sequence of 4x4 matrices as input");
+    }
+    Batch::prepareMatrices(_result.payload.seqValue, in.len);
+    Batch::mulMatrices(in.elements, b, bStep, _result.payload.seqValue.elements, in.len);
+  } else {
+    if (bStep != 0)
+      throw ActivationError("BatchMatMul: vectors can be transformed only by a single matrix");
+    if (in.len == 0) {
+      shards::arrayResize(_result.payload.seqValue, 0);
+      return _result;
+    }
+    const auto type = in.elements[0].valueType;
+    if (type != Float3 && type != Float4)
+      throw ActivationError("BatchMatMul: expected a sequence of Float3 or Float4 as input");
+    for (uint32_t i = 1; i < in.len; i++) {
+      if (in.elements[i].valueType != type)
+        throw ActivationError("BatchMatMul: expected input vectors of the same type");
+    }
+    shards::arrayResize(_result.payload.seqValue, in.len);
+    Batch::transform(Batch::toMatrix(operand), type, in.elements, _result.payload.seqValue.elements, in.len);
+  }
+  return _result;
+}
+
+SHVar BatchTranspose::activate(SHContext *context, const SHVar &input) {
+  const auto &in = input.payload.seqValue;
+  for (uint32_t i = 0; i < in.len; i++) {
+    if (!Batch::isMatrix(in.elements[i]))
+      throw ActivationError("BatchTranspose: expected a sequence of 4x4 matrices as input");
+  }
+  _result.valueType = Seq;
+  Batch::prepareMatrices(_result.payload.seqValue, in.len);
+  Batch::transposeMatrices(in.elements, _result.payload.seqValue.elements, in.len);
+  return _result;
+}
+
 void registerShards() {
   REGISTER_SHARD("Math.Cross", Cross);
   REGISTER_SHARD("Math.Dot", Dot);
@@ -320,6 +698,8 @@ void registerShards() {
   REGISTER_SHARD("Math.Length", Length);
   REGISTER_SHARD("Math.MatMul", MatMul);
   REGISTER_SHARD("Math.Transpose", Transpose);
+  REGISTER_SHARD("Math.BatchMatMul", BatchMatMul);
+  REGISTER_SHARD("Math.BatchTranspose", BatchTranspose);
   REGISTER_SHARD("Math.Orthographic", Orthographic);
   REGISTER_SHARD("Math.Translation", Translation);
   REGISTER_SHARD("Math.Scaling", Scaling);
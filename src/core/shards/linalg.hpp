@@ -7,12 +7,75 @@
 namespace shards {
 namespace Math {
 namespace LinAlg {
+// Batched kernels, running on N vectors or 4x4 matrices at once
+// Items are gathered in blocks of Lanes into SoA arrays so the math runs across lanes and vectorizes,
+// E is either SHVar (Seq elements) or SHVarPayload (Array elements)
+// Operands are either a single item (bStep = 0) or one item per input (bStep = 1)
+// Matrices are Seqs of 4 Float4 columns, output matrices must be already sized
+namespace Batch {
+constexpr size_t Lanes = 8;
+
+// out[i] = m @ in[i], Float3 vectors are transformed as points (w = 1)
+template <typename E> void transform(const linalg::aliases::float4x4 &m, SHType type, const E *in, E *out, size_t n);
+// out[i] = a[i] @ b[i * bStep]
+void mulMatrices(const SHVar *a, const SHVar *b, size_t bStep, SHVar *out, size_t n);
+void transposeMatrices(const SHVar *in, SHVar *out, size_t n);
+void dot(SHType type, const SHVar *a, const SHVar *b, size_t bStep, SHVar *out, size_t n);
+void cross(const SHVar *a, const SHVar *b, size_t bStep, SHVar *out, size_t n);
+void length(SHType type, const SHVar *in, SHVar *out, size_t n, bool squared);
+void normalize(SHType type, const SHVar *in, SHVar *out, size_t n, bool positiveOnly);
+
+inline bool isMatrix(const SHVar &v) {
+  if (v.valueType != Seq || v.payload.seqValue.len != 4)
+    return false;
+  for (uint32_t i = 0; i < 4; i++) {
+    if (v.payload.seqValue.elements[i].valueType != Float4)
+      return false;
+  }
+  return true;
+}
+
+// A Seq of Float4, the shape of a matrix type (the length is only known for constants)
+inline bool isMatrixType(const SHTypeInfo &t) {
+  return t.basicType == Seq && t.seqTypes.len == 1 && t.seqTypes.elements[0].basicType == Float4;
+}
+
+inline linalg::aliases::float4x4 toMatrix(const SHVar &v) {
+  linalg::aliases::float4x4 m;
+  for (int i = 0; i < 4; i++) {
+    const auto &c = v.payload.seqValue.elements[i].payload.float4Value;
+    m[i] = {c[0], c[1], c[2], c[3]};
+  }
+  return m;
+}
+
+// Resizes output to n 4x4 matrices
+inline void prepareMatrices(SHSeq &output, uint32_t n) {
+  shards::arrayResize(output, n);
+  for (uint32_t i = 0; i < n; i++) {
+    auto &m = output.elements[i];
+    if (m.valueType != Seq) {
+      destroyVar(m);
+      m.valueType = Seq;
+    }
+    shards::arrayResize(m.payload.seqValue, 4);
+  }
+}
+} // namespace Batch
+
 struct VectorUnaryBase : public UnaryBase {
+  // set when the input is a Float3/Float4 seq, those run the batch kernels
+  SHType _batchType{SHType::None};
+
   static SHTypesInfo inputTypes() { return CoreInfo::FloatVectors; }
 
   static SHTypesInfo outputTypes() { return CoreInfo::FloatVectors; }
 
-  SHTypeInfo compose(const SHInstanceData &data) { return data.inputType; }
+  SHTypeInfo compose(const SHInstanceData &data) {
+    const auto type = BinaryBase::homogeneousType(data.inputType);
+    _batchType = type == Float3 || type == Float4 ? type : SHType::None;
+    return data.inputType;
+  }
 
   template <class Operation> SHVar doActivate(SHContext *context, const SHVar &input, Operation operate) {
     if (input.valueType == Seq) {
@@ -20,7 +83,7 @@ struct VectorUnaryBase : public UnaryBase {
       shards::arrayResize(_result.payload.seqValue, 0);
       for (uint32_t i = 0; i < input.payload.seqValue.len; i++) {
         SHVar scratch;
-        operate(scratch, input);
+        operate(scratch, input.payload.seqValue.elements[i]);
         shards::arrayPush(_result.payload.seqValue, scratch);
       }
       return _result;
@@ -30,6 +93,15 @@ struct VectorUnaryBase : public UnaryBase {
       return scratch;
     }
   }
+
+  // kernel(in, out, n)
+  template <class Kernel> SHVar doBatch(const SHVar &input, Kernel kernel) {
+    const auto n = input.payload.seqValue.len;
+    _result.valueType = Seq;
+    shards::arrayResize(_result.payload.seqValue, n);
+    kernel(input.payload.seqValue.elements, _result.payload.seqValue.elements, size_t(n));
+    return _result;
+  }
 };
 
 struct VectorBinaryBase : public BinaryBase {
@@ -42,6 +114,38 @@ struct VectorBinaryBase : public BinaryBase {
 
   static SHParametersInfo parameters() { return SHParametersInfo(paramsInfo); }
 
+  // set when input and operand are Float3/Float4 seqs (or a matching single operand), those run the batch kernels
+  SHType _batchType{SHType::None};
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    auto result = BinaryBase::compose(data);
+    _batchType = SHType::None;
+    if (_opType == Seq1 || _opType == SeqSeq) {
+      const auto type = homogeneousType(data.inputType);
+      if ((type == Float3 || type == Float4) && (_opType == Seq1 || homogeneousOperandType(data) == type))
+        _batchType = type;
+    }
+    return result;
+  }
+
+  // kernel(a, b, bStep, out, n)
+  template <class Kernel> SHVar doBatch(const SHVar &input, Kernel kernel) {
+    auto &operand = _operand.get();
+    const auto &a = input.payload.seqValue;
+    size_t n = a.len;
+    const SHVar *b = &operand;
+    size_t bStep = 0;
+    if (_opType == SeqSeq) {
+      n = std::min(n, size_t(operand.payload.seqValue.len));
+      b = operand.payload.seqValue.elements;
+      bStep = 1;
+    }
+    _result.valueType = Seq;
+    shards::arrayResize(_result.payload.seqValue, uint32_t(n));
+    kernel(a.elements, b, bStep, _result.payload.seqValue.elements, n);
+    return _result;
+  }
+
   template <class Operation> SHVar doActivate(SHContext *context, const SHVar &input, Operation operate) {
     auto &operand = _operand.get();
     if (_opType == Normal) {
@@ -78,12 +182,14 @@ struct Cross : public VectorBinaryBase {
   SHVar activate(SHContext *context, const SHVar &input);
 };
 
+static inline Types FloatOrFloatSeq{{CoreInfo::FloatType, CoreInfo::FloatSeqType}};
+
 struct Dot : public VectorBinaryBase {
-  static SHTypesInfo outputTypes() { return CoreInfo::FloatType; }
+  static SHTypesInfo outputTypes() { return FloatOrFloatSeq; }
 
   SHTypeInfo compose(const SHInstanceData &data) {
     VectorBinaryBase::compose(data);
-    return CoreInfo::FloatType;
+    return data.inputType.basicType == Seq ? CoreInfo::FloatSeqType : CoreInfo::FloatType;
   }
 
   struct Operation {
@@ -94,11 +200,11 @@ struct Dot : public VectorBinaryBase {
 };
 
 struct LengthSquared : public VectorUnaryBase {
-  static SHTypesInfo outputTypes() { return CoreInfo::FloatType; }
+  static SHTypesInfo outputTypes() { return FloatOrFloatSeq; }
 
   SHTypeInfo compose(const SHInstanceData &data) {
     VectorUnaryBase::compose(data);
-    return CoreInfo::FloatType;
+    return data.inputType.basicType == Seq ? CoreInfo::FloatSeqType : CoreInfo::FloatType;
   }
 
   struct Operation {
@@ -106,17 +212,19 @@ struct LengthSquared : public VectorUnaryBase {
     void operator()(SHVar &output, const SHVar &input) { dotOp(output, input, input); }
   };
   SHVar activate(SHContext *context, const SHVar &input) {
+    if (_batchType != SHType::None)
+      return doBatch(input, [&](const SHVar *in, SHVar *out, size_t n) { Batch::length(_batchType, in, out, n, true); });
     const Operation op;
     return doActivate(context, input, op);
   }
 };
 
 struct Length : public VectorUnaryBase {
-  static SHTypesInfo outputTypes() { return CoreInfo::FloatType; }
+  static SHTypesInfo outputTypes() { return FloatOrFloatSeq; }
 
   SHTypeInfo compose(const SHInstanceData &data) {
     VectorUnaryBase::compose(data);
-    return CoreInfo::FloatType;
+    return data.inputType.basicType == Seq ? CoreInfo::FloatSeqType : CoreInfo::FloatType;
   }
 
   struct Operation {
@@ -127,6 +235,8 @@ struct Length : public VectorUnaryBase {
     }
   };
   SHVar activate(SHContext *context, const SHVar &input) {
+    if (_batchType != SHType::None)
+      return doBatch(input, [&](const SHVar *in, SHVar *out, size_t n) { Batch::length(_batchType, in, out, n, false); });
     const Operation op;
     return doActivate(context, input, op);
   }
@@ -141,6 +251,7 @@ struct Normalize : public VectorUnaryBase {
   static SHTypesInfo outputTypes() { return CoreInfo::FloatVectorsOrFloatSeq; }
 
   SHTypeInfo compose(const SHInstanceData &data) {
+    VectorUnaryBase::compose(data);
     if (data.inputType.basicType == Seq && data.inputType.seqTypes.len == 1 &&
         data.inputType.seqTypes.elements[0].basicType == Float) {
       OVERRIDE_ACTIVATE(data, activateFloatSeq);
@@ -202,6 +313,65 @@ struct Transpose : public VectorUnaryBase {
   SHVar activate(SHContext *context, const SHVar &input);
 };
 
+// Batched MatMul
+// Input is a Seq (or Array) of N Float3/Float4 vectors or a Seq of N 4x4 matrices
+// Vectors are transformed by the operand matrix, matrices are multiplied as input @ operand,
+// the operand can also be a Seq of N matrices to run N independent multiplications
+struct BatchMatMul {
+  static inline Types InputTypes{
+      {CoreInfo::Float3SeqType, CoreInfo::Float4SeqType, CoreInfo::Float4x4SeqType, Base::AnyArrayType}};
+  static inline Types OperandTypes{{CoreInfo::Float4x4Type, Type::VariableOf(CoreInfo::Float4x4Type),
+                                    CoreInfo::Float4x4SeqType, Type::VariableOf(CoreInfo::Float4x4SeqType)}};
+
+  static inline Parameters Params{
+      {"Operand", SHCCSTR("The matrix or a sequence of matrices, one per input item."), OperandTypes}};
+
+  ParamVar _operand{};
+  SHVar _result{};
+  ExposedInfo _requiredInfo{};
+  bool _matrices{false};
+
+  static SHOptionalString help() {
+    return SHCCSTR("Multiplies a batch of vectors or 4x4 matrices by a matrix (or a matrix per item) at once.");
+  }
+
+  static SHTypesInfo inputTypes() { return InputTypes; }
+  static SHTypesInfo outputTypes() { return InputTypes; }
+  SHParametersInfo parameters() { return Params; }
+
+  void setParam(int index, const SHVar &value) { _operand = value; }
+  SHVar getParam(int index) { return _operand; }
+
+  SHExposedTypesInfo requiredVariables() {
+    if (_operand.isVariable()) {
+      _requiredInfo = ExposedInfo(
+          ExposedInfo::Variable(_operand.variableName(), SHCCSTR("The required operand."), CoreInfo::AnyType));
+      return SHExposedTypesInfo(_requiredInfo);
+    }
+    return {};
+  }
+
+  void destroy() { destroyVar(_result); }
+  void warmup(SHContext *context) { _operand.warmup(context); }
+  void cleanup() { _operand.cleanup(); }
+
+  SHTypeInfo compose(const SHInstanceData &data);
+
+  SHVar activate(SHContext *context, const SHVar &input);
+};
+
+// Transposes a Seq of N 4x4 matrices
+struct BatchTranspose {
+  SHVar _result{};
+
+  static SHTypesInfo inputTypes() { return CoreInfo::Float4x4SeqType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::Float4x4SeqType; }
+
+  void destroy() { destroyVar(_result); }
+
+  SHVar activate(SHContext *context, const SHVar &input);
+};
+
 struct Orthographic : VectorUnaryBase {
   double _width = 1280;
   double _height = 720;
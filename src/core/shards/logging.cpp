@@ -5,23 +5,256 @@
 #include <atomic>
 #include <numeric>
 #include <string>
+#include <thread>
 #include <log/log.hpp>
 #include <spdlog/sinks/dist_sink.h>
 
 namespace shards {
+/*
+ * Asynchronous logging
+ *
+ * Records are copied into a fixed size ring of pre-allocated slots by the
+ * producing (mesh) threads and formatted + written to the sinks by a single
+ * background flusher thread. Slots keep their storage between uses, so once
+ * warm a steady stream of records of similar size does not allocate.
+ * If the ring is full records are dropped (and counted) rather than blocking.
+ */
+struct AsyncLogRecord {
+  std::atomic<size_t> sequence{0};
+  spdlog::level::level_enum level{spdlog::level::info};
+  spdlog::source_loc loc{};
+  std::string wireName;
+  std::string prefix;
+  OwnedVar value{};
+  bool hasValue{false};
+  uint64_t suppressed{0};
+};
+
+struct AsyncLogger {
+  static constexpr size_t RingSize = 4096; // must be a power of 2
+  static constexpr auto IdleWait = std::chrono::milliseconds(1);
+
+  AsyncLogger() : _slots(new AsyncLogRecord[RingSize]) {
+    for (size_t i = 0; i < RingSize; i++) {
+      _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _flusher = std::thread([this]() { flusherLoop(); });
+  }
+
+  ~AsyncLogger() {
+    _running = false;
+    if (_flusher.joinable())
+      _flusher.join();
+  }
+
+  // Multiple producers, never blocks, returns false if the record was dropped
+  template <typename FILL> bool push(FILL &&fill) {
+    AsyncLogRecord *slot;
+    auto pos = _enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+      slot = &_slots[pos & (RingSize - 1)];
+      auto seq = slot->sequence.load(std::memory_order_acquire);
+      auto diff = intptr_t(seq) - intptr_t(pos);
+      if (diff == 0) {
+        if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        // full
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = _enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+    fill(*slot);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  // Single consumer
+  bool pop() {
+    auto &slot = _slots[_dequeuePos & (RingSize - 1)];
+    auto seq = slot.sequence.load(std::memory_order_acquire);
+    if (intptr_t(seq) - intptr_t(_dequeuePos + 1) < 0)
+      return false;
+
+    write(slot);
+
+    // keep value storage around for recycling, just release the slot
+    slot.sequence.store(_dequeuePos + RingSize, std::memory_order_release);
+    _dequeuePos++;
+    return true;
+  }
+
+  void write(const AsyncLogRecord &record) {
+    auto logger = spdlog::default_logger_raw();
+    const SHVar &value = record.value;
+    if (record.suppressed > 0) {
+      if (!record.hasValue)
+        logger->log(record.loc, record.level, "[{}] {} (suppressed: {})", record.wireName, record.prefix, record.suppressed);
+      else if (record.prefix.size() > 0)
+        logger->log(record.loc, record.level, "[{}] {}: {} (suppressed: {})", record.wireName, record.prefix, value,
+                    record.suppressed);
+      else
+        logger->log(record.loc, record.level, "[{}] {} (suppressed: {})", record.wireName, value, record.suppressed);
+    } else {
+      if (!record.hasValue)
+        logger->log(record.loc, record.level, "[{}] {}", record.wireName, record.prefix);
+      else if (record.prefix.size() > 0)
+        logger->log(record.loc, record.level, "[{}] {}: {}", record.wireName, record.prefix, value);
+      else
+        logger->log(record.loc, record.level, "[{}] {}", record.wireName, value);
+    }
+  }
+
+  void flusherLoop() {
+    while (true) {
+      // check before draining so that we always empty the ring on exit
+      const auto running = _running.load();
+
+      size_t written = 0;
+      while (pop())
+        written++;
+
+      auto dropped = _dropped.exchange(0, std::memory_order_relaxed);
+      if (dropped > 0) {
+        SHLOG_WARNING("Async log ring full, dropped {} records", dropped);
+      }
+
+      if (!running)
+        break;
+
+      if (written == 0)
+        std::this_thread::sleep_for(IdleWait);
+    }
+  }
+
+  std::unique_ptr<AsyncLogRecord[]> _slots;
+  alignas(64) std::atomic<size_t> _enqueuePos{0};
+  alignas(64) size_t _dequeuePos{0};
+  std::atomic<uint64_t> _dropped{0};
+  std::atomic_bool _running{true};
+  std::thread _flusher;
+};
+
 struct LoggingBase {
   static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
 
   static SHTypesInfo outputTypes() { return CoreInfo::AnyType; }
+
+  static inline Parameters throttleParams{
+      {"Async",
+       SHCCSTR("If true the message is queued and formatted/written by a background thread instead of the current one."),
+       {CoreInfo::BoolType}},
+      {"Every", SHCCSTR("Only log once every N activations, useful within hot loops."), {CoreInfo::IntType}},
+      {"MaxPerSecond",
+       SHCCSTR("The maximum amount of messages this shard will log every second, 0 means unlimited."),
+       {CoreInfo::IntType}}};
+
+  bool _async{false};
+  int64_t _every{1};
+  int64_t _maxPerSecond{0};
+
+  std::optional<Shared<AsyncLogger>> _asyncLogger;
+
+  uint64_t _counter{0};
+  uint64_t _suppressed{0};
+  int64_t _tokens{0};
+  SHTime _lastRefill{};
+
+  void setBaseParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _async = value.payload.boolValue;
+      break;
+    case 1:
+      _every = std::max(int64_t(1), value.payload.intValue);
+      break;
+    case 2:
+      _maxPerSecond = std::max(int64_t(0), value.payload.intValue);
+      break;
+    default:
+      break;
+    }
+  }
+
+  SHVar getBaseParam(int index) {
+    switch (index) {
+    case 0:
+      return Var(_async);
+    case 1:
+      return Var(_every);
+    case 2:
+      return Var(_maxPerSecond);
+    default:
+      return Var::Empty;
+    }
+  }
+
+  void warmup(SHContext *context) {
+    _counter = 0;
+    _suppressed = 0;
+    _tokens = _maxPerSecond;
+    _lastRefill = SHClock::now();
+    // keep the flusher alive across restarts, released with the shard
+    if (_async && !_asyncLogger)
+      _asyncLogger.emplace();
+  }
+
+  // returns true if this activation should be logged
+  bool throttle() {
+    if (_every > 1 && (_counter++ % uint64_t(_every)) != 0) {
+      _suppressed++;
+      return false;
+    }
+
+    if (_maxPerSecond > 0) {
+      auto now = SHClock::now();
+      if (now - _lastRefill >= std::chrono::seconds(1)) {
+        _tokens = _maxPerSecond;
+        _lastRefill = now;
+      }
+      if (_tokens == 0) {
+        _suppressed++;
+        return false;
+      }
+      _tokens--;
+    }
+
+    return true;
+  }
+
+  void logAsync(SHContext *context, const std::string &prefix, const SHVar *value, spdlog::source_loc loc) {
+    auto logger = spdlog::default_logger_raw();
+    if (!logger->should_log(spdlog::level::info))
+      return;
+
+    auto current = context->wireStack.back();
+    auto suppressed = _suppressed;
+    if ((*_asyncLogger)->push([&](AsyncLogRecord &record) {
+          record.level = spdlog::level::info;
+          record.loc = loc;
+          record.wireName.assign(current->name);
+          record.prefix.assign(prefix);
+          record.hasValue = value != nullptr;
+          if (value)
+            record.value = *value; // recycles the slot's memory
+          record.suppressed = suppressed;
+        })) {
+      _suppressed = 0;
+    }
+  }
 };
 
 struct Log : public LoggingBase {
-  static inline ParamsInfo msgParamsInfo =
-      ParamsInfo(ParamsInfo::Param("Prefix", SHCCSTR("The message to prefix to the logged output."), CoreInfo::StringType));
-
   std::string msg;
 
-  static SHParametersInfo parameters() { return SHParametersInfo(msgParamsInfo); }
+  static SHParametersInfo parameters() {
+    static Parameters params{{{"Prefix", SHCCSTR("The message to prefix to the logged output."), {CoreInfo::StringType}}},
+                             throttleParams};
+    return params;
+  }
 
   static SHOptionalString help() {
     return SHCCSTR(
@@ -34,26 +267,38 @@ struct Log : public LoggingBase {
       msg = inValue.payload.stringValue;
       break;
     default:
+      setBaseParam(index - 1, inValue);
       break;
     }
   }
 
   SHVar getParam(int index) {
-    auto res = SHVar();
     switch (index) {
     case 0:
-      res.valueType = String;
-      res.payload.stringValue = msg.c_str();
-      break;
+      return Var(msg);
     default:
-      break;
+      return getBaseParam(index - 1);
     }
-    return res;
   }
 
   SHVar activate(SHContext *context, const SHVar &input) {
+    if (!throttle())
+      return input;
+
+    if (_async) {
+      logAsync(context, msg, &input, spdlog::source_loc{__FILE__, __LINE__, SPDLOG_FUNCTION});
+      return input;
+    }
+
     auto current = context->wireStack.back();
-    if (msg.size() > 0) {
+    if (_suppressed > 0) {
+      if (msg.size() > 0) {
+        SHLOG_INFO("[{}] {}: {} (suppressed: {})", current->name, msg, input, _suppressed);
+      } else {
+        SHLOG_INFO("[{}] {} (suppressed: {})", current->name, input, _suppressed);
+      }
+      _suppressed = 0;
+    } else if (msg.size() > 0) {
       SHLOG_INFO("[{}] {}: {}", current->name, msg, input);
     } else {
       SHLOG_INFO("[{}] {}", current->name, input);
@@ -63,12 +308,14 @@ struct Log : public LoggingBase {
 };
 
 struct Msg : public LoggingBase {
-  static inline ParamsInfo msgParamsInfo = ParamsInfo(
-      ParamsInfo::Param("Message", SHCCSTR("The message to display on the user's screen or console."), CoreInfo::StringType));
-
   std::string msg;
 
-  static SHParametersInfo parameters() { return SHParametersInfo(msgParamsInfo); }
+  static SHParametersInfo parameters() {
+    static Parameters params{
+        {{"Message", SHCCSTR("The message to display on the user's screen or console."), {CoreInfo::StringType}}},
+        throttleParams};
+    return params;
+  }
 
   static SHOptionalString help() {
     return SHCCSTR("Displays the passed message string or the passed variable's value to the user via standard output.");
@@ -80,26 +327,36 @@ struct Msg : public LoggingBase {
       msg = inValue.payload.stringValue;
       break;
     default:
+      setBaseParam(index - 1, inValue);
       break;
     }
   }
 
   SHVar getParam(int index) {
-    auto res = SHVar();
     switch (index) {
     case 0:
-      res.valueType = String;
-      res.payload.stringValue = msg.c_str();
-      break;
+      return Var(msg);
     default:
-      break;
+      return getBaseParam(index - 1);
     }
-    return res;
   }
 
   SHVar activate(SHContext *context, const SHVar &input) {
+    if (!throttle())
+      return input;
+
+    if (_async) {
+      logAsync(context, msg, nullptr, spdlog::source_loc{__FILE__, __LINE__, SPDLOG_FUNCTION});
+      return input;
+    }
+
     auto current = context->wireStack.back();
-    SHLOG_INFO("[{}] {}", current->name, msg);
+    if (_suppressed > 0) {
+      SHLOG_INFO("[{}] {} (suppressed: {})", current->name, msg, _suppressed);
+      _suppressed = 0;
+    } else {
+      SHLOG_INFO("[{}] {}", current->name, msg);
+    }
     return input;
   }
 };
@@ -11,6 +11,7 @@
 #include "core.hpp"
 #include <sstream>
 #include <stdexcept>
+#include <type_traits>
 #include <variant>
 
 #define _PC
@@ -19,10 +20,88 @@
 
 namespace shards {
 namespace Math {
+// Typed kernels working straight on the payloads of homogeneous Float/Int seqs and arrays,
+// no boxing and no type switch per element.
+// Element strides are compile time constants so the loops vectorize for the target ISA,
+// large inputs are split across the SharedThreadPool.
+namespace kernels {
+constexpr size_t ParallelThreshold = 1 << 16;
+constexpr size_t ParallelChunk = 1 << 14;
+
+template <typename T> constexpr SHType typeOf() { return std::is_floating_point_v<T> ? SHType::Float : SHType::Int; }
+
+template <typename T> ALWAYS_INLINE inline T load(const SHVarPayload &p) {
+  if constexpr (std::is_floating_point_v<T>)
+    return p.floatValue;
+  else
+    return p.intValue;
+}
+
+template <typename T> ALWAYS_INLINE inline T load(const SHVar &v) { return load<T>(v.payload); }
+
+template <typename T> ALWAYS_INLINE inline void store(SHVarPayload &p, T value) {
+  if constexpr (std::is_floating_point_v<T>)
+    p.floatValue = value;
+  else
+    p.intValue = value;
+}
+
+template <typename T> ALWAYS_INLINE inline void store(SHVar &v, T value) {
+  v.valueType = typeOf<T>();
+  store<T>(v.payload, value);
+}
+
+template <typename F> inline void forRange(size_t len, F &&fn) {
+  if (len < ParallelThreshold) {
+    fn(size_t(0), len);
+  } else {
+    const size_t chunks = (len + ParallelChunk - 1) / ParallelChunk;
+    parallelFor(chunks, [&](size_t i) {
+      const size_t begin = i * ParallelChunk;
+      fn(begin, std::min(len, begin + ParallelChunk));
+    });
+  }
+}
+
+// out[i] = op(in[i], operand[i % operandLen]), an operandLen of 0 means operand is a single scalar
+// in and out can be the same buffer
+template <typename T, typename OP, typename E, typename OE>
+inline void binary(const E *in, size_t len, const OE *operand, size_t operandLen, E *out) {
+  forRange(len, [&](size_t begin, size_t end) {
+    OP op;
+    if (operandLen == 0) {
+      const T b = load<T>(*operand);
+      for (size_t i = begin; i < end; i++)
+        store<T>(out[i], op.template apply<T>(load<T>(in[i]), b));
+    } else {
+      size_t i = begin;
+      while (i < end) {
+        const size_t j = i % operandLen;
+        const size_t n = std::min(end - i, operandLen - j);
+        for (size_t k = 0; k < n; k++)
+          store<T>(out[i + k], op.template apply<T>(load<T>(in[i + k]), load<T>(operand[j + k])));
+        i += n;
+      }
+    }
+  });
+}
+
+template <typename T, typename E, typename F> inline void unary(const E *in, size_t len, E *out, F fn) {
+  forRange(len, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      store<T>(out[i], fn(load<T>(in[i])));
+  });
+}
+} // namespace kernels
+
 struct Base {
+  static inline Type AnyArrayType{{SHType::Array}};
+  static inline Type AnyVarArrayType = Type::VariableOf(AnyArrayType);
+
   static inline Types MathTypes{{CoreInfo::IntType, CoreInfo::Int2Type, CoreInfo::Int3Type, CoreInfo::Int4Type,
                                  CoreInfo::Int8Type, CoreInfo::Int16Type, CoreInfo::FloatType, CoreInfo::Float2Type,
-                                 CoreInfo::Float3Type, CoreInfo::Float4Type, CoreInfo::ColorType, CoreInfo::AnySeqType}};
+                                 CoreInfo::Float3Type, CoreInfo::Float4Type, CoreInfo::ColorType, CoreInfo::AnySeqType,
+                                 AnyArrayType}};
 
   SHVar _result{};
 
@@ -43,8 +122,8 @@ struct Base {
 };
 
 struct UnaryBase : public Base {
-  static inline Types FloatOrSeqTypes{
-      {CoreInfo::FloatType, CoreInfo::Float2Type, CoreInfo::Float3Type, CoreInfo::Float4Type, CoreInfo::AnySeqType}};
+  static inline Types FloatOrSeqTypes{{CoreInfo::FloatType, CoreInfo::Float2Type, CoreInfo::Float3Type, CoreInfo::Float4Type,
+                                       CoreInfo::AnySeqType, AnyArrayType}};
 
   static SHTypesInfo inputTypes() { return FloatOrSeqTypes; }
   static SHOptionalString inputHelp() {
@@ -54,14 +133,15 @@ struct UnaryBase : public Base {
 };
 
 struct BinaryBase : public Base {
-  enum OpType { Invalid, Broadcast, Normal, Seq1, SeqSeq };
+  enum OpType { Invalid, Broadcast, Normal, Seq1, SeqSeq, ArrayOp };
 
   static inline Types MathTypesOrVar{
       {CoreInfo::IntType,       CoreInfo::IntVarType,   CoreInfo::Int2Type,      CoreInfo::Int2VarType,  CoreInfo::Int3Type,
        CoreInfo::Int3VarType,   CoreInfo::Int4Type,     CoreInfo::Int4VarType,   CoreInfo::Int8Type,     CoreInfo::Int8VarType,
        CoreInfo::Int16Type,     CoreInfo::Int16VarType, CoreInfo::FloatType,     CoreInfo::FloatVarType, CoreInfo::Float2Type,
        CoreInfo::Float2VarType, CoreInfo::Float3Type,   CoreInfo::Float3VarType, CoreInfo::Float4Type,   CoreInfo::Float4VarType,
-       CoreInfo::ColorType,     CoreInfo::ColorVarType, CoreInfo::AnySeqType,    CoreInfo::AnyVarSeqType}};
+       CoreInfo::ColorType,     CoreInfo::ColorVarType, CoreInfo::AnySeqType,    CoreInfo::AnyVarSeqType, AnyArrayType,
+       AnyVarArrayType}};
 
   static inline ParamsInfo mathParamsInfo =
       ParamsInfo(ParamsInfo::Param("Operand", SHCCSTR("The operand for this operation."), MathTypesOrVar));
@@ -69,6 +149,8 @@ struct BinaryBase : public Base {
   ParamVar _operand{shards::Var(0)};
   ExposedInfo _requiredInfo{};
   OpType _opType = Invalid;
+  // set during compose when both sides are homogeneous Float or Int seqs (or the operand a matching scalar)
+  SHType _kernelType = SHType::None;
   const VectorTypeTraits *_lhsVecType{};
   const VectorTypeTraits *_rhsVecType{};
 
@@ -87,7 +169,12 @@ struct BinaryBase : public Base {
   }
 
   void validateTypes(const SHTypeInfo &lhs, const SHType &rhs, SHTypeInfo &resultType) {
-    if (rhs != Seq && lhs.basicType != Seq) {
+    if (lhs.basicType == Array) {
+      // inner types are only known at runtime
+      if (rhs != Array && rhs != Int && rhs != Float)
+        throw formatTypeError(lhs.basicType, rhs);
+      _opType = ArrayOp;
+    } else if (rhs != Seq && lhs.basicType != Seq) {
       _lhsVecType = VectorTypeLookup::getInstance().get(lhs.basicType);
       _rhsVecType = VectorTypeLookup::getInstance().get(rhs);
       if (_lhsVecType || _rhsVecType) {
@@ -143,9 +230,45 @@ struct BinaryBase : public Base {
       throw ComposeError("Math operand variable not found: " + std::string(operandSpec.payload.stringValue));
     }
 
+    _kernelType = SHType::None;
+    if (_opType == Seq1 || _opType == SeqSeq) {
+      const auto lhsType = homogeneousType(data.inputType);
+      if (lhsType == Int || lhsType == Float) {
+        // Seq1 already validated the operand to be of the same type
+        if (_opType == Seq1 || homogeneousOperandType(data) == lhsType)
+          _kernelType = lhsType;
+      }
+    }
+
     return resultType;
   }
 
+  static SHType homogeneousType(const SHTypeInfo &type) {
+    if (type.basicType != Seq || type.seqTypes.len != 1)
+      return SHType::None;
+    return type.seqTypes.elements[0].basicType;
+  }
+
+  SHType homogeneousOperandType(const SHInstanceData &data) {
+    SHVar operandSpec = _operand;
+    if (operandSpec.valueType == ContextVar) {
+      for (uint32_t i = 0; i < data.shared.len; i++) {
+        if (strcmp(data.shared.elements[i].name, operandSpec.payload.stringValue) == 0)
+          return homogeneousType(data.shared.elements[i].exposedType);
+      }
+    } else if (operandSpec.valueType == Seq && operandSpec.payload.seqValue.len > 0) {
+      // constant, check the actual elements
+      const auto &seq = operandSpec.payload.seqValue;
+      const auto type = seq.elements[0].valueType;
+      for (uint32_t i = 1; i < seq.len; i++) {
+        if (seq.elements[i].valueType != type)
+          return SHType::None;
+      }
+      return type;
+    }
+    return SHType::None;
+  }
+
   SHExposedTypesInfo requiredVariables() {
     SHVar operandSpec = _operand;
     if (operandSpec.valueType == ContextVar) {
@@ -163,6 +286,7 @@ struct BinaryBase : public Base {
 
 template <class OP> struct BinaryOperation : public BinaryBase {
   SH_HAS_MEMBER_TEST(hasApply);
+  SH_HAS_MEMBER_TEST(floatOnly);
 
   static SHOptionalString help() {
     return SHCCSTR("Applies the binary operation on the input value and the operand and returns the result (or a sequence of "
@@ -176,6 +300,16 @@ template <class OP> struct BinaryOperation : public BinaryBase {
         throw ComposeError("Operator broadcast not supported for this type");
       }
     }
+    if constexpr (has_hasApply<OP>::value) {
+      if constexpr (has_floatOnly<OP>::value) {
+        if (_kernelType == Int)
+          _kernelType = SHType::None;
+      }
+    } else {
+      if (_opType == ArrayOp)
+        throw ComposeError("Operator not supported on arrays");
+      _kernelType = SHType::None;
+    }
     return resultType;
   }
 
@@ -284,9 +418,86 @@ template <class OP> struct BinaryOperation : public BinaryBase {
     }
   }
 
+  template <typename T> void operateKernel(SHVar &output, const SHVar &a, const SHVar &b) {
+    if constexpr (has_hasApply<OP>::value) {
+      if (_opType == ArrayOp) {
+        const auto &in = a.payload.arrayValue;
+        size_t len = in.len;
+        if (b.valueType == Array) {
+          if (b.innerType != a.innerType)
+            throw ActivationError("Math operation not supported between arrays of different types");
+          if (b.payload.arrayValue.len == 0)
+            len = 0;
+        } else if (b.valueType != a.innerType) {
+          throw ActivationError("Math operation not supported between given types");
+        }
+
+        if (output.valueType != Array) {
+          destroyVar(output);
+          output.valueType = Array;
+        }
+        output.innerType = a.innerType;
+        shards::arrayResize(output.payload.arrayValue, uint32_t(len));
+        if (b.valueType == Array) {
+          kernels::binary<T, OP>(in.elements, len, b.payload.arrayValue.elements, b.payload.arrayValue.len,
+                                 output.payload.arrayValue.elements);
+        } else {
+          kernels::binary<T, OP>(in.elements, len, &b.payload, 0, output.payload.arrayValue.elements);
+        }
+      } else {
+        // homogeneous seqs, types were validated during compose
+        const auto &in = a.payload.seqValue;
+        size_t len = in.len;
+        if (_opType == SeqSeq && b.payload.seqValue.len == 0)
+          len = 0;
+
+        if (output.valueType != Seq) {
+          destroyVar(output);
+          output.valueType = Seq;
+        }
+        shards::arrayResize(output.payload.seqValue, uint32_t(len));
+        if (_opType == SeqSeq) {
+          kernels::binary<T, OP>(in.elements, len, b.payload.seqValue.elements, b.payload.seqValue.len,
+                                 output.payload.seqValue.elements);
+        } else {
+          kernels::binary<T, OP>(in.elements, len, &b, 0, output.payload.seqValue.elements);
+        }
+      }
+    }
+  }
+
+  // Entry point for a whole input, nested seqs go through operate
+  ALWAYS_INLINE void operateAll(SHVar &output, const SHVar &a, const SHVar &b) {
+    if constexpr (has_hasApply<OP>::value) {
+      if (_opType == ArrayOp) {
+        if (a.innerType == Float) {
+          operateKernel<SHFloat>(output, a, b);
+        } else if (a.innerType == Int) {
+          if constexpr (has_floatOnly<OP>::value) {
+            throw ActivationError("Operation supported only on Float arrays");
+          } else {
+            operateKernel<SHInt>(output, a, b);
+          }
+        } else {
+          throw ActivationError("Math operation not supported on arrays of type " + type2Name(a.innerType));
+        }
+        return;
+      } else if (_kernelType == Float) {
+        operateKernel<SHFloat>(output, a, b);
+        return;
+      } else if (_kernelType == Int) {
+        if constexpr (!has_floatOnly<OP>::value) {
+          operateKernel<SHInt>(output, a, b);
+          return;
+        }
+      }
+    }
+    operateFast(_opType, output, a, b);
+  }
+
   ALWAYS_INLINE SHVar activate(SHContext *context, const SHVar &input) {
     const auto operand = _operand.get();
-    operateFast(_opType, _result, input, operand);
+    operateAll(_result, input, operand);
     return _result;
   }
 };
@@ -499,7 +710,15 @@ template <SHType SHT, typename FuncD, typename FuncF> struct UnaryOperation {
                                                                                                  \
     SHTypeInfo compose(const SHInstanceData &data) {                                             \
       if (data.inputType.basicType == SHType::Seq) {                                             \
-        OVERRIDE_ACTIVATE(data, activateSeq);                                                    \
+        const auto &seqTypes = data.inputType.seqTypes;                                          \
+        if (seqTypes.len == 1 && seqTypes.elements[0].basicType == Float) {                      \
+          OVERRIDE_ACTIVATE(data, activateFloatSeq);                                             \
+        } else {                                                                                 \
+          OVERRIDE_ACTIVATE(data, activateSeq);                                                  \
+        }                                                                                        \
+        static_cast<Shard *>(data.shard)->inlineShardId = NotInline;                             \
+      } else if (data.inputType.basicType == SHType::Array) {                                    \
+        OVERRIDE_ACTIVATE(data, activateArray);                                                  \
         static_cast<Shard *>(data.shard)->inlineShardId = NotInline;                             \
       } else {                                                                                   \
         OVERRIDE_ACTIVATE(data, activateSingle);                                                 \
@@ -548,6 +767,32 @@ template <SHType SHT, typename FuncD, typename FuncF> struct UnaryOperation {
       return _result;                                                                            \
     }                                                                                            \
                                                                                                  \
+    SHVar activateFloatSeq(SHContext *context, const SHVar &input) {                             \
+      const auto len = input.payload.seqValue.len;                                               \
+      _result.valueType = Seq;                                                                   \
+      shards::arrayResize(_result.payload.seqValue, len);                                        \
+      kernels::unary<SHFloat>(input.payload.seqValue.elements, len,                              \
+                              _result.payload.seqValue.elements,                                 \
+                              [](SHFloat x) { return SHFloat(FUNC(x)); });                       \
+      return _result;                                                                            \
+    }                                                                                            \
+                                                                                                 \
+    SHVar activateArray(SHContext *context, const SHVar &input) {                                \
+      if (input.innerType != Float)                                                              \
+        throw ActivationError(#NAME " operation supported only on Float arrays!");               \
+      const auto len = input.payload.arrayValue.len;                                             \
+      if (_result.valueType != Array) {                                                          \
+        destroyVar(_result);                                                                     \
+        _result.valueType = Array;                                                               \
+      }                                                                                          \
+      _result.innerType = Float;                                                                 \
+      shards::arrayResize(_result.payload.arrayValue, len);                                      \
+      kernels::unary<SHFloat>(input.payload.arrayValue.elements, len,                            \
+                              _result.payload.arrayValue.elements,                               \
+                              [](SHFloat x) { return SHFloat(FUNC(x)); });                       \
+      return _result;                                                                            \
+    }                                                                                            \
+                                                                                                 \
     ALWAYS_INLINE SHVar activateSingle(SHContext *context, const SHVar &input) {                 \
       SHVar scratch;                                                                             \
       operate(scratch, input);                                                                   \
@@ -767,7 +1012,9 @@ template <class T> struct UnaryBin : public T {
   void cleanup() { _value.cleanup(); }
 
   SHVar activate(SHContext *context, const SHVar &input) {
-    T::operateFast(T::_opType, _value.get(), _value.get(), T::_operand);
+    // sequences are modified in place
+    invalidateSeqIndex(_value.get());
+    T::operateAll(_value.get(), _value.get(), T::_operand);
     return input;
   }
 
@@ -797,6 +1044,9 @@ using Min = BinaryOperation<MinOp>;
 
 #define MATH_BINARY_FLOAT_PROC(NAME, PROC)                                                                  \
   struct NAME##Op final {                                                                                   \
+    static constexpr bool hasApply{};                                                                       \
+    static constexpr bool floatOnly{};                                                                      \
+    template <typename T> T apply(const T &lhs, const T &rhs) { return PROC(lhs, rhs); }                    \
     ALWAYS_INLINE void operator()(SHVar &output, const SHVar &input, const SHVar &operand, void *) {        \
       switch (input.valueType) {                                                                            \
       case Float:                                                                                           \
@@ -17,19 +17,381 @@
 #pragma clang diagnostic ignored "-Wc++11-narrowing"
 #include <boost/asio.hpp>
 #include <boost/process.hpp>
+#include <boost/process/async.hpp>
 #include <boost/stacktrace.hpp>
+#include <array>
+#include <deque>
+#include <mutex>
 #include <sstream>
 #include <string>
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
 #pragma clang diagnostic pop
 
+#include "reactor.hpp"
+
+namespace bp = boost::process;
+namespace net = boost::asio;
+
 namespace shards {
 namespace Process {
+constexpr uint32_t ProcessCC = 'proc';
+
+struct Common {
+  static inline Type Process{{SHType::Object, {.object = {.vendorId = CoreCC, .typeId = ProcessCC}}}};
+  static inline Type ProcessVar{{SHType::ContextVar, {.contextVarTypes = Process}}};
+};
+
+boost::filesystem::path findExecutable(const std::string &name) {
+  // try PATH first
+  auto exePath = boost::filesystem::path(name);
+  if (!boost::filesystem::exists(exePath)) {
+    // fallback to searching PATH
+    exePath = bp::search_path(name);
+  }
+
+  if (exePath.empty()) {
+    throw ActivationError("Executable not found");
+  }
+
+  return exePath.make_preferred();
+}
+
+std::vector<std::string> collectArguments(const SHVar &argsVar) {
+  std::vector<std::string> argsArray;
+  if (argsVar.valueType == Seq) {
+    for (auto &arg : argsVar) {
+      if (arg.payload.stringLen > 0) {
+        argsArray.emplace_back(arg.payload.stringValue, arg.payload.stringLen);
+      } else {
+        // if really empty likely it's an error (also windows will fail
+        // converting to utf16) if not maybe the string just didn't have
+        // len set
+        if (strlen(arg.payload.stringValue) == 0) {
+          throw ActivationError("Empty argument passed, this most likely is a mistake.");
+        } else {
+          argsArray.emplace_back(arg.payload.stringValue);
+        }
+      }
+    }
+  }
+  return argsArray;
+}
+
+// A running child process with asynchronous stdin, stdout and stderr pipes
+// The reactor buffers output as it arrives, wires take it from the buffers and park on signal while they are empty.
+// A stream stops being read once HighWater bytes are buffered, applying back pressure to the child until they are taken.
+class Child : public std::enable_shared_from_this<Child> {
+public:
+  enum class Stream { Out, Err };
+  enum class Take { Data, Pending, Ended };
+
+  static constexpr size_t HighWater = 1024 * 1024;
+  static constexpr size_t ChunkSize = 64 * 1024;
+
+  std::atomic_bool signal{false};
+
+  static std::shared_ptr<Child> spawn(const boost::filesystem::path &exePath, const std::vector<std::string> &args) {
+    auto child = std::make_shared<Child>();
+    child->start(exePath, args);
+    return child;
+  }
+
+  Child() : _in(Reactor::get().ioCtx), _outputs{Output(Reactor::get().ioCtx), Output(Reactor::get().ioCtx)} {
+    // children must only inherit their own ends (dup'ed on their stdio), or another child holding our end of a pipe
+    // would keep it open, e.g. a cat would never see EOF after closeInput
+    closeOnExec(_in);
+    for (auto &output : _outputs)
+      closeOnExec(output.pipe);
+  }
+
+  void notify() {
+    signal.store(true);
+    CompletionSignal::notify();
+  }
+
+  // Thread safe, queues data for the child's stdin
+  void write(std::string_view data) {
+    net::post(Reactor::get().ioCtx, [self = shared_from_this(), data = std::string(data)]() mutable {
+      if (self->_inClosed)
+        return;
+      self->_inbox.emplace_back(std::move(data));
+      if (self->_inbox.size() == 1)
+        self->writeNext();
+    });
+  }
+
+  // Thread safe, closes stdin (the child reads EOF) after pending writes
+  void closeInput() {
+    net::post(Reactor::get().ioCtx, [self = shared_from_this()]() {
+      self->_closingInput = true;
+      if (self->_inbox.empty())
+        self->doCloseInput();
+    });
+  }
+
+  // Thread safe, kills the child if still running and drops any output not taken yet
+  void kill() {
+    net::post(Reactor::get().ioCtx, [self = shared_from_this()]() {
+      if (!self->_exited.load()) {
+        std::error_code ec;
+#ifdef _WIN32
+        self->_child.terminate(ec);
+        self->onExit(self->_child.exit_code());
+#else
+        // reaped by the exit handler
+        ::kill(self->_child.id(), SIGKILL);
+#endif
+      }
+      self->doCloseInput();
+      for (auto &output : self->_outputs) {
+        boost::system::error_code ec;
+        output.pipe.close(ec);
+      }
+      {
+        std::scoped_lock lock(self->_mutex);
+        for (auto &output : self->_outputs) {
+          output.data.clear();
+          output.head = 0;
+          output.ended = true;
+        }
+      }
+      self->notify();
+    });
+  }
+
+  // Takes the next line of stream without its terminator, the last line might be unterminated
+  Take takeLine(Stream stream, std::string &line) {
+    auto &output = _outputs[size_t(stream)];
+    std::unique_lock lock(_mutex);
+    const auto pending = std::string_view(output.data).substr(output.head);
+    const auto eol = pending.find('\n');
+    if (eol == std::string_view::npos) {
+      if (!output.ended)
+        return Take::Pending;
+      if (pending.empty())
+        return Take::Ended;
+      line.assign(pending);
+      consume(output, pending.size(), lock);
+      return Take::Data;
+    }
+    auto len = eol;
+    if (len > 0 && pending[len - 1] == '\r')
+      len--;
+    line.assign(pending.substr(0, len));
+    consume(output, eol + 1, lock);
+    return Take::Data;
+  }
+
+  // Takes everything buffered from stream
+  Take take(Stream stream, std::string &chunk, bool append = false) {
+    auto &output = _outputs[size_t(stream)];
+    std::unique_lock lock(_mutex);
+    const auto pending = std::string_view(output.data).substr(output.head);
+    if (pending.empty())
+      return output.ended ? Take::Ended : Take::Pending;
+    if (append)
+      chunk.append(pending);
+    else
+      chunk.assign(pending);
+    consume(output, pending.size(), lock);
+    return Take::Data;
+  }
+
+  bool exited(int &exitCode) const {
+    if (!_exited.load())
+      return false;
+    exitCode = _exitCode;
+    return true;
+  }
+
+  bool ended(Stream stream) {
+    std::scoped_lock lock(_mutex);
+    auto &output = _outputs[size_t(stream)];
+    return output.ended && output.head == output.data.size();
+  }
+
+private:
+  struct Output {
+    explicit Output(net::io_context &ioCtx) : pipe(ioCtx) {}
+
+    bp::async_pipe pipe;
+    std::unique_ptr<std::array<char, ChunkSize>> chunk{std::make_unique<std::array<char, ChunkSize>>()};
+    // guarded by _mutex, data before head was already taken
+    std::string data;
+    size_t head{0};
+    bool ended{false};
+    bool paused{false};
+  };
+
+  void start(const boost::filesystem::path &exePath, const std::vector<std::string> &args) {
+    try {
+      _child = bp::child(exePath, args, bp::std_in < _in, bp::std_out > _outputs[0].pipe, bp::std_err > _outputs[1].pipe,
+                         Reactor::get().ioCtx,
+                         bp::on_exit([weak = weak_from_this()](int exitCode, const std::error_code &ec) {
+                           if (auto self = weak.lock())
+                             self->onExit(exitCode);
+                         }));
+    } catch (const std::exception &ex) {
+      SHLOG_ERROR("Failed to start process {}: {}", exePath.string(), ex.what());
+      throw ActivationError("Failed to start process");
+    }
+
+    net::post(Reactor::get().ioCtx, [self = shared_from_this()]() {
+      self->read(Stream::Out);
+      self->read(Stream::Err);
+    });
+  }
+
+  static void closeOnExec(bp::async_pipe &pipe) {
+#ifndef _WIN32
+    ::fcntl(pipe.native_source(), F_SETFD, FD_CLOEXEC);
+    ::fcntl(pipe.native_sink(), F_SETFD, FD_CLOEXEC);
+#endif
+  }
+
+  // reactor side
+
+  void onExit(int exitCode) {
+    if (_exited.load())
+      return;
+    _exitCode = exitCode;
+    _exited.store(true);
+    notify();
+  }
+
+  void read(Stream stream) {
+    auto &output = _outputs[size_t(stream)];
+    output.pipe.async_read_some(net::buffer(*output.chunk), [self = shared_from_this(), stream](
+                                                                    const boost::system::error_code &ec, std::size_t size) {
+      auto &output = self->_outputs[size_t(stream)];
+      bool resume = true;
+      {
+        std::scoped_lock lock(self->_mutex);
+        if (output.ended)
+          return; // killed
+        if (size > 0)
+          output.data.append(output.chunk->data(), size);
+        if (ec) {
+          // eof or broken pipe, either way the child is done with this stream
+          output.ended = true;
+          resume = false;
+        } else if (output.data.size() - output.head >= HighWater) {
+          output.paused = true;
+          resume = false;
+        }
+      }
+      self->notify();
+      if (resume)
+        self->read(stream);
+    });
+  }
+
+  void writeNext() {
+    net::async_write(_in, net::buffer(_inbox.front()),
+                     [self = shared_from_this()](const boost::system::error_code &ec, std::size_t) {
+                       if (ec) {
+                         // the child closed its stdin or exited
+                         self->_inbox.clear();
+                         self->doCloseInput();
+                         return;
+                       }
+                       self->_inbox.pop_front();
+                       if (!self->_inbox.empty())
+                         self->writeNext();
+                       else if (self->_closingInput)
+                         self->doCloseInput();
+                     });
+  }
+
+  void doCloseInput() {
+    if (_inClosed)
+      return;
+    _inClosed = true;
+    boost::system::error_code ec;
+    _in.close(ec);
+  }
+
+  // wire side, lock holds _mutex
+  void consume(Output &output, size_t size, std::unique_lock<std::mutex> &lock) {
+    output.head += size;
+    if (output.head == output.data.size()) {
+      output.data.clear();
+      output.head = 0;
+    } else if (output.head >= ChunkSize && output.head * 2 >= output.data.size()) {
+      output.data.erase(0, output.head);
+      output.head = 0;
+    }
+
+    if (output.paused && output.data.size() - output.head < HighWater / 2) {
+      output.paused = false;
+      lock.unlock();
+      const auto stream = &output == &_outputs[0] ? Stream::Out : Stream::Err;
+      net::post(Reactor::get().ioCtx, [self = shared_from_this(), stream]() { self->read(stream); });
+    }
+  }
+
+  bp::child _child;
+  bp::async_pipe _in;
+  std::array<Output, 2> _outputs;
+
+  std::mutex _mutex;
+  std::atomic_bool _exited{false};
+  int _exitCode{0};
+
+  // reactor only
+  std::deque<std::string> _inbox;
+  bool _closingInput{false};
+  bool _inClosed{false};
+};
+
+enum class WaitResult { Done, Stopped, TimedOut };
+
+// Parks the wire until pred holds, timeout is in seconds and only applies if positive
+template <typename Pred> WaitResult waitFor(SHContext *context, Child &child, double timeout, Pred pred) {
+  using Clock = std::chrono::steady_clock;
+  const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(SHDuration(timeout));
+
+  std::shared_ptr<net::steady_timer> timer;
+  DEFER({
+    if (timer)
+      net::post(Reactor::get().ioCtx, [timer]() { timer->cancel(); });
+  });
+
+  while (true) {
+    child.signal.store(false);
+    if (pred())
+      return WaitResult::Done;
+
+    if (timeout > 0.0) {
+      if (Clock::now() >= deadline)
+        return WaitResult::TimedOut;
+      if (!timer) {
+        // wakes us up at the deadline
+        timer = std::make_shared<net::steady_timer>(Reactor::get().ioCtx);
+        net::post(Reactor::get().ioCtx, [timer, deadline, self = child.shared_from_this()]() {
+          timer->expires_at(deadline);
+          timer->async_wait([self](const boost::system::error_code &ec) {
+            if (!ec)
+              self->notify();
+          });
+        });
+      }
+    }
+
+    if (suspendUntil(context, child.signal) != SHWireState::Continue)
+      return WaitResult::Stopped;
+  }
+}
+
 struct Run {
   std::string _moduleName;
   ParamVar _arguments{};
   std::string _outBuf;
   std::string _errBuf;
   int64_t _timeout{30};
+  std::shared_ptr<Child> _child;
 
   static SHTypesInfo inputTypes() { return CoreInfo::StringType; }
   static SHTypesInfo outputTypes() { return CoreInfo::StringType; }
@@ -72,94 +434,360 @@ struct Run {
 
   void warmup(SHContext *context) { _arguments.warmup(context); }
 
-  void cleanup() { _arguments.cleanup(); }
+  void cleanup() {
+    if (_child) {
+      _child->kill();
+      _child = nullptr;
+    }
+    _arguments.cleanup();
+  }
 
   SHVar activate(SHContext *context, const SHVar &input) {
-    return awaitne(
-        context,
-        [&]() {
-          // add any arguments we have
-          std::vector<std::string> argsArray;
-          auto argsVar = _arguments.get();
-          if (argsVar.valueType == Seq) {
-            for (auto &arg : argsVar) {
-              if (arg.payload.stringLen > 0) {
-                argsArray.emplace_back(arg.payload.stringValue, arg.payload.stringLen);
-              } else {
-                // if really empty likely it's an error (also windows will fail
-                // converting to utf16) if not maybe the string just didn't have
-                // len set
-                if (strlen(arg.payload.stringValue) == 0) {
-                  throw ActivationError("Empty argument passed, this most likely is a mistake.");
-                } else {
-                  argsArray.emplace_back(arg.payload.stringValue);
-                }
-              }
-            }
-          }
-
-          // use async asio to avoid deadlocks
-          boost::asio::io_service ios;
-          std::future<std::string> ostr;
-          std::future<std::string> estr;
-          boost::process::opstream ipipe;
-
-          // try PATH first
-          auto exePath = boost::filesystem::path(_moduleName);
-          if (!boost::filesystem::exists(exePath)) {
-            // fallback to searching PATH
-            exePath = boost::process::search_path(_moduleName);
-          }
-
-          if (exePath.empty()) {
-            throw ActivationError("Executable not found");
-          }
-
-          exePath = exePath.make_preferred();
-
-          boost::process::child cmd(exePath, argsArray, boost::process::std_out > ostr, boost::process::std_err > estr,
-                                    boost::process::std_in < ipipe, ios);
-
-          if (!ipipe) {
-            throw ActivationError("Failed to open streams for child process");
-          }
-
-          ipipe << input.payload.stringValue << std::endl;
-          ipipe.pipe().close(); // send EOF
-
-          SHLOG_TRACE("Process started");
-
-          ios.run_for(std::chrono::seconds(_timeout));
-
-          SHLOG_TRACE("Process finished");
-
-          if (cmd.running()) {
-            cmd.terminate();
-            throw ActivationError("Process timed out");
-          }
-
-          // we still need to wait termination
-          _outBuf = ostr.get();
-          _errBuf = estr.get();
-
-          if (cmd.exit_code() != 0) {
-            SHLOG_INFO(_outBuf);
-            SHLOG_ERROR(_errBuf);
-            std::string err("The process exited with a non-zero exit code: ");
-            err += std::to_string(cmd.exit_code());
-            throw ActivationError(err);
-          } else {
-            if (_errBuf.size() > 0) {
-              // print anyway this stream too
-              SHLOG_INFO("(stderr) {}", _errBuf);
-            }
-            SHLOG_TRACE("Process finished successfully");
-            return Var(_outBuf);
-          }
-        },
-        [] {
-          // TODO CANCELLATION
-        });
+    _child = Child::spawn(findExecutable(_moduleName), collectArguments(_arguments.get()));
+    DEFER({
+      _child->kill();
+      _child = nullptr;
+    });
+
+    _child->write(std::string(SHSTRVIEW(input)) + "\n");
+    _child->closeInput(); // send EOF
+
+    SHLOG_TRACE("Process started");
+
+    // drain as we go, the child might produce more than the pipes can buffer
+    _outBuf.clear();
+    _errBuf.clear();
+    int exitCode = 0;
+    const auto result = waitFor(context, *_child, double(_timeout), [&]() {
+      _child->take(Child::Stream::Out, _outBuf, true);
+      _child->take(Child::Stream::Err, _errBuf, true);
+      return _child->exited(exitCode) && _child->ended(Child::Stream::Out) && _child->ended(Child::Stream::Err);
+    });
+
+    SHLOG_TRACE("Process finished");
+
+    if (result == WaitResult::Stopped)
+      return Var::Empty;
+
+    if (result == WaitResult::TimedOut)
+      throw ActivationError("Process timed out");
+
+    if (exitCode != 0) {
+      SHLOG_INFO(_outBuf);
+      SHLOG_ERROR(_errBuf);
+      std::string err("The process exited with a non-zero exit code: ");
+      err += std::to_string(exitCode);
+      throw ActivationError(err);
+    } else {
+      if (_errBuf.size() > 0) {
+        // print anyway this stream too
+        SHLOG_INFO("(stderr) {}", _errBuf);
+      }
+      SHLOG_TRACE("Process finished successfully");
+      return Var(_outBuf);
+    }
+  }
+};
+
+struct Spawn {
+  std::string _moduleName;
+  ParamVar _arguments{};
+  std::shared_ptr<Child> _child;
+
+  static SHOptionalString help() {
+    return SHCCSTR("Starts a process and outputs a handle to it, its standard streams are used with the Process.Write, "
+                   "Process.Read, Process.ReadLine and Process.Wait shards without ever blocking the wire.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return Common::Process; }
+  static inline Parameters params{
+      {"Executable", SHCCSTR("The executable to run."), {CoreInfo::PathType, CoreInfo::StringType}},
+      {"Arguments",
+       SHCCSTR("The arguments to pass to the executable."),
+       {CoreInfo::NoneType, CoreInfo::StringSeqType, CoreInfo::StringVarSeqType}}};
+  static SHParametersInfo parameters() { return params; }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _moduleName = value.payload.stringValue;
+      break;
+    case 1:
+      _arguments = value;
+      break;
+    default:
+      throw SHException("setParam out of range");
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return Var(_moduleName);
+    case 1:
+      return _arguments;
+    default:
+      throw SHException("getParam out of range");
+    }
+  }
+
+  void warmup(SHContext *context) { _arguments.warmup(context); }
+
+  void cleanup() {
+    if (_child) {
+      _child->kill();
+      _child = nullptr;
+    }
+    _arguments.cleanup();
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    if (_child)
+      _child->kill();
+    _child = Child::spawn(findExecutable(_moduleName), collectArguments(_arguments.get()));
+    return Var::Object(&_child, CoreCC, ProcessCC);
+  }
+};
+
+struct User {
+  std::shared_ptr<Child> _child;
+  void *_lastObject = nullptr;
+  ParamVar _processVar{};
+  SHExposedTypeInfo _expInfo{};
+
+  void cleanup() {
+    _processVar.cleanup();
+    _child = nullptr;
+    _lastObject = nullptr;
+  }
+
+  void warmup(SHContext *context) {
+    _processVar.warmup(context);
+    _lastObject = nullptr;
+  }
+
+  void ensureProcess() {
+    auto p_child = reinterpret_cast<std::shared_ptr<Child> *>(_processVar.get().payload.objectValue);
+    auto obj = p_child->get();
+    if (!obj)
+      throw ActivationError("Process is not running.");
+    if (_lastObject != obj) {
+      _child = *p_child;
+      _lastObject = obj;
+    }
+  }
+
+  SHExposedTypesInfo requiredVariables() {
+    if (_processVar.isVariable()) {
+      _expInfo = SHExposedTypeInfo{_processVar.variableName(), SHCCSTR("The required process."), Common::Process};
+    } else {
+      throw ComposeError("No process specified.");
+    }
+    return SHExposedTypesInfo{&_expInfo, 1, 0};
+  }
+};
+
+struct Write : public User {
+  static SHTypesInfo inputTypes() { return CoreInfo::StringOrBytes; }
+  static SHTypesInfo outputTypes() { return CoreInfo::StringOrBytes; }
+
+  static SHParametersInfo parameters() {
+    static Parameters params{{"Process", SHCCSTR("The process to write to."), {Common::ProcessVar}}};
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) { _processVar = value; }
+
+  SHVar getParam(int index) { return _processVar; }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    ensureProcess();
+    // queued, never blocks the wire
+    if (input.valueType == SHType::Bytes)
+      _child->write(std::string_view((const char *)input.payload.bytesValue, input.payload.bytesSize));
+    else
+      _child->write(SHSTRVIEW(input));
+    return input;
+  }
+};
+
+struct CloseInput : public User {
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::AnyType; }
+
+  static SHParametersInfo parameters() {
+    static Parameters params{{"Process", SHCCSTR("The process whose standard input to close."), {Common::ProcessVar}}};
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) { _processVar = value; }
+
+  SHVar getParam(int index) { return _processVar; }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    ensureProcess();
+    _child->closeInput();
+    return input;
+  }
+};
+
+struct Reader : public User {
+  bool _stderr{false};
+  std::string _output;
+
+  static SHTypesInfo inputTypes() { return CoreInfo::NoneType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::StringOrNone; }
+
+  static SHParametersInfo parameters() {
+    static Parameters params{
+        {"Process", SHCCSTR("The process to read from."), {Common::ProcessVar}},
+        {"Stderr", SHCCSTR("If the standard error should be read instead of the standard output."), {CoreInfo::BoolType}}};
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _processVar = value;
+      break;
+    case 1:
+      _stderr = value.payload.boolValue;
+      break;
+    default:
+      break;
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return _processVar;
+    case 1:
+      return Var(_stderr);
+    default:
+      return Var::Empty;
+    }
+  }
+
+  // Parks until take produces data, outputs None once the stream ended
+  template <typename Take> SHVar read(SHContext *context, Take take) {
+    ensureProcess();
+    bool stopped = false;
+    const auto received = recordData(_output, [&]() {
+      auto result = Child::Take::Pending;
+      if (waitFor(context, *_child, 0.0, [&]() {
+            result = take(_stderr ? Child::Stream::Err : Child::Stream::Out, _output);
+            return result != Child::Take::Pending;
+          }) != WaitResult::Done) {
+        stopped = true;
+        return false;
+      }
+      return result == Child::Take::Data;
+    });
+    if (stopped)
+      return Var::Empty;
+    return received ? Var(_output) : Var::Empty;
+  }
+};
+
+struct Read : public Reader {
+  static SHOptionalString help() {
+    return SHCCSTR("Outputs everything the process wrote since the last read, waiting for it to write something. Outputs "
+                   "None once the stream ended.");
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    return read(context, [&](Child::Stream stream, std::string &output) { return _child->take(stream, output); });
+  }
+};
+
+struct ReadLine : public Reader {
+  static SHOptionalString help() {
+    return SHCCSTR("Outputs the next line the process wrote without its terminator, waiting for it to write one. Outputs "
+                   "None once the stream ended.");
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    return read(context, [&](Child::Stream stream, std::string &output) { return _child->takeLine(stream, output); });
+  }
+};
+
+struct Wait : public User {
+  double _timeout{0.0};
+
+  static SHOptionalString help() {
+    return SHCCSTR("Waits for the process to exit and outputs its exit code, the process is killed if it does not exit in "
+                   "time.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::IntType; }
+
+  static SHParametersInfo parameters() {
+    static Parameters params{
+        {"Process", SHCCSTR("The process to wait for."), {Common::ProcessVar}},
+        {"Timeout",
+         SHCCSTR("The maximum time to wait in seconds, 0 waits forever."),
+         {CoreInfo::FloatType, CoreInfo::IntType}}};
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _processVar = value;
+      break;
+    case 1:
+      _timeout = value.valueType == SHType::Int ? double(value.payload.intValue) : value.payload.floatValue;
+      break;
+    default:
+      break;
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return _processVar;
+    case 1:
+      return Var(_timeout);
+    default:
+      return Var::Empty;
+    }
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    ensureProcess();
+    int exitCode = 0;
+    const auto result = waitFor(context, *_child, _timeout, [&]() { return _child->exited(exitCode); });
+    if (result == WaitResult::Stopped)
+      return Var::Empty;
+    if (result == WaitResult::TimedOut) {
+      _child->kill();
+      throw ActivationError("Process timed out");
+    }
+    return Var(int64_t(exitCode));
+  }
+};
+
+struct Kill : public User {
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::AnyType; }
+
+  static SHParametersInfo parameters() {
+    static Parameters params{{"Process", SHCCSTR("The process to kill."), {Common::ProcessVar}}};
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) { _processVar = value; }
+
+  SHVar getParam(int index) { return _processVar; }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    ensureProcess();
+    _child->kill();
+    return input;
   }
 };
 
@@ -180,6 +808,13 @@ struct StackTrace {
 
 void registerProcessShards() {
   REGISTER_SHARD("Process.Run", Process::Run);
+  REGISTER_SHARD("Process.Spawn", Process::Spawn);
+  REGISTER_SHARD("Process.Write", Process::Write);
+  REGISTER_SHARD("Process.CloseInput", Process::CloseInput);
+  REGISTER_SHARD("Process.Read", Process::Read);
+  REGISTER_SHARD("Process.ReadLine", Process::ReadLine);
+  REGISTER_SHARD("Process.Wait", Process::Wait);
+  REGISTER_SHARD("Process.Kill", Process::Kill);
   REGISTER_SHARD("Process.StackTrace", Process::StackTrace);
 }
 }; // namespace shards
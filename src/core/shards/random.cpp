@@ -2,15 +2,280 @@
 /* Copyright © 2020 Fragcolor Pte. Ltd. */
 
 #include "shared.hpp"
+#include "random.hpp"
+#include <algorithm>
+#include <cmath>
 #include <random>
 
 namespace shards {
 namespace Random {
+namespace {
+constexpr uint32_t PhiloxM0 = 0xD2511F53;
+constexpr uint32_t PhiloxM1 = 0xCD9E8D57;
+constexpr uint32_t PhiloxW0 = 0x9E3779B9;
+constexpr uint32_t PhiloxW1 = 0xBB67AE85;
+// blocks computed together, lanes are independent so the rounds vectorize
+constexpr size_t PhiloxLanes = 8;
+// values generated at once by the bulk distributions
+constexpr size_t BulkChunk = 256;
+
+// 53 random bits to [0, 1)
+inline double toUnit(uint32_t hi, uint32_t lo) {
+  return double((uint64_t(hi) << 21) ^ (uint64_t(lo) >> 11)) * (1.0 / 9007199254740992.0);
+}
+} // namespace
+
+void Philox::seed(uint64_t seed, uint64_t stream) {
+  _key[0] = uint32_t(seed);
+  _key[1] = uint32_t(seed >> 32);
+  _stream = stream;
+  _counter = 0;
+  _index = 4;
+}
+
+void Philox::block(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+  uint32_t x0 = counter[0], x1 = counter[1], x2 = counter[2], x3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; round++) {
+    const uint64_t p0 = uint64_t(PhiloxM0) * x0;
+    const uint64_t p1 = uint64_t(PhiloxM1) * x2;
+    const uint32_t y0 = uint32_t(p1 >> 32) ^ x1 ^ k0;
+    const uint32_t y2 = uint32_t(p0 >> 32) ^ x3 ^ k1;
+    x1 = uint32_t(p1);
+    x3 = uint32_t(p0);
+    x0 = y0;
+    x2 = y2;
+    k0 += PhiloxW0;
+    k1 += PhiloxW1;
+  }
+  out[0] = x0;
+  out[1] = x1;
+  out[2] = x2;
+  out[3] = x3;
+}
+
+void Philox::refill() {
+  blocks(_buffer, 1);
+  _index = 0;
+}
+
+void Philox::blocks(uint32_t *out, size_t count) {
+  const uint32_t s0 = uint32_t(_stream), s1 = uint32_t(_stream >> 32);
+  while (count >= PhiloxLanes) {
+    // structure of arrays, one lane per block
+    uint32_t x0[PhiloxLanes], x1[PhiloxLanes], x2[PhiloxLanes], x3[PhiloxLanes];
+    for (size_t j = 0; j < PhiloxLanes; j++) {
+      const uint64_t counter = _counter + j;
+      x0[j] = uint32_t(counter);
+      x1[j] = uint32_t(counter >> 32);
+      x2[j] = s0;
+      x3[j] = s1;
+    }
+    uint32_t k0 = _key[0], k1 = _key[1];
+    for (int round = 0; round < 10; round++) {
+      for (size_t j = 0; j < PhiloxLanes; j++) {
+        const uint64_t p0 = uint64_t(PhiloxM0) * x0[j];
+        const uint64_t p1 = uint64_t(PhiloxM1) * x2[j];
+        const uint32_t y0 = uint32_t(p1 >> 32) ^ x1[j] ^ k0;
+        const uint32_t y2 = uint32_t(p0 >> 32) ^ x3[j] ^ k1;
+        x1[j] = uint32_t(p1);
+        x3[j] = uint32_t(p0);
+        x0[j] = y0;
+        x2[j] = y2;
+      }
+      k0 += PhiloxW0;
+      k1 += PhiloxW1;
+    }
+    for (size_t j = 0; j < PhiloxLanes; j++) {
+      out[j * 4 + 0] = x0[j];
+      out[j * 4 + 1] = x1[j];
+      out[j * 4 + 2] = x2[j];
+      out[j * 4 + 3] = x3[j];
+    }
+    _counter += PhiloxLanes;
+    out += PhiloxLanes * 4;
+    count -= PhiloxLanes;
+  }
+  for (; count > 0; count--) {
+    const uint32_t counter[4] = {uint32_t(_counter), uint32_t(_counter >> 32), s0, s1};
+    block(counter, _key, out);
+    _counter++;
+    out += 4;
+  }
+}
+
+void Philox::fill(uint32_t *out, size_t n) {
+  // leftovers of the current block first
+  while (n > 0 && _index < 4) {
+    *out++ = _buffer[_index++];
+    n--;
+  }
+  const auto whole = n / 4;
+  blocks(out, whole);
+  out += whole * 4;
+  n -= whole * 4;
+  if (n > 0) {
+    refill();
+    while (n-- > 0)
+      *out++ = _buffer[_index++];
+  }
+}
+
+void fillUniform(Philox &gen, double *out, size_t n, double scale) {
+  uint32_t bits[BulkChunk * 2];
+  while (n > 0) {
+    const auto count = std::min(n, BulkChunk);
+    gen.fill(bits, count * 2);
+    for (size_t i = 0; i < count; i++)
+      out[i] = toUnit(bits[i * 2], bits[i * 2 + 1]) * scale;
+    out += count;
+    n -= count;
+  }
+}
+
+void fillInts(Philox &gen, int64_t *out, size_t n, int64_t max) {
+  if (max <= 0)
+    throw SHException("Random: max must be positive");
+
+  if (uint64_t(max) <= std::numeric_limits<uint32_t>::max()) {
+    // Lemire's multiply and shift, rejecting the few values that would bias the result
+    const auto range = uint32_t(max);
+    const auto threshold = uint32_t(-range) % range;
+    uint32_t bits[BulkChunk];
+    while (n > 0) {
+      const auto count = std::min(n, BulkChunk);
+      gen.fill(bits, count);
+      for (size_t i = 0; i < count; i++) {
+        auto m = uint64_t(bits[i]) * range;
+        while (unlikely(uint32_t(m) < threshold))
+          m = uint64_t(gen()) * range;
+        out[i] = int64_t(m >> 32);
+      }
+      out += count;
+      n -= count;
+    }
+  } else {
+    // rare, rejection sampling of masked 64 bits values
+    auto mask = uint64_t(max - 1);
+    mask |= mask >> 1;
+    mask |= mask >> 2;
+    mask |= mask >> 4;
+    mask |= mask >> 8;
+    mask |= mask >> 16;
+    mask |= mask >> 32;
+    for (size_t i = 0; i < n; i++) {
+      uint64_t value;
+      do {
+        value = ((uint64_t(gen()) << 32) | gen()) & mask;
+      } while (value >= uint64_t(max));
+      out[i] = int64_t(value);
+    }
+  }
+}
+
+void fillNormal(Philox &gen, double *out, size_t n, double mean, double stddev) {
+  constexpr double TwoPi = 6.283185307179586476925286766559;
+  // Box-Muller, every pair of uniforms gives a pair of normals
+  double uniforms[BulkChunk];
+  while (n > 0) {
+    const auto count = std::min(n, BulkChunk);
+    const auto pairs = (count + 1) / 2;
+    fillUniform(gen, uniforms, pairs * 2);
+    for (size_t i = 0; i < pairs; i++) {
+      // 1 - u is in (0, 1], log is finite
+      const auto radius = std::sqrt(-2.0 * std::log(1.0 - uniforms[i * 2])) * stddev;
+      const auto angle = TwoPi * uniforms[i * 2 + 1];
+      out[i * 2] = mean + radius * std::cos(angle);
+      if (i * 2 + 1 < count)
+        out[i * 2 + 1] = mean + radius * std::sin(angle);
+    }
+    out += count;
+    n -= count;
+  }
+}
+
+void fillExponential(Philox &gen, double *out, size_t n, double rate) {
+  fillUniform(gen, out, n);
+  const auto scale = -1.0 / rate;
+  for (size_t i = 0; i < n; i++)
+    out[i] = std::log1p(-out[i]) * scale;
+}
+
+void WeightedChoice::build(const double *weights, size_t n) {
+  if (n == 0 || n > std::numeric_limits<uint32_t>::max())
+    throw SHException("Random: invalid amount of weights");
+
+  double total = 0.0;
+  for (size_t i = 0; i < n; i++)
+    total += std::max(weights[i], 0.0);
+  if (!(total > 0.0))
+    throw SHException("Random: weights must not be all zero");
+
+  // Vose's construction, scaled probabilities average 1
+  _probability.resize(n);
+  _alias.resize(n);
+  std::vector<uint32_t> small, large;
+  for (size_t i = 0; i < n; i++) {
+    _probability[i] = std::max(weights[i], 0.0) * double(n) / total;
+    _alias[i] = uint32_t(i);
+    (_probability[i] < 1.0 ? small : large).push_back(uint32_t(i));
+  }
+  while (!small.empty() && !large.empty()) {
+    const auto less = small.back();
+    small.pop_back();
+    const auto more = large.back();
+    _alias[less] = more;
+    _probability[more] -= 1.0 - _probability[less];
+    if (_probability[more] < 1.0) {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+  // leftovers are 1 up to rounding errors
+  for (auto i : small)
+    _probability[i] = 1.0;
+  for (auto i : large)
+    _probability[i] = 1.0;
+}
+
+void WeightedChoice::fill(Philox &gen, int64_t *out, size_t n) const {
+  const auto count = double(_alias.size());
+  uint32_t bits[BulkChunk * 2];
+  while (n > 0) {
+    const auto chunk = std::min(n, BulkChunk);
+    gen.fill(bits, chunk * 2);
+    for (size_t i = 0; i < chunk; i++) {
+      // the integer part picks a column, the fractional part decides between it and its alias
+      const auto u = toUnit(bits[i * 2], bits[i * 2 + 1]) * count;
+      const auto column = std::min(size_t(u), _alias.size() - 1);
+      out[i] = int64_t(u - double(column) < _probability[column] ? column : _alias[column]);
+    }
+    out += chunk;
+    n -= chunk;
+  }
+}
+
 struct RandBase {
   static inline std::random_device _rd{}; // don't make it thread_local!
   static inline thread_local std::mt19937 _gen{_rd()};
   static inline thread_local std::uniform_int_distribution<> _uintdis{};
   static inline thread_local std::uniform_real_distribution<> _udis{0.0, 1.0};
+
+  // Recorded and replayed runs draw from their own generator, seeded by their recorder
+  static std::mt19937 &gen() {
+    auto recorder = Recorder::current();
+    if (likely(recorder == nullptr))
+      return _gen;
+    if (recorder->id() != _recordedGenId) {
+      _recordedGenId = recorder->id();
+      _recordedGen.seed(std::mt19937::result_type(recorder->seed()));
+    }
+    return _recordedGen;
+  }
+
+private:
+  static inline thread_local std::mt19937 _recordedGen{};
+  static inline thread_local uint64_t _recordedGenId{0};
 };
 
 template <Type &OUTTYPE, SHType SHTYPE> struct Rand : public RandBase {
@@ -33,14 +298,14 @@ template <Type &OUTTYPE, SHType SHTYPE> struct Rand : public RandBase {
     auto max = _max.get();
     if constexpr (SHTYPE == SHType::Int) {
       if (max.valueType == None)
-        res.payload.intValue = _uintdis(_gen);
+        res.payload.intValue = _uintdis(gen());
       else
-        res.payload.intValue = _uintdis(_gen) % max.payload.intValue;
+        res.payload.intValue = _uintdis(gen()) % max.payload.intValue;
     } else if constexpr (SHTYPE == SHType::Float) {
       if (max.valueType == None)
-        res.payload.floatValue = _udis(_gen);
+        res.payload.floatValue = _udis(gen());
       else
-        res.payload.floatValue = _udis(_gen) * max.payload.floatValue;
+        res.payload.floatValue = _udis(gen()) * max.payload.floatValue;
     }
     return res;
   }
@@ -55,33 +320,346 @@ private:
 using RandomInt = Rand<CoreInfo::IntType, SHType::Int>;
 using RandomFloat = Rand<CoreInfo::FloatType, SHType::Float>;
 
-struct RandomBytes : public RandBase {
+// Shards generating values in bulk, each one draws from its own counter based generator
+// With a Seed the sequence restarts at every warmup so that a wire outputs the same values every run,
+// without one the generator is seeded from the thread generator (recorded and replayed like it).
+struct BulkBase : public RandBase {
+  static inline Parameters SeedParams{
+      {"Seed",
+       SHCCSTR("The seed of the generator, a wire outputs the same values at every run given the same seed. None seeds "
+               "it randomly."),
+       {CoreInfo::NoneType, CoreInfo::IntType}}};
+
+  OwnedVar _seed{};
+  Philox _philox;
+  SHVar _output{};
+  std::vector<double> _floats;
+  std::vector<int64_t> _ints;
+
+  void destroy() { destroyVar(_output); }
+
+  void warmup(SHContext *context) {
+    if (_seed.valueType == SHType::Int) {
+      _philox.seed(uint64_t(_seed.payload.intValue));
+    } else {
+      auto &generator = gen();
+      _philox.seed((uint64_t(generator()) << 32) | uint64_t(generator()));
+    }
+  }
+
+  SHVar &floatsOutput() {
+    arrayResize(_output.payload.seqValue, uint32_t(_floats.size()));
+    _output.valueType = SHType::Seq;
+    for (size_t i = 0; i < _floats.size(); i++) {
+      auto &element = _output.payload.seqValue.elements[i];
+      element.valueType = SHType::Float;
+      element.payload.floatValue = _floats[i];
+    }
+    return _output;
+  }
+
+  SHVar &intsOutput() {
+    arrayResize(_output.payload.seqValue, uint32_t(_ints.size()));
+    _output.valueType = SHType::Seq;
+    for (size_t i = 0; i < _ints.size(); i++) {
+      auto &element = _output.payload.seqValue.elements[i];
+      element.valueType = SHType::Int;
+      element.payload.intValue = _ints[i];
+    }
+    return _output;
+  }
+};
+
+template <Type &OUTTYPE, Type &SEQTYPE, SHType SHTYPE> struct RandSeq : public BulkBase {
   static SHTypesInfo inputTypes() { return CoreInfo::NoneType; }
-  static SHTypesInfo outputTypes() { return CoreInfo::BytesType; }
-  static SHParametersInfo parameters() { return _params; }
+  static SHTypesInfo outputTypes() { return SEQTYPE; }
+  static SHParametersInfo parameters() {
+    static Parameters params(
+        {{"Size", SHCCSTR("The amount of values to output."), {CoreInfo::IntType}},
+         {"Max",
+          SHCCSTR("The maximum (if integer, not including) value to output."),
+          {CoreInfo::NoneType, OUTTYPE, Type::VariableOf(OUTTYPE)}}},
+        SeedParams);
+    return params;
+  }
 
-  void setParam(int index, const SHVar &value) { _size = value.payload.intValue; }
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _size = value.payload.intValue;
+      break;
+    case 1:
+      _max = value;
+      break;
+    case 2:
+      _seed = value;
+      break;
+    default:
+      break;
+    }
+  }
 
-  SHVar getParam(int index) { return Var(_size); }
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return Var(_size);
+    case 1:
+      return _max;
+    case 2:
+      return _seed;
+    default:
+      return Var::Empty;
+    }
+  }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    if (_size < 0 || _size > UINT32_MAX)
+      throw ComposeError(SHTYPE == SHType::Int ? "RandomInts: Size out of range" : "RandomFloats: Size out of range");
+    return SEQTYPE;
+  }
+
+  void cleanup() { _max.cleanup(); }
+
+  void warmup(SHContext *context) {
+    _max.warmup(context);
+    BulkBase::warmup(context);
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    auto &max = _max.get();
+    if constexpr (SHTYPE == SHType::Int) {
+      // same range as RandomInt when there is no maximum
+      const auto range = max.valueType == None ? int64_t(std::numeric_limits<int>::max()) + 1 : max.payload.intValue;
+      if (range <= 0)
+        throw ActivationError("RandomInts: Max must be positive");
+      _ints.resize(size_t(_size));
+      fillInts(_philox, _ints.data(), _ints.size(), range);
+      return intsOutput();
+    } else {
+      _floats.resize(size_t(_size));
+      fillUniform(_philox, _floats.data(), _floats.size(), max.valueType == None ? 1.0 : max.payload.floatValue);
+      return floatsOutput();
+    }
+  }
+
+private:
+  int64_t _size{16};
+  ParamVar _max{};
+};
+
+using RandomInts = RandSeq<CoreInfo::IntType, CoreInfo::IntSeqType, SHType::Int>;
+using RandomFloats = RandSeq<CoreInfo::FloatType, CoreInfo::FloatSeqType, SHType::Float>;
+
+// Distributions outputting a single value, or a sequence of Size values
+struct SizedBase : public BulkBase {
+  static inline Parameters SizeParams{{"Size",
+                                       SHCCSTR("The amount of values to output as a sequence, None outputs a single value."),
+                                       {CoreInfo::NoneType, CoreInfo::IntType}}};
+
+  OwnedVar _size{};
+
+  bool sized() const { return _size.valueType == SHType::Int; }
+  size_t count() const { return sized() ? size_t(std::max(_size.payload.intValue, int64_t(0))) : 1; }
+};
+
+template <class Distribution> struct Distribute : public SizedBase {
+  static SHTypesInfo inputTypes() { return CoreInfo::NoneType; }
+  static SHTypesInfo outputTypes() { return Distribution::OutputTypes; }
+  static SHOptionalString help() { return Distribution::help(); }
+  static SHParametersInfo parameters() {
+    static Parameters params(Parameters(Distribution::Params, SizeParams._infos), SeedParams._infos);
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) {
+    const auto own = int(Distribution::Params._infos.size());
+    if (index < own)
+      _distribution.setParam(index, value);
+    else if (index == own)
+      _size = value;
+    else
+      _seed = value;
+  }
+
+  SHVar getParam(int index) {
+    const auto own = int(Distribution::Params._infos.size());
+    if (index < own)
+      return _distribution.getParam(index);
+    return index == own ? _size : _seed;
+  }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    _distribution.validate();
+    return sized() ? Distribution::SeqType : Distribution::SingleType;
+  }
+
+  void cleanup() { _distribution.cleanup(); }
+
+  void warmup(SHContext *context) {
+    _distribution.warmup(context);
+    BulkBase::warmup(context);
+  }
 
   SHVar activate(SHContext *context, const SHVar &input) {
-    _buffer.resize(_size);
-    for (int64_t i = 0; i < _size; i++) {
-      _buffer[i] = _uintdis(_gen) % 256;
+    if constexpr (Distribution::Kind == SHType::Int) {
+      _ints.resize(count());
+      _distribution.fill(_philox, _ints.data(), _ints.size());
+      return sized() ? intsOutput() : Var(_ints[0]);
+    } else {
+      _floats.resize(count());
+      _distribution.fill(_philox, _floats.data(), _floats.size());
+      return sized() ? floatsOutput() : Var(_floats[0]);
     }
-    return Var(_buffer.data(), _size);
+  }
+
+private:
+  Distribution _distribution;
+};
+
+struct Normal {
+  static constexpr SHType Kind = SHType::Float;
+  static inline Type &SingleType = CoreInfo::FloatType;
+  static inline Type &SeqType = CoreInfo::FloatSeqType;
+  static inline Types OutputTypes{{CoreInfo::FloatType, CoreInfo::FloatSeqType}};
+  static inline Parameters Params{{"Mean", SHCCSTR("The mean of the distribution."), {CoreInfo::FloatType}},
+                                  {"Deviation", SHCCSTR("The standard deviation of the distribution."), {CoreInfo::FloatType}}};
+
+  static SHOptionalString help() { return SHCCSTR("Outputs normally distributed random floats."); }
+
+  double _mean{0.0};
+  double _deviation{1.0};
+
+  void setParam(int index, const SHVar &value) { (index == 0 ? _mean : _deviation) = value.payload.floatValue; }
+  SHVar getParam(int index) { return Var(index == 0 ? _mean : _deviation); }
+  void validate() {}
+  void warmup(SHContext *context) {}
+  void cleanup() {}
+
+  void fill(Philox &gen, double *out, size_t n) { fillNormal(gen, out, n, _mean, _deviation); }
+};
+
+struct Exponential {
+  static constexpr SHType Kind = SHType::Float;
+  static inline Type &SingleType = CoreInfo::FloatType;
+  static inline Type &SeqType = CoreInfo::FloatSeqType;
+  static inline Types OutputTypes{{CoreInfo::FloatType, CoreInfo::FloatSeqType}};
+  static inline Parameters Params{{"Rate", SHCCSTR("The rate of the distribution, its mean is 1 / Rate."), {CoreInfo::FloatType}}};
+
+  static SHOptionalString help() { return SHCCSTR("Outputs exponentially distributed random floats."); }
+
+  double _rate{1.0};
+
+  void setParam(int index, const SHVar &value) { _rate = value.payload.floatValue; }
+  SHVar getParam(int index) { return Var(_rate); }
+  void validate() {
+    if (!(_rate > 0.0))
+      throw ComposeError("RandomExponential: Rate must be positive");
+  }
+  void warmup(SHContext *context) {}
+  void cleanup() {}
+
+  void fill(Philox &gen, double *out, size_t n) { fillExponential(gen, out, n, _rate); }
+};
+
+struct Choice {
+  static constexpr SHType Kind = SHType::Int;
+  static inline Type &SingleType = CoreInfo::IntType;
+  static inline Type &SeqType = CoreInfo::IntSeqType;
+  static inline Types OutputTypes{{CoreInfo::IntType, CoreInfo::IntSeqType}};
+  static inline Parameters Params{{"Weights",
+                                   SHCCSTR("The weights of the indices to choose from, an index is chosen with a "
+                                           "probability proportional to its weight."),
+                                   {CoreInfo::FloatSeqType, CoreInfo::FloatVarSeqType}}};
+
+  static SHOptionalString help() {
+    return SHCCSTR("Outputs random indices chosen according to their weights, use Take to pick the matching values.");
+  }
+
+  ParamVar _weights{};
+  std::vector<double> _built;
+  WeightedChoice _choice;
+
+  void setParam(int index, const SHVar &value) { _weights = value; }
+  SHVar getParam(int index) { return _weights; }
+  void validate() {}
+  void warmup(SHContext *context) {
+    _weights.warmup(context);
+    _built.clear();
+  }
+  void cleanup() { _weights.cleanup(); }
+
+  void fill(Philox &gen, int64_t *out, size_t n) {
+    auto &weights = _weights.get();
+    if (weights.valueType != SHType::Seq)
+      throw ActivationError("RandomChoice: Weights expected");
+    // the table is only rebuilt when weights change
+    const auto &seq = weights.payload.seqValue;
+    auto changed = seq.len != _built.size();
+    for (uint32_t i = 0; !changed && i < seq.len; i++)
+      changed = seq.elements[i].payload.floatValue != _built[i];
+    if (changed) {
+      _built.resize(seq.len);
+      for (uint32_t i = 0; i < seq.len; i++)
+        _built[i] = seq.elements[i].payload.floatValue;
+      try {
+        _choice.build(_built.data(), _built.size());
+      } catch (...) {
+        _built.clear();
+        throw;
+      }
+    }
+    _choice.fill(gen, out, n);
+  }
+};
+
+using RandomNormal = Distribute<Normal>;
+using RandomExponential = Distribute<Exponential>;
+using RandomChoice = Distribute<Choice>;
+
+struct RandomBytes : public BulkBase {
+  static SHTypesInfo inputTypes() { return CoreInfo::NoneType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::BytesType; }
+  static SHParametersInfo parameters() {
+    static Parameters params({{"Size", SHCCSTR("The amount of bytes to output."), {CoreInfo::IntType}}}, SeedParams);
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) {
+    if (index == 0)
+      _size = value.payload.intValue;
+    else
+      _seed = value;
+  }
+
+  SHVar getParam(int index) { return index == 0 ? Var(_size) : SHVar(_seed); }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    if (_size < 0 || _size > UINT32_MAX)
+      throw ComposeError("RandomBytes: Size out of range");
+    return CoreInfo::BytesType;
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    // whole words, the tail is cut
+    _words.resize((size_t(_size) + 3) / 4);
+    _philox.fill(_words.data(), _words.size());
+    return Var((uint8_t *)_words.data(), uint32_t(_size));
   }
 
 private:
   int64_t _size{32};
-  std::vector<uint8_t> _buffer;
-  static inline Parameters _params{{"Size", SHCCSTR("The amount of bytes to output."), {CoreInfo::IntType}}};
+  std::vector<uint32_t> _words;
 };
 
 void registerShards() {
   REGISTER_SHARD("RandomInt", RandomInt);
   REGISTER_SHARD("RandomFloat", RandomFloat);
   REGISTER_SHARD("RandomBytes", RandomBytes);
+  REGISTER_SHARD("RandomInts", RandomInts);
+  REGISTER_SHARD("RandomFloats", RandomFloats);
+  REGISTER_SHARD("RandomNormal", RandomNormal);
+  REGISTER_SHARD("RandomExponential", RandomExponential);
+  REGISTER_SHARD("RandomChoice", RandomChoice);
 }
 } // namespace Random
 } // namespace shards
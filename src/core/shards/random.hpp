@@ -0,0 +1,75 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2020 Fragcolor Pte. Ltd. */
+
+#ifndef SH_CORE_SHARDS_RANDOM
+#define SH_CORE_SHARDS_RANDOM
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace shards {
+namespace Random {
+// Philox4x32-10 counter based generator (Salmon et al., Parallel random numbers: as easy as 1, 2, 3)
+// Every 128 bits counter maps to 4 independent 32 bits outputs: blocks are generated in batches the compiler
+// vectorizes, seeding costs nothing and streams with different keys or stream ids never overlap.
+class Philox {
+public:
+  using result_type = uint32_t;
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return std::numeric_limits<uint32_t>::max(); }
+
+  Philox(uint64_t seed = 0, uint64_t stream = 0) { this->seed(seed, stream); }
+
+  // Restarts the sequence from the first block of the given key and stream
+  void seed(uint64_t seed, uint64_t stream = 0);
+
+  result_type operator()() {
+    if (_index == 4)
+      refill();
+    return _buffer[_index++];
+  }
+
+  // Fills out with the next n values of the sequence, same values as calling operator() n times
+  void fill(uint32_t *out, size_t n);
+
+  // Computes one block, counter and key in the reference layout, exposed for known answer tests
+  static void block(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]);
+
+private:
+  void refill();
+  void blocks(uint32_t *out, size_t count);
+
+  uint32_t _key[2];
+  uint64_t _counter;
+  uint64_t _stream;
+  uint32_t _buffer[4];
+  uint32_t _index{4};
+};
+
+// Bulk distributions, each value draws from gen in sequence order
+
+// uniform in [0, scale)
+void fillUniform(Philox &gen, double *out, size_t n, double scale = 1.0);
+// uniform in [0, max) without modulo bias, max must be positive
+void fillInts(Philox &gen, int64_t *out, size_t n, int64_t max);
+void fillNormal(Philox &gen, double *out, size_t n, double mean = 0.0, double stddev = 1.0);
+void fillExponential(Philox &gen, double *out, size_t n, double rate = 1.0);
+
+// Draws indices with probabilities proportional to weights, Walker's alias method: O(1) per draw
+class WeightedChoice {
+public:
+  // Negative weights count as zero, throws if every weight is zero
+  void build(const double *weights, size_t n);
+  size_t size() const { return _alias.size(); }
+  void fill(Philox &gen, int64_t *out, size_t n) const;
+
+private:
+  std::vector<double> _probability;
+  std::vector<uint32_t> _alias;
+};
+} // namespace Random
+} // namespace shards
+
+#endif // SH_CORE_SHARDS_RANDOM
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2022 Fragcolor Pte. Ltd. */
+
+#ifndef SH_CORE_SHARDS_REACTOR
+#define SH_CORE_SHARDS_REACTOR
+
+#include "shared.hpp"
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <csignal>
+#include <thread>
+
+namespace shards {
+// One io_context drives the asynchronous I/O of the WebSocket and Process shards, it runs on its own thread
+// so wires never block on a socket or a child, they park until the reactor signals them.
+// Sockets and pipes are only ever touched from the reactor thread, wires talk to them through posted handlers.
+struct Reactor {
+  boost::asio::io_context ioCtx{1};
+
+  static Reactor &get() {
+    // leaked on purpose, sockets might still be closing and children exiting while statics are destroyed
+    static Reactor *reactor = new Reactor();
+    return *reactor;
+  }
+
+private:
+  Reactor() : _work(boost::asio::make_work_guard(ioCtx)) {
+#ifndef _WIN32
+    // writing to a closed socket or to the stdin of a child that exited must fail with EPIPE, not kill us
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    std::thread([this]() {
+      while (true) {
+        try {
+          ioCtx.run();
+          break;
+        } catch (const std::exception &ex) {
+          SHLOG_ERROR("Reactor handler failed: {}", ex.what());
+        }
+      }
+    }).detach();
+  }
+
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type> _work;
+};
+} // namespace shards
+
+#endif // SH_CORE_SHARDS_REACTOR
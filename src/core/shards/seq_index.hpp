@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2019 Fragcolor Pte. Ltd. */
+
+#ifndef SH_CORE_SHARDS_SEQ_INDEX
+#define SH_CORE_SHARDS_SEQ_INDEX
+
+#include "shards.h"
+#include "ops.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace shards {
+// Opt-in hash indexing of sequence variables
+// Shards that want to index a variable track it here, this marks the variable with SHVAR_FLAGS_INDEXED.
+// Shards that mutate sequences in place call invalidateSeqIndex, which only costs a flag test on untracked variables
+// and bumps the variable's generation otherwise. Plain appends don't need to invalidate, indices pick up new items
+// incrementally.
+struct SeqIndexRegistry {
+  using Generation = std::atomic<uint64_t>;
+
+  // Starts (or resumes) tracking var, the returned generation stays valid as long as it's held
+  static std::shared_ptr<Generation> track(SHVar &var) {
+    std::scoped_lock lock(_mutex);
+    auto &entry = _entries[&var];
+    auto generation = entry.lock();
+    if (generation) {
+      // we might have missed mutations while the flag was lost (e.g. the variable was overwritten)
+      generation->fetch_add(1, std::memory_order_release);
+    } else {
+      generation = std::make_shared<Generation>(0);
+      entry = generation;
+    }
+    var.flags |= SHVAR_FLAGS_INDEXED;
+    return generation;
+  }
+
+  static void touch(SHVar &var) {
+    std::scoped_lock lock(_mutex);
+    auto it = _entries.find(&var);
+    if (it != _entries.end()) {
+      if (auto generation = it->second.lock()) {
+        generation->fetch_add(1, std::memory_order_release);
+        return;
+      }
+      _entries.erase(it);
+    }
+    // nobody is indexing this variable anymore
+    var.flags &= ~SHVAR_FLAGS_INDEXED;
+  }
+
+private:
+  static inline std::mutex _mutex;
+  static inline std::unordered_map<const SHVar *, std::weak_ptr<Generation>> _entries;
+};
+
+// Call before mutating a sequence variable in ways other than appending to it
+inline void invalidateSeqIndex(SHVar &var) {
+  if (unlikely((var.flags & SHVAR_FLAGS_INDEXED) != 0))
+    SeqIndexRegistry::touch(var);
+}
+
+// Hash index over a run of keys (the items of a sequence or keys computed from them)
+// Lookups verify candidates with operator==, so hash collisions only cost a comparison.
+// Items sharing a hash are chained in ascending index order.
+class SeqIndex {
+public:
+  static constexpr uint32_t End = UINT32_MAX;
+
+  // Brings the index in sync with keys[0, len), only the new tail is hashed when generation did not change
+  void sync(const SHVar *keys, size_t len, uint64_t generation) {
+    if (generation != _generation || len < _len) {
+      clear();
+      _generation = generation;
+    }
+    if (len == _len)
+      return;
+
+    _next.resize(len);
+    for (size_t i = _len; i < len; i++) {
+      const auto h = hashOf(keys[i]);
+      auto [it, inserted] = _buckets.try_emplace(h, Bucket{uint32_t(i), uint32_t(i)});
+      if (!inserted) {
+        _next[it->second.last] = uint32_t(i);
+        it->second.last = uint32_t(i);
+      }
+      _next[i] = End;
+    }
+    _len = len;
+  }
+
+  void clear() {
+    _buckets.clear();
+    _next.clear();
+    _len = 0;
+  }
+
+  size_t size() const { return _len; }
+
+  // Returns the first index of key, -1 if not found
+  int64_t find(const SHVar *keys, const SHVar &key) const {
+    int64_t result = -1;
+    forEach(keys, key, [&](uint32_t index) {
+      result = int64_t(index);
+      return false;
+    });
+    return result;
+  }
+
+  // Calls fn(index) for every index of key in ascending order, until fn returns false
+  template <typename F> void forEach(const SHVar *keys, const SHVar &key, F fn) const {
+    auto it = _buckets.find(hashOf(key));
+    if (it == _buckets.end())
+      return;
+    for (auto i = it->second.first; i != End; i = _next[i]) {
+      if (keys[i] == key && !fn(i))
+        return;
+    }
+  }
+
+  static uint64_t hashOf(const SHVar &key) { return uint64_t(hash(key).payload.int2Value[0]); }
+
+private:
+  struct Bucket {
+    uint32_t first;
+    uint32_t last;
+  };
+
+  std::unordered_map<uint64_t, Bucket> _buckets;
+  std::vector<uint32_t> _next;
+  size_t _len{0};
+  uint64_t _generation{0};
+};
+} // namespace shards
+
+#endif // SH_CORE_SHARDS_SEQ_INDEX
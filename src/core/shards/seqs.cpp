@@ -2,6 +2,7 @@
 /* Copyright © 2019 Fragcolor Pte. Ltd. */
 
 #include "shared.hpp"
+#include "seq_index.hpp"
 #include <unordered_set>
 
 namespace shards {
@@ -280,8 +281,403 @@ struct IndexOf {
   }
 };
 
+// A sequence parameter that can be indexed, variables are tracked so that in place mutations invalidate the index
+struct IndexedSeqParam {
+  ParamVar param{};
+
+  void warmup(SHContext *context) {
+    param.warmup(context);
+    if (param.isVariable())
+      _generation = SeqIndexRegistry::track(param.get());
+  }
+
+  void cleanup() {
+    _generation.reset();
+    param.cleanup();
+  }
+
+  const SHSeq &get() {
+    auto &var = param.get();
+    if (var.valueType != Seq)
+      throw ActivationError("Expected a sequence.");
+    return var.payload.seqValue;
+  }
+
+  // Current generation of the sequence, constants never change
+  uint64_t generation() {
+    if (!_generation)
+      return 0;
+    auto &var = param.get();
+    if (unlikely((var.flags & SHVAR_FLAGS_INDEXED) == 0)) {
+      // the variable was overwritten by something that dropped our flag
+      _generation = SeqIndexRegistry::track(var);
+    }
+    return _generation->load(std::memory_order_acquire);
+  }
+
+private:
+  std::shared_ptr<SeqIndexRegistry::Generation> _generation;
+};
+
+// Resets var to a sequence of len items, recycling its previous items
+inline SHSeq &resetSeq(SHVar &var, uint32_t len) {
+  if (var.valueType != Seq) {
+    destroyVar(var);
+    var.valueType = Seq;
+  }
+  arrayResize(var.payload.seqValue, len);
+  return var.payload.seqValue;
+}
+
+inline void pushClone(SHSeq &seq, const SHVar &item) {
+  const auto len = seq.len;
+  arrayResize(seq, len + 1);
+  cloneVar(seq.elements[len], item);
+}
+
+struct IndexedLookupBase {
+  IndexedSeqParam _seq{};
+  SeqIndex _index;
+
+  static inline Types SeqTypes{{CoreInfo::AnySeqType, CoreInfo::AnyVarSeqType}};
+
+  void warmup(SHContext *context) { _seq.warmup(context); }
+
+  void cleanup() {
+    _index.clear();
+    _seq.cleanup();
+  }
+
+  const SHSeq &sync() {
+    auto &seq = _seq.get();
+    _index.sync(seq.elements, seq.len, _seq.generation());
+    return seq;
+  }
+};
+
+struct IsIn : public IndexedLookupBase {
+  static SHOptionalString help() {
+    return SHCCSTR("Checks if the input is an item of the sequence. The sequence is hash indexed, the index is updated "
+                   "incrementally as items are pushed.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHOptionalString inputHelp() { return SHCCSTR("The item to look for."); }
+
+  static SHTypesInfo outputTypes() { return CoreInfo::BoolType; }
+  static SHOptionalString outputHelp() { return SHCCSTR("True if the item is in the sequence."); }
+
+  static inline Parameters params{{"Sequence", SHCCSTR("The sequence to look into."), SeqTypes}};
+  static SHParametersInfo parameters() { return params; }
+
+  void setParam(int index, const SHVar &value) { _seq.param = value; }
+  SHVar getParam(int index) { return _seq.param; }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    auto &seq = sync();
+    return Var(_index.find(seq.elements, input) != -1);
+  }
+};
+
+struct IndexIn : public IndexedLookupBase {
+  SHSeq _results{};
+  bool _all = false;
+
+  static SHOptionalString help() {
+    return SHCCSTR("Finds the index of the input in the sequence. The sequence is hash indexed, the index is updated "
+                   "incrementally as items are pushed.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHOptionalString inputHelp() { return SHCCSTR("The item to look for."); }
+
+  SHTypesInfo outputTypes() {
+    if (_all)
+      return CoreInfo::IntSeqType;
+    else
+      return CoreInfo::IntType;
+  }
+  static SHOptionalString outputHelp() {
+    return SHCCSTR("The first index of the item, -1 if not found. A sequence with all the indices when All is true.");
+  }
+
+  static inline Parameters params{
+      {"Sequence", SHCCSTR("The sequence to look into."), SeqTypes},
+      {"All", SHCCSTR("If true will return a sequence with all the indices of the input."), {CoreInfo::BoolType}}};
+  static SHParametersInfo parameters() { return params; }
+
+  void setParam(int index, const SHVar &value) {
+    if (index == 0)
+      _seq.param = value;
+    else
+      _all = value.payload.boolValue;
+  }
+
+  SHVar getParam(int index) {
+    if (index == 0)
+      return _seq.param;
+    else
+      return Var(_all);
+  }
+
+  void destroy() {
+    if (_results.elements) {
+      shards::arrayFree(_results);
+    }
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    auto &seq = sync();
+    if (!_all)
+      return Var(_index.find(seq.elements, input));
+
+    shards::arrayResize(_results, 0);
+    _index.forEach(seq.elements, input, [&](uint32_t index) {
+      shards::arrayPush(_results, Var(int64_t(index)));
+      return true;
+    });
+    return Var(_results);
+  }
+};
+
+struct Distinct {
+  SHVar _output{};
+  SeqIndex _index;
+
+  static SHOptionalString help() { return SHCCSTR("Removes the duplicates of a sequence, keeping the first occurrences."); }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnySeqType; }
+  static SHOptionalString inputHelp() { return SHCCSTR("The sequence to deduplicate."); }
+
+  static SHTypesInfo outputTypes() { return CoreInfo::AnySeqType; }
+  static SHOptionalString outputHelp() { return SHCCSTR("The sequence without duplicates, in order."); }
+
+  SHTypeInfo compose(const SHInstanceData &data) { return data.inputType; }
+
+  void destroy() { destroyVar(_output); }
+
+  void cleanup() { _index.clear(); }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    auto &seq = input.payload.seqValue;
+    _index.clear();
+    _index.sync(seq.elements, seq.len, 0);
+
+    auto &out = resetSeq(_output, 0);
+    for (uint32_t i = 0; i < seq.len; i++) {
+      if (_index.find(seq.elements, seq.elements[i]) == int64_t(i))
+        pushClone(out, seq.elements[i]);
+    }
+    return _output;
+  }
+};
+
+// Base of the shards computing keys out of the items of a sequence
+struct KeyedSeqBase {
+  ShardsVar _key{};
+  std::vector<OwnedVar> _keys;
+
+  void composeKey(const SHInstanceData &data) {
+    if (!_key)
+      return;
+    SHInstanceData dataCopy = data;
+    dataCopy.inputType = data.inputType.seqTypes.len == 1 ? data.inputType.seqTypes.elements[0] : SHTypeInfo(CoreInfo::AnyType);
+    _key.compose(dataCopy);
+  }
+
+  void warmup(SHContext *context) { _key.warmup(context); }
+
+  void cleanup() {
+    _keys.clear();
+    _key.cleanup();
+  }
+
+  // Appends the keys of seq[from, len) to _keys
+  void computeKeys(SHContext *context, const SHSeq &seq, size_t from) {
+    SHVar output{};
+    for (size_t i = from; i < seq.len; i++) {
+      _key.activate(context, seq.elements[i], output);
+      _keys.emplace_back(output);
+    }
+  }
+
+  // Returns the keys of the whole seq, which is the seq itself without key shards
+  const SHVar *keysOf(SHContext *context, const SHSeq &seq) {
+    if (!_key)
+      return seq.elements;
+    _keys.clear();
+    computeKeys(context, seq, 0);
+    return _keys.data();
+  }
+};
+
+struct GroupBy : public KeyedSeqBase {
+  SHVar _output{};
+  SeqIndex _index;
+  std::vector<uint32_t> _groupOf;
+
+  static SHOptionalString help() {
+    return SHCCSTR("Groups the items of a sequence by key. Outputs a sequence of [key [items]] pairs, in order of first "
+                   "occurrence of each key.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnySeqType; }
+  static SHOptionalString inputHelp() { return SHCCSTR("The sequence to group."); }
+
+  static SHTypesInfo outputTypes() { return CoreInfo::AnySeqType; }
+  static SHOptionalString outputHelp() { return SHCCSTR("The sequence of groups."); }
+
+  static inline Parameters params{
+      {"Key",
+       SHCCSTR("The shards to use to compute the key of each item. Can be None, in which case items are grouped by value."),
+       {CoreInfo::ShardsOrNone}}};
+  static SHParametersInfo parameters() { return params; }
+
+  void setParam(int index, const SHVar &value) { _key = value; }
+  SHVar getParam(int index) { return _key; }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    composeKey(data);
+    return CoreInfo::AnySeqType;
+  }
+
+  void destroy() { destroyVar(_output); }
+
+  void cleanup() {
+    _index.clear();
+    KeyedSeqBase::cleanup();
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    auto &seq = input.payload.seqValue;
+    const auto keys = keysOf(context, seq);
+    _index.clear();
+    _index.sync(keys, seq.len, 0);
+    _groupOf.resize(seq.len);
+
+    auto &groups = resetSeq(_output, 0);
+    for (uint32_t i = 0; i < seq.len; i++) {
+      const auto first = uint32_t(_index.find(keys, keys[i]));
+      if (first == i) {
+        _groupOf[i] = groups.len;
+        arrayResize(groups, groups.len + 1);
+        auto &group = resetSeq(groups.elements[groups.len - 1], 2);
+        cloneVar(group.elements[0], keys[i]);
+        resetSeq(group.elements[1], 0);
+      } else {
+        _groupOf[i] = _groupOf[first];
+      }
+      auto &group = groups.elements[_groupOf[i]].payload.seqValue;
+      pushClone(group.elements[1].payload.seqValue, seq.elements[i]);
+    }
+    return _output;
+  }
+};
+
+struct Join : public KeyedSeqBase {
+  SHVar _output{};
+  IndexedSeqParam _with{};
+  SeqIndex _index;
+  uint64_t _keysGeneration{0};
+
+  static SHOptionalString help() {
+    return SHCCSTR("Inner joins the input sequence with another sequence by key. The other sequence is hash indexed, the "
+                   "index is updated incrementally as items are pushed.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnySeqType; }
+  static SHOptionalString inputHelp() { return SHCCSTR("The left side sequence of the join."); }
+
+  static SHTypesInfo outputTypes() { return CoreInfo::AnySeqType; }
+  static SHOptionalString outputHelp() {
+    return SHCCSTR("A sequence of [left right] pairs, one for each pair of items with equal keys, in order of the left "
+                   "side first and the right side then.");
+  }
+
+  static inline Parameters params{
+      {"With", SHCCSTR("The right side sequence of the join."), IndexedLookupBase::SeqTypes},
+      {"Key",
+       SHCCSTR("The shards to use to compute the key of the items of both sides. Can be None, in which case items are "
+               "matched by value."),
+       {CoreInfo::ShardsOrNone}}};
+  static SHParametersInfo parameters() { return params; }
+
+  void setParam(int index, const SHVar &value) {
+    if (index == 0)
+      _with.param = value;
+    else
+      _key = value;
+  }
+
+  SHVar getParam(int index) {
+    if (index == 0)
+      return _with.param;
+    else
+      return _key;
+  }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    composeKey(data);
+    return CoreInfo::AnySeqType;
+  }
+
+  void destroy() { destroyVar(_output); }
+
+  void warmup(SHContext *context) {
+    _with.warmup(context);
+    KeyedSeqBase::warmup(context);
+  }
+
+  void cleanup() {
+    _index.clear();
+    KeyedSeqBase::cleanup();
+    _with.cleanup();
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    auto &right = _with.get();
+    const auto generation = _with.generation();
+
+    // right side keys are kept in sync like the index
+    const SHVar *rightKeys = right.elements;
+    if (_key) {
+      if (generation != _keysGeneration || right.len < _keys.size()) {
+        _keys.clear();
+        _keysGeneration = generation;
+      }
+      computeKeys(context, right, _keys.size());
+      rightKeys = _keys.data();
+    }
+    _index.sync(rightKeys, right.len, generation);
+
+    auto &left = input.payload.seqValue;
+    auto &pairs = resetSeq(_output, 0);
+    SHVar key{};
+    for (uint32_t i = 0; i < left.len; i++) {
+      if (_key)
+        _key.activate(context, left.elements[i], key);
+      else
+        key = left.elements[i];
+
+      _index.forEach(rightKeys, key, [&](uint32_t index) {
+        arrayResize(pairs, pairs.len + 1);
+        auto &pair = resetSeq(pairs.elements[pairs.len - 1], 2);
+        cloneVar(pair.elements[0], left.elements[i]);
+        cloneVar(pair.elements[1], right.elements[index]);
+        return true;
+      });
+    }
+    return _output;
+  }
+};
+
 void registerSeqsShards() {
   REGISTER_SHARD("Flatten", Flatten);
   REGISTER_SHARD("IndexOf", IndexOf);
+  REGISTER_SHARD("IsIn", IsIn);
+  REGISTER_SHARD("IndexIn", IndexIn);
+  REGISTER_SHARD("Distinct", Distinct);
+  REGISTER_SHARD("GroupBy", GroupBy);
+  REGISTER_SHARD("Join", Join);
 }
 }; // namespace shards
@@ -5,6 +5,7 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 
 #include "shared.hpp"
+#include "compression.hpp"
 #include <boost/filesystem.hpp>
 #include <fstream>
 #include <future>
@@ -198,11 +199,27 @@ struct ReadFile : public FileBase {
 struct ToBytes {
   static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
   static SHTypesInfo outputTypes() { return CoreInfo::BytesType; }
+  static SHParametersInfo parameters() { return compression::Compressor::params; }
 
   Serialization serial;
   std::vector<uint8_t> _buffer;
+  compression::Compressor _compressor;
 
-  void cleanup() { _buffer.clear(); }
+  void setParam(int index, const SHVar &value) { _compressor.setParam(index, value); }
+
+  SHVar getParam(int index) { return _compressor.getParam(index); }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    _compressor.compose();
+    return CoreInfo::BytesType;
+  }
+
+  void warmup(SHContext *context) { _compressor.warmup(context); }
+
+  void cleanup() {
+    _buffer.clear();
+    _compressor.cleanup();
+  }
 
   struct Writer {
     std::vector<uint8_t> &_buffer;
@@ -215,6 +232,9 @@ struct ToBytes {
     _buffer.clear();
     serial.reset();
     serial.serialize(input, s);
+    // FromBytes detects compressed frames
+    if (_compressor.enabled())
+      return _compressor.compress(context, _buffer.data(), _buffer.size());
     return Var(&_buffer.front(), _buffer.size());
   }
 };
@@ -223,8 +243,25 @@ struct FromBytes {
   static SHTypesInfo inputTypes() { return CoreInfo::BytesType; }
   static SHTypesInfo outputTypes() { return CoreInfo::AnyType; }
 
+  static inline Parameters params{
+      {"Dictionary",
+       SHCCSTR("The dictionary the bytes were compressed with, only needed when it was not used yet by this process."),
+       {CoreInfo::NoneType, CoreInfo::BytesType, CoreInfo::BytesVarType}}};
+
+  static SHParametersInfo parameters() { return params; }
+
   Serialization serial;
   SHVar _output{};
+  ParamVar _dictionary{};
+  compression::Frames _frames;
+
+  void setParam(int index, const SHVar &value) { _dictionary = value; }
+
+  SHVar getParam(int index) { return _dictionary; }
+
+  void warmup(SHContext *context) { _dictionary.warmup(context); }
+
+  void cleanup() { _dictionary.cleanup(); }
 
   void destroy() { Serialization::varFree(_output); }
 
@@ -243,6 +280,19 @@ struct FromBytes {
   };
 
   SHVar activate(SHContext *context, const SHVar &input) {
+    if (compression::Frames::isFrame(input.payload.bytesValue, input.payload.bytesSize)) {
+      auto &dictionary = _dictionary.get();
+      if (dictionary.valueType == SHType::Bytes)
+        _frames.setDictionary(dictionary.payload.bytesValue, dictionary.payload.bytesSize);
+
+      auto &bytes = _frames.decompress(context, input.payload.bytesValue, input.payload.bytesSize);
+      Var decompressed((uint8_t *)bytes.data(), uint32_t(bytes.size()));
+      Reader r(decompressed);
+      serial.reset();
+      serial.deserialize(r, _output);
+      return _output;
+    }
+
     Reader r(input);
     serial.reset();
     serial.deserialize(r, _output);
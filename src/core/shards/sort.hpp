@@ -0,0 +1,222 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2019 Fragcolor Pte. Ltd. */
+
+#ifndef SH_CORE_SHARDS_SORT
+#define SH_CORE_SHARDS_SORT
+
+#include "../runtime.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace shards {
+// Stable sort engine for sequences of vars
+// Keys are computed once by the caller, this only produces the sorted order:
+// - homogeneous Int/Float/String keys go through an LSD radix sort (strings are radix sorted on their first 8 bytes,
+//   ties are then resolved with a full comparison)
+// - anything else uses a stable merge sort on the cached keys
+// - in parallel mode chunks are sorted on the SharedThreadPool and merged pairwise
+struct SeqSorter {
+  static constexpr size_t RadixThreshold = 64;
+  static constexpr size_t MinParallelChunk = 1 << 14;
+
+  // the resulting order, order[i] is the index of the key that goes to position i
+  std::vector<uint32_t> order;
+
+  void sort(const SHVar *keys, size_t len, bool desc, bool parallel) {
+    order.resize(len);
+    if (len < 2) {
+      if (len == 1)
+        order[0] = 0;
+      return;
+    }
+
+    const auto kind = radixKind(keys, len);
+    if (kind != SHType::None && len >= RadixThreshold) {
+      radixSortKeys(kind, keys, len, desc, parallel);
+    } else {
+      for (size_t i = 0; i < len; i++)
+        order[i] = uint32_t(i);
+      if (desc) {
+        mergeSort(order, _orderTmp, parallel, [keys](uint32_t a, uint32_t b) { return keys[b] < keys[a]; });
+      } else {
+        mergeSort(order, _orderTmp, parallel, [keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+      }
+    }
+  }
+
+  // Moves the elements of seq following order, seq must have the same length as the sorted keys
+  void apply(SHSeq &seq) {
+    const auto len = order.size();
+    shassert(seq.len == len);
+    _scratch.resize(len);
+    for (size_t i = 0; i < len; i++) {
+      _scratch[i] = seq.elements[order[i]];
+    }
+    // shallow moves, ownership of the payloads does not change
+    memcpy((void *)seq.elements, (const void *)_scratch.data(), len * sizeof(SHVar));
+  }
+
+private:
+  struct RadixItem {
+    uint64_t key;
+    uint32_t index;
+  };
+
+  std::vector<RadixItem> _radix;
+  std::vector<RadixItem> _radixTmp;
+  std::vector<uint32_t> _orderTmp;
+  std::vector<SHVar> _scratch;
+
+  static SHType radixKind(const SHVar *keys, size_t len) {
+    const auto type = keys[0].valueType;
+    if (type != SHType::Int && type != SHType::Float && type != SHType::String)
+      return SHType::None;
+    for (size_t i = 1; i < len; i++) {
+      if (keys[i].valueType != type)
+        return SHType::None;
+    }
+    return type;
+  }
+
+  static std::string_view stringOf(const SHVar &v) {
+    return v.payload.stringLen > 0 ? std::string_view(v.payload.stringValue, v.payload.stringLen)
+                                   : std::string_view(v.payload.stringValue);
+  }
+
+  // Maps keys to unsigned integers with the same ordering
+  static uint64_t radixKey(SHType kind, const SHVar &v) {
+    switch (kind) {
+    case SHType::Int:
+      return uint64_t(v.payload.intValue) ^ (uint64_t(1) << 63);
+    case SHType::Float: {
+      // -0.0 and 0.0 compare equal, keep them together
+      const double f = v.payload.floatValue == 0.0 ? 0.0 : v.payload.floatValue;
+      uint64_t bits;
+      memcpy(&bits, &f, sizeof(bits));
+      return (bits & (uint64_t(1) << 63)) ? ~bits : bits | (uint64_t(1) << 63);
+    }
+    default: {
+      // big endian prefix
+      const auto str = stringOf(v);
+      uint64_t key = 0;
+      const auto n = std::min(str.size(), size_t(8));
+      for (size_t i = 0; i < n; i++)
+        key |= uint64_t(uint8_t(str[i])) << (56 - 8 * i);
+      return key;
+    }
+    }
+  }
+
+  static void radixSort(RadixItem *begin, RadixItem *end, RadixItem *tmp) {
+    const size_t n = size_t(end - begin);
+    if (n < 2)
+      return;
+
+    // all the histograms in one pass
+    size_t counts[8][256]{};
+    for (auto it = begin; it != end; ++it) {
+      for (size_t b = 0; b < 8; b++)
+        counts[b][(it->key >> (8 * b)) & 0xFF]++;
+    }
+
+    RadixItem *src = begin;
+    RadixItem *dst = tmp;
+    for (size_t b = 0; b < 8; b++) {
+      auto &count = counts[b];
+      const auto shift = 8 * b;
+      // skip digits shared by all the keys
+      if (count[(begin->key >> shift) & 0xFF] == n)
+        continue;
+
+      size_t offset = 0;
+      for (size_t d = 0; d < 256; d++) {
+        const auto c = count[d];
+        count[d] = offset;
+        offset += c;
+      }
+      for (auto it = src; it != src + n; ++it) {
+        dst[count[(it->key >> shift) & 0xFF]++] = *it;
+      }
+      std::swap(src, dst);
+    }
+
+    if (src != begin)
+      std::copy(src, src + n, begin);
+  }
+
+  void radixSortKeys(SHType kind, const SHVar *keys, size_t len, bool desc, bool parallel) {
+    _radix.resize(len);
+    for (size_t i = 0; i < len; i++) {
+      const auto key = radixKey(kind, keys[i]);
+      _radix[i] = RadixItem{desc ? ~key : key, uint32_t(i)};
+    }
+
+    sortChunks(
+        _radix, _radixTmp, parallel, [](RadixItem *begin, RadixItem *end, RadixItem *tmp) { radixSort(begin, end, tmp); },
+        [](const RadixItem &a, const RadixItem &b) { return a.key < b.key; });
+
+    for (size_t i = 0; i < len; i++)
+      order[i] = _radix[i].index;
+
+    if (kind == SHType::String) {
+      // resolve runs sharing the same prefix
+      size_t start = 0;
+      for (size_t i = 1; i <= len; i++) {
+        if (i == len || _radix[i].key != _radix[start].key) {
+          if (i - start > 1) {
+            if (desc) {
+              std::stable_sort(order.begin() + start, order.begin() + i,
+                               [keys](uint32_t a, uint32_t b) { return stringOf(keys[b]) < stringOf(keys[a]); });
+            } else {
+              std::stable_sort(order.begin() + start, order.begin() + i,
+                               [keys](uint32_t a, uint32_t b) { return stringOf(keys[a]) < stringOf(keys[b]); });
+            }
+          }
+          start = i;
+        }
+      }
+    }
+  }
+
+  template <typename Less> void mergeSort(std::vector<uint32_t> &v, std::vector<uint32_t> &tmp, bool parallel, Less less) {
+    sortChunks(
+        v, tmp, parallel, [&](uint32_t *begin, uint32_t *end, uint32_t *) { std::stable_sort(begin, end, less); }, less);
+  }
+
+  template <typename T, typename SortChunk, typename Less>
+  void sortChunks(std::vector<T> &v, std::vector<T> &tmp, bool parallel, SortChunk sortChunk, Less less) {
+    const size_t n = v.size();
+    tmp.resize(n);
+
+    const size_t maxChunks = size_t(SharedThreadPoolConcurrency::get());
+    const size_t chunks = parallel ? std::min(maxChunks, n / MinParallelChunk) : 1;
+    if (chunks < 2) {
+      sortChunk(v.data(), v.data() + n, tmp.data());
+      return;
+    }
+
+    const size_t chunkSize = (n + chunks - 1) / chunks;
+    parallelFor(chunks, [&](size_t i) {
+      const auto begin = std::min(n, i * chunkSize);
+      const auto end = std::min(n, begin + chunkSize);
+      sortChunk(v.data() + begin, v.data() + end, tmp.data() + begin);
+    });
+
+    // stable pairwise merges, left run wins on ties
+    for (size_t width = chunkSize; width < n; width *= 2) {
+      const size_t pairs = (n + 2 * width - 1) / (2 * width);
+      parallelFor(pairs, [&](size_t p) {
+        const auto begin = p * 2 * width;
+        const auto mid = std::min(n, begin + width);
+        const auto end = std::min(n, begin + 2 * width);
+        std::merge(v.data() + begin, v.data() + mid, v.data() + mid, v.data() + end, tmp.data() + begin, less);
+      });
+      std::swap(v, tmp);
+    }
+  }
+};
+} // namespace shards
+
+#endif // SH_CORE_SHARDS_SORT
@@ -3,16 +3,112 @@
 
 #include "../../../deps/utf8.h/utf8.h"
 #include "shared.hpp"
-#include <regex>
+#include <memory>
+
+#ifndef PCRE2_CODE_UNIT_WIDTH
+#define PCRE2_CODE_UNIT_WIDTH 8
+#endif
+#include <pcre2.h>
 
 namespace shards {
 namespace Regex {
+// A pattern compiled once by PCRE2, then JIT compiled where the platform supports it (the interpreter runs it
+// otherwise). Matching runs directly over the input string buffer, with ECMAScript like semantics: $ only matches at
+// the very end of the subject.
+class Pattern {
+public:
+  void compile(std::string_view pattern, uint32_t options = 0) {
+    int error;
+    PCRE2_SIZE offset;
+    auto code = pcre2_compile((PCRE2_SPTR)pattern.data(), pattern.size(), options | PCRE2_DOLLAR_ENDONLY, &error, &offset,
+                              nullptr);
+    if (!code) {
+      PCRE2_UCHAR message[256];
+      pcre2_get_error_message(error, message, sizeof(message));
+      throw SHException(fmt::format("Invalid regex \"{}\" at {}: {}", pattern, offset, (const char *)message));
+    }
+    _code.reset(code);
+    // failing just means no JIT on this platform
+    pcre2_jit_compile(code, PCRE2_JIT_COMPLETE);
+    _data.reset(pcre2_match_data_create_from_pattern(code, nullptr));
+    pcre2_pattern_info(code, PCRE2_INFO_CAPTURECOUNT, &_captures);
+    pcre2_pattern_info(code, PCRE2_INFO_BACKREFMAX, &_backrefs);
+  }
+
+  explicit operator bool() const { return bool(_code); }
+
+  // Capture groups, not counting the whole match
+  uint32_t captures() const { return _captures; }
+  // Highest group number a backreference refers to, 0 if none
+  uint32_t backrefs() const { return _backrefs; }
+
+  // Searches from offset, false if nothing matches
+  bool match(const char *subject, size_t len, size_t offset, uint32_t options = 0) {
+    if (!_code)
+      throw ActivationError("Regex not set");
+    auto rc = pcre2_match(_code.get(), (PCRE2_SPTR)subject, len, offset, options, _data.get(), nullptr);
+    if (rc == PCRE2_ERROR_NOMATCH)
+      return false;
+    if (rc < 0) {
+      PCRE2_UCHAR message[256];
+      pcre2_get_error_message(rc, message, sizeof(message));
+      throw ActivationError(fmt::format("Regex matching failed: {}", (const char *)message));
+    }
+    return true;
+  }
+
+  // Calls fn(ovector) for each non overlapping match, like a global search: an empty match is retried at the same
+  // position as a non empty one before moving on
+  template <typename F> void forEach(const char *subject, size_t len, F &&fn) {
+    size_t offset = 0;
+    uint32_t options = 0;
+    while (offset <= len) {
+      if (!match(subject, len, offset, options)) {
+        if (options == 0)
+          break;
+        // no non empty match here, step over one char
+        options = 0;
+        offset++;
+        continue;
+      }
+      const auto ovector = groups();
+      fn(ovector);
+      offset = ovector[1];
+      options = ovector[0] == ovector[1] ? PCRE2_NOTEMPTY_ATSTART | PCRE2_ANCHORED : 0;
+    }
+  }
+
+  // Start and end offsets of the whole match then of each capture group, PCRE2_UNSET for the unset ones
+  const PCRE2_SIZE *groups() const { return pcre2_get_ovector_pointer(_data.get()); }
+
+private:
+  struct CodeDeleter {
+    void operator()(pcre2_code *code) const { pcre2_code_free(code); }
+  };
+  struct DataDeleter {
+    void operator()(pcre2_match_data *data) const { pcre2_match_data_free(data); }
+  };
+
+  std::unique_ptr<pcre2_code, CodeDeleter> _code;
+  std::unique_ptr<pcre2_match_data, DataDeleter> _data;
+  uint32_t _captures{0};
+  uint32_t _backrefs{0};
+};
+
+inline std::string_view group(const char *subject, const PCRE2_SIZE *ovector, size_t index) {
+  const auto start = ovector[index * 2];
+  if (start == PCRE2_UNSET)
+    return {};
+  return std::string_view(subject + start, ovector[index * 2 + 1] - start);
+}
+
 struct Common {
   static inline Parameters params{{"Regex", SHCCSTR("The regular expression."), {CoreInfo::StringType}}};
 
-  std::regex _re;
+  Pattern _re;
   std::string _re_str;
-  std::string _subject;
+  // compile options of the pattern
+  uint32_t _options{0};
 
   static SHTypesInfo inputTypes() { return CoreInfo::StringType; }
 
@@ -22,7 +118,7 @@ struct Common {
     switch (index) {
     case 0:
       _re_str = value.payload.stringValue;
-      _re.assign(_re_str);
+      _re.compile(_re_str, _options);
       break;
     default:
       break;
@@ -43,17 +139,20 @@ struct Match : public Common {
   IterableSeq _output;
   std::vector<std::string> _pool;
 
+  // anchored at compile time rather than at match time so that the JIT still applies
+  Match() { _options = PCRE2_ANCHORED | PCRE2_ENDANCHORED; }
+
   static SHTypesInfo outputTypes() { return CoreInfo::StringSeqType; }
 
   SHVar activate(SHContext *context, const SHVar &input) {
-    std::smatch match;
-    _subject.assign(input.payload.stringValue, SHSTRLEN(input));
-    if (std::regex_match(_subject, match, _re)) {
-      auto size = match.size();
+    const auto subject = input.payload.stringValue;
+    if (_re.match(subject, SHSTRLEN(input), 0)) {
+      const auto size = size_t(_re.captures()) + 1;
+      const auto ovector = _re.groups();
       _pool.resize(size);
       _output.resize(size);
       for (size_t i = 0; i < size; i++) {
-        _pool[i].assign(match[i].str());
+        _pool[i].assign(group(subject, ovector, i));
         _output[i] = Var(_pool[i]);
       }
     } else {
@@ -71,19 +170,20 @@ struct Search : public Common {
   static SHTypesInfo outputTypes() { return CoreInfo::StringSeqType; }
 
   SHVar activate(SHContext *context, const SHVar &input) {
-    std::smatch match;
-    _subject.assign(input.payload.stringValue, SHSTRLEN(input));
-    _pool.clear();
-    _output.clear();
-    while (std::regex_search(_subject, match, _re)) {
-      auto size = match.size();
+    const auto subject = input.payload.stringValue;
+    const auto size = size_t(_re.captures()) + 1;
+    // keep the pool strings around to recycle their memory
+    size_t count = 0;
+    _re.forEach(subject, SHSTRLEN(input), [&](const PCRE2_SIZE *ovector) {
+      if (_pool.size() < count + size)
+        _pool.resize(count + size);
       for (size_t i = 0; i < size; i++) {
-        _pool.emplace_back(match[i].str());
+        _pool[count++].assign(group(subject, ovector, i));
       }
-      _subject.assign(match.suffix());
-    }
-    for (auto &s : _pool) {
-      _output.push_back(Var(s));
+    });
+    _output.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      _output[i] = Var(_pool[i]);
     }
     return Var(SHSeq(_output));
   }
@@ -91,7 +191,6 @@ struct Search : public Common {
 
 struct Replace : public Common {
   ParamVar _replacement;
-  std::string _replacementStr;
   std::string _output;
 
   static inline Parameters params{
@@ -125,14 +224,140 @@ struct Replace : public Common {
 
   void cleanup() { _replacement.cleanup(); }
 
+  // ECMAScript replacement patterns: $$, $&, $`, $' and $n or $nn for the groups
+  void format(std::string_view subject, const PCRE2_SIZE *ovector, std::string_view replacement) {
+    const auto groups = size_t(_re.captures());
+    for (size_t i = 0; i < replacement.size(); i++) {
+      const auto c = replacement[i];
+      if (c != '$' || i + 1 == replacement.size()) {
+        _output.push_back(c);
+        continue;
+      }
+
+      const auto next = replacement[i + 1];
+      if (next == '$') {
+        _output.push_back('$');
+        i++;
+      } else if (next == '&') {
+        _output.append(group(subject.data(), ovector, 0));
+        i++;
+      } else if (next == '`') {
+        _output.append(subject.substr(0, ovector[0]));
+        i++;
+      } else if (next == '\'') {
+        _output.append(subject.substr(ovector[1]));
+        i++;
+      } else if (next >= '0' && next <= '9') {
+        size_t n = size_t(next - '0');
+        size_t digits = 1;
+        // two digits if that names a group
+        if (i + 2 < replacement.size() && replacement[i + 2] >= '0' && replacement[i + 2] <= '9') {
+          const auto nn = n * 10 + size_t(replacement[i + 2] - '0');
+          if (nn >= 1 && nn <= groups) {
+            n = nn;
+            digits = 2;
+          }
+        }
+        if (n >= 1 && n <= groups) {
+          _output.append(group(subject.data(), ovector, n));
+          i += digits;
+        } else {
+          _output.push_back(c);
+        }
+      } else {
+        _output.push_back(c);
+      }
+    }
+  }
+
   SHVar activate(SHContext *context, const SHVar &input) {
-    _subject.assign(input.payload.stringValue, SHSTRLEN(input));
-    _replacementStr.assign(_replacement.get().payload.stringValue, SHSTRLEN(_replacement.get()));
-    _output.assign(std::regex_replace(_subject, _re, _replacementStr));
+    const std::string_view subject(input.payload.stringValue, SHSTRLEN(input));
+    const std::string_view replacement(_replacement.get().payload.stringValue, SHSTRLEN(_replacement.get()));
+    _output.clear();
+    size_t last = 0;
+    _re.forEach(subject.data(), subject.size(), [&](const PCRE2_SIZE *ovector) {
+      _output.append(subject.substr(last, ovector[0] - last));
+      format(subject, ovector, replacement);
+      last = ovector[1];
+    });
+    _output.append(subject.substr(last));
     return Var(_output);
   }
 };
 
+struct MatchAny {
+  static SHOptionalString help() {
+    return SHCCSTR("Searches the input string for all the given patterns in a single pass and outputs the index of the "
+                   "pattern matching at the earliest position (the first one in the list when more than one matches at the "
+                   "same position), or -1 if none matches. Patterns can't contain backreferences.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::StringType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::IntType; }
+
+  static inline Parameters params{{"Regexes", SHCCSTR("The regular expressions to test."), {CoreInfo::StringSeqType}}};
+
+  static SHParametersInfo parameters() { return params; }
+
+  void setParam(int index, const SHVar &value) {
+    _patterns = value;
+    compile();
+  }
+
+  SHVar getParam(int index) { return _patterns; }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    if (_patterns.valueType != SHType::Seq || _patterns.payload.seqValue.len == 0)
+      throw ComposeError("Regex.MatchAny requires at least one pattern");
+    return CoreInfo::IntType;
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    if (!_re.match(input.payload.stringValue, SHSTRLEN(input), 0))
+      return Var(int64_t(-1));
+
+    const auto ovector = _re.groups();
+    for (size_t i = 0; i < _groups.size(); i++) {
+      if (ovector[_groups[i] * 2] != PCRE2_UNSET)
+        return Var(int64_t(i));
+    }
+    return Var(int64_t(-1));
+  }
+
+private:
+  // Fuses all the patterns into a single alternation of capture groups
+  // and remembers which group belongs to which pattern
+  void compile() {
+    _groups.clear();
+    if (_patterns.valueType != SHType::Seq)
+      return;
+
+    std::string fused;
+    size_t group = 1;
+    for (uint32_t i = 0; i < _patterns.payload.seqValue.len; i++) {
+      auto str = SHSTRVIEW(_patterns.payload.seqValue.elements[i]);
+      // validate and count the inner groups of this pattern
+      Pattern single;
+      single.compile(str);
+      // fusing shifts the group numbers, \1 would refer to another group
+      if (single.backrefs() > 0)
+        throw SHException(fmt::format("Regex.MatchAny patterns can't contain backreferences: {}", str));
+      if (!fused.empty())
+        fused.push_back('|');
+      fused.push_back('(');
+      fused.append(str);
+      fused.push_back(')');
+      _groups.push_back(group);
+      group += 1 + single.captures();
+    }
+    _re.compile(fused);
+  }
+
+  OwnedVar _patterns{};
+  Pattern _re;
+  std::vector<size_t> _groups;
+};
+
 struct Join {
   static SHOptionalString help() {
     return SHCCSTR("Concatenates all the elements of a string sequence, using the specified separator between each element.");
@@ -309,6 +534,7 @@ void registerShards() {
   REGISTER_SHARD("Regex.Replace", Replace);
   REGISTER_SHARD("Regex.Search", Search);
   REGISTER_SHARD("Regex.Match", Match);
+  REGISTER_SHARD("Regex.MatchAny", MatchAny);
   REGISTER_SHARD("String.Join", Join);
   REGISTER_SHARD("String.ToUpper", ToUpper);
   REGISTER_SHARD("String.ToLower", ToLower);
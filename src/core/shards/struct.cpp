@@ -2,72 +2,55 @@
 /* Copyright © 2019 Fragcolor Pte. Ltd. */
 
 #include "shared.hpp"
-#include <regex>
 
 namespace shards {
-class Tokenizer {
-public:
-  Tokenizer(const std::string &input, const std::vector<std::regex> &regexes)
-      : _tag(-1), _regs(regexes), _iter(input.begin()), _end(input.end()) {
-    advance();
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool NativeBigEndian = true;
+#else
+constexpr bool NativeBigEndian = false;
+#endif
+
+template <typename T> inline T byteSwap(T value) {
+  if constexpr (sizeof(T) == 1) {
+    return value;
+  } else if constexpr (sizeof(T) == 2) {
+    uint16_t x;
+    memcpy(&x, &value, 2);
+    x = __builtin_bswap16(x);
+    memcpy(&value, &x, 2);
+    return value;
+  } else if constexpr (sizeof(T) == 4) {
+    uint32_t x;
+    memcpy(&x, &value, 4);
+    x = __builtin_bswap32(x);
+    memcpy(&value, &x, 4);
+    return value;
+  } else {
+    static_assert(sizeof(T) == 8);
+    uint64_t x;
+    memcpy(&x, &value, 8);
+    x = __builtin_bswap64(x);
+    memcpy(&value, &x, 8);
+    return value;
   }
+}
 
-  std::string token() const { return _token; }
-
-  int tag() const { return _tag; };
-
-  void next() { advance(); }
-
-  bool eof() const { return _iter == _end; }
-
-private:
-  static inline std::regex whitespacex{"[\\s,]+|;.*"};
-
-  void skipSpaces() {
-    std::smatch match;
-    auto flags = std::regex_constants::match_continuous;
-    while (std::regex_search(_iter, _end, match, whitespacex, flags)) {
-      _iter += match.str(0).size();
-    }
-  }
-
-  void advance() {
-    // skip current token, previosly required
-    _iter += _token.size();
-
-    skipSpaces();
-    if (eof()) {
-      return;
-    }
-
-    bool mismatched = true;
-    auto tag = 0;
-    for (auto &re : _regs) {
-      std::smatch match;
-      auto flags = std::regex_constants::match_continuous;
-      if (std::regex_search(_iter, _end, match, re, flags)) {
-        // matched
-        _token = match.str(0);
-        _tag = tag;
-        mismatched = false;
-        break;
-      }
-      tag++;
-    }
-
-    if (mismatched) {
-      std::string mismatch(_iter, _end);
-      throw SHException("Tokenizer mismatched, unexpected: " + mismatch);
-    }
-  }
-
-  using Iterator = std::string::const_iterator;
-
-  std::string _token;
-  int _tag;
-  const std::vector<std::regex> &_regs;
-  Iterator _iter;
-  Iterator _end;
+template <SHType SHT> struct PayloadOf {};
+template <> struct PayloadOf<SHType::Int> {
+  static auto &get(SHVar &v) { return v.payload.intValue; }
+  static auto get(const SHVar &v) { return v.payload.intValue; }
+};
+template <> struct PayloadOf<SHType::Float> {
+  static auto &get(SHVar &v) { return v.payload.floatValue; }
+  static auto get(const SHVar &v) { return v.payload.floatValue; }
+};
+template <> struct PayloadOf<SHType::Bool> {
+  static auto &get(SHVar &v) { return v.payload.boolValue; }
+  static auto get(const SHVar &v) { return v.payload.boolValue; }
+};
+template <> struct PayloadOf<SHType::String> {
+  static auto &get(SHVar &v) { return v.payload.stringValue; }
+  static auto get(const SHVar &v) { return v.payload.stringValue; }
 };
 
 // e.g i32 f32 b i8[256]
@@ -81,219 +64,369 @@ struct StructBase {
     Tags tag;
   };
 
-  static inline std::vector<std::regex> rexes{
-      std::regex("i8\\[\\d+\\]"),  // i8 array
-      std::regex("i16\\[\\d+\\]"), // i16 array
-      std::regex("i32\\[\\d+\\]"), // i32 array
-      std::regex("i64\\[\\d+\\]"), // i64 array
-      std::regex("f32\\[\\d+\\]"), // f32 array
-      std::regex("f64\\[\\d+\\]"), // f64 array
-      std::regex("i8"),            // i8
-      std::regex("i16"),           // i16
-      std::regex("i32"),           // i32
-      std::regex("i64"),           // i64
-      std::regex("f32"),           // f32
-      std::regex("f64"),           // f64
-      std::regex("b"),             // bool
-      std::regex("p"),             // pointer
-      std::regex("s"),             // string
-  };
+  // A step of the compiled plan, either a single array member
+  // or a run of contiguous scalar members of the same type
+  struct Run;
+  using PackFn = void (*)(const Run &run, const SHVar *members, uint8_t *dst);
+  using UnpackFn = void (*)(const Run &run, const uint8_t *src, SHVar *members);
 
-  static inline std::regex arrlenx{"^.*\\[(\\d+)\\]$"};
+  struct Run {
+    Tags tag;
+    size_t first;  // first member index
+    size_t count;  // number of scalar members (1 for arrays)
+    size_t arrlen; // array length
+    size_t offset; // byte offset of the first member
+    PackFn pack;
+    UnpackFn unpack;
+  };
 
-  static inline ParamsInfo params = ParamsInfo(
-      ParamsInfo::Param("Definition", SHCCSTR("A string defining the struct e.g. \"i32 f32 b i8[256]\"."), CoreInfo::StringType));
+  static inline Parameters params{
+      {"Definition", SHCCSTR("A string defining the struct e.g. \"i32 f32 b i8[256]\"."), {CoreInfo::StringType}},
+      {"Align",
+       SHCCSTR("If true members are laid out at their natural alignment (like a C struct) and the total size is padded "
+               "accordingly, otherwise members are tightly packed."),
+       {CoreInfo::BoolType}},
+      {"BigEndian", SHCCSTR("If true numeric members are stored in big endian (network) byte order."), {CoreInfo::BoolType}}};
 
-  static SHParametersInfo parameters() { return SHParametersInfo(params); }
+  static SHParametersInfo parameters() { return params; }
 
   std::string _def;
+  bool _align{false};
+  bool _bigEndian{false};
   std::vector<Desc> _members;
-  size_t _size;
+  std::vector<Run> _plan;
+  size_t _size{0};
 
   void setParam(int index, const SHVar &value) {
-    _def = value.payload.stringValue;
+    switch (index) {
+    case 0:
+      _def = value.payload.stringValue;
+      break;
+    case 1:
+      _align = value.payload.boolValue;
+      break;
+    case 2:
+      _bigEndian = value.payload.boolValue;
+      break;
+    default:
+      break;
+    }
+    compile();
+  }
 
-    // compile members
-    _members.clear();
-    _size = 0;
-    Tokenizer t(_def, rexes);
-    while (!t.eof()) {
-      auto token = t.token();
-      Desc d{};
-      d.tag = static_cast<Tags>(t.tag());
-      if (d.tag < i8) { // array
-        // must populate d.arrlen
-        // should not fail, if does throw which is ok
-        std::smatch match;
-        if (!std::regex_search(token, match, arrlenx)) {
-          throw SHException("Unexpected struct compiler failure.");
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return Var(_def);
+    case 1:
+      return Var(_align);
+    case 2:
+      return Var(_bigEndian);
+    default:
+      return Var::Empty;
+    }
+  }
+
+  static size_t elementSize(Tags tag) {
+    switch (tag) {
+    case Tags::i8Array:
+    case Tags::i8:
+    case Tags::Bool:
+      return 1;
+    case Tags::i16Array:
+    case Tags::i16:
+      return 2;
+    case Tags::i32Array:
+    case Tags::f32Array:
+    case Tags::i32:
+    case Tags::f32:
+      return 4;
+    case Tags::i64Array:
+    case Tags::f64Array:
+    case Tags::i64:
+    case Tags::f64:
+      return 8;
+    case Tags::Pointer:
+    case Tags::String:
+      return sizeof(uintptr_t);
+    }
+    return 0;
+  }
+
+  static bool isArray(Tags tag) { return tag < Tags::i8; }
+
+  // Parses the definition, tokens are matched greedily in the same order of the Tags enum
+  static std::vector<Desc> parse(std::string_view def) {
+    static constexpr std::string_view names[] = {"i8", "i16", "i32", "i64", "f32", "f64"};
+
+    std::vector<Desc> members;
+    size_t pos = 0;
+    const auto skipSpaces = [&]() {
+      while (pos < def.size()) {
+        const auto c = def[pos];
+        if (c == ';') {
+          while (pos < def.size() && def[pos] != '\n')
+            pos++;
+        } else if (c == ',' || isspace(uint8_t(c))) {
+          pos++;
+        } else {
+          break;
         }
-        d.arrlen = std::stoll(match.str(1));
       }
+    };
 
-      // store offset (using _size)
-      d.offset = _size;
+    skipSpaces();
+    while (pos < def.size()) {
+      const auto rest = def.substr(pos);
+      Desc d{};
+      bool matched = false;
+
+      // arrays
+      for (size_t i = 0; i < 6 && !matched; i++) {
+        const auto name = names[i];
+        if (rest.size() > name.size() + 2 && rest.substr(0, name.size()) == name && rest[name.size()] == '[') {
+          size_t end = name.size() + 1;
+          size_t len = 0;
+          while (end < rest.size() && isdigit(uint8_t(rest[end]))) {
+            len = len * 10 + size_t(rest[end] - '0');
+            end++;
+          }
+          if (end > name.size() + 1 && end < rest.size() && rest[end] == ']') {
+            d.tag = Tags(Tags::i8Array + i);
+            d.arrlen = len;
+            pos += end + 1;
+            matched = true;
+          }
+        }
+      }
 
-      _members.push_back(d);
+      // scalars
+      for (size_t i = 0; i < 6 && !matched; i++) {
+        if (rest.substr(0, names[i].size()) == names[i]) {
+          d.tag = Tags(Tags::i8 + i);
+          pos += names[i].size();
+          matched = true;
+        }
+      }
 
-      // compute size
-      switch (d.tag) {
-      case Tags::i8Array:
-        _size += d.arrlen;
-        break;
-      case Tags::i16Array:
-        _size += 2 * d.arrlen;
-        break;
-      case Tags::f32Array:
-      case Tags::i32Array:
-        _size += 4 * d.arrlen;
-        break;
-      case Tags::f64Array:
-      case Tags::i64Array:
-        _size += 8 * d.arrlen;
-        break;
-      case Tags::i8:
-        _size += 1;
-        break;
-      case Tags::i16:
-        _size += 2;
-        break;
-      case Tags::f32:
-      case Tags::i32:
-        _size += 4;
-        break;
-      case Tags::f64:
-      case Tags::i64:
-        _size += 8;
-        break;
-      case Tags::Bool:
-        _size += 1;
-        break;
-      case Tags::Pointer:
-        _size += sizeof(uintptr_t);
-        break;
-      case Tags::String:
-        _size += sizeof(uintptr_t);
-        break;
+      if (!matched) {
+        switch (rest[0]) {
+        case 'b':
+          d.tag = Tags::Bool;
+          break;
+        case 'p':
+          d.tag = Tags::Pointer;
+          break;
+        case 's':
+          d.tag = Tags::String;
+          break;
+        default:
+          throw SHException("Struct definition mismatched, unexpected: " + std::string(rest));
+        }
+        pos++;
       }
 
-      t.next();
+      members.push_back(d);
+      skipSpaces();
     }
+    return members;
   }
 
-  SHVar getParam(int index) { return Var(_def); }
+  template <bool Swap> static void bindKernels(Run &run);
+
+  void compile() {
+    _members = parse(_def);
+    _plan.clear();
+    _size = 0;
+
+    size_t maxAlign = 1;
+    for (size_t idx = 0; idx < _members.size(); idx++) {
+      auto &d = _members[idx];
+      const auto esize = elementSize(d.tag);
+      if (_align) {
+        _size = (_size + esize - 1) & ~(esize - 1);
+        maxAlign = std::max(maxAlign, esize);
+      }
+      d.offset = _size;
+      _size += isArray(d.tag) ? esize * d.arrlen : esize;
+
+      // merge contiguous scalars of the same type into a single run
+      if (!isArray(d.tag) && !_plan.empty()) {
+        auto &last = _plan.back();
+        if (last.tag == d.tag && last.offset + last.count * esize == d.offset) {
+          last.count++;
+          continue;
+        }
+      }
+
+      Run run{d.tag, idx, 1, d.arrlen, d.offset, nullptr, nullptr};
+      if (_bigEndian != NativeBigEndian)
+        bindKernels<true>(run);
+      else
+        bindKernels<false>(run);
+      _plan.push_back(run);
+    }
+
+    if (_align)
+      _size = (_size + maxAlign - 1) & ~(maxAlign - 1);
+  }
 };
 
-struct Pack : public StructBase {
-  std::vector<uint8_t> _storage;
+// Kernels
+// type checks are accumulated branch-free and reported after the loop to keep the loops tight
 
-  static SHTypesInfo inputTypes() { return CoreInfo::AnySeqType; }
-  static SHTypesInfo outputTypes() { return CoreInfo::BytesType; }
+template <typename T, SHType SHT, bool Swap> struct StructKernels {
+  using CT = std::remove_reference_t<decltype(PayloadOf<SHT>::get(std::declval<SHVar &>()))>;
 
-  void setParam(int index, const SHVar &value) {
-    StructBase::setParam(index, value);
+  static void store(uint8_t *dst, CT value) {
+    T x = static_cast<T>(value);
+    if constexpr (Swap)
+      x = byteSwap(x);
+    memcpy(dst, &x, sizeof(T));
+  }
+
+  static CT load(const uint8_t *src) {
+    T x;
+    memcpy(&x, src, sizeof(T));
+    if constexpr (Swap)
+      x = byteSwap(x);
+    return static_cast<CT>(x);
+  }
 
-    // prepare our backing memory
-    _storage.resize(_size);
+  static void typeError(const SHVar &value) {
+    throw ActivationError("Expected " + type2Name(SHT) + " instead was: " + type2Name(value.valueType));
   }
 
-  void ensureType(const SHVar &input, SHType wantedType) {
-    if (input.valueType != wantedType) {
-      throw ActivationError("Expected " + type2Name(wantedType) + " instead was: " + type2Name(input.valueType));
+  static void checkTypes(const SHVar *values, size_t count) {
+    bool mismatch = false;
+    for (size_t i = 0; i < count; i++) {
+      mismatch |= values[i].valueType != SHT;
+    }
+    if (unlikely(mismatch)) {
+      for (size_t i = 0; i < count; i++) {
+        if (values[i].valueType != SHT)
+          typeError(values[i]);
+      }
     }
   }
 
-  template <typename T, typename CT> void write(const CT input, size_t offset) {
-    T x = static_cast<T>(input);
-    memcpy(&_storage.front() + offset, &x, sizeof(T));
+  static void packScalars(const StructBase::Run &run, const SHVar *members, uint8_t *dst) {
+    const auto values = members + run.first;
+    checkTypes(values, run.count);
+    dst += run.offset;
+    for (size_t i = 0; i < run.count; i++) {
+      store(dst + i * sizeof(T), PayloadOf<SHT>::get(values[i]));
+    }
   }
 
-  template <typename T, SHType SHT, typename CT>
-  void writeMany(const SHSeq &input, CT SHVarPayload::*value, size_t offset, size_t len) {
-    if (len != (size_t)input.len) {
-      throw ActivationError("Expected " + std::to_string(len) + " size sequence as value");
+  static void packArray(const StructBase::Run &run, const SHVar *members, uint8_t *dst) {
+    const auto &member = members[run.first];
+    if (member.valueType != SHType::Seq) {
+      throw ActivationError("Expected Seq instead was: " + type2Name(member.valueType));
     }
+    const auto &seq = member.payload.seqValue;
+    if (seq.len != run.arrlen) {
+      throw ActivationError("Expected " + std::to_string(run.arrlen) + " size sequence as value");
+    }
+    checkTypes(seq.elements, run.arrlen);
+    dst += run.offset;
+    for (size_t i = 0; i < run.arrlen; i++) {
+      store(dst + i * sizeof(T), PayloadOf<SHT>::get(seq.elements[i]));
+    }
+  }
 
-    for (size_t i = 0; i < len; i++) {
-      auto &val = input.elements[i];
-      ensureType(val, SHT);
-      write<T, decltype(val.payload.*value)>(val.payload.*value, offset + (i * sizeof(T)));
+  static void unpackScalars(const StructBase::Run &run, const uint8_t *src, SHVar *members) {
+    src += run.offset;
+    auto values = members + run.first;
+    for (size_t i = 0; i < run.count; i++) {
+      PayloadOf<SHT>::get(values[i]) = load(src + i * sizeof(T));
     }
   }
 
+  static void unpackArray(const StructBase::Run &run, const uint8_t *src, SHVar *members) {
+    src += run.offset;
+    auto values = members[run.first].payload.seqValue.elements;
+    for (size_t i = 0; i < run.arrlen; i++) {
+      PayloadOf<SHT>::get(values[i]) = load(src + i * sizeof(T));
+    }
+  }
+
+  static void bind(StructBase::Run &run, bool array) {
+    if (array) {
+      run.pack = &packArray;
+      run.unpack = &unpackArray;
+    } else {
+      run.pack = &packScalars;
+      run.unpack = &unpackScalars;
+    }
+  }
+};
+
+template <bool Swap> void StructBase::bindKernels(Run &run) {
+  const auto array = isArray(run.tag);
+  switch (run.tag) {
+  case Tags::i8Array:
+  case Tags::i8:
+    StructKernels<int8_t, SHType::Int, Swap>::bind(run, array);
+    break;
+  case Tags::i16Array:
+  case Tags::i16:
+    StructKernels<int16_t, SHType::Int, Swap>::bind(run, array);
+    break;
+  case Tags::i32Array:
+  case Tags::i32:
+    StructKernels<int32_t, SHType::Int, Swap>::bind(run, array);
+    break;
+  case Tags::i64Array:
+  case Tags::i64:
+    StructKernels<int64_t, SHType::Int, Swap>::bind(run, array);
+    break;
+  case Tags::f32Array:
+  case Tags::f32:
+    StructKernels<float, SHType::Float, Swap>::bind(run, array);
+    break;
+  case Tags::f64Array:
+  case Tags::f64:
+    StructKernels<double, SHType::Float, Swap>::bind(run, array);
+    break;
+  case Tags::Bool:
+    StructKernels<bool, SHType::Bool, false>::bind(run, false);
+    break;
+  case Tags::Pointer:
+    // native pointers, never swapped
+    StructKernels<uintptr_t, SHType::Int, false>::bind(run, false);
+    break;
+  case Tags::String:
+    StructKernels<const char *, SHType::String, false>::bind(run, false);
+    break;
+  }
+}
+
+struct Pack : public StructBase {
+  std::vector<uint8_t> _storage;
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnySeqType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::BytesType; }
+
+  void setParam(int index, const SHVar &value) {
+    StructBase::setParam(index, value);
+
+    // prepare our backing memory, zeroed so that padding is deterministic
+    _storage.assign(_size, 0);
+  }
+
   SHVar activate(SHContext *context, const SHVar &input) {
     if (_members.size() != (size_t)input.payload.seqValue.len) {
       throw ActivationError("Expected " + std::to_string(_members.size()) + " members as input.");
     }
 
-    auto idx = 0;
-    auto &seq = input.payload.seqValue;
-    for (auto &member : _members) {
-      switch (member.tag) {
-      case Tags::i8Array:
-        ensureType(seq.elements[idx], Seq);
-        writeMany<int8_t, Int>(seq.elements[idx].payload.seqValue, &SHVarPayload::intValue, member.offset, member.arrlen);
-        break;
-      case Tags::i8:
-        ensureType(seq.elements[idx], Int);
-        write<int8_t>(seq.elements[idx].payload.intValue, member.offset);
-        break;
-      case Tags::i16Array:
-        ensureType(seq.elements[idx], Seq);
-        writeMany<int16_t, Int>(seq.elements[idx].payload.seqValue, &SHVarPayload::intValue, member.offset, member.arrlen);
-        break;
-      case Tags::i16:
-        ensureType(seq.elements[idx], Int);
-        write<int16_t>(seq.elements[idx].payload.intValue, member.offset);
-        break;
-      case Tags::i32Array:
-        ensureType(seq.elements[idx], Seq);
-        writeMany<int32_t, Int>(seq.elements[idx].payload.seqValue, &SHVarPayload::intValue, member.offset, member.arrlen);
-        break;
-      case Tags::i32:
-        ensureType(seq.elements[idx], Int);
-        write<int32_t>(seq.elements[idx].payload.intValue, member.offset);
-        break;
-      case Tags::i64Array:
-        ensureType(seq.elements[idx], Seq);
-        writeMany<int64_t, Int>(seq.elements[idx].payload.seqValue, &SHVarPayload::intValue, member.offset, member.arrlen);
-        break;
-      case Tags::i64:
-        ensureType(seq.elements[idx], Int);
-        write<int64_t>(seq.elements[idx].payload.intValue, member.offset);
-        break;
-      case Tags::f32Array:
-        ensureType(seq.elements[idx], Seq);
-        writeMany<float, Float>(seq.elements[idx].payload.seqValue, &SHVarPayload::floatValue, member.offset, member.arrlen);
-        break;
-      case Tags::f32:
-        ensureType(seq.elements[idx], Float);
-        write<float>(seq.elements[idx].payload.floatValue, member.offset);
-        break;
-      case Tags::f64Array:
-        ensureType(seq.elements[idx], Seq);
-        writeMany<double, Float>(seq.elements[idx].payload.seqValue, &SHVarPayload::floatValue, member.offset, member.arrlen);
-        break;
-      case Tags::f64:
-        ensureType(seq.elements[idx], Float);
-        write<double>(seq.elements[idx].payload.floatValue, member.offset);
-        break;
-      case Tags::Bool:
-        ensureType(seq.elements[idx], SHType::Bool);
-        write<bool>(seq.elements[idx].payload.boolValue, member.offset);
-        break;
-      case Tags::Pointer:
-        ensureType(seq.elements[idx], Int);
-        write<uintptr_t>(seq.elements[idx].payload.intValue, member.offset);
-        break;
-      case Tags::String:
-        ensureType(seq.elements[idx], SHType::String);
-        write<const char *>(seq.elements[idx].payload.stringValue, member.offset);
-      }
-      idx++;
+    const auto members = input.payload.seqValue.elements;
+    const auto dst = _storage.data();
+    for (auto &run : _plan) {
+      run.pack(run, members, dst);
     }
 
-    return Var(&_storage.front(), _size);
+    return Var(_storage.data(), _size);
   }
 };
 
@@ -308,7 +441,7 @@ RUNTIME_SHARD_activate(Pack);
 RUNTIME_SHARD_END(Pack);
 
 struct Unpack : public StructBase {
-  SHSeq _output;
+  SHSeq _output{};
 
   static SHTypesInfo inputTypes() { return CoreInfo::BytesType; }
   static SHTypesInfo outputTypes() { return CoreInfo::AnySeqType; }
@@ -316,7 +449,7 @@ struct Unpack : public StructBase {
   void destroy() {
     if (_output.elements) {
       // cleanup sub seqs
-      for (size_t i = 0; i < _members.size(); i++) {
+      for (size_t i = 0; i < _output.len; i++) {
         if (_output.elements[i].valueType == Seq) {
           shards::arrayFree(_output.elements[i].payload.seqValue);
         }
@@ -326,17 +459,17 @@ struct Unpack : public StructBase {
   }
 
   void setParam(int index, const SHVar &value) {
-    StructBase::setParam(index, value);
-    // now we know what size we need
-    size_t curLen = _output.len;
-    if (_members.size() < curLen) {
-      // need to destroy leftovers if arrays
-      for (size_t i = _members.size(); i < curLen; i++) {
-        if (_output.elements[i].valueType == Seq) {
-          shards::arrayFree(_output.elements[i].payload.seqValue);
-        }
+    // free previous sub seqs, the layout might have changed
+    for (size_t i = 0; i < _output.len; i++) {
+      if (_output.elements[i].valueType == Seq) {
+        shards::arrayFree(_output.elements[i].payload.seqValue);
       }
+      _output.elements[i] = SHVar();
     }
+
+    StructBase::setParam(index, value);
+
+    // now we know what size we need
     shards::arrayResize(_output, _members.size());
     auto idx = 0;
     for (auto &member : _members) {
@@ -384,76 +517,16 @@ struct Unpack : public StructBase {
     }
   }
 
-  template <typename T, typename CT> void read(CT &output, const SHVar &input, size_t offset) {
-    T x;
-    memcpy(&x, input.payload.bytesValue + offset, sizeof(T));
-    output = static_cast<CT>(x);
-  }
-
   SHVar activate(SHContext *context, const SHVar &input) {
-    auto idx = 0;
-    for (auto &member : _members) {
-      auto &arr = _output.elements[idx].payload.seqValue;
-      switch (member.tag) {
-      case Tags::i8Array:
-        for (size_t i = 0; i < member.arrlen; i++) {
-          read<int8_t>(arr.elements[i].payload.intValue, input, member.offset + i);
-        }
-        break;
-      case Tags::i8:
-        read<int8_t>(_output.elements[idx].payload.intValue, input, member.offset);
-        break;
-      case Tags::i16Array:
-        for (size_t i = 0; i < member.arrlen; i++) {
-          read<int16_t>(arr.elements[i].payload.intValue, input, member.offset + (2 * i));
-        }
-        break;
-      case Tags::i16:
-        read<int16_t>(_output.elements[idx].payload.intValue, input, member.offset);
-        break;
-      case Tags::i32Array:
-        for (size_t i = 0; i < member.arrlen; i++) {
-          read<int32_t>(arr.elements[i].payload.intValue, input, member.offset + (4 * i));
-        }
-        break;
-      case Tags::i32:
-        read<int32_t>(_output.elements[idx].payload.intValue, input, member.offset);
-        break;
-      case Tags::i64Array:
-        for (size_t i = 0; i < member.arrlen; i++) {
-          read<int64_t>(arr.elements[i].payload.intValue, input, member.offset + (8 * i));
-        }
-        break;
-      case Tags::i64:
-        read<int64_t>(_output.elements[idx].payload.intValue, input, member.offset);
-        break;
-      case Tags::f32Array:
-        for (size_t i = 0; i < member.arrlen; i++) {
-          read<float>(arr.elements[i].payload.floatValue, input, member.offset + (4 * i));
-        }
-        break;
-      case Tags::f32:
-        read<float>(_output.elements[idx].payload.floatValue, input, member.offset);
-        break;
-      case Tags::f64Array:
-        for (size_t i = 0; i < member.arrlen; i++) {
-          read<double>(arr.elements[i].payload.floatValue, input, member.offset + (8 * i));
-        }
-        break;
-      case Tags::f64:
-        read<double>(_output.elements[idx].payload.floatValue, input, member.offset);
-        break;
-      case Tags::Bool:
-        read<bool>(_output.elements[idx].payload.boolValue, input, member.offset);
-        break;
-      case Tags::Pointer:
-        read<uintptr_t>(_output.elements[idx].payload.intValue, input, member.offset);
-        break;
-      case Tags::String:
-        read<const char *>(_output.elements[idx].payload.stringValue, input, member.offset);
-        break;
-      }
-      idx++;
+    if (input.payload.bytesSize < _size) {
+      throw ActivationError("Expected at least " + std::to_string(_size) + " bytes as input, got " +
+                            std::to_string(input.payload.bytesSize));
+    }
+
+    const auto src = input.payload.bytesValue;
+    const auto members = _output.elements;
+    for (auto &run : _plan) {
+      run.unpack(run, src, members);
     }
 
     return Var(_output);
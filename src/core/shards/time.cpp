@@ -2,6 +2,8 @@
 /* Copyright © 2019 Fragcolor Pte. Ltd. */
 
 #include "shared.hpp"
+#include "time.hpp"
+#include <algorithm>
 #include <chrono>
 
 namespace shards {
@@ -20,7 +22,7 @@ struct Now {
   SHVar activate(SHContext *context, const SHVar &input) {
     auto tnow = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> dt = tnow - _clock.Start;
-    return Var(dt.count());
+    return Var(recordTime(dt.count()));
   }
 };
 
@@ -28,7 +30,7 @@ struct NowMs : public Now {
   SHVar activate(SHContext *context, const SHVar &input) {
     auto tnow = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double, std::milli> dt = tnow - _clock.Start;
-    return Var(dt.count());
+    return Var(recordTime(dt.count()));
   }
 };
 
@@ -38,10 +40,10 @@ struct Delta {
   static SHTypesInfo inputTypes() { return CoreInfo::NoneType; }
   static SHTypesInfo outputTypes() { return CoreInfo::FloatType; }
 
-  void warmup(SHContext *context) { _clock.Start = std::chrono::high_resolution_clock::now(); }
+  void warmup(SHContext *context) { _clock.Start = clockNow(); }
 
   SHVar activate(SHContext *context, const SHVar &input) {
-    auto tnow = std::chrono::high_resolution_clock::now();
+    auto tnow = clockNow();
     std::chrono::duration<double> dt = tnow - _clock.Start;
     _clock.Start = tnow; // reset timer
     return Var(dt.count());
@@ -50,7 +52,7 @@ struct Delta {
 
 struct DeltaMs : public Delta {
   SHVar activate(SHContext *context, const SHVar &input) {
-    auto tnow = std::chrono::high_resolution_clock::now();
+    auto tnow = clockNow();
     std::chrono::duration<double, std::milli> dt = tnow - _clock.Start;
     _clock.Start = tnow; // reset timer
     return Var(dt.count());
@@ -64,7 +66,7 @@ struct EpochMs {
   SHVar activate(SHContext *context, const SHVar &input) {
     using namespace std::chrono;
     milliseconds ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch());
-    return Var(int(ms.count()));
+    return Var(int(recordEpoch(ms.count())));
   }
 };
 
@@ -81,7 +83,8 @@ struct Pop {
 
   SHOptionalString help() {
     return SHCCSTR("This shards delays its output until one of the values of "
-                   "the sequence parameter expires.");
+                   "the sequence parameter expires. The sequence is scanned at every tick, Time.Queue scales to large "
+                   "amounts of pending values.");
   }
 
   ParamVar _pseq{};
@@ -124,7 +127,7 @@ struct Pop {
     while (true) {
       auto &seq = _pseq.get();
       milliseconds ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch());
-      auto now = ms.count();
+      auto now = recordEpoch(ms.count());
       for (uint32_t idx = 0; idx < seq.payload.seqValue.len; idx++) {
         auto &v = seq.payload.seqValue.elements[idx];
         auto &time = v.payload.seqValue.elements[1]; // time ms in epoch here
@@ -141,6 +144,291 @@ struct Pop {
     }
   }
 };
+
+void DelayQueue::push(const SHVar &value, Deadline deadline) {
+  std::scoped_lock lock(_mutex);
+  Entry entry{deadline, _order++, {}};
+  cloneVar(entry.value, value);
+  _heap.emplace_back(entry);
+  std::push_heap(_heap.begin(), _heap.end(), later);
+  // waiters parked until the previous earliest deadline
+  if (_heap.front().order == entry.order)
+    wakeAll();
+}
+
+bool DelayQueue::pop(Deadline now, SHVar &output) {
+  std::scoped_lock lock(_mutex);
+  if (_heap.empty() || _heap.front().deadline > now)
+    return false;
+  std::pop_heap(_heap.begin(), _heap.end(), later);
+  destroyVar(output);
+  // ownership moves to output
+  output = _heap.back().value;
+  _heap.pop_back();
+  return true;
+}
+
+bool DelayQueue::peek(SHVar &output) const {
+  std::scoped_lock lock(_mutex);
+  if (_heap.empty())
+    return false;
+  cloneVar(output, _heap.front().value);
+  return true;
+}
+
+DelayQueue::Deadline DelayQueue::next() const {
+  std::scoped_lock lock(_mutex);
+  return _heap.empty() ? Deadline::max() : _heap.front().deadline;
+}
+
+size_t DelayQueue::size() const {
+  std::scoped_lock lock(_mutex);
+  return _heap.size();
+}
+
+void DelayQueue::clear() {
+  std::scoped_lock lock(_mutex);
+  for (auto &entry : _heap)
+    destroyVar(entry.value);
+  _heap.clear();
+  wakeAll();
+}
+
+DelayQueue::Deadline DelayQueue::wait(std::atomic_bool &flag) {
+  std::scoped_lock lock(_mutex);
+  flag = false;
+  _waiters.push_back(&flag);
+  return _heap.empty() ? Deadline::max() : _heap.front().deadline;
+}
+
+void DelayQueue::forget(std::atomic_bool &flag) {
+  std::scoped_lock lock(_mutex);
+  _waiters.erase(std::remove(_waiters.begin(), _waiters.end(), &flag), _waiters.end());
+}
+
+void DelayQueue::wakeAll() {
+  if (_waiters.empty())
+    return;
+  for (auto flag : _waiters)
+    flag->store(true, std::memory_order_release);
+  _waiters.clear();
+  CompletionSignal::notify();
+}
+
+constexpr uint32_t QueueCC = 'dque';
+
+struct QueueCommon {
+  static inline Type Queue{{SHType::Object, {.object = {.vendorId = CoreCC, .typeId = QueueCC}}}};
+  static inline Type QueueVar{{SHType::ContextVar, {.contextVarTypes = Queue}}};
+};
+
+struct Queue {
+  std::shared_ptr<DelayQueue> _queue;
+
+  static SHOptionalString help() {
+    return SHCCSTR("Outputs a new delay queue, values pushed with Time.QueuePush are released by Time.QueuePop once "
+                   "their delay expired, earliest first.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return QueueCommon::Queue; }
+
+  void cleanup() { _queue = nullptr; }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    // wires still holding the previous queue keep it alive
+    _queue = std::make_shared<DelayQueue>();
+    return Var::Object(&_queue, CoreCC, QueueCC);
+  }
+};
+
+struct QueueUser {
+  std::shared_ptr<DelayQueue> _queue;
+  void *_lastObject = nullptr;
+  ParamVar _queueVar{};
+  SHExposedTypeInfo _expInfo{};
+
+  void cleanup() {
+    _queueVar.cleanup();
+    _queue = nullptr;
+    _lastObject = nullptr;
+  }
+
+  void warmup(SHContext *context) {
+    _queueVar.warmup(context);
+    _lastObject = nullptr;
+  }
+
+  void ensureQueue() {
+    auto p_queue = reinterpret_cast<std::shared_ptr<DelayQueue> *>(_queueVar.get().payload.objectValue);
+    auto obj = p_queue->get();
+    if (!obj)
+      throw ActivationError("Delay queue is not valid.");
+    if (_lastObject != obj) {
+      _queue = *p_queue;
+      _lastObject = obj;
+    }
+  }
+
+  SHExposedTypesInfo requiredVariables() {
+    if (_queueVar.isVariable()) {
+      _expInfo = SHExposedTypeInfo{_queueVar.variableName(), SHCCSTR("The required delay queue."), QueueCommon::Queue};
+    } else {
+      throw ComposeError("No delay queue specified.");
+    }
+    return SHExposedTypesInfo{&_expInfo, 1, 0};
+  }
+};
+
+struct QueuePush : public QueueUser {
+  ParamVar _delay{Var(0.0)};
+
+  static SHOptionalString help() {
+    return SHCCSTR("Pushes a copy of the input into the delay queue, Time.QueuePop releases it once the delay expired. "
+                   "Outputs the input.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::AnyType; }
+
+  static SHParametersInfo parameters() {
+    static Parameters params{
+        {"Queue", SHCCSTR("The delay queue to push to."), {QueueCommon::QueueVar}},
+        {"Delay",
+         SHCCSTR("The time in seconds before the value is released."),
+         {CoreInfo::FloatType, CoreInfo::IntType, CoreInfo::FloatVarType, CoreInfo::IntVarType}}};
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _queueVar = value;
+      break;
+    case 1:
+      _delay = value;
+      break;
+    default:
+      break;
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return _queueVar;
+    case 1:
+      return _delay;
+    default:
+      return Var::Empty;
+    }
+  }
+
+  void cleanup() {
+    _delay.cleanup();
+    QueueUser::cleanup();
+  }
+
+  void warmup(SHContext *context) {
+    _delay.warmup(context);
+    QueueUser::warmup(context);
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    ensureQueue();
+    auto &delay = _delay.get();
+    const auto seconds = delay.valueType == SHType::Int ? double(delay.payload.intValue) : delay.payload.floatValue;
+    _queue->push(input, clockNow().time_since_epoch() + SHDuration(seconds));
+    return input;
+  }
+};
+
+struct QueuePop : public QueueUser {
+  OwnedVar _output{};
+  // set by the queue when an earlier value is pushed while we wait
+  std::atomic_bool _woken{false};
+
+  static SHOptionalString help() {
+    return SHCCSTR("Outputs the value of the delay queue whose delay expired first, the wire sleeps until a value is "
+                   "due, without polling the queue.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::AnyType; }
+
+  static SHParametersInfo parameters() {
+    static Parameters params{{"Queue", SHCCSTR("The delay queue to pop from."), {QueueCommon::QueueVar}}};
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) { _queueVar = value; }
+
+  SHVar getParam(int index) { return _queueVar; }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    ensureQueue();
+    while (true) {
+      const auto now = clockNow().time_since_epoch();
+      if (_queue->pop(now, _output))
+        return _output;
+
+      const auto next = _queue->wait(_woken);
+      DEFER(_queue->forget(_woken));
+      const auto seconds = next == SHDuration::max() ? std::numeric_limits<double>::infinity() : (next - now).count();
+      if (suspendUntil(context, _woken, seconds) != SHWireState::Continue)
+        return Var::Empty;
+    }
+  }
+};
+
+struct QueuePeek : public QueueUser {
+  OwnedVar _output{};
+
+  static SHOptionalString help() {
+    return SHCCSTR("Outputs a copy of the value of the delay queue that will be released first, due or not, or None if "
+                   "the queue is empty.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::AnyType; }
+
+  static SHParametersInfo parameters() {
+    static Parameters params{{"Queue", SHCCSTR("The delay queue to peek."), {QueueCommon::QueueVar}}};
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) { _queueVar = value; }
+
+  SHVar getParam(int index) { return _queueVar; }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    ensureQueue();
+    if (!_queue->peek(_output))
+      return Var::Empty;
+    return _output;
+  }
+};
+
+struct QueueSize : public QueueUser {
+  static SHOptionalString help() { return SHCCSTR("Outputs the number of values pending in the delay queue."); }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::IntType; }
+
+  static SHParametersInfo parameters() {
+    static Parameters params{{"Queue", SHCCSTR("The delay queue."), {QueueCommon::QueueVar}}};
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) { _queueVar = value; }
+
+  SHVar getParam(int index) { return _queueVar; }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    ensureQueue();
+    return Var(int64_t(_queue->size()));
+  }
+};
 } // namespace Time
 
 void registerTimeShards() {
@@ -150,5 +438,10 @@ void registerTimeShards() {
   REGISTER_SHARD("Time.DeltaMs", Time::DeltaMs);
   REGISTER_SHARD("Time.EpochMs", Time::EpochMs);
   REGISTER_SHARD("Time.Pop", Time::Pop);
+  REGISTER_SHARD("Time.Queue", Time::Queue);
+  REGISTER_SHARD("Time.QueuePush", Time::QueuePush);
+  REGISTER_SHARD("Time.QueuePop", Time::QueuePop);
+  REGISTER_SHARD("Time.QueuePeek", Time::QueuePeek);
+  REGISTER_SHARD("Time.QueueSize", Time::QueueSize);
 }
 } // namespace shards
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2019 Fragcolor Pte. Ltd. */
+
+#ifndef SH_CORE_SHARDS_TIME
+#define SH_CORE_SHARDS_TIME
+
+#include "shards.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace shards {
+namespace Time {
+// Values released once their deadline passed, earliest deadline first and in push order among equal deadlines
+// A binary min-heap, push and pop cost O(log n) no matter how many values are pending.
+// Thread safe, wires waiting for a value register a flag that is set as soon as an earlier deadline is pushed.
+class DelayQueue {
+public:
+  // same as SHDuration, seconds since the SHClock epoch
+  using Deadline = std::chrono::duration<double>;
+
+  ~DelayQueue() { clear(); }
+
+  // value is cloned
+  void push(const SHVar &value, Deadline deadline);
+  // Moves the earliest value into output if its deadline is not after now, output is destroyed first
+  bool pop(Deadline now, SHVar &output);
+  // Clones the earliest value into output, false if the queue is empty
+  bool peek(SHVar &output) const;
+  // Earliest deadline, Deadline::max() if the queue is empty
+  Deadline next() const;
+  size_t size() const;
+  void clear();
+
+  // Registers flag to be set (followed by a CompletionSignal::notify) once the earliest deadline moves sooner or the
+  // queue is cleared, returns the earliest deadline at registration, flags are unregistered when set or by forget
+  Deadline wait(std::atomic_bool &flag);
+  void forget(std::atomic_bool &flag);
+
+private:
+  struct Entry {
+    Deadline deadline;
+    uint64_t order;
+    SHVar value;
+  };
+
+  // std heap functions build max-heaps, this puts the earliest entry on top
+  static bool later(const Entry &a, const Entry &b) {
+    return a.deadline > b.deadline || (a.deadline == b.deadline && a.order > b.order);
+  }
+
+  void wakeAll();
+
+  mutable std::mutex _mutex;
+  std::vector<Entry> _heap;
+  uint64_t _order{0};
+  std::vector<std::atomic_bool *> _waiters;
+};
+} // namespace Time
+} // namespace shards
+
+#endif // SH_CORE_SHARDS_TIME
@@ -342,13 +342,13 @@ struct Wait : public WireBase {
     } else {
       auto timeout = _timeout.get();
       if (timeout.valueType == SHType::Float) {
-        SHTime start = SHClock::now();
+        SHTime start = clockNow();
         auto dTimeout = SHDuration(timeout.payload.floatValue);
         while (wire->context != context && isRunning(wire.get())) {
           SH_SUSPEND(context, 0);
 
           // Deal with timeout
-          SHTime now = SHClock::now();
+          SHTime now = clockNow();
           if ((now - start) > dTimeout) {
             SHLOG_ERROR("Wait: Wire {} timed out", wire->name);
             throw ActivationError("Wait: Wire timed out");
@@ -591,7 +591,7 @@ struct Resume : public WireBase {
     }
 
     // Prepare if no callc was called
-    if (!pWire->coro) {
+    if (!shards::isPrepared(pWire)) {
       pWire->mesh = context->main->mesh;
       shards::prepare(pWire, context->flow);
 
@@ -904,7 +904,7 @@ struct BaseRunner : public WireBase {
     }
 
     // Prepare if no callc was called
-    if (!wire->coro) {
+    if (!shards::isPrepared(wire.get())) {
       wire->mesh = context->main->mesh;
       // pre-set wire context with our context
       // this is used to copy wireStack over to the new one
@@ -920,7 +920,7 @@ struct BaseRunner : public WireBase {
     }
 
     // Tick the wire on the flow that this Step wire created
-    SHDuration now = SHClock::now().time_since_epoch();
+    SHDuration now = clockNow().time_since_epoch();
     shards::tick(wire->context->flow->wire, now, input);
   }
 };
@@ -1631,7 +1631,7 @@ struct ParallelBase : public CapturingSpawners {
             }
 
             // Prepare and start if no callc was called
-            if (!cref->wire->coro) {
+            if (!shards::isPrepared(cref->wire.get())) {
               cref->wire->mesh = context->main->mesh;
 
               // pre-set wire context with our context
@@ -1645,7 +1645,7 @@ struct ParallelBase : public CapturingSpawners {
             }
 
             // Tick the wire on the flow that this wire created
-            SHDuration now = SHClock::now().time_since_epoch();
+            SHDuration now = clockNow().time_since_epoch();
             shards::tick(cref->wire->context->flow->wire, now, getInput(cref, input));
 
             if (!isRunning(cref->wire.get())) {
@@ -1680,7 +1680,7 @@ struct ParallelBase : public CapturingSpawners {
                 }
 
                 // Prepare and start if no callc was called
-                if (!cref->wire->coro) {
+                if (!shards::isPrepared(cref->wire.get())) {
                   if (!cref->mesh) {
                     cref->mesh = SHMesh::make();
                   }
@@ -1699,7 +1699,7 @@ struct ParallelBase : public CapturingSpawners {
                 }
 
                 // Tick the wire on the flow that this wire created
-                SHDuration now = SHClock::now().time_since_epoch();
+                SHDuration now = clockNow().time_since_epoch();
                 shards::tick(cref->wire->context->flow->wire, now, getInput(cref, input));
                 // also tick the mesh
                 cref->mesh->tick();
@@ -2010,7 +2010,7 @@ struct StepMany : public TryMany {
         }
 
         // Prepare and start if no callc was called
-        if (!cref->wire->coro) {
+        if (!shards::isPrepared(cref->wire.get())) {
           cref->wire->mesh = context->main->mesh;
 
           // pre-set wire context with our context
@@ -2028,7 +2028,7 @@ struct StepMany : public TryMany {
         }
 
         // Tick the wire on the flow that this wire created
-        SHDuration now = SHClock::now().time_since_epoch();
+        SHDuration now = clockNow().time_since_epoch();
         shards::tick(cref->wire->context->flow->wire, now, getInput(cref, input));
 
         // this can be anything really...
@@ -2212,6 +2212,152 @@ private:
   BranchFailureBehavior _failureBehavior = BranchFailureBehavior::Everything;
 };
 
+// Scheduling statistics, see SHMesh::tick, times are in seconds
+struct SchedulingStats {
+  static inline std::array<SHString, 10> WireKeys{"Name",   "Resumes",  "Total",    "Last",     "Max",
+                                                  "Average", "Budget", "Priority", "Overruns", "Deferrals"};
+  static inline Types WireTableTypes{{CoreInfo::StringType, CoreInfo::IntType, CoreInfo::FloatType, CoreInfo::FloatType,
+                                      CoreInfo::FloatType, CoreInfo::FloatType, CoreInfo::FloatType, CoreInfo::IntType,
+                                      CoreInfo::IntType, CoreInfo::IntType}};
+  static inline Type WireTable = Type::TableOf(WireTableTypes, WireKeys);
+  static inline Types WireTableSeqTypes{{WireTable}};
+  static inline Type WireTableSeq = Type::SeqOf(WireTableSeqTypes);
+
+  static inline std::array<SHString, 5> OverrunKeys{"Wire", "Time", "CPU", "Budget", "Frame"};
+  static inline Types OverrunTableTypes{
+      {CoreInfo::StringType, CoreInfo::FloatType, CoreInfo::FloatType, CoreInfo::FloatType, CoreInfo::BoolType}};
+  static inline Type OverrunTable = Type::TableOf(OverrunTableTypes, OverrunKeys);
+  static inline Types OverrunTableSeqTypes{{OverrunTable}};
+  static inline Type OverrunTableSeq = Type::SeqOf(OverrunTableSeqTypes);
+
+  static inline std::array<SHString, 7> MeshKeys{"Frames", "LastFrame", "MaxFrame", "FrameBudget",
+                                                 "Overruns", "Wires", "Watchdog"};
+  static inline Types MeshTableTypes{{CoreInfo::IntType, CoreInfo::FloatType, CoreInfo::FloatType, CoreInfo::FloatType,
+                                      CoreInfo::IntType, WireTableSeq, OverrunTableSeq}};
+  static inline Type MeshTable = Type::TableOf(MeshTableTypes, MeshKeys);
+
+  static void fill(TableVar &table, const SHWire *wire) {
+    const auto &stats = wire->stats;
+    cloneVar(table["Name"], Var(wire->name));
+    table["Resumes"] = Var(int64_t(stats.resumes));
+    table["Total"] = Var(CycleClock::seconds(stats.total));
+    table["Last"] = Var(CycleClock::seconds(stats.last));
+    table["Max"] = Var(CycleClock::seconds(stats.max));
+    table["Average"] = Var(stats.resumes ? CycleClock::seconds(stats.total) / double(stats.resumes) : 0.0);
+    table["Budget"] = Var(wire->budget);
+    table["Priority"] = Var(int64_t(wire->priority));
+    table["Overruns"] = Var(int64_t(stats.overruns));
+    table["Deferrals"] = Var(int64_t(stats.deferrals));
+  }
+};
+
+struct GetWireStats {
+  static SHOptionalString help() {
+    return SHCCSTR("Outputs the CPU time accounting of a wire: how often it was resumed, how long its resumes took in seconds "
+                   "and how often it ran over its budget or was deferred by the mesh frame budget.");
+  }
+
+  static inline Parameters params{
+      {"Wire", SHCCSTR("The wire to inspect, if none the wire being ticked (the root of the current flow)."),
+       {WireBase::WireVarTypes}}};
+
+  static SHParametersInfo parameters() { return params; }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return SchedulingStats::WireTable; }
+
+  void setParam(int index, const SHVar &value) { _wire = value; }
+
+  SHVar getParam(int index) { return _wire; }
+
+  SHExposedTypesInfo requiredVariables() {
+    if (_wire.isVariable()) {
+      _requiredWire = SHExposedTypeInfo{_wire.variableName(), SHCCSTR("The wire to inspect."), CoreInfo::WireType};
+      return {&_requiredWire, 1, 0};
+    } else {
+      return {};
+    }
+  }
+
+  void warmup(SHContext *context) { _wire.warmup(context); }
+
+  void cleanup() { _wire.cleanup(); }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    auto &vwire = _wire.get();
+    if (vwire.valueType == SHType::Wire) {
+      SchedulingStats::fill(_output, SHWire::sharedFromRef(vwire.payload.wireValue).get());
+    } else if (vwire.valueType == SHType::String) {
+      auto it = GetGlobals().GlobalWires.find(vwire.payload.stringValue);
+      if (it == GetGlobals().GlobalWires.end())
+        throw ActivationError(std::string("Wire.Stats: wire not found: ") + vwire.payload.stringValue);
+      SchedulingStats::fill(_output, it->second.get());
+    } else {
+      SchedulingStats::fill(_output, context->main);
+    }
+    return _output;
+  }
+
+private:
+  ParamVar _wire{};
+  SHExposedTypeInfo _requiredWire{};
+  TableVar _output{};
+};
+
+struct GetMeshStats {
+  static SHOptionalString help() {
+    return SHCCSTR("Outputs the CPU time accounting of the mesh running the current flow: tick times in seconds, ticks over the "
+                   "frame budget, every scheduled wire heaviest first (see Wire.Stats) and the latest watchdog records, each "
+                   "naming the wire that ran over its budget or took the largest share of a tick over the frame budget.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return SchedulingStats::MeshTable; }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    auto mesh = context->main->mesh.lock();
+    if (!mesh)
+      throw ActivationError("Mesh.Stats: the current wire is not scheduled on a mesh");
+
+    _output["Frames"] = Var(int64_t(mesh->stats.frames));
+    _output["LastFrame"] = Var(CycleClock::seconds(mesh->stats.lastFrame));
+    _output["MaxFrame"] = Var(CycleClock::seconds(mesh->stats.maxFrame));
+    _output["FrameBudget"] = Var(mesh->frameBudget);
+    _output["Overruns"] = Var(int64_t(mesh->stats.overruns));
+
+    _sorted.clear();
+    for (auto &wire : mesh->scheduled) {
+      _sorted.emplace_back(wire.get());
+    }
+    std::sort(_sorted.begin(), _sorted.end(), [](auto a, auto b) { return a->stats.total > b->stats.total; });
+    SeqVar wires;
+    for (auto wire : _sorted) {
+      TableVar table;
+      SchedulingStats::fill(table, wire);
+      wires.push_back(std::move(table));
+    }
+    cloneVar(_output["Wires"], wires);
+
+    SeqVar watchdog;
+    for (auto &overrun : mesh->overruns) {
+      TableVar table;
+      cloneVar(table["Wire"], Var(overrun.wire));
+      table["Time"] = Var(overrun.time);
+      table["CPU"] = Var(overrun.cpu);
+      table["Budget"] = Var(overrun.budget);
+      table["Frame"] = Var(overrun.frame);
+      watchdog.push_back(std::move(table));
+    }
+    cloneVar(_output["Watchdog"], watchdog);
+
+    return _output;
+  }
+
+private:
+  std::vector<SHWire *> _sorted;
+  TableVar _output{};
+};
+
 void registerWiresShards() {
   using RunWireDo = RunWire<false, RunWireMode::Inline>;
   using RunWireDispatch = RunWire<true, RunWireMode::Inline>;
@@ -2233,6 +2379,8 @@ void registerWiresShards() {
   REGISTER_SHARD("Expand", Expand);
   REGISTER_SHARD("Branch", Branch);
   REGISTER_SHARD("StepMany", StepMany);
+  REGISTER_SHARD("Wire.Stats", GetWireStats);
+  REGISTER_SHARD("Mesh.Stats", GetMeshStats);
 }
 }; // namespace shards
 
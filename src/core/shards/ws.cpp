@@ -4,13 +4,17 @@
 #ifndef SHARDS_NO_HTTP_SHARDS
 #define BOOST_ERROR_CODE_HEADER_ONLY
 
-#include "shared.hpp"
+#include "reactor.hpp"
 
 #include <boost/beast/core.hpp>
 #include <boost/beast/ssl.hpp>
 #include <boost/beast/version.hpp>
 #include <boost/beast/websocket.hpp>
 #include <boost/beast/websocket/ssl.hpp>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 
 namespace beast = boost::beast;         // from <boost/beast.hpp>
 namespace http = beast::http;           // from <boost/beast/http.hpp>
@@ -28,50 +32,346 @@ struct Common {
   static inline Type WebSocketVar{{SHType::ContextVar, {.contextVarTypes = WebSocket}}};
 };
 
-struct Socket {
-  Socket(bool secure) : _secure(secure) {}
+struct Options {
+  bool compress{false};
+  // pings are sent at half of it, the connection is dropped after it without traffic
+  double timeout{30.0};
+  size_t fragmentSize{16384};
+  size_t maxMessageSize{64 * 1024 * 1024};
+};
 
-  net::io_context ioCtx{};
-  ssl::context secureCtx{ssl::context::tlsv12_client};
-  websocket::stream<beast::ssl_stream<tcp::socket>> _ssl_socket{ioCtx, secureCtx};
-  websocket::stream<tcp::socket> _socket{ioCtx};
+class Connection;
+
+struct Message {
+  std::string data;
+  bool binary{false};
+  std::weak_ptr<Connection> from;
+};
+
+// Messages received by one or more connections, filled by the reactor and drained by a wire
+// signal is set on every new message or connection state change, wires park on it.
+// Connections stop reading while the inbox is full and are resumed once it's drained.
+struct Inbox {
+  static constexpr size_t HighWater = 1024;
+
+  std::atomic_bool signal{false};
+
+  void notify() {
+    signal.store(true);
+    CompletionSignal::notify();
+  }
+
+  // Returns false if the inbox is full, the connection must pause reading until resumed
+  bool push(Message &&message, const std::shared_ptr<Connection> &from);
+
+  bool pop(Message &message);
+
+private:
+  std::mutex _mutex;
+  std::deque<Message> _messages;
+  std::vector<std::weak_ptr<Connection>> _paused;
+};
+
+// Parks the wire until pred holds, returns false if the wire is stopping
+template <typename Pred> bool waitFor(SHContext *context, Inbox &inbox, Pred pred) {
+  while (true) {
+    inbox.signal.store(false);
+    if (pred())
+      return true;
+    if (suspendUntil(context, inbox.signal) != SHWireState::Continue)
+      return false;
+  }
+}
+
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+  enum class State { Connecting, Open, Closed };
+
+  Connection(std::shared_ptr<Inbox> inbox, const Options &options, bool accepted)
+      : _inbox(std::move(inbox)), _options(options), _accepted(accepted) {}
+
+  virtual ~Connection() = default;
+
+  State state() const { return _state.load(); }
+  bool accepted() const { return _accepted; }
+  Inbox &inbox() { return *_inbox; }
+
+  std::string error() const {
+    std::scoped_lock lock(_errorMutex);
+    return _error;
+  }
 
+  // Thread safe, queues payload for writing
+  void send(std::string_view payload, bool binary) {
+    net::post(Reactor::get().ioCtx, [self = shared_from_this(), data = std::string(payload), binary]() mutable {
+      if (self->state() == State::Closed)
+        return;
+      self->_outbox.emplace_back(Message{std::move(data), binary, {}});
+      if (self->_outbox.size() == 1 && self->state() == State::Open)
+        self->write();
+    });
+  }
+
+  // Thread safe, gracefully closes after pending writes
   void close() {
-    if (_socket.is_open()) {
-      SHLOG_DEBUG("Closing WebSocket");
-      try {
-        _socket.close(websocket::close_code::normal);
-      } catch (const std::exception &ex) {
-        SHLOG_WARNING("Ignored an exception during WebSocket close: {}", ex.what());
-      }
+    net::post(Reactor::get().ioCtx, [self = shared_from_this()]() {
+      self->_closing = true;
+      if (self->state() == State::Open && self->_outbox.empty())
+        self->shutdown();
+      else if (self->state() == State::Connecting)
+        self->fail("closed while connecting");
+    });
+  }
+
+  // Reactor side, called once when the connection closes
+  void onClosed(std::function<void()> fn) { _onClosed = std::move(fn); }
+
+  // Thread safe, called by the inbox once it has room again
+  void resume() {
+    net::post(Reactor::get().ioCtx, [self = shared_from_this()]() {
+      if (self->state() == State::Open)
+        self->read();
+    });
+  }
+
+protected:
+  // reactor side, implemented by Session
+
+  virtual void read() = 0;
+  virtual void write() = 0;
+  virtual void shutdown() = 0;
+
+  void opened() {
+    if (_state == State::Closed) {
+      // closed while connecting
+      shutdown();
+      return;
     }
-    if (_ssl_socket.is_open()) {
-      SHLOG_DEBUG("Closing WebSocket");
-      try {
-        _ssl_socket.close(websocket::close_code::normal);
-      } catch (const std::exception &ex) {
-        SHLOG_WARNING("Ignored an exception during WebSocket close: {}", ex.what());
-      }
+    _state = State::Open;
+    _inbox->notify();
+    read();
+    if (!_outbox.empty())
+      write();
+  }
+
+  void received(std::string &&data, bool binary) {
+    if (_inbox->push(Message{std::move(data), binary, weak_from_this()}, shared_from_this()))
+      read();
+  }
+
+  void written() {
+    if (_outbox.empty())
+      return;
+    _outbox.pop_front();
+    if (_state == State::Closed)
+      return;
+    if (!_outbox.empty())
+      write();
+    else if (_closing)
+      shutdown();
+  }
+
+  void fail(std::string_view error) {
+    if (_state == State::Closed)
+      return;
+    {
+      std::scoped_lock lock(_errorMutex);
+      _error = error;
     }
+    // while open the front message is being written, its buffer must outlive the write handler
+    if (_state == State::Open && !_outbox.empty())
+      _outbox.erase(_outbox.begin() + 1, _outbox.end());
+    else
+      _outbox.clear();
+    _state = State::Closed;
+    _inbox->notify();
+    if (auto closed = std::exchange(_onClosed, nullptr))
+      closed();
   }
 
-  ~Socket() { close(); }
+  std::shared_ptr<Inbox> _inbox;
+  Options _options;
+  std::deque<Message> _outbox;
+  bool _closing{false};
+
+private:
+  std::atomic<State> _state{State::Connecting};
+  bool _accepted;
+  mutable std::mutex _errorMutex;
+  std::string _error;
+  std::function<void()> _onClosed;
+};
 
-  websocket::stream<beast::ssl_stream<tcp::socket>> &get_secure() {
-    assert(_secure);
-    return _ssl_socket;
+bool Inbox::push(Message &&message, const std::shared_ptr<Connection> &from) {
+  bool hasRoom;
+  {
+    std::scoped_lock lock(_mutex);
+    _messages.emplace_back(std::move(message));
+    hasRoom = _messages.size() < HighWater;
+    if (!hasRoom)
+      _paused.emplace_back(from);
   }
+  notify();
+  return hasRoom;
+}
 
-  websocket::stream<tcp::socket> &get_unsecure() {
-    assert(!_secure);
-    return _socket;
+bool Inbox::pop(Message &message) {
+  std::vector<std::weak_ptr<Connection>> resumed;
+  {
+    std::scoped_lock lock(_mutex);
+    if (_messages.empty())
+      return false;
+    message = std::move(_messages.front());
+    _messages.pop_front();
+    if (!_paused.empty() && _messages.size() < HighWater / 2)
+      std::swap(resumed, _paused);
   }
+  for (auto &weak : resumed) {
+    if (auto connection = weak.lock())
+      connection->resume();
+  }
+  return true;
+}
 
-  constexpr bool secure() const { return _secure; }
+template <typename Stream> class Session final : public Connection {
+public:
+  static constexpr bool Secure = !std::is_same_v<Stream, beast::tcp_stream>;
+
+  template <typename... Args>
+  Session(std::shared_ptr<Inbox> inbox, const Options &options, bool accepted, Args &&...args)
+      : Connection(std::move(inbox), options, accepted), _ws(std::forward<Args>(args)...), _resolver(Reactor::get().ioCtx) {}
+
+  // Client side, resolve, connect, TLS handshake if secure and finally the WebSocket handshake
+  void connect(std::string host, std::string port, std::string target) {
+    net::post(Reactor::get().ioCtx, [self = shared(), host = std::move(host), port = std::move(port),
+                                     target = std::move(target)]() mutable {
+      self->_resolver.async_resolve(host, port,
+                                    [self, host, target](beast::error_code ec, tcp::resolver::results_type results) mutable {
+                                      if (ec)
+                                        return self->fail("Failed to resolve host: " + ec.message());
+                                      self->connectTo(std::move(host), std::move(target), results);
+                                    });
+    });
+  }
+
+  // Server side, the socket was accepted already
+  void accept() {
+    net::post(Reactor::get().ioCtx, [self = shared()]() {
+      self->configure(beast::role_type::server);
+      self->_ws.async_accept([self](beast::error_code ec) {
+        if (ec)
+          return self->fail("WebSocket accept failed: " + ec.message());
+        self->opened();
+      });
+    });
+  }
+
+protected:
+  void read() override {
+    _ws.async_read(_buffer, [self = shared()](beast::error_code ec, std::size_t) {
+      if (ec)
+        return self->fail(ec == websocket::error::closed ? "Connection closed" : "Read failed: " + ec.message());
+      const auto data = self->_buffer.data();
+      std::string message(static_cast<const char *>(data.data()), data.size());
+      self->_buffer.consume(self->_buffer.size());
+      self->received(std::move(message), !self->_ws.got_text());
+    });
+  }
 
-  bool _secure;
+  void write() override {
+    auto &front = _outbox.front();
+    _ws.binary(front.binary);
+    _ws.async_write(net::buffer(front.data), [self = shared()](beast::error_code ec, std::size_t) {
+      if (ec)
+        return self->fail("Write failed: " + ec.message());
+      self->written();
+    });
+  }
+
+  void shutdown() override {
+    _ws.async_close(websocket::close_code::normal, [self = shared()](beast::error_code ec) { self->fail("Connection closed"); });
+  }
+
+private:
+  std::shared_ptr<Session> shared() { return std::static_pointer_cast<Session>(shared_from_this()); }
+
+  void configure(beast::role_type role) {
+    websocket::stream_base::timeout timeouts = websocket::stream_base::timeout::suggested(role);
+    timeouts.idle_timeout = std::chrono::milliseconds(int64_t(_options.timeout * 1000.0));
+    timeouts.keep_alive_pings = true;
+    _ws.set_option(timeouts);
+
+    if (_options.compress) {
+      websocket::permessage_deflate deflate;
+      deflate.client_enable = true;
+      deflate.server_enable = true;
+      _ws.set_option(deflate);
+    }
+
+    // big messages are sent as a sequence of frames
+    _ws.auto_fragment(true);
+    _ws.write_buffer_bytes(_options.fragmentSize);
+    _ws.read_message_max(_options.maxMessageSize);
+
+    const auto agent = std::string(BOOST_BEAST_VERSION_STRING) + " shards-websocket";
+    if (role == beast::role_type::client) {
+      _ws.set_option(
+          websocket::stream_base::decorator([agent](websocket::request_type &req) { req.set(http::field::user_agent, agent); }));
+    } else {
+      _ws.set_option(
+          websocket::stream_base::decorator([agent](websocket::response_type &res) { res.set(http::field::server, agent); }));
+    }
+  }
+
+  void connectTo(std::string host, std::string target, const tcp::resolver::results_type &results) {
+    auto &lowest = beast::get_lowest_layer(_ws);
+    lowest.expires_after(std::chrono::seconds(30));
+    lowest.async_connect(results, [self = shared(), host = std::move(host), target = std::move(target)](
+                                      beast::error_code ec, tcp::resolver::results_type::endpoint_type ep) mutable {
+      if (ec)
+        return self->fail("Failed to connect: " + ec.message());
+      if constexpr (Secure) {
+        // Set SNI Hostname (many hosts need this to handshake successfully)
+        if (!SSL_set_tlsext_host_name(self->_ws.next_layer().native_handle(), host.c_str()))
+          return self->fail("Failed to set SNI host name");
+      }
+      // as per RFC 7230 the Host header includes the port
+      host += ':' + std::to_string(ep.port());
+      if constexpr (Secure) {
+        self->_ws.next_layer().async_handshake(ssl::stream_base::client,
+                                               [self, host = std::move(host), target = std::move(target)](
+                                                   beast::error_code ec) mutable {
+                                                 if (ec)
+                                                   return self->fail("SSL handshake failed: " + ec.message());
+                                                 self->handshake(std::move(host), std::move(target));
+                                               });
+      } else {
+        self->handshake(std::move(host), std::move(target));
+      }
+    });
+  }
+
+  void handshake(std::string host, std::string target) {
+    // websocket has its own timeouts
+    beast::get_lowest_layer(_ws).expires_never();
+    configure(beast::role_type::client);
+    SHLOG_DEBUG("WebSocket handshake with: {}", host);
+    _ws.async_handshake(host, target, [self = shared()](beast::error_code ec) {
+      if (ec)
+        return self->fail("WebSocket handshake failed: " + ec.message());
+      SHLOG_TRACE("Websocket performed handshake");
+      self->opened();
+    });
+  }
+
+  websocket::stream<Stream> _ws;
+  tcp::resolver _resolver;
+  beast::flat_buffer _buffer;
 };
 
+using PlainSession = Session<beast::tcp_stream>;
+using SecureSession = Session<beast::ssl_stream<beast::tcp_stream>>;
+
 struct Client {
   static SHTypesInfo inputTypes() { return CoreInfo::NoneType; }
   static SHTypesInfo outputTypes() { return Common::WebSocket; }
@@ -85,6 +385,10 @@ struct Client {
         {"Certificate",
          SHCCSTR("If the connection is secured, you can specify a CA certificate pem file to use."),
          {CoreInfo::StringType, CoreInfo::StringVarType, CoreInfo::NoneType}},
+        {"Compress", SHCCSTR("If permessage-deflate compression should be negotiated."), {CoreInfo::BoolType}},
+        {"Timeout",
+         SHCCSTR("The idle timeout in seconds, keepalive pings are sent at half of it."),
+         {CoreInfo::FloatType, CoreInfo::IntType}},
     };
     return params;
   }
@@ -106,6 +410,12 @@ struct Client {
     case 4:
       certificate = value;
       break;
+    case 5:
+      options.compress = value.payload.boolValue;
+      break;
+    case 6:
+      options.timeout = value.valueType == SHType::Int ? double(value.payload.intValue) : value.payload.floatValue;
+      break;
     default:
       break;
     }
@@ -123,99 +433,48 @@ struct Client {
       return Var(ssl);
     case 4:
       return certificate;
+    case 5:
+      return Var(options.compress);
+    case 6:
+      return Var(options.timeout);
     default:
       return {};
     }
   }
 
   void connect(SHContext *context) {
-    try {
-      boost::asio::io_context ioc;
-      tcp::resolver resolver{ioc};
-      await(
-          context,
-          [&] {
-            boost::system::error_code error;
-            auto resolved = resolver.resolve(host.get().payload.stringValue, std::to_string(port.get().payload.intValue), error);
-
-            if (error) {
-              throw ActivationError("Failed to resolve host");
-            }
-
-            SHLOG_TRACE("Websocket resolved remote host");
-
-            if (ssl) {
-              // Set SNI Hostname (many hosts need this to handshake successfully)
-              if (!SSL_set_tlsext_host_name(ws->get_secure().next_layer().native_handle(), host.get().payload.stringValue)) {
-                boost::system::error_code ec{static_cast<int>(::ERR_get_error()), boost::asio::error::get_ssl_category()};
-                throw boost::system::system_error{ec};
-              }
-
-              // add custom certs if we need
-              auto certVar = certificate.get();
-              if (certVar.valueType != SHType::None) {
-                auto cert = certVar.payload.stringValue;
-                auto certPath = SHSTRVIEW(certificate.get());
-                std::string certStr(certPath.begin(), certPath.end());
-                ws->secureCtx.load_verify_file(certStr);
-              }
-            }
-
-            // Make the connection on the IP address we get from a lookup
-            auto ep = ssl ? net::connect(get_lowest_layer(ws->get_secure()), resolved)
-                          : net::connect(ws->get_unsecure().next_layer(), resolved);
-            std::string h = host.get().payload.stringValue;
-            h += ':' + std::to_string(ep.port());
-
-            SHLOG_TRACE("Websocket connected with the remote host");
-
-            // Set a decorator to change the User-Agent of the handshake
-            if (ssl) {
-              ws->get_secure().set_option(websocket::stream_base::decorator([](websocket::request_type &req) {
-                req.set(http::field::user_agent, std::string(BOOST_BEAST_VERSION_STRING) + " websocket-client-coro");
-              }));
-            } else {
-              ws->get_unsecure().set_option(websocket::stream_base::decorator([](websocket::request_type &req) {
-                req.set(http::field::user_agent, std::string(BOOST_BEAST_VERSION_STRING) + " websocket-client-coro");
-              }));
-            }
-
-            websocket::stream_base::timeout timeouts{
-                std::chrono::seconds(30), // handshake timeout
-                std::chrono::seconds(30), // idle timeout
-                true                      // send ping at half idle timeout
-            };
-
-            if (ssl)
-              ws->get_secure().set_option(timeouts);
-            else
-              ws->get_unsecure().set_option(timeouts);
-
-            if (ssl) {
-              // Perform the SSL handshake
-              ws->get_secure().next_layer().handshake(ssl::stream_base::client);
-              SHLOG_TRACE("Websocket performed SSL handshake");
-            }
-
-            SHLOG_DEBUG("WebSocket handshake with: {}", h);
-
-            // Perform the websocket handshake
-            if (ssl)
-              ws->get_secure().handshake(h, target.get().payload.stringValue);
-            else
-              ws->get_unsecure().handshake(h, target.get().payload.stringValue);
-
-            SHLOG_TRACE("Websocket performed handshake");
-
-            connected = true;
-          },
-          [&] {
-            SHLOG_DEBUG("Cancelling WebSocket connection");
-            resolver.cancel();
-            ws->close();
-          });
-    } catch (const std::exception &ex) {
-      SHLOG_WARNING("WebSocket connection failed: {}", ex.what());
+    auto inbox = std::make_shared<Inbox>();
+    std::string hostStr(SHSTRVIEW(host.get()));
+    std::string targetStr(SHSTRVIEW(target.get()));
+    auto portStr = std::to_string(port.get().payload.intValue);
+
+    if (ssl) {
+      // add custom certs if we need
+      auto certVar = certificate.get();
+      if (certVar.valueType != SHType::None) {
+        auto certPath = SHSTRVIEW(certVar);
+        std::string certStr(certPath.begin(), certPath.end());
+        try {
+          secureCtx.load_verify_file(certStr);
+        } catch (const std::exception &ex) {
+          SHLOG_WARNING("WebSocket failed to load certificate: {}", ex.what());
+          throw ActivationError("WebSocket connection failed.");
+        }
+      }
+      auto session = std::make_shared<SecureSession>(inbox, options, false, Reactor::get().ioCtx, secureCtx);
+      session->connect(hostStr, portStr, targetStr);
+      ws = session;
+    } else {
+      auto session = std::make_shared<PlainSession>(inbox, options, false, Reactor::get().ioCtx);
+      session->connect(hostStr, portStr, targetStr);
+      ws = session;
+    }
+
+    if (!waitFor(context, *inbox, [&]() { return ws->state() != Connection::State::Connecting; }))
+      return;
+
+    if (ws->state() != Connection::State::Open) {
+      SHLOG_WARNING("WebSocket connection failed: {}", ws->error());
       throw ActivationError("WebSocket connection failed.");
     }
   }
@@ -226,11 +485,9 @@ struct Client {
     target.cleanup();
     certificate.cleanup();
 
-    if (socket) {
-      releaseVariable(socket);
+    if (ws) {
+      ws->close();
       ws = nullptr;
-      socket = nullptr;
-      connected = false;
     }
   }
 
@@ -239,41 +496,30 @@ struct Client {
     host.warmup(ctx);
     target.warmup(ctx);
     certificate.warmup(ctx);
-
-    socket = referenceVariable(ctx, name.c_str());
-  }
-
-  SHExposedTypesInfo exposedVariables() {
-    _expInfo = SHExposedTypeInfo{name.c_str(), SHCCSTR("The exposed websocket."), Common::WebSocket};
-    _expInfo.isProtected = true;
-    return SHExposedTypesInfo{&_expInfo, 1, 0};
   }
 
   SHVar activate(SHContext *context, const SHVar &input) {
-    ws = std::make_shared<Socket>(ssl);
+    if (ws)
+      ws->close();
     connect(context);
     return Var::Object(&ws, CoreCC, WebSocketCC);
   }
 
 protected:
-  std::string name;
   ParamVar port{Var(443)};
   ParamVar host{Var("echo.websocket.org")};
   ParamVar target{Var("/")};
   bool ssl = true;
   ParamVar certificate{};
+  Options options{};
 
-  SHExposedTypeInfo _expInfo{};
-
-  bool connected = false;
-  SHVar *socket;
+  ssl::context secureCtx{ssl::context::tlsv12_client};
 
-  // These objects perform our I/O
-  std::shared_ptr<Socket> ws{nullptr};
+  std::shared_ptr<Connection> ws{nullptr};
 };
 
 struct User {
-  std::shared_ptr<Socket> _ws;
+  std::shared_ptr<Connection> _ws;
   void *_lastObject = nullptr;
   ParamVar _wsVar{};
   SHExposedTypeInfo _expInfo{};
@@ -299,8 +545,10 @@ struct User {
   }
 
   void ensureSocket() {
-    auto p_ws = reinterpret_cast<std::shared_ptr<Socket> *>(_wsVar.get().payload.objectValue);
+    auto p_ws = reinterpret_cast<std::shared_ptr<Connection> *>(_wsVar.get().payload.objectValue);
     auto obj = p_ws->get();
+    if (!obj)
+      throw ActivationError("WebSocket is not connected.");
     if (_lastObject != obj) {
       _ws = *p_ws;
       _lastObject = obj;
@@ -324,35 +572,19 @@ struct WriteString : public User {
   SHVar activate(SHContext *context, const SHVar &input) {
     ensureSocket();
 
-    std::string_view payload{};
-
-    if (input.payload.stringLen > 0) {
-      payload = std::string_view(input.payload.stringValue, input.payload.stringLen);
-    } else {
-      payload = std::string_view(input.payload.stringValue);
-    }
-
-    try {
-      await(
-          context,
-          [&]() {
-            if (_ws->secure())
-              _ws->get_secure().write(net::buffer(payload));
-            else
-              _ws->get_unsecure().write(net::buffer(payload));
-          },
-          [] {});
-    } catch (const std::exception &ex) {
-      SHLOG_WARNING("WebSocket write failed: {}", ex.what());
+    if (_ws->state() == Connection::State::Closed) {
+      SHLOG_WARNING("WebSocket write failed: {}", _ws->error());
       throw ActivationError("WebSocket write failed.");
     }
 
+    // queued, never blocks the wire
+    _ws->send(SHSTRVIEW(input), false);
     return input;
   }
 };
 
 struct ReadString : public User {
-  beast::flat_buffer _buffer;
+  Message _message;
   std::string _output;
 
   static SHTypesInfo inputTypes() { return CoreInfo::NoneType; }
@@ -361,35 +593,241 @@ struct ReadString : public User {
   SHVar activate(SHContext *context, const SHVar &input) {
     ensureSocket();
 
-    _buffer.clear();
-
-    try {
-      await(
-          context,
-          [&]() {
-            if (_ws->secure())
-              _ws->get_secure().read(_buffer);
-            else
-              _ws->get_unsecure().read(_buffer);
-          },
-          [] {});
-    } catch (const std::exception &ex) {
-      SHLOG_WARNING("WebSocket read failed: {}", ex.what());
+    if (_ws->accepted())
+      throw ActivationError("WebSocket server peers are read by the WS.Server handler.");
+
+    auto &inbox = _ws->inbox();
+    bool stopped = false;
+    const auto received = recordData(_output, [&]() {
+      bool popped = false;
+      if (!waitFor(context, inbox, [&]() {
+            popped = inbox.pop(_message);
+            return popped || _ws->state() == Connection::State::Closed;
+          })) {
+        stopped = true;
+        return false;
+      }
+      if (popped)
+        std::swap(_output, _message.data);
+      return popped;
+    });
+    if (stopped)
+      return Var::Empty;
+
+    if (!received) {
+      SHLOG_WARNING("WebSocket read failed: {}", _ws->error());
       throw ActivationError("WebSocket read failed.");
     }
 
-    _output.clear();
-    const auto data = _buffer.data();
-    _output.reserve(data.size());
-    _output.append(static_cast<char const *>(data.data()), data.size());
     return Var(_output);
   }
 };
 
+struct Server {
+  static constexpr std::string_view PeerVariable = "WS.Peer";
+
+  static SHOptionalString help() {
+    return SHCCSTR("Accepts WebSocket connections and runs Handler for every message received, the sending peer is "
+                   "available to the handler as the WS.Peer variable.");
+  }
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AnyType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::AnyType; }
+
+  static SHParametersInfo parameters() {
+    static Parameters params{
+        {"Address", SHCCSTR("The local bind address."), {CoreInfo::StringType}},
+        {"Port", SHCCSTR("The port to listen on."), {CoreInfo::IntType}},
+        {"Handler", SHCCSTR("The shards to run for every message, the input is the message."), {CoreInfo::ShardsOrNone}},
+        {"Compress", SHCCSTR("If permessage-deflate compression should be accepted."), {CoreInfo::BoolType}},
+        {"Timeout",
+         SHCCSTR("The idle timeout in seconds, keepalive pings are sent at half of it."),
+         {CoreInfo::FloatType, CoreInfo::IntType}},
+    };
+    return params;
+  }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _address = SHSTRVIEW(value);
+      break;
+    case 1:
+      _port = uint16_t(value.payload.intValue);
+      break;
+    case 2:
+      _handler = value;
+      break;
+    case 3:
+      _options.compress = value.payload.boolValue;
+      break;
+    case 4:
+      _options.timeout = value.valueType == SHType::Int ? double(value.payload.intValue) : value.payload.floatValue;
+      break;
+    default:
+      break;
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return Var(_address);
+    case 1:
+      return Var(int64_t(_port));
+    case 2:
+      return _handler;
+    case 3:
+      return Var(_options.compress);
+    case 4:
+      return Var(_options.timeout);
+    default:
+      return Var::Empty;
+    }
+  }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    // we need to edit a copy of data
+    SHInstanceData dataCopy = data;
+    // we need to deep copy it
+    dataCopy.shared = {};
+    DEFER({ arrayFree(dataCopy.shared); });
+    for (uint32_t i = 0; i < data.shared.len; i++) {
+      arrayPush(dataCopy.shared, data.shared.elements[i]);
+    }
+    arrayPush(dataCopy.shared, ExposedInfo::Variable(PeerVariable.data(), SHCCSTR("The peer that sent the message."),
+                                                     SHTypeInfo(Common::WebSocket)));
+    dataCopy.inputType = CoreInfo::StringType;
+    _handler.compose(dataCopy);
+    return data.inputType;
+  }
+
+  void warmup(SHContext *context) {
+    _handler.warmup(context);
+    _peerVar = referenceVariable(context, PeerVariable.data());
+  }
+
+  void cleanup() {
+    if (_listener) {
+      _listener->stop();
+      _listener = nullptr;
+    }
+    _peer = nullptr;
+    _inbox = nullptr;
+
+    if (_peerVar) {
+      releaseVariable(_peerVar);
+      _peerVar = nullptr;
+    }
+
+    _handler.cleanup();
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    if (!_listener) {
+      _inbox = std::make_shared<Inbox>();
+      _listener = std::make_shared<Listener>(_inbox, _options);
+      try {
+        _listener->listen(_address, _port);
+      } catch (const std::exception &ex) {
+        SHLOG_ERROR("WebSocket server failed to listen on {}:{}: {}", _address, _port, ex.what());
+        _listener = nullptr;
+        throw ActivationError("WebSocket server failed to listen.");
+      }
+    }
+
+    // run the handler for every message received since the last activation
+    Message message;
+    while (_inbox->pop(message)) {
+      _peer = message.from.lock();
+      if (!_peer)
+        continue;
+
+      auto rc = _peerVar->refcount;
+      auto rcflag = _peerVar->flags & SHVAR_FLAGS_REF_COUNTED;
+      *_peerVar = Var::Object(&_peer, CoreCC, WebSocketCC);
+      _peerVar->refcount = rc;
+      _peerVar->flags |= rcflag;
+
+      SHVar output{};
+      if (_handler.activate(context, Var(message.data), output) != SHWireState::Continue)
+        break;
+    }
+
+    return input;
+  }
+
+private:
+  // Accepts connections on the reactor, they all share the server inbox
+  struct Listener : public std::enable_shared_from_this<Listener> {
+    Listener(std::shared_ptr<Inbox> inbox, const Options &options)
+        : _inbox(std::move(inbox)), _options(options), _acceptor(Reactor::get().ioCtx) {}
+
+    void listen(const std::string &address, uint16_t port) {
+      tcp::endpoint endpoint{net::ip::make_address(address), port};
+      _acceptor.open(endpoint.protocol());
+      _acceptor.set_option(net::socket_base::reuse_address(true));
+      _acceptor.bind(endpoint);
+      _acceptor.listen(net::socket_base::max_listen_connections);
+      net::post(Reactor::get().ioCtx, [self = shared_from_this()]() { self->accept(); });
+    }
+
+    void stop() {
+      net::post(Reactor::get().ioCtx, [self = shared_from_this()]() {
+        beast::error_code ec;
+        self->_acceptor.close(ec);
+        for (auto &[_, peer] : self->_peers)
+          peer->close();
+        self->_peers.clear();
+      });
+    }
+
+    void accept() {
+      _acceptor.async_accept([self = shared_from_this()](beast::error_code ec, tcp::socket socket) {
+        if (ec == net::error::operation_aborted)
+          return;
+        if (!ec) {
+          auto peer = std::make_shared<PlainSession>(self->_inbox, self->_options, true, std::move(socket));
+          peer->accept();
+          self->track(peer);
+        } else {
+          SHLOG_DEBUG("WebSocket accept failed: {}", ec.message());
+        }
+        self->accept();
+      });
+    }
+
+    // The listener owns its peers until they close, a peer paused by a full inbox has no pending handler keeping it alive
+    void track(const std::shared_ptr<Connection> &peer) {
+      peer->onClosed([weak = weak_from_this(), raw = peer.get()]() {
+        if (auto self = weak.lock())
+          self->_peers.erase(raw);
+      });
+      _peers.emplace(peer.get(), peer);
+    }
+
+    std::shared_ptr<Inbox> _inbox;
+    Options _options;
+    tcp::acceptor _acceptor;
+    std::unordered_map<Connection *, std::shared_ptr<Connection>> _peers;
+  };
+
+  std::string _address{"0.0.0.0"};
+  uint16_t _port{8080};
+  ShardsVar _handler{};
+  Options _options{};
+
+  std::shared_ptr<Inbox> _inbox;
+  std::shared_ptr<Listener> _listener;
+  std::shared_ptr<Connection> _peer;
+  SHVar *_peerVar{nullptr};
+};
+
 void registerShards() {
   REGISTER_SHARD("WS.Client", Client);
   REGISTER_SHARD("WS.WriteString", WriteString);
   REGISTER_SHARD("WS.ReadString", ReadString);
+  REGISTER_SHARD("WS.Server", Server);
 }
 } // namespace WS
 } // namespace shards
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: BSD-3-Clause */
 /* Copyright © 2020 Fragcolor Pte. Ltd. */
 
+#include "shards/compression.hpp"
 #include "shards/shared.hpp"
 #include "runtime.hpp"
 #include <brotli/decode.h>
@@ -8,28 +9,67 @@
 
 namespace shards {
 namespace Brotli {
+// Output grows by this much while streaming
+constexpr size_t StreamStep = 16384;
+
 struct Compress {
   std::vector<uint8_t> _buffer;
   int _quality{BROTLI_DEFAULT_QUALITY};
+  bool _stream{false};
+  BrotliEncoderState *_encoder{nullptr};
 
   static SHTypesInfo inputTypes() { return CoreInfo::BytesType; }
   static SHTypesInfo outputTypes() { return CoreInfo::BytesType; }
 
-  static inline Parameters params{{"Quality",
-                                   SHCCSTR("Compression quality, higher is better but slower, valid values "
-                                           "from 1 to 11."),
-                                   {CoreInfo::IntType}}};
+  static inline Parameters params{
+      {"Quality",
+       SHCCSTR("Compression quality, higher is better but slower, valid values "
+               "from 1 to 11."),
+       {CoreInfo::IntType}},
+      {"Stream",
+       SHCCSTR("Keep compressing on the same stream across activations, each output is a flushed chunk only a streaming "
+               "Brotli.Decompress can read, in order. Many small and similar values compress much better this way."),
+       {CoreInfo::BoolType}}};
 
   SHParametersInfo parameters() { return params; }
 
   void setParam(int index, const SHVar &value) {
-    _quality = int(value.payload.intValue);
-    _quality = std::clamp(_quality, 1, 11);
+    switch (index) {
+    case 0:
+      _quality = int(value.payload.intValue);
+      _quality = std::clamp(_quality, 1, 11);
+      break;
+    case 1:
+      _stream = value.payload.boolValue;
+      break;
+    default:
+      break;
+    }
   }
 
-  SHVar getParam(int index) { return Var(_quality); }
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return Var(_quality);
+    case 1:
+      return Var(_stream);
+    default:
+      return Var::Empty;
+    }
+  }
+
+  // the stream restarts on every run
+  void cleanup() {
+    if (_encoder) {
+      BrotliEncoderDestroyInstance(_encoder);
+      _encoder = nullptr;
+    }
+  }
 
   SHVar activate(SHContext *context, const SHVar &input) {
+    if (_stream)
+      return compressStream(input);
+
     auto maxLen = BrotliEncoderMaxCompressedSize(input.payload.bytesSize);
     _buffer.resize(maxLen + sizeof(uint32_t));
     size_t outputLen = maxLen;
@@ -42,15 +82,62 @@ struct Compress {
     *len = input.payload.bytesSize;
     return Var((uint8_t *)&_buffer[0], uint32_t(outputLen + sizeof(uint32_t)));
   }
+
+  SHVar compressStream(const SHVar &input) {
+    if (!_encoder) {
+      _encoder = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+      if (!_encoder)
+        throw ActivationError("Failed to create the brotli encoder");
+      BrotliEncoderSetParameter(_encoder, BROTLI_PARAM_QUALITY, uint32_t(_quality));
+    }
+
+    size_t availableIn = input.payload.bytesSize;
+    const uint8_t *nextIn = input.payload.bytesValue;
+    _buffer.clear();
+    do {
+      const auto pos = _buffer.size();
+      _buffer.resize(pos + StreamStep);
+      size_t availableOut = StreamStep;
+      uint8_t *nextOut = &_buffer[pos];
+      if (!BrotliEncoderCompressStream(_encoder, BROTLI_OPERATION_FLUSH, &availableIn, &nextIn, &availableOut, &nextOut,
+                                       nullptr)) {
+        throw ActivationError("Failed to compress");
+      }
+      _buffer.resize(pos + StreamStep - availableOut);
+    } while (availableIn > 0 || BrotliEncoderHasMoreOutput(_encoder));
+    return Var((uint8_t *)_buffer.data(), uint32_t(_buffer.size()));
+  }
 };
 
 struct Decompress {
   std::vector<uint8_t> _buffer;
+  bool _stream{false};
+  BrotliDecoderState *_decoder{nullptr};
 
   static SHTypesInfo inputTypes() { return CoreInfo::BytesType; }
   static SHTypesInfo outputTypes() { return CoreInfo::BytesType; }
 
+  static inline Parameters params{
+      {"Stream", SHCCSTR("Decompress the chunks of a streaming Brotli.Compress, in the order they were produced."),
+       {CoreInfo::BoolType}}};
+
+  SHParametersInfo parameters() { return params; }
+
+  void setParam(int index, const SHVar &value) { _stream = value.payload.boolValue; }
+
+  SHVar getParam(int index) { return Var(_stream); }
+
+  void cleanup() {
+    if (_decoder) {
+      BrotliDecoderDestroyInstance(_decoder);
+      _decoder = nullptr;
+    }
+  }
+
   SHVar activate(SHContext *context, const SHVar &input) {
+    if (_stream)
+      return decompressStream(input);
+
     auto len = reinterpret_cast<uint32_t *>(input.payload.bytesValue);
     auto buffer = &input.payload.bytesValue[sizeof(uint32_t)];
     auto bufferSize = input.payload.bytesSize - sizeof(uint32_t);
@@ -63,9 +150,65 @@ struct Decompress {
     _buffer[*len] = 0;
     return Var((uint8_t *)&_buffer[0], uint32_t(*len));
   }
+
+  SHVar decompressStream(const SHVar &input) {
+    if (!_decoder) {
+      _decoder = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+      if (!_decoder)
+        throw ActivationError("Failed to create the brotli decoder");
+    }
+
+    size_t availableIn = input.payload.bytesSize;
+    const uint8_t *nextIn = input.payload.bytesValue;
+    _buffer.clear();
+    BrotliDecoderResult res;
+    do {
+      const auto pos = _buffer.size();
+      _buffer.resize(pos + StreamStep);
+      size_t availableOut = StreamStep;
+      uint8_t *nextOut = &_buffer[pos];
+      res = BrotliDecoderDecompressStream(_decoder, &availableIn, &nextIn, &availableOut, &nextOut, nullptr);
+      _buffer.resize(pos + StreamStep - availableOut);
+    } while (res == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
+    // needing more input just means the chunk was fully consumed
+    if (res == BROTLI_DECODER_RESULT_ERROR) {
+      throw ActivationError("Failed to decompress");
+    }
+    const auto len = _buffer.size();
+    _buffer.push_back(0);
+    return Var((uint8_t *)&_buffer[0], uint32_t(len));
+  }
+};
+
+// Brotli one shot functions need no state, the context only exists for the compression frames
+class Context : public compression::Context {
+public:
+  Context(int level) : _quality(level > 0 ? std::clamp(level, 1, 11) : BROTLI_DEFAULT_QUALITY) {}
+
+  size_t bound(size_t size) const override { return BrotliEncoderMaxCompressedSize(size); }
+
+  size_t compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity) override {
+    size_t outputLen = capacity;
+    if (BrotliEncoderCompress(_quality, BROTLI_DEFAULT_WINDOW, BROTLI_DEFAULT_MODE, size, src, &outputLen, dst) != BROTLI_TRUE)
+      throw SHException("Brotli failed to compress");
+    return outputLen;
+  }
+
+  void decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t originalSize) override {
+    size_t outputLen = originalSize;
+    if (BrotliDecoderDecompress(size, src, &outputLen, dst) != BROTLI_DECODER_RESULT_SUCCESS || outputLen != originalSize)
+      throw SHException("Brotli failed to decompress");
+  }
+
+private:
+  int _quality;
 };
 
 void registerShards() {
+  compression::registerCodec(
+      compression::Codec::Brotli,
+      [](const compression::Options &options) { return std::make_unique<Context>(options.level); }, false);
+
   REGISTER_SHARD("Brotli.Compress", Compress);
   REGISTER_SHARD("Brotli.Decompress", Decompress);
 }
@@ -1,61 +1,604 @@
 /* SPDX-License-Identifier: BSD-3-Clause */
 /* Copyright © 2021 Fragcolor Pte. Ltd. */
 
+#include "dsp.hpp"
 #include "shards/shared.hpp"
 #include "runtime.hpp"
-
-#include "kiss_fft.h"
-#include "kiss_fftr.h"
-
-// TODO optimize.
-// Best would be to introduce our SHVar packing in kissfft fork
-// Just like linalg, so to use our types directly
+#include <cmath>
+#include <mutex>
+#include <numeric>
+#include <unordered_map>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 namespace shards {
 namespace DSP {
+namespace {
+constexpr double Pi = 3.14159265358979323846;
+
+bool isPowerOfTwo(size_t n) { return (n & (n - 1)) == 0; }
+
+size_t nextPowerOfTwo(size_t n) {
+  size_t p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+// x1 *= w, then x0, x1 = x0 + x1, x0 - x1 for half split complex numbers
+inline void butterflies(float *__restrict re0, float *__restrict im0, float *__restrict re1, float *__restrict im1,
+                        const float *wr, const float *wi, size_t half) {
+  size_t k = 0;
+#if defined(__AVX2__)
+  for (; k + 8 <= half; k += 8) {
+    const __m256 xr = _mm256_loadu_ps(re1 + k);
+    const __m256 xi = _mm256_loadu_ps(im1 + k);
+    const __m256 cr = _mm256_loadu_ps(wr + k);
+    const __m256 ci = _mm256_loadu_ps(wi + k);
+    const __m256 tr = _mm256_sub_ps(_mm256_mul_ps(xr, cr), _mm256_mul_ps(xi, ci));
+    const __m256 ti = _mm256_add_ps(_mm256_mul_ps(xr, ci), _mm256_mul_ps(xi, cr));
+    const __m256 ur = _mm256_loadu_ps(re0 + k);
+    const __m256 ui = _mm256_loadu_ps(im0 + k);
+    _mm256_storeu_ps(re0 + k, _mm256_add_ps(ur, tr));
+    _mm256_storeu_ps(im0 + k, _mm256_add_ps(ui, ti));
+    _mm256_storeu_ps(re1 + k, _mm256_sub_ps(ur, tr));
+    _mm256_storeu_ps(im1 + k, _mm256_sub_ps(ui, ti));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; k + 4 <= half; k += 4) {
+    const float32x4_t xr = vld1q_f32(re1 + k);
+    const float32x4_t xi = vld1q_f32(im1 + k);
+    const float32x4_t cr = vld1q_f32(wr + k);
+    const float32x4_t ci = vld1q_f32(wi + k);
+    const float32x4_t tr = vfmsq_f32(vmulq_f32(xr, cr), xi, ci);
+    const float32x4_t ti = vfmaq_f32(vmulq_f32(xr, ci), xi, cr);
+    const float32x4_t ur = vld1q_f32(re0 + k);
+    const float32x4_t ui = vld1q_f32(im0 + k);
+    vst1q_f32(re0 + k, vaddq_f32(ur, tr));
+    vst1q_f32(im0 + k, vaddq_f32(ui, ti));
+    vst1q_f32(re1 + k, vsubq_f32(ur, tr));
+    vst1q_f32(im1 + k, vsubq_f32(ui, ti));
+  }
+#endif
+  for (; k < half; k++) {
+    const float tr = re1[k] * wr[k] - im1[k] * wi[k];
+    const float ti = re1[k] * wi[k] + im1[k] * wr[k];
+    re1[k] = re0[k] - tr;
+    im1[k] = im0[k] - ti;
+    re0[k] += tr;
+    im0[k] += ti;
+  }
+}
+
+inline float dot(const float *a, const float *b, size_t n) {
+  size_t i = 0;
+  float sum = 0.0f;
+#if defined(__AVX2__)
+  __m256 acc = _mm256_setzero_ps();
+  for (; i + 8 <= n; i += 8)
+    acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  s = _mm_hadd_ps(s, s);
+  s = _mm_hadd_ps(s, s);
+  sum = _mm_cvtss_f32(s);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  float32x4_t acc = vdupq_n_f32(0.0f);
+  for (; i + 4 <= n; i += 4)
+    acc = vfmaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+  sum = vaddvq_f32(acc);
+#endif
+  for (; i < n; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+double besselI0(double x) {
+  const double q = x * x / 4.0;
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 64 && term > sum * 1e-12; k++) {
+    term *= q / (double(k) * double(k));
+    sum += term;
+  }
+  return sum;
+}
+
+// Scratch of the frames of a batch, per thread so that a steady stream of batches doesn't allocate
+float *batchScratch(size_t size) {
+  static thread_local std::vector<float> scratch;
+  if (scratch.size() < size)
+    scratch.resize(size);
+  return scratch.data();
+}
+
+template <typename F> void runBatch(const Plan &plan, size_t count, F &&fn) {
+  // floats a lane should transform at least, the pool costs more than it saves below
+  constexpr size_t LaneWork = 1 << 15;
+  const auto lanes = std::min({count, size_t(SharedThreadPoolConcurrency::get()),
+                               std::max(size_t(1), count * plan.signalFloats() / LaneWork)});
+  parallelFor(lanes, [&](size_t lane) {
+    auto scratch = batchScratch(plan.scratchSize());
+    for (size_t i = lane; i < count; i += lanes)
+      fn(i, scratch);
+  });
+}
+} // namespace
+
+struct Plan::Transform {
+  explicit Transform(size_t n) : n(n) {}
+  virtual ~Transform() = default;
+
+  // Forward transform of n split complex numbers in place, running it on swapped re and im gives the inverse
+  virtual void run(float *re, float *im, float *scratch) const = 0;
+  virtual size_t scratchSize() const { return 0; }
+
+  const size_t n;
+};
+
+namespace {
+class Radix2 final : public Plan::Transform {
+public:
+  explicit Radix2(size_t n) : Transform(n), _reversed(n) {
+    unsigned bits = 0;
+    while ((size_t(1) << bits) < n)
+      bits++;
+    for (size_t i = 0; i < n; i++) {
+      size_t r = 0;
+      for (unsigned b = 0; b < bits; b++)
+        r |= ((i >> b) & 1) << (bits - 1 - b);
+      _reversed[i] = uint32_t(r);
+    }
+
+    // stage twiddles are contiguous, the half of a stage is also its offset + 1
+    if (n > 1) {
+      _twiddlesRe.resize(n - 1);
+      _twiddlesIm.resize(n - 1);
+      for (size_t half = 1; half < n; half *= 2) {
+        for (size_t k = 0; k < half; k++) {
+          const double angle = -Pi * double(k) / double(half);
+          _twiddlesRe[half - 1 + k] = float(std::cos(angle));
+          _twiddlesIm[half - 1 + k] = float(std::sin(angle));
+        }
+      }
+    }
+  }
+
+  void run(float *re, float *im, float *scratch) const override {
+    for (size_t i = 0; i < n; i++) {
+      const size_t j = _reversed[i];
+      if (i < j) {
+        std::swap(re[i], re[j]);
+        std::swap(im[i], im[j]);
+      }
+    }
+
+    size_t half = 1;
+    if (n >= 4) {
+      // the first two stages as one radix 4 pass, their twiddles are 1 and -i
+      for (size_t j = 0; j < n; j += 4) {
+        const float a0r = re[j] + re[j + 1], a0i = im[j] + im[j + 1];
+        const float a1r = re[j] - re[j + 1], a1i = im[j] - im[j + 1];
+        const float a2r = re[j + 2] + re[j + 3], a2i = im[j + 2] + im[j + 3];
+        const float a3r = re[j + 2] - re[j + 3], a3i = im[j + 2] - im[j + 3];
+        re[j] = a0r + a2r;
+        im[j] = a0i + a2i;
+        re[j + 2] = a0r - a2r;
+        im[j + 2] = a0i - a2i;
+        re[j + 1] = a1r + a3i;
+        im[j + 1] = a1i - a3r;
+        re[j + 3] = a1r - a3i;
+        im[j + 3] = a1i + a3r;
+      }
+      half = 4;
+    }
+
+    for (; half < n; half *= 2) {
+      const float *wr = &_twiddlesRe[half - 1];
+      const float *wi = &_twiddlesIm[half - 1];
+      for (size_t j = 0; j < n; j += half * 2)
+        butterflies(re + j, im + j, re + j + half, im + j + half, wr, wi, half);
+    }
+  }
+
+private:
+  std::vector<uint32_t> _reversed;
+  std::vector<float> _twiddlesRe;
+  std::vector<float> _twiddlesIm;
+};
+
+// Any size as a circular convolution with a chirp, computed by a power of two transform at least twice as big
+class Bluestein final : public Plan::Transform {
+public:
+  explicit Bluestein(size_t n)
+      : Transform(n), _inner(nextPowerOfTwo(2 * n - 1)), _chirpRe(n), _chirpIm(n), _filterRe(_inner.n), _filterIm(_inner.n) {
+    const auto m = _inner.n;
+    for (size_t k = 0; k < n; k++) {
+      // k^2 modulo 2n keeps the angle small and precise
+      const auto angle = -Pi * double((uint64_t(k) * uint64_t(k)) % (uint64_t(n) * 2)) / double(n);
+      _chirpRe[k] = float(std::cos(angle));
+      _chirpIm[k] = float(std::sin(angle));
+    }
+
+    // the conjugated chirp wrapped around, transformed once and scaled for the inverse
+    _filterRe[0] = _chirpRe[0];
+    _filterIm[0] = -_chirpIm[0];
+    for (size_t k = 1; k < n; k++) {
+      _filterRe[k] = _filterRe[m - k] = _chirpRe[k];
+      _filterIm[k] = _filterIm[m - k] = -_chirpIm[k];
+    }
+    _inner.run(_filterRe.data(), _filterIm.data(), nullptr);
+    const float scale = 1.0f / float(m);
+    for (size_t k = 0; k < m; k++) {
+      _filterRe[k] *= scale;
+      _filterIm[k] *= scale;
+    }
+  }
+
+  size_t scratchSize() const override { return _inner.n * 2; }
+
+  void run(float *re, float *im, float *scratch) const override {
+    const auto m = _inner.n;
+    float *ar = scratch;
+    float *ai = scratch + m;
+    for (size_t k = 0; k < n; k++) {
+      ar[k] = re[k] * _chirpRe[k] - im[k] * _chirpIm[k];
+      ai[k] = re[k] * _chirpIm[k] + im[k] * _chirpRe[k];
+    }
+    std::fill(ar + n, ar + m, 0.0f);
+    std::fill(ai + n, ai + m, 0.0f);
+
+    _inner.run(ar, ai, nullptr);
+    for (size_t k = 0; k < m; k++) {
+      const float r = ar[k] * _filterRe[k] - ai[k] * _filterIm[k];
+      ai[k] = ar[k] * _filterIm[k] + ai[k] * _filterRe[k];
+      ar[k] = r;
+    }
+    _inner.run(ai, ar, nullptr);
+
+    for (size_t k = 0; k < n; k++) {
+      re[k] = ar[k] * _chirpRe[k] - ai[k] * _chirpIm[k];
+      im[k] = ar[k] * _chirpIm[k] + ai[k] * _chirpRe[k];
+    }
+  }
+
+private:
+  Radix2 _inner;
+  std::vector<float> _chirpRe;
+  std::vector<float> _chirpIm;
+  std::vector<float> _filterRe;
+  std::vector<float> _filterIm;
+};
+
+std::unique_ptr<const Plan::Transform> makeTransform(size_t n) {
+  if (isPowerOfTwo(n))
+    return std::make_unique<const Radix2>(n);
+  return std::make_unique<const Bluestein>(n);
+}
+} // namespace
+
+std::shared_ptr<const Plan> Plan::get(Kind kind, size_t size) {
+  static std::mutex mutex;
+  static std::unordered_map<uint64_t, std::shared_ptr<const Plan>> plans;
+
+  const auto key = uint64_t(size) << 1 | uint64_t(kind == Kind::Real);
+  std::scoped_lock lock(mutex);
+  auto &plan = plans[key];
+  if (!plan)
+    plan = std::make_shared<const Plan>(kind, size);
+  return plan;
+}
+
+Plan::Plan(Kind kind, size_t size) : _kind(kind), _size(size) {
+  if (size == 0)
+    throw SHException("FFT size must be positive");
+
+  const auto even = kind == Kind::Real && size % 2 == 0;
+  const auto n = even ? size / 2 : size;
+  _transform = makeTransform(n);
+  _scratchSize = n * 2 + _transform->scratchSize();
+
+  if (even) {
+    _twiddlesRe.resize(n + 1);
+    _twiddlesIm.resize(n + 1);
+    for (size_t k = 0; k <= n; k++) {
+      const double angle = -2.0 * Pi * double(k) / double(size);
+      _twiddlesRe[k] = float(std::cos(angle));
+      _twiddlesIm[k] = float(std::sin(angle));
+    }
+  }
+}
+
+Plan::~Plan() = default;
+
+void Plan::forward(const float *signal, float *spectrum, float *scratch) const {
+  const auto n = _transform->n;
+  float *re = scratch;
+  float *im = scratch + n;
+  float *inner = scratch + n * 2;
+
+  if (_kind == Kind::Complex) {
+    for (size_t k = 0; k < n; k++) {
+      re[k] = signal[k * 2];
+      im[k] = signal[k * 2 + 1];
+    }
+    _transform->run(re, im, inner);
+    for (size_t k = 0; k < n; k++) {
+      spectrum[k * 2] = re[k];
+      spectrum[k * 2 + 1] = im[k];
+    }
+  } else if (!_twiddlesRe.empty()) {
+    // even and odd samples packed as one complex signal of half the size
+    for (size_t k = 0; k < n; k++) {
+      re[k] = signal[k * 2];
+      im[k] = signal[k * 2 + 1];
+    }
+    _transform->run(re, im, inner);
+    for (size_t k = 0; k <= n; k++) {
+      const auto a = k % n;
+      const auto b = (n - k) % n;
+      // the spectra of the even and odd samples
+      const float er = 0.5f * (re[a] + re[b]);
+      const float ei = 0.5f * (im[a] - im[b]);
+      const float or_ = 0.5f * (im[a] + im[b]);
+      const float oi = -0.5f * (re[a] - re[b]);
+      spectrum[k * 2] = er + _twiddlesRe[k] * or_ - _twiddlesIm[k] * oi;
+      spectrum[k * 2 + 1] = ei + _twiddlesRe[k] * oi + _twiddlesIm[k] * or_;
+    }
+  } else {
+    for (size_t k = 0; k < n; k++) {
+      re[k] = signal[k];
+      im[k] = 0.0f;
+    }
+    _transform->run(re, im, inner);
+    for (size_t k = 0; k <= n / 2; k++) {
+      spectrum[k * 2] = re[k];
+      spectrum[k * 2 + 1] = im[k];
+    }
+  }
+}
+
+void Plan::inverse(const float *spectrum, float *signal, float *scratch) const {
+  const auto n = _transform->n;
+  float *re = scratch;
+  float *im = scratch + n;
+  float *inner = scratch + n * 2;
+
+  if (_kind == Kind::Complex) {
+    for (size_t k = 0; k < n; k++) {
+      re[k] = spectrum[k * 2];
+      im[k] = spectrum[k * 2 + 1];
+    }
+    _transform->run(im, re, inner);
+    for (size_t k = 0; k < n; k++) {
+      signal[k * 2] = re[k];
+      signal[k * 2 + 1] = im[k];
+    }
+  } else if (!_twiddlesRe.empty()) {
+    for (size_t k = 0; k < n; k++) {
+      const float ar = spectrum[k * 2], ai = spectrum[k * 2 + 1];
+      const float br = spectrum[(n - k) * 2], bi = spectrum[(n - k) * 2 + 1];
+      // twice the spectra of the even and odd samples
+      const float er = ar + br;
+      const float ei = ai - bi;
+      const float dr = ar - br;
+      const float di = ai + bi;
+      const float or_ = dr * _twiddlesRe[k] + di * _twiddlesIm[k];
+      const float oi = di * _twiddlesRe[k] - dr * _twiddlesIm[k];
+      re[k] = er - oi;
+      im[k] = ei + or_;
+    }
+    _transform->run(im, re, inner);
+    for (size_t k = 0; k < n; k++) {
+      signal[k * 2] = re[k];
+      signal[k * 2 + 1] = im[k];
+    }
+  } else {
+    // the missing half of the spectrum of a real signal is conjugated
+    for (size_t k = 0; k <= n / 2; k++) {
+      re[k] = spectrum[k * 2];
+      im[k] = spectrum[k * 2 + 1];
+    }
+    for (size_t k = 1; k <= n / 2; k++) {
+      re[n - k] = re[k];
+      im[n - k] = -im[k];
+    }
+    _transform->run(im, re, inner);
+    for (size_t k = 0; k < n; k++)
+      signal[k] = re[k];
+  }
+}
+
+void Plan::forward(const float *signals, float *spectra, size_t count) const {
+  runBatch(*this, count,
+           [&](size_t i, float *scratch) { forward(signals + i * signalFloats(), spectra + i * spectrumFloats(), scratch); });
+}
+
+void Plan::inverse(const float *spectra, float *signals, size_t count) const {
+  runBatch(*this, count,
+           [&](size_t i, float *scratch) { inverse(spectra + i * spectrumFloats(), signals + i * signalFloats(), scratch); });
+}
+
+std::vector<float> window(WindowFunction function, size_t size) {
+  std::vector<float> res(size, 1.0f);
+  for (size_t i = 0; i < size; i++) {
+    const double x = 2.0 * Pi * double(i) / double(size);
+    switch (function) {
+    case WindowFunction::Rectangular:
+      break;
+    case WindowFunction::Hann:
+      res[i] = float(0.5 - 0.5 * std::cos(x));
+      break;
+    case WindowFunction::Hamming:
+      res[i] = float(0.54 - 0.46 * std::cos(x));
+      break;
+    case WindowFunction::Blackman:
+      res[i] = float(0.42 - 0.5 * std::cos(x) + 0.08 * std::cos(2.0 * x));
+      break;
+    }
+  }
+  return res;
+}
+
+Resampler::Resampler(uint32_t from, uint32_t to, uint32_t channels, uint32_t taps)
+    : _from(from), _to(to), _channels(channels), _taps(std::max(taps, uint32_t(4))) {
+  // a bank per phase, too many of them would not fit in cache anyway
+  constexpr uint32_t MaxPhases = 4096;
+  // fraction of the lower Nyquist frequency kept
+  constexpr double Passband = 0.9;
+  constexpr double KaiserBeta = 8.0;
+
+  if (from == 0 || to == 0 || channels == 0)
+    throw SHException("Resampler: sample rates and channels must be positive");
+  const auto divisor = std::gcd(from, to);
+  _up = to / divisor;
+  _down = from / divisor;
+  if (_up > MaxPhases)
+    throw SHException(fmt::format("Resampler: can't resample from {} to {}, the ratio is too complex", from, to));
+
+  const auto length = size_t(_up) * _taps;
+  const double cutoff = Passband * 0.5 / double(std::max(_up, _down));
+  const double center = double(length - 1) / 2.0;
+  _bank.resize(length);
+  for (uint32_t phase = 0; phase < _up; phase++) {
+    float *coeffs = &_bank[size_t(phase) * _taps];
+    double sum = 0.0;
+    for (uint32_t t = 0; t < _taps; t++) {
+      const double x = double(phase + size_t(t) * _up) - center;
+      const double sinc = x == 0.0 ? 2.0 * cutoff : std::sin(2.0 * Pi * cutoff * x) / (Pi * x);
+      const double r = 2.0 * x / double(length - 1);
+      const double kaiser = besselI0(KaiserBeta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(KaiserBeta);
+      coeffs[_taps - 1 - t] = float(sinc * kaiser);
+      sum += sinc * kaiser;
+    }
+    // unity gain at DC whatever the phase
+    for (uint32_t t = 0; t < _taps; t++)
+      coeffs[t] = float(coeffs[t] / sum);
+  }
+
+  _history.assign(channels, std::vector<float>(_taps - 1, 0.0f));
+  _time = uint64_t(_taps - 1) * _up;
+}
+
+void Resampler::process(const float *input, size_t frames, std::vector<float> &output) {
+  for (uint32_t c = 0; c < _channels; c++) {
+    auto &history = _history[c];
+    const auto offset = history.size();
+    history.resize(offset + frames);
+    for (size_t f = 0; f < frames; f++)
+      history[offset + f] = input[f * _channels + c];
+  }
+
+  // y[m] = sum h[p + t * up] x[i - t], where i and p are the quotient and remainder of m * down by up
+  const auto available = _history[0].size();
+  output.reserve(output.size() + (frames * _up / _down + 1) * _channels);
+  while (_time / _up < available) {
+    const auto i = size_t(_time / _up);
+    const float *coeffs = &_bank[size_t(_time % _up) * _taps];
+    for (uint32_t c = 0; c < _channels; c++)
+      output.push_back(dot(coeffs, &_history[c][i + 1 - _taps], _taps));
+    _time += _down;
+  }
+
+  // keep what the next outputs still need
+  const auto drop = std::min(size_t(_time / _up) + 1 - _taps, available);
+  for (auto &history : _history)
+    history.erase(history.begin(), history.begin() + drop);
+  _time -= uint64_t(drop) * _up;
+}
+
 static TableVar experimental{{"experimental", Var(true)}};
 
+REGISTER_ENUM(WindowFunction, 'dspW');
+
+static inline Type FloatSeqSeqType = Type::SeqOf(CoreInfo::FloatSeqType);
+static inline Type Float2SeqSeqType = Type::SeqOf(CoreInfo::Float2SeqType);
+
 struct FFTBase {
-  kiss_fft_cfg _state{nullptr};
-  kiss_fftr_cfg _rstate{nullptr};
-  int _currentWindow{-1};
-  std::vector<kiss_fft_cpx> _cscratch;
-  std::vector<kiss_fft_cpx> _cscratch2;
-  std::vector<float> _fscratch;
+  std::shared_ptr<const Plan> _plan;
+  std::vector<float> _scratch;
+  std::vector<float> _input;
+  std::vector<float> _output;
   std::vector<SHVar> _vscratch;
+  // frames of a batch, slices of _vscratch
+  std::vector<SHVar> _frames;
 
   static inline Types FloatTypes{{CoreInfo::FloatSeqType, CoreInfo::Float2SeqType, CoreInfo::AudioType}};
 
-  void cleanup() {
-    if (_state) {
-      kiss_fft_free(_state);
-      _state = nullptr;
+  void cleanup() { _plan.reset(); }
+
+  // plans are shared, only a size change costs a lookup
+  const Plan &plan(Plan::Kind kind, size_t size) {
+    if (unlikely(!_plan || _plan->kind() != kind || _plan->size() != size)) {
+      _plan = Plan::get(kind, size);
+      _scratch.resize(_plan->scratchSize());
     }
+    return *_plan;
+  }
 
-    if (_rstate) {
-      kiss_fftr_free(_rstate);
-      _rstate = nullptr;
+  // Seq of count seqs of len values of type
+  SHVar frames(size_t count, size_t len, SHType type) {
+    _vscratch.resize(count * len, SHVar{.valueType = type});
+    _frames.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      auto &frame = _frames[i];
+      frame.valueType = SHType::Seq;
+      frame.payload.seqValue.elements = count * len > 0 ? &_vscratch[i * len] : nullptr;
+      frame.payload.seqValue.len = uint32_t(len);
+      frame.payload.seqValue.cap = 0;
     }
+    return Var(_frames);
+  }
+
+  // the length of every frame of a batch, they must match
+  static size_t frameLength(const SHVar &input) {
+    const auto len = input.payload.seqValue.len > 0 ? input.payload.seqValue.elements[0].payload.seqValue.len : 0;
+    for (auto &frame : input) {
+      if (frame.payload.seqValue.len != len)
+        throw ActivationError("Expected frames of the same length");
+    }
+    return len;
   }
 };
 
 struct FFT : public FFTBase {
-  static SHTypesInfo inputTypes() { return FloatTypes; }
+  static SHTypesInfo inputTypes() { return BatchTypes; }
 
-  static SHTypesInfo outputTypes() { return CoreInfo::Float2SeqType; } // complex numbers
+  static SHTypesInfo outputTypes() { return OutputTypes; } // complex numbers
+
+  static SHOptionalString help() {
+    return SHCCSTR("Computes the FFT of real (Float seq or single channel Audio) or complex (Float2 seq) values. A seq of "
+                   "frames of the same length is transformed as one batch.");
+  }
 
   static const SHTable *properties() { return &experimental.payload.tableValue; }
 
+  static inline Types BatchTypes{FloatTypes, {FloatSeqSeqType, Float2SeqSeqType}};
+  static inline Types OutputTypes{{CoreInfo::Float2SeqType, Float2SeqSeqType}};
+
   SHTypeInfo compose(const SHInstanceData &data) {
     if (data.inputType.basicType == SHType::Audio) {
       OVERRIDE_ACTIVATE(data, activateAudio);
-    } else {
-      // assume seq
-      if (data.inputType.seqTypes.elements[0].basicType == SHType::Float) {
-        OVERRIDE_ACTIVATE(data, activateFloat);
+      return CoreInfo::Float2SeqType;
+    }
+
+    // assume seq
+    const auto &element = data.inputType.seqTypes.elements[0];
+    if (element.basicType == SHType::Seq) {
+      if (element.seqTypes.elements[0].basicType == SHType::Float) {
+        OVERRIDE_ACTIVATE(data, activateFloatBatch);
       } else {
-        OVERRIDE_ACTIVATE(data, activate);
+        OVERRIDE_ACTIVATE(data, activateBatch);
       }
+      return Float2SeqSeqType;
+    }
+
+    if (element.basicType == SHType::Float) {
+      OVERRIDE_ACTIVATE(data, activateFloat);
+    } else {
+      OVERRIDE_ACTIVATE(data, activate);
     }
     return CoreInfo::Float2SeqType;
   }
@@ -76,58 +619,78 @@ struct FFT : public FFTBase {
       throw ActivationError("Expected a positive input length");
     }
 
-    int flen = 0;
-    if constexpr (ITYPE == SHType::Audio || ITYPE == SHType::Float) {
-      flen = (len / 2) + 1;
-    } else {
-      flen = len;
-    }
-
-    if (unlikely(_currentWindow != len)) {
-      cleanup();
-
-      if constexpr (ITYPE == SHType::Float2) {
-        _state = kiss_fft_alloc(len, 0, 0, 0);
-        _cscratch2.resize(len);
-      } else if constexpr (ITYPE == SHType::Float) {
-        _rstate = kiss_fftr_alloc(len, 0, 0, 0);
-        _fscratch.resize(len);
-      } else {
-        _rstate = kiss_fftr_alloc(len, 0, 0, 0);
-      }
-      _currentWindow = len;
-      _cscratch.resize(flen);
-      _vscratch.resize(flen, SHVar{.valueType = SHType::Float2});
-    }
+    auto &p = plan(ITYPE == SHType::Float2 ? Plan::Kind::Complex : Plan::Kind::Real, size_t(len));
+    const auto flen = p.spectrumFloats() / 2;
+    _output.resize(p.spectrumFloats());
 
     if constexpr (ITYPE == SHType::Float2) {
+      _input.resize(p.signalFloats());
       int idx = 0;
       for (const auto &fvar : input) {
-        _cscratch2[idx++] = {float(fvar.payload.float2Value[0]), float(fvar.payload.float2Value[1])};
+        _input[idx++] = float(fvar.payload.float2Value[0]);
+        _input[idx++] = float(fvar.payload.float2Value[1]);
       }
-      kiss_fft(_state, _cscratch2.data(), _cscratch.data());
+      p.forward(_input.data(), _output.data(), _scratch.data());
     } else if constexpr (ITYPE == SHType::Float) {
+      _input.resize(p.signalFloats());
       int idx = 0;
       for (const auto &fvar : input) {
-        _fscratch[idx++] = float(fvar.payload.floatValue);
+        _input[idx++] = float(fvar.payload.floatValue);
       }
-      kiss_fftr(_rstate, _fscratch.data(), _cscratch.data());
+      p.forward(_input.data(), _output.data(), _scratch.data());
     } else {
-      kiss_fftr(_rstate, input.payload.audioValue.samples, _cscratch.data());
+      p.forward(input.payload.audioValue.samples, _output.data(), _scratch.data());
     }
 
-    for (int i = 0; i < flen; i++) {
-      _vscratch[i].payload.float2Value[0] = _cscratch[i].r;
-      _vscratch[i].payload.float2Value[1] = _cscratch[i].i;
+    _vscratch.resize(flen, SHVar{.valueType = SHType::Float2});
+    for (size_t i = 0; i < flen; i++) {
+      _vscratch[i].payload.float2Value[0] = _output[i * 2];
+      _vscratch[i].payload.float2Value[1] = _output[i * 2 + 1];
     }
 
     return Var(_vscratch);
   }
 
+  template <SHType ITYPE> SHVar tbatch(SHContext *context, const SHVar &input) {
+    const auto count = size_t(input.payload.seqValue.len);
+    const auto len = frameLength(input);
+    if (len == 0)
+      throw ActivationError("Expected a positive input length");
+
+    auto &p = plan(ITYPE == SHType::Float2 ? Plan::Kind::Complex : Plan::Kind::Real, len);
+    _input.resize(count * p.signalFloats());
+    size_t idx = 0;
+    for (auto &frame : input) {
+      for (auto &fvar : frame) {
+        if constexpr (ITYPE == SHType::Float2) {
+          _input[idx++] = float(fvar.payload.float2Value[0]);
+          _input[idx++] = float(fvar.payload.float2Value[1]);
+        } else {
+          _input[idx++] = float(fvar.payload.floatValue);
+        }
+      }
+    }
+
+    _output.resize(count * p.spectrumFloats());
+    p.forward(_input.data(), _output.data(), count);
+
+    const auto flen = p.spectrumFloats() / 2;
+    auto res = frames(count, flen, SHType::Float2);
+    for (size_t i = 0; i < count * flen; i++) {
+      _vscratch[i].payload.float2Value[0] = _output[i * 2];
+      _vscratch[i].payload.float2Value[1] = _output[i * 2 + 1];
+    }
+    return res;
+  }
+
   SHVar activateAudio(SHContext *context, const SHVar &input) { return tactivate<SHType::Audio>(context, input); }
 
   SHVar activateFloat(SHContext *context, const SHVar &input) { return tactivate<SHType::Float>(context, input); }
 
+  SHVar activateFloatBatch(SHContext *context, const SHVar &input) { return tbatch<SHType::Float>(context, input); }
+
+  SHVar activateBatch(SHContext *context, const SHVar &input) { return tbatch<SHType::Float2>(context, input); }
+
   SHVar activate(SHContext *context, const SHVar &input) { return tactivate<SHType::Float2>(context, input); }
 };
 
@@ -135,12 +698,20 @@ struct IFFT : public FFTBase {
   bool _asAudio{false};
   bool _complex{false};
 
-  static SHTypesInfo inputTypes() { return CoreInfo::Float2SeqType; } // complex numbers
+  static SHTypesInfo inputTypes() { return InputTypes; } // complex numbers
+
+  static SHTypesInfo outputTypes() { return OutputTypes; }
 
-  static SHTypesInfo outputTypes() { return FloatTypes; }
+  static SHOptionalString help() {
+    return SHCCSTR("Computes the inverse FFT of complex values (Float2 seq), the output is not scaled. A seq of frames of the "
+                   "same length is transformed as one batch.");
+  }
 
   static const SHTable *properties() { return &experimental.payload.tableValue; }
 
+  static inline Types InputTypes{{CoreInfo::Float2SeqType, Float2SeqSeqType}};
+  static inline Types OutputTypes{FloatTypes, {FloatSeqSeqType, Float2SeqSeqType}};
+
   static inline Parameters Params{
       {"Audio", SHCCSTR("If the output should be an Audio chunk."), {CoreInfo::BoolType}},
       {"Complex", SHCCSTR("If the output should be complex numbers (only if not Audio)."), {CoreInfo::BoolType}}};
@@ -172,6 +743,17 @@ struct IFFT : public FFTBase {
   }
 
   SHTypeInfo compose(const SHInstanceData &data) {
+    if (data.inputType.seqTypes.elements[0].basicType == SHType::Seq) {
+      if (_asAudio)
+        throw ComposeError("IFFT can't output a batch of frames as Audio");
+      if (_complex) {
+        OVERRIDE_ACTIVATE(data, activateBatch);
+        return Float2SeqSeqType;
+      }
+      OVERRIDE_ACTIVATE(data, activateFloatBatch);
+      return FloatSeqSeqType;
+    }
+
     if (_asAudio) {
       OVERRIDE_ACTIVATE(data, activateAudio);
       return CoreInfo::AudioType;
@@ -184,72 +766,437 @@ struct IFFT : public FFTBase {
     }
   }
 
+  // real outputs have len * 2 - 2 samples
+  static size_t outputSize(SHType type, size_t len) {
+    if (type == SHType::Float2)
+      return len;
+    if (len < 2)
+      throw ActivationError("Expected at least 2 complex numbers to output real values");
+    return len * 2 - 2;
+  }
+
   template <SHType OTYPE> SHVar tactivate(SHContext *context, const SHVar &input) {
     const int len = int(input.payload.seqValue.len);
     if (len <= 0) {
       throw ActivationError("Expected a positive input length");
     }
-    // following optimized away in certain paths
-    const int olen = len * 2 - 2;
-
-    if (unlikely(_currentWindow != len)) {
-      cleanup();
-
-      _currentWindow = len;
-      _cscratch.resize(len);
-      if constexpr (OTYPE == SHType::Float) {
-        _vscratch.resize(olen, SHVar{.valueType = OTYPE});
-      }
-      if constexpr (OTYPE == SHType::Float2) {
-        _cscratch2.resize(len);
-        _vscratch.resize(len, SHVar{.valueType = OTYPE});
-      }
-      if constexpr (OTYPE == SHType::Audio || OTYPE == SHType::Float) {
-        _fscratch.resize(olen);
-        _rstate = kiss_fftr_alloc(olen, 1, 0, 0);
-        SHLOG_TRACE("IFFT alloc window {}", olen);
-      } else {
-        _state = kiss_fft_alloc(len, 1, 0, 0);
-        SHLOG_TRACE("IFFT alloc window {}", len);
-      }
-    }
 
+    const auto olen = outputSize(OTYPE, size_t(len));
+    auto &p = plan(OTYPE == SHType::Float2 ? Plan::Kind::Complex : Plan::Kind::Real, olen);
+    _input.resize(p.spectrumFloats());
     int idx = 0;
     for (const auto &vf : input) {
-      _cscratch[idx++] = {float(vf.payload.float2Value[0]), float(vf.payload.float2Value[1])};
+      _input[idx++] = float(vf.payload.float2Value[0]);
+      _input[idx++] = float(vf.payload.float2Value[1]);
     }
 
-    if constexpr (OTYPE == SHType::Audio) {
-      kiss_fftri(_rstate, _cscratch.data(), _fscratch.data());
+    _output.resize(p.signalFloats());
+    p.inverse(_input.data(), _output.data(), _scratch.data());
 
-      return Var(SHAudio{0, uint16_t(olen), uint16_t(1), _fscratch.data()});
+    if constexpr (OTYPE == SHType::Audio) {
+      return Var(SHAudio{0, uint16_t(olen), uint16_t(1), _output.data()});
     } else if constexpr (OTYPE == SHType::Float) {
-      kiss_fftri(_rstate, _cscratch.data(), _fscratch.data());
-
-      for (int i = 0; i < olen; i++) {
-        _vscratch[i].payload.floatValue = double(_fscratch[i]);
+      _vscratch.resize(olen, SHVar{.valueType = OTYPE});
+      for (size_t i = 0; i < olen; i++) {
+        _vscratch[i].payload.floatValue = double(_output[i]);
       }
-
       return Var(_vscratch);
     } else {
-      kiss_fft(_state, _cscratch.data(), _cscratch2.data());
+      _vscratch.resize(olen, SHVar{.valueType = OTYPE});
+      for (size_t i = 0; i < olen; i++) {
+        _vscratch[i].payload.float2Value[0] = _output[i * 2];
+        _vscratch[i].payload.float2Value[1] = _output[i * 2 + 1];
+      }
+      return Var(_vscratch);
+    }
+  }
 
-      for (int i = 0; i < len; i++) {
-        _vscratch[i].payload.float2Value[0] = _cscratch2[i].r;
-        _vscratch[i].payload.float2Value[1] = _cscratch2[i].i;
+  template <SHType OTYPE> SHVar tbatch(SHContext *context, const SHVar &input) {
+    const auto count = size_t(input.payload.seqValue.len);
+    const auto len = frameLength(input);
+    if (len == 0)
+      throw ActivationError("Expected a positive input length");
+
+    const auto olen = outputSize(OTYPE, len);
+    auto &p = plan(OTYPE == SHType::Float2 ? Plan::Kind::Complex : Plan::Kind::Real, olen);
+    _input.resize(count * p.spectrumFloats());
+    size_t idx = 0;
+    for (auto &frame : input) {
+      for (auto &vf : frame) {
+        _input[idx++] = float(vf.payload.float2Value[0]);
+        _input[idx++] = float(vf.payload.float2Value[1]);
       }
+    }
 
-      return Var(_vscratch);
+    _output.resize(count * p.signalFloats());
+    p.inverse(_input.data(), _output.data(), count);
+
+    auto res = frames(count, olen, OTYPE);
+    for (size_t i = 0; i < count * olen; i++) {
+      if constexpr (OTYPE == SHType::Float) {
+        _vscratch[i].payload.floatValue = double(_output[i]);
+      } else {
+        _vscratch[i].payload.float2Value[0] = _output[i * 2];
+        _vscratch[i].payload.float2Value[1] = _output[i * 2 + 1];
+      }
     }
+    return res;
   }
 
   SHVar activateFloat(SHContext *context, const SHVar &input) { return tactivate<SHType::Float>(context, input); }
 
   SHVar activateAudio(SHContext *context, const SHVar &input) { return tactivate<SHType::Audio>(context, input); }
 
+  SHVar activateFloatBatch(SHContext *context, const SHVar &input) { return tbatch<SHType::Float>(context, input); }
+
+  SHVar activateBatch(SHContext *context, const SHVar &input) { return tbatch<SHType::Float2>(context, input); }
+
   SHVar activate(SHContext *context, const SHVar &input) { return tactivate<SHType::Float2>(context, input); }
 };
 
+struct STFT : public FFTBase {
+  int64_t _size{1024};
+  int64_t _hop{256};
+  WindowFunction _window{WindowFunction::Hann};
+  std::vector<float> _coeffs;
+  // samples not consumed by a frame yet
+  std::vector<float> _pending;
+  std::vector<float> _samples;
+
+  static SHTypesInfo inputTypes() { return InputTypes; }
+
+  static SHTypesInfo outputTypes() { return Float2SeqSeqType; }
+
+  static SHOptionalString help() {
+    return SHCCSTR("Short time Fourier transform of a stream of real values (Float seq or single channel Audio). Each "
+                   "activation outputs the spectrum of every complete windowed frame, possibly none, the stream starts with "
+                   "Size - Hop samples of silence.");
+  }
+
+  static const SHTable *properties() { return &experimental.payload.tableValue; }
+
+  static inline Types InputTypes{{CoreInfo::FloatSeqType, CoreInfo::AudioType}};
+
+  static inline Parameters Params{
+      {"Size", SHCCSTR("The length of a frame in samples, must be even."), {CoreInfo::IntType}},
+      {"Hop", SHCCSTR("The samples between the starts of two frames."), {CoreInfo::IntType}},
+      {"Window", SHCCSTR("The window applied to each frame."), {WindowFunctionType}}};
+
+  SHParametersInfo parameters() { return Params; }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _size = value.payload.intValue;
+      break;
+    case 1:
+      _hop = value.payload.intValue;
+      break;
+    case 2:
+      _window = WindowFunction(value.payload.enumValue);
+      break;
+    default:
+      throw InvalidParameterIndex();
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return Var(_size);
+    case 1:
+      return Var(_hop);
+    case 2:
+      return Var::Enum(_window, CoreCC, WindowFunctionCC);
+    default:
+      throw InvalidParameterIndex();
+    }
+  }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    if (_size < 2)
+      throw ComposeError("STFT Size must be at least 2");
+    // ISTFT derives the frame size from the bins as (bins - 1) * 2
+    if (_size % 2 != 0)
+      throw ComposeError("STFT Size must be even");
+    if (_hop <= 0 || _hop > _size)
+      throw ComposeError("STFT Hop must be positive and at most Size");
+
+    if (data.inputType.basicType == SHType::Audio) {
+      OVERRIDE_ACTIVATE(data, activateAudio);
+    } else {
+      OVERRIDE_ACTIVATE(data, activate);
+    }
+    return Float2SeqSeqType;
+  }
+
+  void warmup(SHContext *context) {
+    _coeffs = window(_window, size_t(_size));
+    _pending.assign(size_t(_size - _hop), 0.0f);
+  }
+
+  void cleanup() {
+    FFTBase::cleanup();
+    _pending.clear();
+  }
+
+  SHVar process(const float *samples, size_t len) {
+    const auto size = size_t(_size);
+    const auto hop = size_t(_hop);
+    _pending.insert(_pending.end(), samples, samples + len);
+
+    const auto count = _pending.size() >= size ? (_pending.size() - size) / hop + 1 : 0;
+    auto &p = plan(Plan::Kind::Real, size);
+    _input.resize(count * size);
+    for (size_t f = 0; f < count; f++) {
+      for (size_t i = 0; i < size; i++)
+        _input[f * size + i] = _pending[f * hop + i] * _coeffs[i];
+    }
+    _pending.erase(_pending.begin(), _pending.begin() + count * hop);
+
+    _output.resize(count * p.spectrumFloats());
+    if (count > 0)
+      p.forward(_input.data(), _output.data(), count);
+
+    const auto bins = p.spectrumFloats() / 2;
+    auto res = frames(count, bins, SHType::Float2);
+    for (size_t i = 0; i < count * bins; i++) {
+      _vscratch[i].payload.float2Value[0] = _output[i * 2];
+      _vscratch[i].payload.float2Value[1] = _output[i * 2 + 1];
+    }
+    return res;
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    _samples.clear();
+    for (auto &fvar : input)
+      _samples.push_back(float(fvar.payload.floatValue));
+    return process(_samples.data(), _samples.size());
+  }
+
+  SHVar activateAudio(SHContext *context, const SHVar &input) {
+    if (input.payload.audioValue.channels != 1)
+      throw ActivationError("STFT expects a single channel audio buffer");
+    return process(input.payload.audioValue.samples, input.payload.audioValue.nsamples);
+  }
+};
+
+struct ISTFT : public FFTBase {
+  int64_t _hop{256};
+  WindowFunction _window{WindowFunction::Hann};
+  int64_t _sampleRate{44100};
+  // frame size the state below was built for
+  size_t _size{0};
+  std::vector<float> _coeffs;
+  // inverse of the squared windows overlapping at each position of a hop
+  std::vector<float> _norm;
+  // overlap added frames, the first hop samples are complete
+  std::vector<float> _acc;
+  std::vector<float> _audio;
+
+  static SHTypesInfo inputTypes() { return Float2SeqSeqType; }
+
+  static SHTypesInfo outputTypes() { return CoreInfo::AudioType; }
+
+  static SHOptionalString help() {
+    return SHCCSTR("Inverse of STFT, overlap adds the frames (seqs of Size / 2 + 1 complex numbers) into a single channel "
+                   "Audio chunk of Hop samples per frame. Given the same Hop and Window as the STFT the signal is "
+                   "reconstructed exactly, Size - Hop samples late.");
+  }
+
+  static const SHTable *properties() { return &experimental.payload.tableValue; }
+
+  static inline Parameters Params{
+      {"Hop", SHCCSTR("The samples between the starts of two frames."), {CoreInfo::IntType}},
+      {"Window", SHCCSTR("The window the frames were analyzed with."), {WindowFunctionType}},
+      {"SampleRate", SHCCSTR("The sample rate of the output Audio."), {CoreInfo::IntType}}};
+
+  SHParametersInfo parameters() { return Params; }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _hop = value.payload.intValue;
+      break;
+    case 1:
+      _window = WindowFunction(value.payload.enumValue);
+      break;
+    case 2:
+      _sampleRate = value.payload.intValue;
+      break;
+    default:
+      throw InvalidParameterIndex();
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return Var(_hop);
+    case 1:
+      return Var::Enum(_window, CoreCC, WindowFunctionCC);
+    case 2:
+      return Var(_sampleRate);
+    default:
+      throw InvalidParameterIndex();
+    }
+  }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    if (_hop <= 0)
+      throw ComposeError("ISTFT Hop must be positive");
+    if (_sampleRate < 0)
+      throw ComposeError("ISTFT SampleRate can't be negative");
+    return CoreInfo::AudioType;
+  }
+
+  void cleanup() {
+    FFTBase::cleanup();
+    _size = 0;
+    _acc.clear();
+  }
+
+  void reshape(size_t size) {
+    const auto hop = size_t(_hop);
+    if (size < hop)
+      throw ActivationError(fmt::format("ISTFT frames of {} samples can't be {} samples apart", size, hop));
+
+    _coeffs = window(_window, size);
+    _norm.resize(hop);
+    for (size_t i = 0; i < hop; i++) {
+      float sum = 0.0f;
+      for (size_t j = i; j < size; j += hop)
+        sum += _coeffs[j] * _coeffs[j];
+      _norm[i] = sum > 1e-6f ? 1.0f / sum : 0.0f;
+    }
+    _acc.assign(size, 0.0f);
+    _size = size;
+  }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    const auto count = size_t(input.payload.seqValue.len);
+    const auto hop = size_t(_hop);
+    if (count * hop > UINT16_MAX)
+      throw ActivationError(fmt::format("ISTFT can't output {} frames in one Audio chunk", count));
+
+    _audio.resize(count * hop);
+    if (count == 0)
+      return Var(SHAudio{uint32_t(_sampleRate), 0, uint16_t(1), _audio.data()});
+
+    const auto bins = frameLength(input);
+    if (bins < 2)
+      throw ActivationError("Expected frames of at least 2 complex numbers");
+    const auto size = (bins - 1) * 2;
+    if (unlikely(size != _size))
+      reshape(size);
+
+    auto &p = plan(Plan::Kind::Real, size);
+    _input.resize(count * p.spectrumFloats());
+    size_t idx = 0;
+    for (auto &frame : input) {
+      for (auto &vf : frame) {
+        _input[idx++] = float(vf.payload.float2Value[0]);
+        _input[idx++] = float(vf.payload.float2Value[1]);
+      }
+    }
+    _output.resize(count * size);
+    p.inverse(_input.data(), _output.data(), count);
+
+    const float scale = 1.0f / float(size);
+    for (size_t f = 0; f < count; f++) {
+      const float *frame = &_output[f * size];
+      for (size_t i = 0; i < size; i++)
+        _acc[i] += frame[i] * scale * _coeffs[i];
+
+      float *out = &_audio[f * hop];
+      for (size_t i = 0; i < hop; i++)
+        out[i] = _acc[i] * _norm[i];
+      std::copy(_acc.begin() + hop, _acc.end(), _acc.begin());
+      std::fill(_acc.end() - hop, _acc.end(), 0.0f);
+    }
+
+    return Var(SHAudio{uint32_t(_sampleRate), uint16_t(count * hop), uint16_t(1), _audio.data()});
+  }
+};
+
+struct Resample {
+  int64_t _sampleRate{48000};
+  int64_t _taps{32};
+  std::unique_ptr<Resampler> _resampler;
+  std::vector<float> _output;
+
+  static SHTypesInfo inputTypes() { return CoreInfo::AudioType; }
+
+  static SHTypesInfo outputTypes() { return CoreInfo::AudioType; }
+
+  static SHOptionalString help() {
+    return SHCCSTR("Resamples a stream of Audio chunks to SampleRate with a polyphase filter. The output is delayed by "
+                   "about Taps / 2 input samples and a chunk holds what could be computed so far.");
+  }
+
+  static const SHTable *properties() { return &experimental.payload.tableValue; }
+
+  static inline Parameters Params{
+      {"SampleRate", SHCCSTR("The sample rate of the output Audio."), {CoreInfo::IntType}},
+      {"Taps", SHCCSTR("The length of the filter, longer is sharper but slower."), {CoreInfo::IntType}}};
+
+  SHParametersInfo parameters() { return Params; }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _sampleRate = value.payload.intValue;
+      break;
+    case 1:
+      _taps = value.payload.intValue;
+      break;
+    default:
+      throw InvalidParameterIndex();
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return Var(_sampleRate);
+    case 1:
+      return Var(_taps);
+    default:
+      throw InvalidParameterIndex();
+    }
+  }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    if (_sampleRate <= 0 || _sampleRate > UINT32_MAX)
+      throw ComposeError("Resample SampleRate must be positive");
+    if (_taps < 4 || _taps > 1024)
+      throw ComposeError("Resample Taps must be between 4 and 1024");
+    return CoreInfo::AudioType;
+  }
+
+  void cleanup() { _resampler.reset(); }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    const auto &audio = input.payload.audioValue;
+    if (audio.sampleRate == 0)
+      throw ActivationError("Resample needs the sample rate of its input");
+    if (audio.channels == 0)
+      throw ActivationError("Resample expects at least one channel");
+
+    if (unlikely(!_resampler || _resampler->from() != audio.sampleRate || _resampler->channels() != audio.channels)) {
+      _resampler = std::make_unique<Resampler>(audio.sampleRate, uint32_t(_sampleRate), audio.channels, uint32_t(_taps));
+    }
+
+    _output.clear();
+    _resampler->process(audio.samples, audio.nsamples, _output);
+    const auto frames = _output.size() / audio.channels;
+    if (frames > UINT16_MAX)
+      throw ActivationError(fmt::format("Resample can't output {} samples in one Audio chunk", frames));
+
+    return Var(SHAudio{uint32_t(_sampleRate), uint16_t(frames), audio.channels, _output.data()});
+  }
+};
+
 #if 0
 // TODO this works but we need to add more types, specifically orthogonal ones
 // TODO also add coverage of all cases
@@ -504,6 +1451,9 @@ struct IWT : public WTBase {
 void registerShards() {
   REGISTER_SHARD("DSP.FFT", FFT);
   REGISTER_SHARD("DSP.IFFT", IFFT);
+  REGISTER_SHARD("DSP.STFT", STFT);
+  REGISTER_SHARD("DSP.ISTFT", ISTFT);
+  REGISTER_SHARD("DSP.Resample", Resample);
 #if 0
   REGISTER_SHARD("DSP.Wavelet", WT);
   REGISTER_SHARD("DSP.InverseWavelet", IWT);
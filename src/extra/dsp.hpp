@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2021 Fragcolor Pte. Ltd. */
+
+#ifndef SH_EXTRA_DSP
+#define SH_EXTRA_DSP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace shards {
+namespace DSP {
+// A planned FFT of one size, immutable once built and shared by every user of that size through a process wide cache,
+// any number of threads can run the same plan at once as long as each brings its own scratch.
+// Power of two sizes run a radix 2 transform vectorized with AVX2 or NEON, other sizes go through Bluestein's algorithm
+// on a power of two transform. Real plans of even sizes run a complex transform of half the size.
+// Nothing is scaled, an inverse after a forward multiplies by size.
+class Plan {
+public:
+  enum class Kind { Complex, Real };
+
+  static std::shared_ptr<const Plan> get(Kind kind, size_t size);
+
+  Plan(Kind kind, size_t size);
+  ~Plan();
+
+  Plan(const Plan &) = delete;
+  Plan &operator=(const Plan &) = delete;
+
+  Kind kind() const { return _kind; }
+  size_t size() const { return _size; }
+
+  // Floats in a signal frame and in a spectrum frame, complex numbers are interleaved.
+  // Complex: size complex numbers both, Real: size floats and size / 2 + 1 complex numbers.
+  size_t signalFloats() const { return _kind == Kind::Real ? _size : _size * 2; }
+  size_t spectrumFloats() const { return _kind == Kind::Real ? (_size / 2 + 1) * 2 : _size * 2; }
+
+  // Floats of scratch a transform needs
+  size_t scratchSize() const { return _scratchSize; }
+
+  void forward(const float *signal, float *spectrum, float *scratch) const;
+  void inverse(const float *spectrum, float *signal, float *scratch) const;
+
+  // count contiguous frames, big batches are spread over the shared thread pool
+  void forward(const float *signals, float *spectra, size_t count) const;
+  void inverse(const float *spectra, float *signals, size_t count) const;
+
+  struct Transform;
+
+private:
+  Kind _kind;
+  size_t _size;
+  size_t _scratchSize{0};
+  // complex, of size or of size / 2 for even real plans
+  std::unique_ptr<const Transform> _transform;
+  // even real plans, exp(-2 pi i k / size) for k <= size / 2
+  std::vector<float> _twiddlesRe;
+  std::vector<float> _twiddlesIm;
+};
+
+enum class WindowFunction { Rectangular, Hann, Hamming, Blackman };
+
+// Periodic window of size, the form that overlaps evenly
+std::vector<float> window(WindowFunction function, size_t size);
+
+// Polyphase resampling by the rational factor to / from, streaming: what a call can't output yet is kept for the next.
+// A Kaiser windowed sinc low pass of taps per phase removes what the lower rate can't carry, it delays the signal by
+// about taps / 2 input frames.
+class Resampler {
+public:
+  Resampler(uint32_t from, uint32_t to, uint32_t channels, uint32_t taps = 32);
+
+  uint32_t from() const { return _from; }
+  uint32_t to() const { return _to; }
+  uint32_t channels() const { return _channels; }
+
+  // Appends the resampled frames of frames interleaved input frames to output
+  void process(const float *input, size_t frames, std::vector<float> &output);
+
+private:
+  uint32_t _from;
+  uint32_t _to;
+  uint32_t _channels;
+  uint32_t _taps;
+  uint32_t _up;
+  uint32_t _down;
+  // up phases of taps coefficients, reversed to run forward over the history
+  std::vector<float> _bank;
+  // per channel, taps - 1 frames of history followed by the pending input
+  std::vector<std::vector<float>> _history;
+  // position of the next output in the upsampled history
+  uint64_t _time;
+};
+} // namespace DSP
+} // namespace shards
+
+#endif // SH_EXTRA_DSP
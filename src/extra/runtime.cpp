@@ -34,6 +34,10 @@ namespace Brotli {
 extern void registerShards();
 }
 
+namespace Zstd {
+extern void registerShards();
+}
+
 namespace Audio {
 extern void registerShards();
 }
@@ -57,6 +61,7 @@ void shInitExtras() {
 
   Snappy::registerShards();
   Brotli::registerShards();
+  Zstd::registerShards();
 
   gfx::registerShards();
   shards::ImGui::registerShards();
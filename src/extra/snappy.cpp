@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: BSD-3-Clause */
 /* Copyright © 2019 Fragcolor Pte. Ltd. */
 
+#include "shards/compression.hpp"
 #include "shards/shared.hpp"
 #include "runtime.hpp"
 #include <snappy.h>
@@ -40,7 +41,30 @@ struct Decompress {
   }
 };
 
+// Snappy has no state nor levels, the context only exists for the compression frames
+class Context : public compression::Context {
+public:
+  size_t bound(size_t size) const override { return snappy::MaxCompressedLength(size); }
+
+  size_t compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity) override {
+    size_t outputLen;
+    snappy::RawCompress((const char *)src, size, (char *)dst, &outputLen);
+    return outputLen;
+  }
+
+  void decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t originalSize) override {
+    size_t len;
+    if (!snappy::GetUncompressedLength((const char *)src, size, &len) || len != originalSize ||
+        !snappy::RawUncompress((const char *)src, size, (char *)dst)) {
+      throw SHException("Snappy failed to decompress, probably invalid data!");
+    }
+  }
+};
+
 void registerShards() {
+  compression::registerCodec(
+      compression::Codec::Snappy, [](const compression::Options &) { return std::make_unique<Context>(); }, false);
+
   REGISTER_SHARD("Snappy.Compress", Compress);
   REGISTER_SHARD("Snappy.Decompress", Decompress);
 }
@@ -0,0 +1,338 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright © 2022 Fragcolor Pte. Ltd. */
+
+#include "shards/compression.hpp"
+#include "shards/shared.hpp"
+#include "runtime.hpp"
+#include <zdict.h>
+#include <zstd.h>
+
+namespace shards {
+namespace Zstd {
+inline size_t check(size_t res, const char *what) {
+  if (ZSTD_isError(res))
+    throw ActivationError(fmt::format("Zstd failed to {}: {}", what, ZSTD_getErrorName(res)));
+  return res;
+}
+
+// The zstd contexts and digested dictionary, kept across values since creating them costs more than compressing a small
+// value. Not thread safe.
+class Context : public compression::Context {
+public:
+  Context(int level, std::shared_ptr<const compression::Dictionary> dictionary)
+      : _level(level != 0 ? level : ZSTD_CLEVEL_DEFAULT), _dictionary(std::move(dictionary)) {}
+
+  ~Context() {
+    // all of them accept null
+    ZSTD_freeCCtx(_cctx);
+    ZSTD_freeDCtx(_dctx);
+    ZSTD_freeCDict(_cdict);
+    ZSTD_freeDDict(_ddict);
+  }
+
+  Context(const Context &) = delete;
+  Context &operator=(const Context &) = delete;
+
+  size_t bound(size_t size) const override { return ZSTD_compressBound(size); }
+
+  size_t compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity) override {
+    return check(ZSTD_compress2(encoder(), dst, capacity, src, size), "compress");
+  }
+
+  void decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t originalSize) override {
+    if (check(ZSTD_decompressDCtx(decoder(), dst, originalSize, src, size), "decompress") != originalSize)
+      throw ActivationError("Zstd failed to decompress: unexpected size");
+  }
+
+  // Every call outputs a flushed chunk that depends on all the previous ones
+  void compressStream(const uint8_t *src, size_t size, std::vector<uint8_t> &output) {
+    ZSTD_inBuffer in{src, size, 0};
+    output.clear();
+    size_t remaining;
+    do {
+      const auto pos = output.size();
+      output.resize(pos + ZSTD_CStreamOutSize());
+      ZSTD_outBuffer out{output.data() + pos, ZSTD_CStreamOutSize(), 0};
+      remaining = check(ZSTD_compressStream2(encoder(), &out, &in, ZSTD_e_flush), "compress");
+      output.resize(pos + out.pos);
+    } while (remaining != 0 || in.pos < in.size);
+  }
+
+  void decompressStream(const uint8_t *src, size_t size, std::vector<uint8_t> &output, size_t maxSize) {
+    ZSTD_inBuffer in{src, size, 0};
+    output.clear();
+    bool full;
+    do {
+      const auto pos = output.size();
+      output.resize(pos + ZSTD_DStreamOutSize());
+      ZSTD_outBuffer out{output.data() + pos, ZSTD_DStreamOutSize(), 0};
+      check(ZSTD_decompressStream(decoder(), &out, &in), "decompress");
+      output.resize(pos + out.pos);
+      if (output.size() > maxSize)
+        throw ActivationError(fmt::format("Zstd failed to decompress: more than the limit of {} bytes", maxSize));
+      // a full output might hide more data still buffered
+      full = out.pos == out.size;
+    } while (in.pos < in.size || full);
+  }
+
+private:
+  ZSTD_CCtx *encoder() {
+    if (!_cctx) {
+      _cctx = ZSTD_createCCtx();
+      if (!_cctx)
+        throw ActivationError("Zstd failed to create a compression context");
+      check(ZSTD_CCtx_setParameter(_cctx, ZSTD_c_compressionLevel, _level), "set the compression level");
+      if (_dictionary) {
+        _cdict = ZSTD_createCDict(_dictionary->data.data(), _dictionary->data.size(), _level);
+        if (!_cdict)
+          throw ActivationError("Zstd failed to load the dictionary");
+        check(ZSTD_CCtx_refCDict(_cctx, _cdict), "reference the dictionary");
+      }
+    }
+    return _cctx;
+  }
+
+  ZSTD_DCtx *decoder() {
+    if (!_dctx) {
+      _dctx = ZSTD_createDCtx();
+      if (!_dctx)
+        throw ActivationError("Zstd failed to create a decompression context");
+      if (_dictionary) {
+        _ddict = ZSTD_createDDict(_dictionary->data.data(), _dictionary->data.size());
+        if (!_ddict)
+          throw ActivationError("Zstd failed to load the dictionary");
+        check(ZSTD_DCtx_refDDict(_dctx, _ddict), "reference the dictionary");
+      }
+    }
+    return _dctx;
+  }
+
+  int _level;
+  std::shared_ptr<const compression::Dictionary> _dictionary;
+  ZSTD_CCtx *_cctx{nullptr};
+  ZSTD_DCtx *_dctx{nullptr};
+  ZSTD_CDict *_cdict{nullptr};
+  ZSTD_DDict *_ddict{nullptr};
+};
+
+// What both shards share: the dictionary parameter and a context following it
+struct Base {
+  static inline Parameters dictionaryAndStreamParams{
+      {"Dictionary", SHCCSTR("An optional dictionary, see Zstd.TrainDictionary. Decompress with the same one."),
+       {CoreInfo::NoneType, CoreInfo::BytesType, CoreInfo::BytesVarType}},
+      {"Stream",
+       SHCCSTR("Keep the same stream across activations, each value is a flushed chunk that must be decompressed in order by "
+               "a streaming shard. Many small and similar values compress much better this way."),
+       {CoreInfo::BoolType}}};
+
+  std::vector<uint8_t> _buffer;
+  ParamVar _dictionary{};
+  bool _stream{false};
+  int _level{0};
+  std::unique_ptr<Context> _context;
+  const uint8_t *_dictionaryData{nullptr};
+
+  static SHTypesInfo inputTypes() { return CoreInfo::BytesType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::BytesType; }
+
+  void warmup(SHContext *context) { _dictionary.warmup(context); }
+
+  // streams restart on every run
+  void cleanup() {
+    _dictionary.cleanup();
+    _context.reset();
+    _dictionaryData = nullptr;
+  }
+
+  Context &context() {
+    auto &dict = _dictionary.get();
+    const uint8_t *data = dict.valueType == SHType::Bytes && dict.payload.bytesSize > 0 ? dict.payload.bytesValue : nullptr;
+    if (!_context || data != _dictionaryData) {
+      _dictionaryData = data;
+      _context = std::make_unique<Context>(_level, data ? compression::addDictionary(data, dict.payload.bytesSize) : nullptr);
+    }
+    return *_context;
+  }
+};
+
+struct Compress : public Base {
+  static inline Parameters params{
+      {{"Level", SHCCSTR("The compression level, from 1 to 22 (negative values are faster), 0 = the zstd default."),
+        {CoreInfo::IntType}}},
+      dictionaryAndStreamParams};
+
+  static SHParametersInfo parameters() { return params; }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _level = int(value.payload.intValue);
+      _context.reset();
+      break;
+    case 1:
+      _dictionary = value;
+      break;
+    case 2:
+      _stream = value.payload.boolValue;
+      break;
+    default:
+      break;
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return Var(_level);
+    case 1:
+      return _dictionary;
+    case 2:
+      return Var(_stream);
+    default:
+      return Var::Empty;
+    }
+  }
+
+  SHVar activate(SHContext *shContext, const SHVar &input) {
+    auto &ctx = context();
+    if (_stream) {
+      ctx.compressStream(input.payload.bytesValue, input.payload.bytesSize, _buffer);
+    } else {
+      _buffer.resize(ctx.bound(input.payload.bytesSize));
+      _buffer.resize(ctx.compress(input.payload.bytesValue, input.payload.bytesSize, _buffer.data(), _buffer.size()));
+    }
+    return Var(_buffer.data(), uint32_t(_buffer.size()));
+  }
+};
+
+struct Decompress : public Base {
+  static inline Parameters params{
+      dictionaryAndStreamParams,
+      {{"MaxSize",
+        SHCCSTR("The largest decompressed value accepted in bytes, the sizes recorded in the input can't be trusted."),
+        {CoreInfo::IntType}}}};
+
+  // the frame content size is read from the input, it's checked before allocating
+  int64_t _maxSize{compression::Frames::DefaultMaxSize};
+
+  static SHParametersInfo parameters() { return params; }
+
+  void setParam(int index, const SHVar &value) {
+    switch (index) {
+    case 0:
+      _dictionary = value;
+      break;
+    case 1:
+      _stream = value.payload.boolValue;
+      break;
+    case 2:
+      _maxSize = value.payload.intValue;
+      break;
+    default:
+      break;
+    }
+  }
+
+  SHVar getParam(int index) {
+    switch (index) {
+    case 0:
+      return _dictionary;
+    case 1:
+      return Var(_stream);
+    case 2:
+      return Var(_maxSize);
+    default:
+      return Var::Empty;
+    }
+  }
+
+  SHTypeInfo compose(const SHInstanceData &data) {
+    // the output is a single Bytes value
+    if (_maxSize <= 0 || _maxSize >= int64_t(UINT32_MAX))
+      throw ComposeError("Zstd.Decompress: MaxSize out of range");
+    return CoreInfo::BytesType;
+  }
+
+  SHVar activate(SHContext *shContext, const SHVar &input) {
+    auto &ctx = context();
+    size_t len;
+    if (_stream) {
+      ctx.decompressStream(input.payload.bytesValue, input.payload.bytesSize, _buffer, size_t(_maxSize));
+      len = _buffer.size();
+      _buffer.push_back(0);
+    } else {
+      const auto size = ZSTD_getFrameContentSize(input.payload.bytesValue, input.payload.bytesSize);
+      if (size == ZSTD_CONTENTSIZE_ERROR)
+        throw ActivationError("Zstd failed to decompress, probably invalid data!");
+      if (size == ZSTD_CONTENTSIZE_UNKNOWN)
+        throw ActivationError("Zstd failed to find the decompressed size, was it compressed with Stream?");
+      if (size > uint64_t(_maxSize))
+        throw ActivationError(fmt::format("Zstd failed to decompress: {} bytes, more than the limit of {}", size, _maxSize));
+      len = size_t(size);
+      _buffer.resize(len + 1);
+      ctx.decompress(input.payload.bytesValue, input.payload.bytesSize, _buffer.data(), len);
+    }
+    // easy fix for null term strings
+    _buffer[len] = 0;
+    return Var(_buffer.data(), uint32_t(len));
+  }
+};
+
+struct TrainDictionary {
+  static inline Parameters params{
+      {"Size", SHCCSTR("The maximum size of the dictionary in bytes, about 100 times less than the samples is a good start."),
+       {CoreInfo::IntType}}};
+
+  std::vector<uint8_t> _samples;
+  std::vector<size_t> _sizes;
+  std::vector<uint8_t> _buffer;
+  int64_t _size{16384};
+
+  static SHTypesInfo inputTypes() { return CoreInfo::BytesSeqType; }
+  static SHTypesInfo outputTypes() { return CoreInfo::BytesType; }
+
+  static SHOptionalString help() {
+    return SHCCSTR("Trains a dictionary from a sequence of sample values, to compress small values that look like them much "
+                   "better. Needs plenty of samples, zstd recommends a few thousands.");
+  }
+
+  static SHParametersInfo parameters() { return params; }
+
+  void setParam(int index, const SHVar &value) { _size = std::max(int64_t(256), value.payload.intValue); }
+
+  SHVar getParam(int index) { return Var(_size); }
+
+  SHVar activate(SHContext *context, const SHVar &input) {
+    return awaitne(
+        context,
+        [&]() {
+          _samples.clear();
+          _sizes.clear();
+          for (auto &sample : input) {
+            _samples.insert(_samples.end(), sample.payload.bytesValue, sample.payload.bytesValue + sample.payload.bytesSize);
+            _sizes.push_back(sample.payload.bytesSize);
+          }
+
+          _buffer.resize(size_t(_size));
+          auto res =
+              ZDICT_trainFromBuffer(_buffer.data(), _buffer.size(), _samples.data(), _sizes.data(), unsigned(_sizes.size()));
+          if (ZDICT_isError(res))
+            throw ActivationError(fmt::format("Zstd failed to train the dictionary: {}", ZDICT_getErrorName(res)));
+          _buffer.resize(res);
+          return Var(_buffer.data(), uint32_t(_buffer.size()));
+        },
+        [] {});
+  }
+};
+
+void registerShards() {
+  compression::registerCodec(
+      compression::Codec::Zstd,
+      [](const compression::Options &options) { return std::make_unique<Context>(options.level, options.dictionary); }, true);
+
+  REGISTER_SHARD("Zstd.Compress", Compress);
+  REGISTER_SHARD("Zstd.Decompress", Decompress);
+  REGISTER_SHARD("Zstd.TrainDictionary", TrainDictionary);
+}
+} // namespace Zstd
+} // namespace shards
@@ -19,6 +19,8 @@ static String printValues(malValueIter begin, malValueIter end, const String &se
 
 static StaticList<malBuiltIn *> handlers;
 
+thread_local std::vector<String> *slurpLog = nullptr;
+
 #define ARG(type, name) type *name = VALUE_CAST(type, *argsBegin++)
 
 #define FUNCNAME(uniq) builtIn##uniq
@@ -465,6 +467,9 @@ BUILTIN("slurp") {
   String data;
   data.assign(std::istreambuf_iterator<char>(file), {});
 
+  if (slurpLog)
+    slurpLog->push_back(fs::absolute(filepath).string());
+
   return mal::string(data);
 }
 
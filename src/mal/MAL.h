@@ -29,6 +29,8 @@ extern String rep(const String &input, malEnvPtr env);
 // Core.cpp
 extern void installCore(malEnvPtr env);
 extern void installSHCore(const malEnvPtr &env, const char *exePath, const char *scriptPath);
+// while set, the absolute paths of the files slurp reads on this thread are appended to it
+extern thread_local std::vector<String> *slurpLog;
 
 // Reader.cpp
 extern malValuePtr readStr(const String &input);
@@ -9,6 +9,7 @@
 #include "Types.h"
 #undef String
 #include "../core/shards/shared.hpp"
+#include "../core/artifact.hpp"
 #include "../core/runtime.hpp"
 #include <algorithm>
 #include <boost/lockfree/queue.hpp>
@@ -545,17 +546,32 @@ struct WireFileWatcher {
 
         SHLOG_DEBUG("Processing {}", fileNameOnly.string());
 
+        // the bootstrap code is part of what the wire was built from
+        const auto key = shards::artifact::key(str, autoexec ? autoexec->print(true) : "");
+        const auto artifactPath = shards::artifact::pathOf(p.string());
+        std::vector<std::string> dependencies;
+
         malEnvPtr env(new malEnv(rootEnv));
-        auto res = maleval(str.c_str(), env);
-        auto var = varify(res);
-        if (var->value().valueType != SHType::Wire) {
-          SHLOG_ERROR("Script did not return a SHWire");
-          return;
+        malValuePtr res;
+        auto wire = shards::artifact::load(artifactPath, key);
+        const auto compiled = wire != nullptr;
+        if (compiled) {
+          SHLOG_DEBUG("Loaded {} from {}", fileNameOnly.string(), artifactPath);
+          res = malValuePtr(new malSHWire(wire));
+        } else {
+          slurpLog = &dependencies;
+          DEFER(slurpLog = nullptr);
+          res = maleval(str.c_str(), env);
+          auto var = varify(res);
+          if (var->value().valueType != SHType::Wire) {
+            SHLOG_ERROR("Script did not return a SHWire");
+            return;
+          }
+
+          auto wireref = var->value().payload.wireValue;
+          wire = SHWire::sharedFromRef(wireref);
         }
 
-        auto wireref = var->value().payload.wireValue;
-        auto wire = SHWire::sharedFromRef(wireref);
-
         SHInstanceData data{};
         data.inputType = inputTypeInfo;
         data.shared = shared;
@@ -580,6 +596,10 @@ struct WireFileWatcher {
 
         SHLOG_TRACE("Validated {}", fileNameOnly.string());
 
+        // only wires that composed are worth caching
+        if (!compiled)
+          shards::artifact::store(artifactPath, key, wire, dependencies);
+
         liveWires[wire.get()] = std::make_tuple(env, res);
 
         WireLoadResult result = {false, "", wire.get()};
@@ -1620,6 +1640,44 @@ BUILTIN("tick") {
   return mal::nilValue();
 }
 
+BUILTIN("record") {
+  CHECK_ARGS_IS(2);
+  ARG(malSHMesh, mesh);
+  ARG(malString, path);
+  mesh->value()->recorder = shards::Recorder::record(path->ref());
+  return mal::nilValue();
+}
+
+BUILTIN("replay") {
+  CHECK_ARGS_IS(2);
+  ARG(malSHMesh, mesh);
+  ARG(malString, path);
+  mesh->value()->recorder = shards::Recorder::replay(path->ref());
+  return mal::nilValue();
+}
+
+BUILTIN("set-budget") {
+  CHECK_ARGS_IS(2);
+  auto first = *argsBegin++;
+  ARG(malNumber, seconds);
+  if (const malSHWire *v = DYNAMIC_CAST(malSHWire, first)) {
+    SHWire::sharedFromRef(v->value())->budget = seconds->value();
+  } else if (const malSHMesh *v = DYNAMIC_CAST(malSHMesh, first)) {
+    v->value()->frameBudget = seconds->value();
+  } else {
+    throw shards::SHException("set-budget Expected Mesh or Wire");
+  }
+  return mal::nilValue();
+}
+
+BUILTIN("set-priority") {
+  CHECK_ARGS_IS(2);
+  ARG(malSHWire, wirevar);
+  ARG(malNumber, priority);
+  SHWire::sharedFromRef(wirevar->value())->priority = int(priority->value());
+  return mal::nilValue();
+}
+
 BUILTIN("stop") {
   CHECK_ARGS_IS(1);
   ARG(malSHWire, wirevar);
@@ -1682,8 +1740,13 @@ BUILTIN("run") {
       // before sleep
       // cos during sleep some shards
       // swap states and invalidate stuff
-      if (sleepTime <= 0.0) {
+      if (mesh->replaying()) {
+        // replays run as fast as possible, time comes from the recording
+        continue;
+      } else if (sleepTime <= 0.0) {
         shards::sleep(-1.0);
+        // don't spin while every wire is waiting, run loop callbacks still get called regularly
+        mesh->idle(SHDuration(0.01));
       } else {
         // remove the time we took to tick from sleep
         now = SHClock::now();
@@ -1747,6 +1810,193 @@ BUILTIN("path") {
   return malValuePtr(mvar);
 }
 
+// The forms a script reads to are cached as artifacts, reading with the regex tokenizer is a good share of a cold start.
+// Each form is stored as a sequence of its tag, its line and its value or children.
+namespace {
+enum class FormTag : int64_t { List, Vector, Hash, String, Keyword, Symbol, ContextVar, Integer, Float, Nil, True, False };
+
+// bump when the encoding changes
+constexpr std::string_view FormsVersion = "forms-1";
+
+void pushVar(SHVar &seq, const SHVar &value) {
+  SHVar tmp{};
+  shards::cloneVar(tmp, value);
+  shards::arrayPush(seq.payload.seqValue, tmp);
+}
+
+// throws if form is not something the reader produces
+void encodeForm(const malValuePtr &form, SHVar &output) {
+  SHVar node{};
+  node.valueType = SHType::Seq;
+  DEFER(shards::destroyVar(node));
+
+  const auto push = [&](FormTag tag) {
+    pushVar(node, Var(int64_t(tag)));
+    pushVar(node, Var(int64_t(form->line)));
+  };
+  const auto pushItems = [&](const malSequence *seq) {
+    for (auto it = seq->begin(); it != seq->end(); ++it)
+      encodeForm(*it, node);
+  };
+
+  if (auto list = DYNAMIC_CAST(malList, form)) {
+    push(FormTag::List);
+    pushItems(list);
+  } else if (auto vector = DYNAMIC_CAST(malVector, form)) {
+    push(FormTag::Vector);
+    pushItems(vector);
+  } else if (auto hash = DYNAMIC_CAST(malHash, form)) {
+    push(FormTag::Hash);
+    for (auto &[key, value] : hash->m_map) {
+      pushVar(node, Var(key));
+      encodeForm(value, node);
+    }
+  } else if (auto string = DYNAMIC_CAST(malString, form)) {
+    push(FormTag::String);
+    pushVar(node, Var(string->ref()));
+  } else if (auto keyword = DYNAMIC_CAST(malKeyword, form)) {
+    push(FormTag::Keyword);
+    pushVar(node, Var(keyword->ref()));
+  } else if (auto symbol = DYNAMIC_CAST(malSymbol, form)) {
+    push(FormTag::Symbol);
+    pushVar(node, Var(symbol->ref()));
+  } else if (auto number = DYNAMIC_CAST(malNumber, form)) {
+    push(number->isInteger() ? FormTag::Integer : FormTag::Float);
+    pushVar(node, Var(number->value()));
+  } else if (auto var = DYNAMIC_CAST(malSHVar, form); var && var->value().valueType == SHType::ContextVar) {
+    push(FormTag::ContextVar);
+    SHVar name = var->value();
+    name.valueType = SHType::String;
+    pushVar(node, name);
+  } else if (form == mal::nilValue()) {
+    push(FormTag::Nil);
+  } else if (form == mal::trueValue()) {
+    push(FormTag::True);
+  } else if (form == mal::falseValue()) {
+    push(FormTag::False);
+  } else {
+    throw shards::SHException(fmt::format("Unexpected form: {}", form->print(true)));
+  }
+
+  shards::arrayPush(output.payload.seqValue, node);
+  node = SHVar{};
+}
+
+MalString formString(const SHVar &value) {
+  if (value.valueType != SHType::String)
+    throw shards::SHException("Corrupted forms artifact");
+  return MalString(value.payload.stringValue, SHSTRLEN(value));
+}
+
+malValuePtr decodeForm(const SHVar &node) {
+  if (node.valueType != SHType::Seq || node.payload.seqValue.len < 2)
+    throw shards::SHException("Corrupted forms artifact");
+  const auto &items = node.payload.seqValue;
+  const auto tag = FormTag(items.elements[0].payload.intValue);
+  const auto decodeItems = [&]() {
+    std::unique_ptr<malValueVec> forms(new malValueVec);
+    for (uint32_t i = 2; i < items.len; i++)
+      forms->push_back(decodeForm(items.elements[i]));
+    return forms;
+  };
+
+  malValuePtr form;
+  switch (tag) {
+  case FormTag::List:
+    form = mal::list(decodeItems().release());
+    break;
+  case FormTag::Vector:
+    form = mal::vector(decodeItems().release());
+    break;
+  case FormTag::Hash: {
+    // keys are stored the way the hash prints them
+    malValueVec pairs;
+    for (uint32_t i = 2; i + 1 < items.len; i += 2) {
+      const auto key = formString(items.elements[i]);
+      pairs.push_back(key[0] == ':' ? mal::keyword(key) : mal::string(unescape(key)));
+      pairs.push_back(decodeForm(items.elements[i + 1]));
+    }
+    form = mal::hash(pairs.begin(), pairs.end(), false);
+  } break;
+  case FormTag::String:
+    form = mal::string(formString(items.elements[2]));
+    break;
+  case FormTag::Keyword:
+    form = mal::keyword(formString(items.elements[2]));
+    break;
+  case FormTag::Symbol:
+    form = mal::symbol(formString(items.elements[2]));
+    break;
+  case FormTag::ContextVar:
+    form = mal::contextVar(formString(items.elements[2]));
+    break;
+  case FormTag::Integer:
+  case FormTag::Float:
+    form = mal::number(items.elements[2].payload.floatValue, tag == FormTag::Integer);
+    break;
+  case FormTag::Nil:
+    form = mal::nilValue();
+    break;
+  case FormTag::True:
+    form = mal::trueValue();
+    break;
+  case FormTag::False:
+    form = mal::falseValue();
+    break;
+  default:
+    throw shards::SHException("Corrupted forms artifact");
+  }
+  form->line = size_t(items.elements[1].payload.intValue);
+  return form;
+}
+} // namespace
+
+// Same as (read-string (str "(do " (slurp filename) "\nnil)")) but going through the forms cache
+BUILTIN("read-file") {
+  CHECK_ARGS_IS(1);
+  ARG(malString, filename);
+
+  auto filepath = fs::path(filename->value());
+  std::ifstream file(filepath.c_str(), std::ios::binary);
+  MAL_CHECK(!file.fail(), "Cannot open %s", filename->value().c_str());
+
+  MalString source("(do ");
+  source.append(std::istreambuf_iterator<char>(file), {});
+  source.append("\nnil)");
+
+  if (slurpLog)
+    slurpLog->push_back(fs::absolute(filepath).string());
+
+  if (!shards::artifact::enabled())
+    return readStr(source);
+
+  const auto key = shards::artifact::key(source, FormsVersion);
+  const auto artifactPath = shards::artifact::pathOf(filepath.string(), "forms");
+
+  SHVar cached{};
+  if (shards::artifact::loadVar(artifactPath, key, cached)) {
+    DEFER(Serialization::varFree(cached));
+    try {
+      if (cached.valueType == SHType::Seq && cached.payload.seqValue.len == 1)
+        return decodeForm(cached.payload.seqValue.elements[0]);
+    } catch (const std::exception &e) {
+      SHLOG_DEBUG("Stale artifact: {}, {}", artifactPath, e.what());
+    }
+  }
+
+  auto forms = readStr(source);
+  SHVar encoded{};
+  encoded.valueType = SHType::Seq;
+  DEFER(shards::destroyVar(encoded));
+  try {
+    encodeForm(forms, encoded);
+    shards::artifact::storeVar(artifactPath, key, encoded);
+  } catch (const std::exception &e) {
+    SHLOG_DEBUG("Not storing artifact: {}, {}", artifactPath, e.what());
+  }
+  return forms;
+}
+
 BUILTIN("enum") {
   CHECK_ARGS_IS(3);
   ARG(malNumber, value0);
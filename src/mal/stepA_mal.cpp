@@ -380,8 +380,7 @@ static const char *malFunctionTable[] = {
     "(> (count xs) 1) (nth xs 1) (throw \"odd number of forms to cond\")) "
     "(cons 'cond (rest (rest xs)))))))",
     "(def! not (fn* (cond) (if cond false true)))",
-    "(def! load-file (fn* (filename) \
-        (eval (read-string (str \"(do \" (slurp filename) \"\nnil)\")))))",
+    "(def! load-file (fn* (filename) (eval (read-file filename))))",
     "(def! *host-language* \"C++\")",
 };
 
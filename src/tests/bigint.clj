@@ -38,6 +38,24 @@
 
    "4e2" (HexToBytes) (BigInt) (BigInt.ToString) (Assert.Is "1250" true) (Log "Returned")
 
+   ; past 256 bits values go through arbitrary precision
+   "115792089237316195423570985008687907853269984665640564039457584007913129639935" (BigInt) >= .max-u256
+   "1" (BigInt) >= .1
+   .max-u256 (BigInt.Add .1) (BigInt.ToString)
+   (Assert.Is "115792089237316195423570985008687907853269984665640564039457584007913129639936" true)
+   .max-u256 (BigInt.Add .1) (BigInt.Subtract .1) (BigInt.Is .max-u256) (Assert.Is true true)
+   .max-u256 (BigInt.Multiply .max-u256) (BigInt.Divide .max-u256) (BigInt.Is .max-u256) (Assert.Is true true)
+   -7 (BigInt) (BigInt.Mod .2) (BigInt.ToString) (Assert.Is "-1" true)
+   -7 (BigInt) (BigInt.Divide .2) (BigInt.ToString) (Assert.Is "-3" true)
+   "007" (BigInt) (BigInt.ToString) (Assert.Is "7" true)
+
+   ; modular arithmetic, the product would not fit 256 bits
+   "1000000007" (BigInt) >= .p
+   .max-u256 (BigInt.MulMod .max-u256 .p) (BigInt.ToString) (Assert.Is "832694962" true) (Log "MulMod")
+   "3" (BigInt) >= .3
+   .2 (BigInt.PowMod .max-u256 .p) (BigInt.ToString) (Assert.Is "104075069" true) (Log "PowMod")
+   "5" (BigInt) (BigInt.PowMod .3 .p) (BigInt.ToString) (Assert.Is "125" true)
+
    ;
    ))
 
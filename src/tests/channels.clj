@@ -65,4 +65,48 @@
 (schedule Root consumer33)
 (run Root 0.1)
 
+;; a ring of 2 values, the producer suspends until the slow listener catches up
+(def producer
+  (Wire
+   "Producer"
+   (Repeat
+    (-> "A message"
+        (Broadcast "c" :Capacity 2 :Lag BroadcastLag.Block)
+        (Log "Broadcasted (Block): "))
+    10)
+   (Complete "c")))
+
+(def slow-listener
+  (Wire
+   "SlowListener"
+   :Looped
+   (Listen "c")
+   (Log "Slow listener: ")
+   (Pause 0.1)))
+
+;; same ring, the producer never waits and the slow listener skips what it missed
+(def dropping-producer
+  (Wire
+   "DroppingProducer"
+   (Repeat
+    (-> "A message"
+        (Broadcast "d" :Capacity 2 :Lag BroadcastLag.DropOldest)
+        (Log "Broadcasted (DropOldest): "))
+    10)
+   (Complete "d")))
+
+(def dropping-listener
+  (Wire
+   "DroppingListener"
+   :Looped
+   (Listen "d")
+   (Log "Dropping listener: ")
+   (Pause 0.1)))
+
+(schedule Root producer)
+(schedule Root slow-listener)
+(schedule Root dropping-producer)
+(schedule Root dropping-listener)
+(run Root 0.1)
+
 (prn "Done")
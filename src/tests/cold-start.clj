@@ -0,0 +1,38 @@
+; SPDX-License-Identifier: BSD-3-Clause
+; Copyright © 2022 Fragcolor Pte. Ltd.
+
+; Cold start of the project's test scripts, reading them against loading the forms cached under .shards-cache
+; ./shards ../src/tests/cold-start.clj
+; the cached side reads like the uncached one when SHARDS_NO_ARTIFACT_CACHE is set
+
+(def scripts ["general.edn" "variables.clj" "linalg.clj" "channels.clj" "flows.edn" "subwires.clj"
+              "genetic.clj" "kdtree.clj" "wasm.clj" "const-vars.edn" "network.clj" "struct.clj"])
+(def rounds 10)
+
+(defn sum [xs] (if (empty? xs) 0 (+ (first xs) (sum (rest xs)))))
+
+(defn read-uncached [file] (read-string (str "(do " (slurp file) "\nnil)")))
+
+(defn read-times [read file n]
+  (when (> n 0)
+    (read file)
+    (read-times read file (- n 1))))
+
+(defn measure [read file]
+  (let [start (time-ms)]
+    (read-times read file rounds)
+    (/ (- (time-ms) start) (* rounds 1.0))))
+
+(def totals
+  (map
+   (fn [file]
+     ; the first read-file stores the cache, both sides must read to the same forms
+     (if (not (= (read-uncached file) (read-file file)))
+       (throw (str file ": cached forms differ")))
+     (let [uncached (measure read-uncached file)
+           cached (measure read-file file)]
+       (println (str file ": read " uncached " ms, cached " cached " ms"))
+       [uncached cached]))
+   scripts))
+
+(println (str "total: read " (sum (map first totals)) " ms, cached " (sum (map (fn [t] (nth t 1)) totals)) " ms"))
@@ -0,0 +1,106 @@
+; SPDX-License-Identifier: BSD-3-Clause
+; Copyright © 2022 Fragcolor Pte. Ltd.
+
+(def Root (Mesh))
+
+(def value {"name" "player" "position" (Float3 1 2 3) "tags" ["fast" "red" "fast" "red"]})
+
+(defn roundtrip [codec]
+  (->
+   value
+   (ToBytes :Compression codec :Level 5)
+   (FromBytes)
+   (Assert.Is value true)))
+
+(schedule
+ Root
+ (Wire
+  "frames"
+  (roundtrip Codec.Snappy)
+  (roundtrip Codec.Brotli)
+  (roundtrip Codec.Zstd)
+  ;; a value spanning several blocks, compressed in parallel
+  "" (Set .long)
+  (Repeat (-> "Compressing this string is the test, " (AppendTo .long)) 100000)
+  (Get .long) (ToBytes :Compression Codec.Zstd) (Set .frame)
+  (Count .frame) (Log "frame")
+  (Get .frame) (FromBytes) (ExpectString) (Is .long) (Assert.Is true true)))
+
+(tick Root)
+
+(schedule
+ Root
+ (Wire
+  "dictionary"
+  0 (Set .n)
+  (Repeat
+   (-> (Math.Inc .n)
+       .n (ToString) (Set .text)
+       " name: player, position: 1 2 3, health: 100, alive: true" (AppendTo .text)
+       (Get .text) (ToBytes) (Push .samples))
+   2000)
+  (Get .samples) (Zstd.TrainDictionary :Size 4096) (Set .dictionary)
+  (Count .dictionary) (Log "dictionary")
+  (Get .samples) (Take 0) (Set .sample)
+  (Zstd.Compress :Dictionary .dictionary) (Set .with)
+  (Get .sample) (Zstd.Compress) (Set .without)
+  (Count .without) (Set .without-size)
+  (Count .with) (Log "with dictionary")
+  (IsLess .without-size) (Assert.Is true true)
+  (Get .with) (Zstd.Decompress :Dictionary .dictionary)
+  (Assert.Is .sample true)
+  ;; frames only carry the dictionary id
+  (Get .sample) (FromBytes) (ToBytes :Compression Codec.Zstd :Dictionary .dictionary)
+  (FromBytes) (ToBytes) (Assert.Is .sample true)))
+
+(tick Root)
+
+(schedule
+ Root
+ (Wire
+  "streams"
+  (Repeat
+   (-> "A small message that repeats itself"
+       (ToBytes) (Zstd.Compress :Stream true) (Zstd.Decompress :Stream true)
+       (FromBytes) (ExpectString) (Assert.Is "A small message that repeats itself" true)
+       "A small message that repeats itself"
+       (ToBytes) (Brotli.Compress :Stream true) (Brotli.Decompress :Stream true)
+       (FromBytes) (ExpectString) (Assert.Is "A small message that repeats itself" true))
+   10)))
+
+(tick Root)
+
+(schedule
+ Root
+ (Wire
+  "limits"
+  ;; the size recorded in the input is checked before allocating the output
+  "A message longer than sixteen bytes" (ToBytes) (Zstd.Compress) (Set .compressed)
+  (Maybe (-> (Get .compressed) (Zstd.Decompress :MaxSize 16) false) (-> true) :Silent true)
+  (Assert.Is true true)
+  (Get .compressed) (Zstd.Decompress :MaxSize 1024)
+  (FromBytes) (ExpectString) (Assert.Is "A message longer than sixteen bytes" true)))
+
+(tick Root)
+
+(def producer
+  (Wire
+   "Producer"
+   (Repeat
+    (-> value
+        (Produce "compressed" :Compression Codec.Zstd)
+        (Log "Produced: "))
+    5)
+   (Complete "compressed")))
+
+(def consumer
+  (Wire
+   "Consumer"
+   :Looped
+   (Consume "compressed")
+   (Assert.Is value true)
+   (Log "Consumed: ")))
+
+(schedule Root producer)
+(schedule Root consumer)
+(run Root 0.1)
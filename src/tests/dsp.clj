@@ -0,0 +1,45 @@
+; SPDX-License-Identifier: BSD-3-Clause
+; Copyright © 2022 Fragcolor Pte. Ltd.
+
+(def Root (Mesh))
+
+(def signal [0.5 -1.0 0.25 0.75 -0.5 1.0 0.0 -0.25 0.125 -0.75])
+
+(defn small [tolerance]
+  (ForEach (-> (Math.Abs) (IsLess tolerance) (Assert.Is true true))))
+
+(schedule
+ Root
+ (Wire
+  "fft"
+  ;; transforms are not scaled, an inverse after a forward multiplies by the size
+  signal (DSP.FFT) (Set .spectrum)
+  (Count .spectrum) (Assert.Is 6 true)
+  (Get .spectrum) (DSP.IFFT) (Math.Multiply 0.1) (Math.Subtract signal) (small 0.0001)
+  ;; frames of the same length are transformed as one batch
+  [signal signal signal] (DSP.FFT) (Set .spectra)
+  (Count .spectra) (Assert.Is 3 true)
+  (Get .spectra) (DSP.IFFT) (Set .signals)
+  (Count .signals) (Assert.Is 3 true)
+  (Get .signals) (Take 2) (Math.Multiply 0.1) (Math.Subtract signal) (small 0.0001)
+  (Get .spectra) (DSP.IFFT :Complex true) (DSP.FFT) (Count) (Assert.Is 3 true)))
+
+(tick Root)
+
+(schedule
+ Root
+ (Wire
+  "stft"
+  (RandomFloats 4096) (Set .noise)
+  ;; 384 samples of silence lead the stream, 4480 samples make 32 frames
+  (Get .noise) (DSP.STFT :Size 512 :Hop 128 :Window WindowFunction.Hann) (Set .frames)
+  (Count .frames) (Assert.Is 32 true)
+  (Get .frames) (Take 0) (Count) (Assert.Is 257 true)
+  (Get .frames) (DSP.ISTFT :Hop 128 :Window WindowFunction.Hann :SampleRate 48000) (Set .audio)
+  ;; back to floats through a plain roundtrip, the reconstruction is Size - Hop samples late
+  (Get .audio) (DSP.FFT) (DSP.IFFT) (Math.Multiply 0.000244140625) (Slice :From 384) (Set .reconstructed)
+  (Get .noise) (Slice :To 3712) (Math.Subtract .reconstructed) (small 0.001)
+  ;; a third of the rate, plus the filter history
+  (Get .audio) (DSP.Resample :SampleRate 16000 :Taps 32) (DSP.FFT) (Count) (Assert.Is 684 true)))
+
+(tick Root)
@@ -150,3 +150,46 @@
 (schedule Root evolveme)
 (run Root 0.1)
 (prn "Done 3")
+
+(def Root (Mesh))
+
+(def fitness
+  (Wire
+   "fitness"
+   (Math.Subtract 36)
+   (ToFloat)
+   (Math.Abs)
+   (Math.Multiply -1.0)))
+
+(def evolveme
+  (Wire
+   "test"
+   (Sequence .best :Types [Type.Float Type.Wire])
+   (Repeat
+    (->
+     (Evolve
+      (Wire
+       "evolveme"
+       (Mutant (Const 10) [0])
+       (Pause)
+       (Mutant (Math.Multiply 2) [0] [(->
+                                       (RandomInt 10)
+                                       (Math.Add 1))]))
+      fitness
+      :Population 60
+      :Threads 4
+      :Islands 3
+      :MigrationInterval 2
+      :MigrationRate 0.2)
+     (Log) > .best)
+    10)
+   .best
+   (Take 0) (ExpectFloat) (IsMore -20.0) (Assert.Is true)
+   (Log)))
+
+(schedule Root evolveme)
+(run Root 0.1)
+(def Root nil)
+(def evolveme nil)
+(def fitness nil)
+(prn "Done 4")
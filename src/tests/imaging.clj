@@ -34,6 +34,18 @@
   .baseImg
   (ResizeImage :Width 0 :Height 200)
   (WritePNG "testResized2.png")
+  .baseImg
+  (BlurImage 3)
+  (WritePNG "testBlurred.png")
+  .baseImg
+  (BlurImage :Radius 2 :Box true)
+  (WritePNG "testBoxBlurred.png")
+  .baseImg
+  (ConvolveImage [-0.5 2.0 -0.5])
+  (WritePNG "testSharpened.png")
+  .baseImg
+  (ProcessImage [{"Blur" 2} {"Convolve" [-0.5 2.0 -0.5]} {"Resize" (Int2 100 0)}] :Linearize true)
+  (WritePNG "testProcessed.png")
   (WritePNG) (ExpectBytes) ;
   (LoadImage) (ImageToBytes) (ExpectBytes) ;
   ))
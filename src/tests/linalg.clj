@@ -102,6 +102,37 @@
   (Log)
   (Assert.Is mat2t true)
 
+  ; batches
+  (Const [(Float3 1 2 3) (Float3 4 5 6)])
+  (Math.BatchMatMul [(Float4 1 0 0 0) (Float4 0 1 0 0) (Float4 0 0 1 0) (Float4 10 20 30 1)])
+  (Log)
+  (Assert.Is [(Float3 11 22 33) (Float3 14 25 36)] true)
+
+  (Const [identity mat1])
+  (Math.BatchMatMul identity)
+  (Log)
+  (Assert.Is [identity mat1] true)
+
+  (Const [mat1 identity])
+  (Math.BatchMatMul [identity mat1])
+  (Log)
+  (Assert.Is [mat1 mat1] true)
+
+  (Const [mat1 identity])
+  (Math.BatchTranspose)
+  (Log)
+  (Assert.Is [mat1t identity] true)
+
+  (Const [(Float3 0 0 2) (Float3 0 3 4)])
+  (Math.Length)
+  (Log)
+  (Assert.Is [2.0 5.0] true)
+
+  (Const [(Float3 1 2 3) (Float3 1 3 4)])
+  (Math.Dot (Float3 1 5 7))
+  (Log)
+  (Assert.Is [32.0 44.0] true)
+
   (Math.Orthographic 2560 1440 0 10000)
   (Math.Transpose)
   (Log)
@@ -26,4 +26,42 @@
 
 ;; (Loop 5)
 
-(run n 0.1)
\ No newline at end of file
+(run n 0.1)
+; streaming, every wire talks to its own cat without blocking the others
+(def cat-clients 100)
+
+(defn cat-client [i]
+  (Wire
+   (str "cat-" i)
+   (Process.Spawn "cat") = .cat
+   (str "hello " i "\n") (Process.Write .cat)
+   "world\n" (Process.Write .cat)
+   (Process.ReadLine .cat) (Assert.Is (str "hello " i) true)
+   (Process.ReadLine .cat) (Assert.Is "world" true)
+   (Process.CloseInput .cat)
+   (Process.ReadLine .cat) (Assert.Is nil true)
+   (Process.Wait .cat :Timeout 5) (Assert.Is 0 true)))
+
+(map (fn* [i] (schedule n (cat-client i))) (range 1 cat-clients))
+(if (run n) nil (throw "Failed"))
+
+; yes never ends, reading it is throttled by the pipe until it gets killed
+(schedule
+ n
+ (Wire
+  "yes"
+  (Process.Spawn "yes" ["shards"]) = .yes
+  (Repeat (-> (Process.ReadLine .yes) (Assert.Is "shards" true)) :Times 100000)
+  (Process.Read .yes) (ExpectString)
+  (Process.Kill .yes)
+  (Process.Wait .yes :Timeout 5) (Assert.IsNot 0 true)))
+(if (run n) nil (throw "Failed"))
+
+(schedule
+ n
+ (Wire
+  "timeout"
+  (Process.Spawn "sleep" ["10"]) = .sleep
+  (Maybe (-> (Process.Wait .sleep :Timeout 0.5)) (-> -1))
+  (Assert.Is -1 true)))
+(if (run n) nil (throw "Failed"))
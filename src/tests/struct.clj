@@ -73,6 +73,22 @@
   (Log)
   (Take 2)
   (ExpectInt)
-  (Assert.Is 3 true)))
+  (Assert.Is 3 true)
+
+  (Const [1 258])
+  (Pack "i8 i32" :Align true)
+  (ToHex) (Log "aligned")
+  (Assert.Is "0x0100000002010000" true)
+
+  (Const [1 258])
+  (Pack "i8 i32" :BigEndian true)
+  (ToHex) (Log "big endian")
+  (Assert.Is "0x0100000102" true)
+
+  (Const [258 -3 7 1.5 [1.0 -2.0]])
+  (Pack "i16 i32 i32 f64 f32[2]" :Align true :BigEndian true)
+  (Unpack "i16 i32 i32 f64 f32[2]" :Align true :BigEndian true)
+  (Log)
+  (Assert.Is [258 -3 7 1.5 [1.0 -2.0]] true)))
 
 (tick Root)
@@ -1,11 +1,14 @@
 /* SPDX-License-Identifier: BSD-3-Clause */
 /* Copyright © 2020 Fragcolor Pte. Ltd. */
 
+#include <complex>
+#include <numeric>
 #include <random>
 
 #include "../../include/ops.hpp"
 #include "../../include/utility.hpp"
 #include "../core/runtime.hpp"
+#include "../extra/dsp.hpp"
 
 #undef CHECK
 
@@ -23,3 +26,177 @@ int main(int argc, char *argv[]) {
 #endif
   return result;
 }
+
+namespace {
+constexpr double Pi = 3.14159265358979323846;
+
+using Complex = std::complex<double>;
+
+std::vector<Complex> naiveDFT(const std::vector<Complex> &x) {
+  const auto n = x.size();
+  std::vector<Complex> res(n);
+  for (size_t k = 0; k < n; k++) {
+    for (size_t j = 0; j < n; j++)
+      res[k] += x[j] * std::polar(1.0, -2.0 * Pi * double((k * j) % n) / double(n));
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("DSP") {
+  using namespace shards::DSP;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+  SECTION("Plans") {
+    // powers of two, Bluestein sizes, odd and even real sizes
+    for (size_t size : {1, 2, 3, 4, 7, 8, 12, 31, 64, 100, 255, 1024}) {
+      INFO("size " << size);
+      std::vector<Complex> x(size);
+      std::vector<float> complexSignal(size * 2);
+      std::vector<float> realSignal(size);
+      for (size_t i = 0; i < size; i++) {
+        complexSignal[i * 2] = dist(rng);
+        complexSignal[i * 2 + 1] = dist(rng);
+        x[i] = {complexSignal[i * 2], complexSignal[i * 2 + 1]};
+      }
+      const auto expected = naiveDFT(x);
+      const auto tolerance = 1e-5 * std::sqrt(double(size));
+
+      auto complexPlan = Plan::get(Plan::Kind::Complex, size);
+      CHECK(complexPlan == Plan::get(Plan::Kind::Complex, size));
+      std::vector<float> scratch(complexPlan->scratchSize());
+      std::vector<float> spectrum(complexPlan->spectrumFloats());
+      std::vector<float> signal(complexPlan->signalFloats());
+      complexPlan->forward(complexSignal.data(), spectrum.data(), scratch.data());
+      for (size_t k = 0; k < size; k++) {
+        CHECK(std::abs(Complex(spectrum[k * 2], spectrum[k * 2 + 1]) - expected[k]) < tolerance);
+      }
+      complexPlan->inverse(spectrum.data(), signal.data(), scratch.data());
+      for (size_t i = 0; i < size * 2; i++) {
+        CHECK(std::abs(signal[i] / float(size) - complexSignal[i]) < 1e-5f);
+      }
+
+      for (size_t i = 0; i < size; i++) {
+        realSignal[i] = dist(rng);
+        x[i] = realSignal[i];
+      }
+      const auto expectedReal = naiveDFT(x);
+
+      auto realPlan = Plan::get(Plan::Kind::Real, size);
+      CHECK(realPlan != complexPlan);
+      scratch.resize(realPlan->scratchSize());
+      spectrum.resize(realPlan->spectrumFloats());
+      signal.resize(realPlan->signalFloats());
+      REQUIRE(spectrum.size() == (size / 2 + 1) * 2);
+      realPlan->forward(realSignal.data(), spectrum.data(), scratch.data());
+      for (size_t k = 0; k <= size / 2; k++) {
+        CHECK(std::abs(Complex(spectrum[k * 2], spectrum[k * 2 + 1]) - expectedReal[k]) < tolerance);
+      }
+      realPlan->inverse(spectrum.data(), signal.data(), scratch.data());
+      for (size_t i = 0; i < size; i++) {
+        CHECK(std::abs(signal[i] / float(size) - realSignal[i]) < 1e-5f);
+      }
+    }
+  }
+
+  SECTION("Batch") {
+    const size_t size = 512;
+    const size_t count = 100;
+    auto plan = Plan::get(Plan::Kind::Real, size);
+    std::vector<float> signals(count * size);
+    for (auto &v : signals)
+      v = dist(rng);
+
+    std::vector<float> spectra(count * plan->spectrumFloats());
+    plan->forward(signals.data(), spectra.data(), count);
+
+    std::vector<float> scratch(plan->scratchSize());
+    std::vector<float> spectrum(plan->spectrumFloats());
+    for (size_t f = 0; f < count; f++) {
+      plan->forward(&signals[f * size], spectrum.data(), scratch.data());
+      CHECK(std::equal(spectrum.begin(), spectrum.end(), spectra.begin() + f * spectrum.size()));
+    }
+
+    std::vector<float> back(count * size);
+    plan->inverse(spectra.data(), back.data(), count);
+    for (size_t i = 0; i < count * size; i++) {
+      CHECK(std::abs(back[i] / float(size) - signals[i]) < 1e-5f);
+    }
+  }
+
+  SECTION("Window") {
+    // periodic Hann windows overlapping by half sum to one
+    const auto hann = window(WindowFunction::Hann, 64);
+    CHECK(hann[0] == 0.0f);
+    for (size_t i = 0; i < 32; i++) {
+      CHECK(std::abs(hann[i] + hann[i + 32] - 1.0f) < 1e-6f);
+    }
+  }
+
+  SECTION("Resampler") {
+    for (auto [from, to] : std::vector<std::pair<uint32_t, uint32_t>>{{44100, 48000}, {48000, 16000}, {22050, 22050}}) {
+      INFO(from << " to " << to);
+      Resampler resampler(from, to, 2);
+      std::vector<float> input(from * 2);
+      for (size_t i = 0; i < from; i++) {
+        input[i * 2] = float(std::sin(2.0 * Pi * 440.0 * double(i) / double(from)));
+        input[i * 2 + 1] = 0.5f;
+      }
+      // odd chunks, the stream must not care
+      std::vector<float> output;
+      for (size_t offset = 0; offset < from; offset += 777) {
+        resampler.process(&input[offset * 2], std::min(size_t(777), from - offset), output);
+      }
+      const auto frames = output.size() / 2;
+      CHECK(std::abs(double(frames) - double(to)) <= 1.0);
+
+      // the filter delays by half its length
+      const auto divisor = std::gcd(from, to);
+      const auto delay = (double(to / divisor) * 32.0 - 1.0) / (2.0 * double(from / divisor));
+      for (size_t m = frames / 4; m < frames * 3 / 4; m++) {
+        const auto expected = std::sin(2.0 * Pi * 440.0 * (double(m) - delay) / double(to));
+        CHECK(std::abs(output[m * 2] - expected) < 1e-3);
+        CHECK(std::abs(output[m * 2 + 1] - 0.5f) < 1e-3f);
+      }
+    }
+  }
+}
+
+TEST_CASE("DSP-Benchmark", "[.benchmark]") {
+  using namespace shards::DSP;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+  const size_t size = 1024;
+  const size_t count = 256;
+  auto plan = Plan::get(Plan::Kind::Real, size);
+  std::vector<float> signals(count * size);
+  for (auto &v : signals)
+    v = dist(rng);
+  std::vector<float> spectra(count * plan->spectrumFloats());
+  std::vector<float> scratch(plan->scratchSize());
+
+  BENCHMARK("1024 real, one frame") {
+    plan->forward(signals.data(), spectra.data(), scratch.data());
+    return spectra[0];
+  };
+  BENCHMARK("1024 real, 256 frames one by one") {
+    for (size_t f = 0; f < count; f++)
+      plan->forward(&signals[f * size], &spectra[f * plan->spectrumFloats()], scratch.data());
+    return spectra[0];
+  };
+  BENCHMARK("1024 real, 256 frames batched") {
+    plan->forward(signals.data(), spectra.data(), count);
+    return spectra[0];
+  };
+
+  auto bluestein = Plan::get(Plan::Kind::Real, 1000);
+  std::vector<float> bluesteinScratch(bluestein->scratchSize());
+  BENCHMARK("1000 real (Bluestein), one frame") {
+    bluestein->forward(signals.data(), spectra.data(), bluesteinScratch.data());
+    return spectra[0];
+  };
+}
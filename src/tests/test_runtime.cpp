@@ -1156,6 +1156,8 @@ TEST_CASE("HashedActivations") {
 }
 
 #include "number_types.hpp"
+#include <cfloat>
+#include <cmath>
 
 TEST_CASE("Number Types") {
   NumberTypeLookup typeLookup;
@@ -1269,6 +1271,104 @@ TEST_CASE("Vector types") {
   }
 }
 
+TEST_CASE("Number bulk conversion") {
+  SECTION("Normalize") {
+    std::vector<uint8_t> u8(259);
+    for (size_t i = 0; i < u8.size(); i++)
+      u8[i] = uint8_t(i);
+
+    // contiguous buffers take the vectorized path, strided ones the scalar one, they must agree
+    std::vector<float> contiguous(u8.size());
+    std::vector<float> strided(u8.size() * 2);
+    convertNumbers(NumberType::UInt8, u8.data(), NumberType::Float32, contiguous.data(), u8.size(), NumberConversionMode::Normalize);
+    convertNumbers(NumberType::UInt8, u8.data(), 1, NumberType::Float32, strided.data(), sizeof(float) * 2, u8.size(),
+                   NumberConversionMode::Normalize);
+    for (size_t i = 0; i < u8.size(); i++) {
+      CHECK(contiguous[i] == strided[i * 2]);
+      CHECK(contiguous[i] == float(u8[i]) / 255.0f);
+    }
+
+    std::vector<float> floats{-1.0f, 0.0f, 0.5f, 1.0f, 2.0f, NAN, INFINITY, 0.25f, 0.75f, 0.1f};
+    std::vector<uint8_t> back(floats.size());
+    convertNumbers(NumberType::Float32, floats.data(), NumberType::UInt8, back.data(), floats.size(),
+                   NumberConversionMode::Normalize);
+    CHECK(back == std::vector<uint8_t>{0, 0, 128, 255, 255, 0, 255, 64, 191, 26});
+
+    int16_t i16[] = {-32768, 32767, 0};
+    double d[3];
+    convertNumbers(NumberType::Int16, i16, NumberType::Float64, d, 3, NumberConversionMode::Normalize);
+    CHECK(d[0] == -1.0);
+    CHECK(d[1] == 1.0);
+    CHECK(d[2] == 0.0);
+  }
+
+  SECTION("Saturate") {
+    double d[] = {1e300, -1e300, NAN, 3.7};
+    int64_t i64[4];
+    int8_t i8[4];
+    float f[4];
+    convertNumbers(NumberType::Float64, d, NumberType::Int64, i64, 4, NumberConversionMode::Saturate);
+    convertNumbers(NumberType::Float64, d, NumberType::Int8, i8, 4, NumberConversionMode::Saturate);
+    convertNumbers(NumberType::Float64, d, NumberType::Float32, f, 4, NumberConversionMode::Saturate);
+    CHECK(i64[0] == INT64_MAX);
+    CHECK(i64[1] == INT64_MIN);
+    CHECK(i64[2] == 0);
+    CHECK(i64[3] == 3);
+    CHECK(i8[0] == 127);
+    CHECK(i8[1] == -128);
+    CHECK(f[0] == FLT_MAX);
+    CHECK(f[1] == -FLT_MAX);
+
+    int64_t ints[] = {300, -5, 100};
+    uint8_t u8[3];
+    convertNumbers(NumberType::Int64, ints, NumberType::UInt8, u8, 3, NumberConversionMode::Saturate);
+    CHECK(u8[0] == 255);
+    CHECK(u8[1] == 0);
+    CHECK(u8[2] == 100);
+  }
+
+  SECTION("Gather from vars") {
+    std::vector<Var> vars{Var(1.5), Var(2.5), Var(-3.5)};
+    float f[3];
+    convertNumbers(NumberType::Float64, &vars[0].payload.floatValue, sizeof(SHVar), NumberType::Float32, f, sizeof(float), 3);
+    CHECK(f[0] == 1.5f);
+    CHECK(f[1] == 2.5f);
+    CHECK(f[2] == -3.5f);
+  }
+}
+
+TEST_CASE("Number-Conversion-Benchmark", "[.benchmark]") {
+  // 1080p RGBA
+  const size_t size = 1920 * 1080 * 4;
+  std::vector<uint8_t> image(size);
+  for (size_t i = 0; i < size; i++)
+    image[i] = uint8_t(i * 31);
+  std::vector<float> floats(size);
+  std::vector<Var> vars(size, Var(0.0));
+
+  BENCHMARK("UInt8 to Float32 (normalize)") {
+    convertNumbers(NumberType::UInt8, image.data(), NumberType::Float32, floats.data(), size, NumberConversionMode::Normalize);
+    return floats[size - 1];
+  };
+
+  BENCHMARK("Float32 to UInt8 (normalize)") {
+    convertNumbers(NumberType::Float32, floats.data(), NumberType::UInt8, image.data(), size, NumberConversionMode::Normalize);
+    return image[size - 1];
+  };
+
+  BENCHMARK("UInt8 to Float vars (ImageToFloats)") {
+    convertNumbers(NumberType::UInt8, image.data(), 1, NumberType::Float64, &vars[0].payload.floatValue, sizeof(SHVar), size,
+                   NumberConversionMode::Normalize);
+    return vars[size - 1].payload.floatValue;
+  };
+
+  BENCHMARK("UInt8 to Float vars (per element)") {
+    for (size_t i = 0; i < size; i++)
+      vars[i].payload.floatValue = double(image[i]) / 255.0;
+    return vars[size - 1].payload.floatValue;
+  };
+}
+
 TEST_CASE("UnsafeActivate-shard") {
   typedef SHVar (*Func)(SHContext *, const SHVar *);
   Func f = [](SHContext *ctx, const SHVar *input) -> SHVar { return Var(77); };
@@ -1279,3 +1379,1904 @@ TEST_CASE("UnsafeActivate-shard") {
   SHVar input{};
   CHECK(b1->activate(b1, nullptr, &input).payload.intValue == 77);
 }
+
+#include "../core/edn/read.hpp"
+#include <regex>
+
+namespace {
+// generates a script with one 5 lines wire per iteration
+std::string generateEdnScript(size_t wires) {
+  std::string script;
+  for (size_t i = 0; i < wires; i++) {
+    script += "(defwire wire-" + std::to_string(i) + "\n";
+    script += "  \"hello \\\"world\\\"\\n\" (Log \"prefix\") ; a comment\n";
+    script += "  [1 2.5 0xFF -3 .key] (Math.Add 1)\n";
+    script += "  {:a 1 :b #{1 2}} (Assert.Is true) '(quoted form))\n\n";
+  }
+  return script;
+}
+
+// the regex tokenizer the reader used to have, kept as reference
+size_t regexTokenize(const std::string &input) {
+  static const std::regex regex("([\\s,]+)|(~@|#\\{)|([\\[\\]{}()\'`~^@])|(\"(?:\\\\.|[^\\\\\"])*\"?)|"
+                                "(#\"(?:\\\\.|[^\\\\\"])*\"?)|(;.*)|(0[xX][0-9a-fA-F]+)|"
+                                "([-+]?[0-9]*\\.[0-9]+([eE][-+]?[0-9]+)?)|([-+]?\\d+)|([^\\s\\[\\]{}(\'\"`,;)]+)");
+  size_t count = 0;
+  for (std::sregex_iterator it(input.begin(), input.end(), regex), end; it != end; ++it) {
+    count++;
+  }
+  return count;
+}
+} // namespace
+
+TEST_CASE("EDN-Lexer") {
+  using namespace shards::edn;
+
+  auto tokens = token::tokenize("(foo 1 -2.5e3 0x1F\n  \"a \\\"b\\\"\" #\"raw\" true ~@x) ; done");
+  REQUIRE(tokens.size() == 11);
+  CHECK(tokens[0].type == token::type::SPECIAL_CHAR);
+  CHECK(tokens[1].type == token::type::SYMBOL);
+  CHECK(std::get<std::string>(tokens[1].value) == "foo");
+  CHECK(tokens[2].type == token::type::INT);
+  CHECK(std::get<int64_t>(tokens[2].value) == 1);
+  CHECK(tokens[3].type == token::type::DOUBLE);
+  CHECK(std::get<double>(tokens[3].value) == -2500.0);
+  CHECK(tokens[4].type == token::type::HEX);
+  CHECK(std::get<int64_t>(tokens[4].value) == 31);
+  CHECK(tokens[5].type == token::type::STRING);
+  CHECK(tokens[5].line == 2);
+  CHECK(tokens[5].column == 3);
+  CHECK(tokens[6].type == token::type::RAW_STRING);
+  CHECK(tokens[7].type == token::type::SYMBOL);
+  CHECK(std::get<bool>(tokens[7].value) == true);
+  CHECK(tokens[8].type == token::type::SPECIAL_CHARS);
+  CHECK(tokens[9].type == token::type::SYMBOL);
+  CHECK(tokens[10].type == token::type::SPECIAL_CHAR);
+  CHECK(tokens[10].line == 2);
+  CHECK(tokens[10].column == 28);
+
+  // 1. is an int followed by a symbol, like it always was
+  tokens = token::tokenize("1.");
+  REQUIRE(tokens.size() == 2);
+  CHECK(tokens[0].type == token::type::INT);
+  CHECK(tokens[1].type == token::type::SYMBOL);
+}
+
+TEST_CASE("EDN-IncrementalRead") {
+  using namespace shards::edn;
+
+  auto script = generateEdnScript(100);
+  auto full = read(script);
+
+  ReadCache cache;
+  auto first = read(script, cache);
+  CHECK(cache.misses == 100);
+  CHECK(cache.hits == 0);
+  REQUIRE(first.size() == full.size());
+
+  // change a single form and shift every following one by a line
+  auto pos = script.find("(defwire wire-50\n");
+  script.insert(pos, "\n(defwire added\n  (Msg \"new\"))\n");
+  auto second = read(script, cache);
+  CHECK(cache.misses == 1);
+  CHECK(cache.hits == 100);
+
+  auto fresh = read(script);
+  REQUIRE(second.size() == fresh.size());
+  auto it = fresh.begin();
+  for (auto &form : second) {
+    CHECK(form::FormWrapper{form} == form::FormWrapper{*it});
+    // the first token of each wire must be on the same line in both reads
+    auto &a = std::get<std::list<form::FormWrapper>>(form).front();
+    auto &b = std::get<std::list<form::FormWrapper>>(*it).front();
+    CHECK(std::get<token::Token>(a.form).line == std::get<token::Token>(b.form).line);
+    ++it;
+  }
+}
+
+TEST_CASE("EDN-Reader-Benchmark", "[.benchmark]") {
+  using namespace shards::edn;
+
+  // ~50k lines
+  const auto script = generateEdnScript(10000);
+
+  BENCHMARK("Regex tokenizer (previous reader)") { return regexTokenize(script); };
+
+  BENCHMARK("Lexer") { return token::tokenize(script).size(); };
+
+  BENCHMARK("Full read") { return read(script).size(); };
+
+  ReadCache cache;
+  read(script, cache);
+  BENCHMARK("Incremental re-read") { return read(script, cache).size(); };
+}
+
+#include "../core/shards/sort.hpp"
+
+namespace {
+std::vector<Var> generateSortKeys(SHType type, size_t len, std::vector<std::string> &strings) {
+  std::mt19937_64 rng(len);
+  std::vector<Var> keys(len);
+  strings.resize(len);
+  for (size_t i = 0; i < len; i++) {
+    const auto r = int64_t(rng() % 100000) - 50000;
+    switch (type) {
+    case SHType::Int:
+      keys[i] = Var(r);
+      break;
+    case SHType::Float:
+      keys[i] = Var(double(r) / 3.0);
+      break;
+    case SHType::String:
+      strings[i] = "item-" + std::to_string(r);
+      keys[i] = Var(strings[i]);
+      break;
+    default:
+      keys[i] = Var(r, r);
+      break;
+    }
+  }
+  return keys;
+}
+} // namespace
+
+TEST_CASE("SeqSorter") {
+  std::vector<std::string> strings;
+  for (auto type : {SHType::Int, SHType::Float, SHType::String, SHType::Int2}) {
+    for (size_t len : {0, 1, 10, 1000, 100000}) {
+      auto keys = generateSortKeys(type, len, strings);
+      for (bool desc : {false, true}) {
+        for (bool parallel : {false, true}) {
+          SeqSorter sorter;
+          sorter.sort(keys.data(), len, desc, parallel);
+
+          // must match a stable sort on the same keys
+          std::vector<uint32_t> expected(len);
+          for (size_t i = 0; i < len; i++)
+            expected[i] = uint32_t(i);
+          std::stable_sort(expected.begin(), expected.end(),
+                           [&](uint32_t a, uint32_t b) { return desc ? keys[b] < keys[a] : keys[a] < keys[b]; });
+          CHECK(sorter.order == expected);
+        }
+      }
+    }
+  }
+
+  // mixed types cannot be compared
+  std::vector<Var> mixed{Var(1), Var(2.0), Var(0)};
+  SeqSorter sorter;
+  CHECK_THROWS(sorter.sort(mixed.data(), mixed.size(), false, false));
+}
+
+TEST_CASE("Sort-Benchmark", "[.benchmark]") {
+  std::vector<std::string> strings;
+  for (size_t len : {1000, 100000, 1000000}) {
+    for (auto type : {SHType::Int, SHType::Float, SHType::String, SHType::Int2}) {
+      auto keys = generateSortKeys(type, len, strings);
+      SeqSorter sorter;
+      const auto name = type2Name(type) + " x " + std::to_string(len);
+
+      BENCHMARK(name.c_str()) {
+        sorter.sort(keys.data(), len, false, false);
+        return sorter.order[0];
+      };
+
+      BENCHMARK((name + " (parallel)").c_str()) {
+        sorter.sort(keys.data(), len, false, true);
+        return sorter.order[0];
+      };
+
+      if (len <= 100000) {
+        BENCHMARK((name + " (std::stable_sort)").c_str()) {
+          std::vector<Var> copy(keys);
+          std::stable_sort(copy.begin(), copy.end(), [](const SHVar &a, const SHVar &b) { return a < b; });
+          return copy[0].valueType;
+        };
+      }
+    }
+  }
+}
+
+#include "../core/shards/linalg.hpp"
+
+namespace {
+using namespace shards::Math::LinAlg;
+
+std::vector<Var> generatePoints(SHType type, size_t len) {
+  std::vector<Var> points(len);
+  for (size_t i = 0; i < len; i++) {
+    const float f = float(i % 1000) * 0.01f;
+    if (type == SHType::Float3)
+      points[i] = Var(f, f + 1.0f, f - 2.0f);
+    else
+      points[i] = Var(f, f + 1.0f, f - 2.0f, 1.0f);
+  }
+  return points;
+}
+
+std::vector<Var> generateMatrices(size_t len, std::vector<Var> &columns) {
+  columns.resize(len * 4);
+  std::vector<Var> matrices(len);
+  for (size_t i = 0; i < len; i++) {
+    for (size_t c = 0; c < 4; c++) {
+      const float f = float((i + c) % 16) * 0.25f;
+      columns[i * 4 + c] = Var(f, f + 1.0f, f * 0.5f, float(c == 3));
+    }
+    matrices[i].valueType = SHType::Seq;
+    matrices[i].payload.seqValue.elements = &columns[i * 4];
+    matrices[i].payload.seqValue.len = 4;
+  }
+  return matrices;
+}
+
+linalg::aliases::float4 float4Of(const SHVar &v) {
+  const auto &f = v.payload.float4Value;
+  return {f[0], f[1], f[2], f[3]};
+}
+} // namespace
+
+TEST_CASE("LinAlg-Batch") {
+  std::vector<Var> columns;
+  auto matrices = generateMatrices(37, columns);
+  const auto m = Batch::toMatrix(matrices[5]);
+
+  SECTION("Transform") {
+    for (auto type : {SHType::Float3, SHType::Float4}) {
+      auto points = generatePoints(type, 37);
+      std::vector<Var> out(points.size());
+      Batch::transform(m, type, points.data(), out.data(), points.size());
+      for (size_t i = 0; i < points.size(); i++) {
+        auto v = float4Of(points[i]);
+        if (type == SHType::Float3)
+          v.w = 1.0f;
+        const auto expected = linalg::mul(m, v);
+        CHECK(out[i].valueType == type);
+        for (int d = 0; d < (type == SHType::Float3 ? 3 : 4); d++)
+          CHECK(out[i].payload.float4Value[d] == Catch::Approx(expected[d]));
+      }
+    }
+  }
+
+  SECTION("MulMatrices") {
+    std::vector<Var> outColumns;
+    auto out = generateMatrices(matrices.size(), outColumns);
+    Batch::mulMatrices(matrices.data(), matrices.data() + matrices.size() - 1, 0, out.data(), matrices.size());
+    const auto b = Batch::toMatrix(matrices.back());
+    for (size_t i = 0; i < matrices.size(); i++) {
+      const auto expected = linalg::mul(Batch::toMatrix(matrices[i]), b);
+      const auto result = Batch::toMatrix(out[i]);
+      for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++)
+          CHECK(result[c][r] == Catch::Approx(expected[c][r]));
+      }
+    }
+
+    Batch::transposeMatrices(matrices.data(), out.data(), matrices.size());
+    for (size_t i = 0; i < matrices.size(); i++) {
+      const auto expected = linalg::transpose(Batch::toMatrix(matrices[i]));
+      const auto result = Batch::toMatrix(out[i]);
+      for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++)
+          CHECK(result[c][r] == expected[c][r]);
+      }
+    }
+  }
+
+  SECTION("Vector ops") {
+    auto points = generatePoints(SHType::Float3, 37);
+    std::vector<Var> out(points.size());
+    Var operand(0.5f, -1.0f, 2.0f);
+
+    Batch::cross(points.data(), &operand, 0, out.data(), points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+      SHVar expected{};
+      Cross::Operation()(expected, points[i], operand);
+      CHECK(out[i] == expected);
+    }
+
+    Batch::dot(SHType::Float3, points.data(), points.data(), 1, out.data(), points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+      SHVar expected{};
+      Dot::Operation()(expected, points[i], points[i]);
+      CHECK(out[i].payload.floatValue == Catch::Approx(expected.payload.floatValue));
+    }
+
+    Batch::normalize(SHType::Float3, points.data(), out.data(), points.size(), true);
+    for (size_t i = 0; i < points.size(); i++) {
+      SHVar expected{};
+      Normalize::Operation{true}(expected, points[i]);
+      for (int d = 0; d < 3; d++)
+        CHECK(out[i].payload.float3Value[d] == Catch::Approx(expected.payload.float3Value[d]));
+    }
+  }
+}
+
+TEST_CASE("LinAlg-Batch-Benchmark", "[.benchmark]") {
+  std::vector<Var> columns;
+  auto matrices = generateMatrices(10000, columns);
+  const Mat4 m = Batch::toMatrix(matrices[0]);
+
+  for (size_t len : {1000, 100000}) {
+    auto points = generatePoints(SHType::Float4, len);
+    std::vector<Var> out(len);
+    const auto name = std::to_string(len);
+
+    BENCHMARK(("Transform Float4 x " + name + " (per item)").c_str()) {
+      for (size_t i = 0; i < len; i++) {
+        // same as the Math.MatMul Mat @ Vec path
+        auto v = reinterpret_cast<const linalg::aliases::float4 *>(&points[i].payload);
+        auto r = reinterpret_cast<linalg::aliases::float4 *>(&out[i].payload);
+        *r = linalg::mul(m, *v);
+        out[i].valueType = SHType::Float4;
+      }
+      return out[0].valueType;
+    };
+
+    BENCHMARK(("Transform Float4 x " + name + " (batch)").c_str()) {
+      Batch::transform(m, SHType::Float4, points.data(), out.data(), len);
+      return out[0].valueType;
+    };
+
+    Var operand(0.5f, -1.0f, 2.0f);
+    auto points3 = generatePoints(SHType::Float3, len);
+    BENCHMARK(("Cross x " + name + " (per item)").c_str()) {
+      Cross::Operation op;
+      for (size_t i = 0; i < len; i++)
+        op(out[i], points3[i], operand);
+      return out[0].valueType;
+    };
+
+    BENCHMARK(("Cross x " + name + " (batch)").c_str()) {
+      Batch::cross(points3.data(), &operand, 0, out.data(), len);
+      return out[0].valueType;
+    };
+  }
+
+  std::vector<Var> outColumns;
+  auto out = generateMatrices(matrices.size(), outColumns);
+  BENCHMARK("MatMul 4x4 x 10000 (per item)") {
+    for (size_t i = 0; i < matrices.size(); i++) {
+      const auto r = linalg::mul(Batch::toMatrix(matrices[i]), Batch::toMatrix(matrices[0]));
+      for (int c = 0; c < 4; c++)
+        out[i].payload.seqValue.elements[c].payload.float4Value = SHFloat4{r[c][0], r[c][1], r[c][2], r[c][3]};
+    }
+    return out[0].valueType;
+  };
+
+  BENCHMARK("MatMul 4x4 x 10000 (batch)") {
+    Batch::mulMatrices(matrices.data(), matrices.data(), 0, out.data(), matrices.size());
+    return out[0].valueType;
+  };
+}
+
+#include "../core/shards/seq_index.hpp"
+
+TEST_CASE("SeqIndex") {
+  std::vector<Var> items;
+  for (int64_t i = 0; i < 1000; i++)
+    items.emplace_back(i % 300);
+
+  SeqIndex index;
+  index.sync(items.data(), 500, 0);
+  CHECK(index.size() == 500);
+  CHECK(index.find(items.data(), Var(5)) == 5);
+  CHECK(index.find(items.data(), Var(299)) == 299);
+  CHECK(index.find(items.data(), Var(300)) == -1);
+  CHECK(index.find(items.data(), Var(5.0)) == -1);
+
+  const auto indicesOf = [&](const SHVar &key) {
+    std::vector<uint32_t> res;
+    index.forEach(items.data(), key, [&](uint32_t i) {
+      res.push_back(i);
+      return true;
+    });
+    return res;
+  };
+  CHECK(indicesOf(Var(3)) == std::vector<uint32_t>{3, 303});
+
+  // appends are picked up incrementally
+  index.sync(items.data(), items.size(), 0);
+  CHECK(indicesOf(Var(3)) == std::vector<uint32_t>{3, 303, 603, 903});
+
+  // a new generation rebuilds
+  items[3] = Var(-1);
+  index.sync(items.data(), items.size(), 1);
+  CHECK(index.find(items.data(), Var(3)) == 303);
+  CHECK(index.find(items.data(), Var(-1)) == 3);
+
+  // shrinking rebuilds too
+  index.sync(items.data(), 10, 1);
+  CHECK(index.find(items.data(), Var(3)) == -1);
+  CHECK(index.find(items.data(), Var(9)) == 9);
+
+  SECTION("Registry") {
+    SHVar var{};
+    auto generation = SeqIndexRegistry::track(var);
+    CHECK((var.flags & SHVAR_FLAGS_INDEXED) != 0);
+    const auto start = generation->load();
+    invalidateSeqIndex(var);
+    CHECK(generation->load() == start + 1);
+
+    // tracking again shares the generation but assumes a change
+    auto other = SeqIndexRegistry::track(var);
+    CHECK(other == generation);
+    CHECK(generation->load() == start + 2);
+
+    // nobody left indexing, the flag goes away on the next invalidation
+    generation.reset();
+    other.reset();
+    invalidateSeqIndex(var);
+    CHECK((var.flags & SHVAR_FLAGS_INDEXED) == 0);
+  }
+}
+
+TEST_CASE("SeqIndex-Benchmark", "[.benchmark]") {
+  for (size_t len : {100, 10000, 1000000}) {
+    std::vector<Var> items;
+    for (size_t i = 0; i < len; i++)
+      items.emplace_back(int64_t(i));
+    const auto name = std::to_string(len);
+    const Var needle(int64_t(len - 1));
+
+    SeqIndex index;
+    index.sync(items.data(), len, 0);
+
+    BENCHMARK(("find x " + name).c_str()) { return index.find(items.data(), needle); };
+
+    BENCHMARK(("linear scan x " + name).c_str()) {
+      for (size_t i = 0; i < len; i++) {
+        if (items[i] == needle)
+          return int64_t(i);
+      }
+      return int64_t(-1);
+    };
+
+    BENCHMARK(("build x " + name).c_str()) {
+      SeqIndex fresh;
+      fresh.sync(items.data(), len, 0);
+      return fresh.size();
+    };
+  }
+}
+
+#include "../core/shards/imaging.hpp"
+
+namespace {
+SHImage floatImage(std::vector<float> &pixels, uint16_t w, uint16_t h, uint8_t c) {
+  SHImage image{};
+  image.width = w;
+  image.height = h;
+  image.channels = c;
+  image.flags = SHIMAGE_FLAGS_32BITS_FLOAT;
+  image.data = reinterpret_cast<uint8_t *>(pixels.data());
+  return image;
+}
+
+std::vector<float> runPipeline(Imaging::ImagePipeline &pipeline, SHImage image) {
+  std::vector<float> out(size_t(pipeline.width()) * pipeline.height() * image.channels);
+  pipeline.run(image, reinterpret_cast<uint8_t *>(out.data()), false);
+  return out;
+}
+
+float maxError(const std::vector<float> &a, const std::vector<float> &b) {
+  REQUIRE(a.size() == b.size());
+  float res = 0.0f;
+  for (size_t i = 0; i < a.size(); i++)
+    res = std::max(res, std::abs(a[i] - b[i]));
+  return res;
+}
+} // namespace
+
+TEST_CASE("ImagePipeline") {
+  // not a multiple of the tile size on purpose
+  const uint16_t w = 300, h = 170;
+  const uint8_t c = 3;
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+  std::vector<float> pixels(size_t(w) * h * c);
+  for (auto &p : pixels)
+    p = dist(rng);
+  const auto image = floatImage(pixels, w, h, c);
+
+  SECTION("Identity") {
+    Imaging::ImagePipeline pipeline;
+    pipeline.reset(w, h);
+    CHECK(runPipeline(pipeline, image) == pixels);
+  }
+
+  SECTION("Gaussian blur matches a direct 2D convolution") {
+    const int r = 3;
+    const auto taps = Imaging::gaussianKernel(r);
+    std::vector<float> expected(pixels.size());
+    for (int y = 0; y < h; y++) {
+      for (int x = 0; x < w; x++) {
+        for (int ch = 0; ch < c; ch++) {
+          double acc = 0.0;
+          for (int j = -r; j <= r; j++) {
+            for (int i = -r; i <= r; i++) {
+              const int yy = std::clamp(y + j, 0, h - 1);
+              const int xx = std::clamp(x + i, 0, w - 1);
+              acc += taps[j + r] * taps[i + r] * pixels[(size_t(yy) * w + xx) * c + ch];
+            }
+          }
+          expected[(size_t(y) * w + x) * c + ch] = float(acc);
+        }
+      }
+    }
+
+    Imaging::ImagePipeline pipeline;
+    pipeline.reset(w, h);
+    pipeline.gaussianBlur(r);
+    CHECK(maxError(runPipeline(pipeline, image), expected) < 1e-5f);
+  }
+
+  SECTION("Fused chains match running each step") {
+    Imaging::ImagePipeline fused;
+    fused.reset(w, h);
+    fused.boxBlur(2);
+    fused.resize(123, 77);
+    fused.gaussianBlur(1);
+    const auto result = runPipeline(fused, image);
+
+    Imaging::ImagePipeline blur;
+    blur.reset(w, h);
+    blur.boxBlur(2);
+    auto step1 = runPipeline(blur, image);
+
+    Imaging::ImagePipeline resize;
+    resize.reset(w, h);
+    resize.resize(123, 77);
+    auto step2 = runPipeline(resize, floatImage(step1, w, h, c));
+
+    Imaging::ImagePipeline blur2;
+    blur2.reset(123, 77);
+    blur2.gaussianBlur(1);
+    auto step3 = runPipeline(blur2, floatImage(step2, 123, 77, c));
+
+    CHECK(maxError(result, step3) < 1e-5f);
+  }
+
+  SECTION("Resizing keeps flat colors") {
+    std::vector<uint8_t> rgba(64 * 48 * 4);
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+      rgba[i] = 200;
+      rgba[i + 1] = 10;
+      rgba[i + 2] = 90;
+      rgba[i + 3] = 255;
+    }
+    SHImage input{};
+    input.width = 64;
+    input.height = 48;
+    input.channels = 4;
+    input.data = rgba.data();
+
+    Imaging::ImagePipeline pipeline;
+    pipeline.reset(64, 48);
+    pipeline.resize(150, 0);
+    CHECK(pipeline.width() == 150);
+    CHECK(pipeline.height() == 112);
+
+    std::vector<uint8_t> out(size_t(pipeline.width()) * pipeline.height() * 4);
+    pipeline.run(input, out.data(), true);
+    for (size_t i = 0; i < out.size(); i += 4) {
+      REQUIRE(std::abs(int(out[i]) - 200) <= 1);
+      REQUIRE(std::abs(int(out[i + 1]) - 10) <= 1);
+      REQUIRE(std::abs(int(out[i + 2]) - 90) <= 1);
+      REQUIRE(out[i + 3] == 255);
+    }
+  }
+}
+
+TEST_CASE("ImagePipeline-Benchmark", "[.benchmark]") {
+  const uint16_t w = 3840, h = 2160;
+  std::mt19937 rng(42);
+  std::vector<uint8_t> pixels(size_t(w) * h * 4);
+  for (auto &p : pixels)
+    p = uint8_t(rng());
+  SHImage image{};
+  image.width = w;
+  image.height = h;
+  image.channels = 4;
+  image.data = pixels.data();
+  std::vector<uint8_t> out(pixels.size());
+
+  const auto bench = [&](const char *name, bool linearize, auto build) {
+    Imaging::ImagePipeline pipeline;
+    pipeline.reset(w, h);
+    build(pipeline);
+    BENCHMARK(name) {
+      pipeline.run(image, out.data(), linearize);
+      return out[0];
+    };
+  };
+
+  bench("4K box blur r4", false, [](auto &p) { p.boxBlur(4); });
+  bench("4K gaussian blur r8", false, [](auto &p) { p.gaussianBlur(8); });
+  bench("4K resize to 1080p (linear light)", true, [](auto &p) { p.resize(1920, 1080); });
+  bench("4K gaussian blur r4 + resize to 1080p (fused)", false, [](auto &p) {
+    p.gaussianBlur(4);
+    p.resize(1920, 1080);
+  });
+}
+
+TEST_CASE("HashCache") {
+  SeqVar items;
+  for (int64_t i = 0; i < 100; i++)
+    items.push_back(Var(i));
+  const auto expected = hash(items);
+
+  SECTION("Seq") {
+    OwnedVar frozen = items;
+    frozen.flags |= SHVAR_FLAGS_FROZEN;
+    CHECK(hash(frozen) == expected);
+    // second time from the cache
+    CHECK(hash(frozen) == expected);
+
+    // overwriting with a same length seq reuses the storage, the cached hash must go
+    SeqVar other;
+    for (int64_t i = 0; i < 100; i++)
+      other.push_back(Var(i * 2));
+    frozen = other;
+    CHECK(frozen.payload.seqValue.len == 100);
+    CHECK(hash(frozen) == hash(other));
+    CHECK(hash(frozen) != expected);
+  }
+
+  SECTION("Nested") {
+    TableVar table;
+    cloneVar(table["items"], items);
+    table["name"] = Var("cached");
+    for (int64_t i = 0; i < 10; i++)
+      table[std::to_string(i)] = Var(i);
+    const auto tableHash = hash(table);
+
+    OwnedVar frozen = table;
+    frozen.flags |= SHVAR_FLAGS_FROZEN;
+    CHECK(hash(frozen) == tableHash);
+    CHECK(hash(frozen) == tableHash);
+
+    // frozen and plain children hash the same
+    const auto pushClone = [](SeqVar &seq, const SHVar &value) {
+      SHVar copy{};
+      cloneVar(copy, value);
+      seq.push_back(std::move(copy));
+    };
+    SeqVar outer;
+    pushClone(outer, table);
+    outer.push_back(frozen);
+    SeqVar outerCopy;
+    pushClone(outerCopy, table);
+    pushClone(outerCopy, table);
+    CHECK(hash(outer) == hash(outerCopy));
+    // outer only borrowed frozen
+    outer[1] = Var::Empty;
+  }
+
+  SECTION("Params") {
+    ParamVar param(items);
+    CHECK((((SHVar)param).flags & SHVAR_FLAGS_FROZEN) == SHVAR_FLAGS_FROZEN);
+    CHECK(hash(param) == expected);
+    CHECK(hash(param) == expected);
+    param = Var(10);
+    CHECK(hash(param) == hash(Var(10)));
+  }
+}
+
+TEST_CASE("HashCache-Benchmark", "[.benchmark]") {
+  for (size_t len : {100, 10000, 1000000}) {
+    SeqVar items;
+    for (size_t i = 0; i < len; i++)
+      items.push_back(Var(int64_t(i)));
+    OwnedVar frozen = items;
+    frozen.flags |= SHVAR_FLAGS_FROZEN;
+    const auto name = std::to_string(len);
+
+    BENCHMARK(("hash x " + name).c_str()) { return hash(items); };
+    BENCHMARK(("cached hash x " + name).c_str()) { return hash(frozen); };
+  }
+}
+
+TEST_CASE("CompletionSignal") {
+  SECTION("Stale generation") {
+    const auto seen = CompletionSignal::generation();
+    CompletionSignal::notify();
+    const auto start = SHClock::now();
+    CompletionSignal::wait(seen, SHDuration(10.0));
+    CHECK(SHDuration(SHClock::now() - start).count() < 5.0);
+  }
+
+  SECTION("Notify from another thread") {
+    const auto seen = CompletionSignal::generation();
+    std::thread notifier([]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      CompletionSignal::notify();
+    });
+    const auto start = SHClock::now();
+    CompletionSignal::wait(seen, SHDuration(10.0));
+    CHECK(SHDuration(SHClock::now() - start).count() < 5.0);
+    notifier.join();
+  }
+}
+
+namespace {
+std::shared_ptr<SHMesh> awaitingMesh(size_t count) {
+  auto mesh = SHMesh::make();
+  for (size_t i = 0; i < count; i++) {
+    auto wire = shards::Wire("test-wire-await-" + std::to_string(i))
+                    .let(int64_t(i))
+                    .shard("Await", Weave().shard("Math.Add", int64_t(1)))
+                    .shard("Assert.Is", int64_t(i + 1));
+    mesh->schedule(wire);
+  }
+  return mesh;
+}
+} // namespace
+
+TEST_CASE("ParkedAwaits") {
+  auto mesh = awaitingMesh(1000);
+  size_t ticks = 0;
+  while (!mesh->empty()) {
+    REQUIRE(mesh->tick());
+    mesh->idle(SHDuration(0.01));
+    ticks++;
+  }
+  CHECK(ticks > 0);
+}
+
+TEST_CASE("ParkedAwaits-Benchmark", "[.benchmark]") {
+  for (size_t count : {100, 5000}) {
+    const auto name = std::to_string(count);
+
+    BENCHMARK_ADVANCED(("awaits x " + name + " idle").c_str())(Catch::Benchmark::Chronometer meter) {
+      auto mesh = awaitingMesh(count);
+      meter.measure([&]() {
+        size_t ticks = 0;
+        while (!mesh->empty()) {
+          mesh->tick();
+          mesh->idle(SHDuration(0.01));
+          ticks++;
+        }
+        return ticks;
+      });
+    };
+
+    BENCHMARK_ADVANCED(("awaits x " + name + " spinning").c_str())(Catch::Benchmark::Chronometer meter) {
+      auto mesh = awaitingMesh(count);
+      meter.measure([&]() {
+        size_t ticks = 0;
+        while (!mesh->empty()) {
+          mesh->tick();
+          ticks++;
+        }
+        return ticks;
+      });
+    };
+  }
+}
+
+namespace {
+shards::Wire nondeterministicWire() {
+  return shards::Wire("test-wire-replay")
+      .shard("RandomFloat")
+      .shard("Push", Var("values"))
+      .shard("Time.Delta")
+      .shard("Push", Var("values"))
+      .shard("Pause", 0.002)
+      .shard("Time.Now")
+      .shard("Push", Var("values"))
+      .let(int64_t(41))
+      .shard("Await", Weave().shard("Math.Add", int64_t(1)))
+      .shard("ToFloat")
+      .shard("Push", Var("values"))
+      .shard("RandomFloat")
+      .shard("Push", Var("values"))
+      .shard("Time.Delta")
+      .shard("Push", Var("values"))
+      .shard("Get", Var("values"));
+}
+
+// Runs the wire to completion, returns its output and how many ticks it took
+std::pair<OwnedVar, size_t> runNondeterministic(std::shared_ptr<shards::Recorder> recorder, bool &ok) {
+  auto mesh = SHMesh::make();
+  mesh->recorder = recorder;
+  auto wire = nondeterministicWire();
+  mesh->schedule(wire);
+  size_t ticks = 0;
+  ok = true;
+  while (!mesh->empty()) {
+    ok = mesh->tick() && ok;
+    ticks++;
+  }
+  mesh->terminate();
+  return {OwnedVar(wire->finishedOutput), ticks};
+}
+} // namespace
+
+TEST_CASE("Replay") {
+  const std::string path = "test-replay.shrr";
+  DEFER(std::remove(path.c_str()));
+
+  bool ok;
+  auto [recorded, recordedTicks] = runNondeterministic(shards::Recorder::record(path), ok);
+  REQUIRE(ok);
+  REQUIRE(recorded.valueType == SHType::Seq);
+  REQUIRE(recorded.payload.seqValue.len == 6);
+
+  SECTION("Same run") {
+    auto [replayed, replayedTicks] = runNondeterministic(shards::Recorder::replay(path), ok);
+    REQUIRE(ok);
+    // bit for bit, even the scheduling
+    CHECK(replayed == recorded);
+    CHECK(replayedTicks == recordedTicks);
+  }
+
+  SECTION("Live runs differ") {
+    auto [live, liveTicks] = runNondeterministic(nullptr, ok);
+    REQUIRE(ok);
+    CHECK(live != recorded);
+  }
+
+  SECTION("Divergence") {
+    auto mesh = SHMesh::make();
+    mesh->recorder = shards::Recorder::replay(path);
+    // reads a clock where the recording has a seed
+    auto wire = shards::Wire("test-wire-replay-diverged").shard("Time.Now").shard("RandomFloat");
+    mesh->schedule(wire);
+    bool failed = false;
+    while (!mesh->empty()) {
+      failed = !mesh->tick() || failed;
+    }
+    CHECK(failed);
+  }
+}
+
+#include "../core/shards/time.hpp"
+
+TEST_CASE("DelayQueue") {
+  using Deadline = shards::Time::DelayQueue::Deadline;
+  shards::Time::DelayQueue queue;
+  OwnedVar out;
+
+  SECTION("Earliest first") {
+    queue.push(Var("c"), Deadline(3.0));
+    queue.push(Var("a"), Deadline(1.0));
+    queue.push(Var("b"), Deadline(2.0));
+    queue.push(Var("a2"), Deadline(1.0));
+    CHECK(queue.size() == 4);
+    CHECK(queue.next() == Deadline(1.0));
+
+    CHECK_FALSE(queue.pop(Deadline(0.5), out));
+    REQUIRE(queue.peek(out));
+    CHECK(out == Var("a"));
+    // peek does not remove
+    CHECK(queue.size() == 4);
+
+    REQUIRE(queue.pop(Deadline(1.0), out));
+    CHECK(out == Var("a"));
+    // same deadline, push order
+    REQUIRE(queue.pop(Deadline(1.0), out));
+    CHECK(out == Var("a2"));
+    CHECK_FALSE(queue.pop(Deadline(1.5), out));
+    REQUIRE(queue.pop(Deadline(10.0), out));
+    CHECK(out == Var("b"));
+    REQUIRE(queue.pop(Deadline(10.0), out));
+    CHECK(out == Var("c"));
+    CHECK_FALSE(queue.pop(Deadline(10.0), out));
+    CHECK(queue.next() == Deadline::max());
+  }
+
+  SECTION("Values are owned") {
+    std::vector<Var> seq{Var(1), Var(2)};
+    queue.push(Var(seq), Deadline(1.0));
+    seq[0] = Var(3);
+    REQUIRE(queue.pop(Deadline(1.0), out));
+    REQUIRE(out.valueType == SHType::Seq);
+    CHECK(out.payload.seqValue.elements[0] == Var(1));
+  }
+
+  SECTION("Waiters") {
+    std::atomic_bool woken{false};
+    queue.push(Var(1), Deadline(5.0));
+    CHECK(queue.wait(woken) == Deadline(5.0));
+    // later deadlines don't change when the waiter is due
+    queue.push(Var(2), Deadline(6.0));
+    CHECK_FALSE(woken);
+    queue.push(Var(3), Deadline(4.0));
+    CHECK(woken);
+
+    woken = false;
+    CHECK(queue.wait(woken) == Deadline(4.0));
+    queue.forget(woken);
+    queue.push(Var(4), Deadline(1.0));
+    CHECK_FALSE(woken);
+
+    CHECK(queue.wait(woken) == Deadline(1.0));
+    queue.clear();
+    CHECK(woken);
+    CHECK(queue.size() == 0);
+  }
+
+  SECTION("Wire") {
+    auto mesh = SHMesh::make();
+    auto wire = shards::Wire("test-wire-delay-queue")
+                    .shard("Time.Queue")
+                    .shard("Set", Var("queue"))
+                    .let(Var("late"))
+                    .shard("Time.QueuePush", Var::ContextVar("queue"), 0.02)
+                    .let(Var("early"))
+                    .shard("Time.QueuePush", Var::ContextVar("queue"), 0.01)
+                    .shard("Time.QueuePop", Var::ContextVar("queue"))
+                    .shard("Push", Var("values"))
+                    .shard("Time.QueuePop", Var::ContextVar("queue"))
+                    .shard("Push", Var("values"))
+                    .shard("Get", Var("values"));
+    mesh->schedule(wire);
+    size_t ticks = 0;
+    while (!mesh->empty()) {
+      REQUIRE(mesh->tick());
+      mesh->idle(SHDuration(1.0));
+      ticks++;
+    }
+    mesh->terminate();
+    auto &output = wire->finishedOutput;
+    REQUIRE(output.valueType == SHType::Seq);
+    REQUIRE(output.payload.seqValue.len == 2);
+    CHECK(output.payload.seqValue.elements[0] == Var("early"));
+    CHECK(output.payload.seqValue.elements[1] == Var("late"));
+    // the wire sleeps until each deadline instead of being resumed every tick
+    CHECK(ticks <= 6);
+  }
+}
+
+TEST_CASE("DelayQueue-Benchmark", "[.benchmark]") {
+  using Deadline = shards::Time::DelayQueue::Deadline;
+  const size_t count = 100000;
+  std::vector<double> deadlines(count);
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> dist(0.0, 100.0);
+  for (auto &deadline : deadlines)
+    deadline = dist(gen);
+
+  BENCHMARK("Queue push 100k then pop as they expire") {
+    shards::Time::DelayQueue queue;
+    for (size_t i = 0; i < count; i++)
+      queue.push(Var(int64_t(i)), Deadline(deadlines[i]));
+    OwnedVar out;
+    size_t popped = 0;
+    for (double now = 0.0; now <= 100.0; now += 0.01) {
+      while (queue.pop(Deadline(now), out))
+        popped++;
+    }
+    return popped;
+  };
+
+  // what Time.Pop does, a full scan of the pending values on every tick, 10 times less values
+  BENCHMARK("Sequence scan 10k then pop as they expire") {
+    const size_t scanCount = count / 10;
+    std::vector<std::pair<int64_t, double>> pending;
+    for (size_t i = 0; i < scanCount; i++)
+      pending.emplace_back(int64_t(i), deadlines[i]);
+    size_t popped = 0;
+    for (double now = 0.0; now <= 100.0; now += 0.01) {
+      for (size_t idx = 0; idx < pending.size();) {
+        if (now >= pending[idx].second) {
+          pending[idx] = pending.back();
+          pending.pop_back();
+          popped++;
+        } else {
+          idx++;
+        }
+      }
+    }
+    return popped;
+  };
+}
+
+#include "../core/shards/random.hpp"
+
+TEST_CASE("Philox") {
+  using namespace shards::Random;
+
+  SECTION("Known answers") {
+    // Random123 kat_vectors, philox4x32 10 rounds
+    uint32_t out[4];
+    const uint32_t zeroCounter[4] = {0, 0, 0, 0};
+    const uint32_t zeroKey[2] = {0, 0};
+    Philox::block(zeroCounter, zeroKey, out);
+    CHECK(out[0] == 0x6627e8d5);
+    CHECK(out[1] == 0xe169c58d);
+    CHECK(out[2] == 0xbc57ac4c);
+    CHECK(out[3] == 0x9b00dbd8);
+
+    const uint32_t piCounter[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+    const uint32_t piKey[2] = {0xa4093822, 0x299f31d0};
+    Philox::block(piCounter, piKey, out);
+    CHECK(out[0] == 0xd16cfe09);
+    CHECK(out[1] == 0x94fdcceb);
+    CHECK(out[2] == 0x5001e420);
+    CHECK(out[3] == 0x24126ea1);
+  }
+
+  SECTION("Bulk fill is the same sequence") {
+    Philox bulk(42, 7), single(42, 7);
+    // start unaligned on a block
+    CHECK(bulk() == single());
+    CHECK(bulk() == single());
+    std::vector<uint32_t> values(1003);
+    bulk.fill(values.data(), values.size());
+    for (auto value : values)
+      CHECK(value == single());
+
+    Philox other(42, 8);
+    CHECK(other() != Philox(42, 7)());
+  }
+
+  SECTION("Distributions") {
+    Philox gen(1);
+    std::vector<double> values(200000);
+
+    fillUniform(gen, values.data(), values.size(), 2.0);
+    CHECK(*std::min_element(values.begin(), values.end()) >= 0.0);
+    CHECK(*std::max_element(values.begin(), values.end()) < 2.0);
+
+    fillNormal(gen, values.data(), values.size(), 2.0, 3.0);
+    double mean = 0.0, variance = 0.0;
+    for (auto value : values)
+      mean += value;
+    mean /= double(values.size());
+    for (auto value : values)
+      variance += (value - mean) * (value - mean);
+    variance /= double(values.size());
+    CHECK(mean == Catch::Approx(2.0).margin(0.05));
+    CHECK(std::sqrt(variance) == Catch::Approx(3.0).margin(0.05));
+
+    fillExponential(gen, values.data(), values.size(), 4.0);
+    mean = 0.0;
+    for (auto value : values) {
+      REQUIRE(value >= 0.0);
+      mean += value;
+    }
+    CHECK(mean / double(values.size()) == Catch::Approx(0.25).margin(0.005));
+
+    std::vector<int64_t> ints(60000);
+    fillInts(gen, ints.data(), ints.size(), 6);
+    int64_t histogram[6] = {};
+    for (auto value : ints) {
+      REQUIRE(value >= 0);
+      REQUIRE(value < 6);
+      histogram[value]++;
+    }
+    for (auto count : histogram)
+      CHECK(count == Catch::Approx(10000).margin(500));
+  }
+
+  SECTION("Weighted choice") {
+    Philox gen(3);
+    const double weights[4] = {1.0, 0.0, 3.0, 6.0};
+    WeightedChoice choice;
+    choice.build(weights, 4);
+    std::vector<int64_t> indices(100000);
+    choice.fill(gen, indices.data(), indices.size());
+    int64_t histogram[4] = {};
+    for (auto index : indices)
+      histogram[index]++;
+    CHECK(histogram[0] == Catch::Approx(10000).margin(600));
+    CHECK(histogram[1] == 0);
+    CHECK(histogram[2] == Catch::Approx(30000).margin(600));
+    CHECK(histogram[3] == Catch::Approx(60000).margin(600));
+
+    const double zeros[2] = {0.0, 0.0};
+    CHECK_THROWS(choice.build(zeros, 2));
+  }
+
+  SECTION("Seeded shards") {
+    auto run = [](std::optional<int64_t> seed) {
+      auto mesh = SHMesh::make();
+      auto seedVar = seed ? Var(*seed) : Var::Empty;
+      auto wire = shards::Wire("test-wire-random-seeded")
+                      .shard("RandomNormal", 0.0, 1.0, int64_t(4), seedVar)
+                      .shard("Push", Var("values"))
+                      .shard("RandomChoice", Var(std::vector<Var>{Var(1.0), Var(2.0)}), Var::Empty, seedVar)
+                      .shard("Push", Var("values"))
+                      .shard("RandomBytes", int64_t(7), seedVar)
+                      .shard("Push", Var("values"))
+                      .shard("Get", Var("values"));
+      mesh->schedule(wire);
+      while (!mesh->empty())
+        REQUIRE(mesh->tick());
+      mesh->terminate();
+      return OwnedVar(wire->finishedOutput);
+    };
+    auto first = run(42);
+    REQUIRE(first.valueType == SHType::Seq);
+    REQUIRE(first.payload.seqValue.len == 3);
+    CHECK(first.payload.seqValue.elements[0].payload.seqValue.len == 4);
+    CHECK(first.payload.seqValue.elements[1].valueType == SHType::Int);
+    CHECK(first.payload.seqValue.elements[2].payload.bytesSize == 7);
+    CHECK(run(42) == first);
+    CHECK(run(43) != first);
+    CHECK(run(std::nullopt) != first);
+  }
+
+  SECTION("Negative sizes") {
+    for (auto name : {"RandomInts", "RandomFloats", "RandomBytes"}) {
+      auto shard = createShard(name);
+      DEFER(shard->destroy(shard));
+      Var size(int64_t(-1));
+      shard->setParam(shard, 0, &size);
+      CHECK(shard->compose(shard, SHInstanceData{}).error.code != 0);
+    }
+  }
+}
+
+TEST_CASE("Random-Benchmark", "[.benchmark]") {
+  using namespace shards::Random;
+  const size_t count = 1000000;
+  std::vector<double> floats(count);
+  std::vector<uint8_t> bytes(count);
+  std::mt19937 mt(1);
+  Philox philox(1);
+
+  BENCHMARK("1M uniform floats, mt19937 per value") {
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+    for (auto &value : floats)
+      value = dist(mt);
+    return floats[count - 1];
+  };
+
+  BENCHMARK("1M uniform floats, Philox bulk") {
+    fillUniform(philox, floats.data(), count);
+    return floats[count - 1];
+  };
+
+  BENCHMARK("1M normal floats, mt19937 per value") {
+    std::normal_distribution<> dist(0.0, 1.0);
+    for (auto &value : floats)
+      value = dist(mt);
+    return floats[count - 1];
+  };
+
+  BENCHMARK("1M normal floats, Philox bulk") {
+    fillNormal(philox, floats.data(), count);
+    return floats[count - 1];
+  };
+
+  BENCHMARK("1M bytes, mt19937 per byte (previous RandomBytes)") {
+    std::uniform_int_distribution<> dist;
+    for (auto &value : bytes)
+      value = dist(mt) % 256;
+    return bytes[count - 1];
+  };
+
+  BENCHMARK("1M bytes, Philox bulk") {
+    philox.fill(reinterpret_cast<uint32_t *>(bytes.data()), count / 4);
+    return bytes[count - 1];
+  };
+}
+
+namespace {
+// keeps every wire on a coroutine, like before non suspending wires were detected
+struct CoroutineObserver : SHMesh::EmptyObserver {
+  void before_prepare(SHWire *wire) { wire->nonSuspending = false; }
+};
+
+std::shared_ptr<SHMesh> tinyWiresMesh(size_t count, bool coroutines) {
+  auto mesh = SHMesh::make();
+  for (size_t i = 0; i < count; i++) {
+    auto wire = shards::Wire("test-wire-tiny")
+                    .looped(true)
+                    .shard("Once", Weave().let(int64_t(0)).shard("Set", Var("counter")))
+                    .shard("Get", Var("counter"))
+                    .shard("Math.Add", int64_t(1))
+                    .shard("Update", Var("counter"));
+    if (coroutines)
+      mesh->schedule(CoroutineObserver{}, wire);
+    else
+      mesh->schedule(wire);
+  }
+  return mesh;
+}
+} // namespace
+
+TEST_CASE("NonSuspendingWires") {
+  SECTION("Detected at compose") {
+    auto mesh = SHMesh::make();
+    auto pure = shards::Wire("test-wire-pure").let(int64_t(1)).shard("Math.Add", int64_t(1)).shard("Log");
+    auto paused = shards::Wire("test-wire-paused").let(int64_t(1)).shard("Pause", 0.0);
+    auto pausedInner = shards::Wire("test-wire-paused-inner").let(int64_t(1)).shard("Pause", 0.0);
+    auto nested = shards::Wire("test-wire-nested").let(int64_t(1)).shard("Do", Var(pausedInner));
+    mesh->schedule(pure);
+    mesh->schedule(paused);
+    mesh->schedule(nested);
+    CHECK(pure->nonSuspending);
+    CHECK(pure->directRun);
+    CHECK_FALSE(pure->coro);
+    CHECK_FALSE(paused->nonSuspending);
+    CHECK(paused->coro);
+    CHECK_FALSE(nested->nonSuspending);
+    while (!mesh->empty())
+      REQUIRE(mesh->tick());
+    CHECK(pure->finishedOutput == Var(int64_t(2)));
+    CHECK(nested->finishedOutput == Var(int64_t(1)));
+  }
+
+  SECTION("Parallel sort") {
+    auto mesh = SHMesh::make();
+    // at least Sort's parallel threshold, so that it awaits
+    auto sorted = shards::Wire("test-wire-parallel-sort")
+                      .shard("RandomInts", int64_t(1 << 16))
+                      .shard("Set", "items")
+                      .shard("Sort", Var::ContextVar("items"), Var::Empty, false, Var::Empty, true)
+                      .shard("Count", "items");
+    mesh->schedule(sorted);
+    CHECK_FALSE(sorted->nonSuspending);
+    while (!mesh->empty())
+      REQUIRE(mesh->tick());
+    CHECK(sorted->finishedError.empty());
+    CHECK(sorted->finishedOutput == Var(int64_t(1 << 16)));
+  }
+
+  SECTION("Looped, stopped and failed") {
+    auto mesh = tinyWiresMesh(3, false);
+    for (int i = 0; i < 5; i++)
+      REQUIRE(mesh->tick());
+    for (auto &wire : mesh->scheduled) {
+      REQUIRE(wire->directRun);
+      CHECK(wire->previousOutput == Var(int64_t(5)));
+      CHECK(shards::isRunning(wire.get()));
+    }
+    mesh->terminate();
+    CHECK(mesh->empty());
+
+    auto failing = shards::Wire("test-wire-direct-fail").let(int64_t(1)).shard("Assert.Is", int64_t(2), false);
+    mesh->schedule(failing);
+    REQUIRE(failing->directRun);
+    CHECK_FALSE(mesh->tick());
+    CHECK(failing->state == SHWire::State::Stopped);
+    CHECK_FALSE(failing->finishedError.empty());
+  }
+
+  SECTION("Same results as coroutines") {
+    auto direct = tinyWiresMesh(10, false);
+    auto coroutines = tinyWiresMesh(10, true);
+    for (int i = 0; i < 7; i++) {
+      REQUIRE(direct->tick());
+      REQUIRE(coroutines->tick());
+    }
+    for (auto &wire : coroutines->scheduled) {
+      REQUIRE(wire->coro);
+      CHECK(wire->previousOutput == Var(int64_t(7)));
+    }
+    for (auto &wire : direct->scheduled)
+      CHECK(wire->previousOutput == Var(int64_t(7)));
+  }
+}
+
+TEST_CASE("NonSuspendingWires-Benchmark", "[.benchmark]") {
+  const size_t count = 10000;
+  for (auto coroutines : {true, false}) {
+    const std::string name = coroutines ? "coroutines" : "direct";
+
+    BENCHMARK_ADVANCED(("schedule 10k tiny wires, " + name).c_str())(Catch::Benchmark::Chronometer meter) {
+      meter.measure([&]() { return tinyWiresMesh(count, coroutines)->scheduled.size(); });
+    };
+
+    auto mesh = tinyWiresMesh(count, coroutines);
+    BENCHMARK(("tick 10k tiny wires, " + name).c_str()) { return mesh->tick(); };
+  }
+}
+
+namespace {
+struct OrderObserver : SHMesh::EmptyObserver {
+  std::vector<SHWire *> *order;
+  void before_tick(SHWire *wire) { order->push_back(wire); }
+};
+} // namespace
+
+TEST_CASE("WireBudgets") {
+  // a synthetic hog, 20ms per resume
+  auto hogWire = [](const char *name) { return shards::Wire(name).looped(true).let(0.02).shard("SleepBlocking!"); };
+
+  SECTION("Overruns and deferrals") {
+    auto mesh = SHMesh::make();
+    mesh->frameBudget = 0.01;
+    auto hog = hogWire("test-wire-hog").budget(0.005);
+    auto light = shards::Wire("test-wire-light").looped(true).budget(0.015).let(int64_t(1)).shard("Math.Add", int64_t(1));
+    mesh->schedule(hog);
+    mesh->schedule(light);
+    for (int i = 0; i < 4; i++)
+      REQUIRE(mesh->tick());
+
+    CHECK(hog->stats.resumes == 4);
+    CHECK(hog->stats.overruns == 4);
+    CHECK(shards::CycleClock::seconds(hog->stats.max) > 0.019);
+    // deferred by the hog every other tick, then resumed first
+    CHECK(light->stats.resumes == 2);
+    CHECK(light->stats.deferrals == 2);
+    CHECK(light->stats.overruns == 0);
+
+    CHECK(mesh->stats.frames == 4);
+    CHECK(mesh->stats.overruns == 4);
+    REQUIRE(mesh->overruns.size() == 8);
+    for (auto &overrun : mesh->overruns) {
+      CHECK(overrun.wire == "test-wire-hog");
+      CHECK(overrun.cpu > overrun.budget);
+    }
+  }
+
+  SECTION("Priorities") {
+    auto mesh = SHMesh::make();
+    mesh->frameBudget = 0.01;
+    auto hog = hogWire("test-wire-hog");
+    auto urgent = shards::Wire("test-wire-urgent").looped(true).priority(1).let(int64_t(1)).shard("Math.Add", int64_t(1));
+    mesh->schedule(hog);
+    mesh->schedule(urgent);
+
+    std::vector<SHWire *> order;
+    OrderObserver observer;
+    observer.order = &order;
+    REQUIRE(mesh->tick(observer));
+    REQUIRE(mesh->tick(observer));
+    CHECK(order == std::vector<SHWire *>{urgent.get(), hog.get(), urgent.get(), hog.get()});
+    CHECK(urgent->stats.deferrals == 0);
+
+    // priorities can change after scheduling
+    hog->priority = 2;
+    order.clear();
+    REQUIRE(mesh->tick(observer));
+    REQUIRE(mesh->tick(observer));
+    CHECK(order == std::vector<SHWire *>{urgent.get(), hog.get(), hog.get(), urgent.get()});
+    CHECK(urgent->stats.deferrals == 0);
+    CHECK(urgent->stats.resumes == 4);
+  }
+
+  SECTION("Stats shards") {
+    auto mesh = SHMesh::make();
+    auto hog = hogWire("test-wire-hog").budget(0.005);
+    auto wireStats = shards::Wire("test-wire-stats")
+                         .looped(true)
+                         .priority(-1)
+                         .shard("Wire.Stats", Var(hog))
+                         .shard("Take", Var("Overruns"));
+    auto meshStats = shards::Wire("test-wire-mesh-stats")
+                         .looped(true)
+                         .priority(-1)
+                         .shard("Mesh.Stats")
+                         .shard("Take", Var("Wires"))
+                         .shard("Take", int64_t(0))
+                         .shard("Take", Var("Name"));
+    mesh->schedule(wireStats);
+    mesh->schedule(meshStats);
+    mesh->schedule(hog);
+    for (int i = 0; i < 3; i++)
+      REQUIRE(mesh->tick());
+    CHECK(wireStats->previousOutput == Var(int64_t(3)));
+    CHECK(meshStats->previousOutput == Var("test-wire-hog"));
+  }
+}
+
+#include "../core/shards/channels.hpp"
+#include <boost/lockfree/queue.hpp>
+#include <thread>
+
+TEST_CASE("BroadcastChannel") {
+  using namespace shards::channels;
+
+  SECTION("Every listener reads every value") {
+    BroadcastChannel channel(false, 4);
+    auto early = channel.subscribe();
+    REQUIRE(channel.publish(Var("a")));
+    auto late = channel.subscribe();
+    REQUIRE(channel.publish(Var("b")));
+
+    BroadcastChannel::Message *message;
+    REQUIRE(channel.read(*early, message));
+    CHECK(message->value == Var("a"));
+    channel.release(message);
+    REQUIRE(channel.read(*early, message));
+    CHECK(message->value == Var("b"));
+    // held values stay valid however far the ring moves
+    auto held = message;
+    CHECK_FALSE(channel.read(*early, message));
+
+    REQUIRE(channel.read(*late, message));
+    CHECK(message->value == Var("b"));
+    channel.release(message);
+    CHECK_FALSE(channel.read(*late, message));
+
+    channel.unsubscribe(late.get());
+    for (int64_t i = 0; i < 4; i++) {
+      REQUIRE(channel.publish(Var(i)));
+      REQUIRE(channel.read(*early, message));
+      channel.release(message);
+    }
+    CHECK(held->value == Var("b"));
+    channel.release(held);
+    channel.unsubscribe(early.get());
+  }
+
+  SECTION("Block") {
+    BroadcastChannel channel(false, 4, BroadcastLag::Block);
+    auto listener = channel.subscribe();
+    for (int64_t i = 0; i < 4; i++)
+      REQUIRE(channel.publish(Var(i)));
+    CHECK_FALSE(channel.publish(Var(int64_t(4))));
+
+    BroadcastChannel::Message *message;
+    REQUIRE(channel.read(*listener, message));
+    CHECK(message->value == Var(int64_t(0)));
+    channel.release(message);
+    CHECK(channel.publish(Var(int64_t(4))));
+    CHECK_FALSE(channel.publish(Var(int64_t(5))));
+
+    // a gone listener does not hold producers back
+    channel.unsubscribe(listener.get());
+    CHECK(channel.publish(Var(int64_t(5))));
+  }
+
+  SECTION("DropOldest") {
+    BroadcastChannel channel(false, 4, BroadcastLag::DropOldest);
+    auto listener = channel.subscribe();
+    for (int64_t i = 0; i < 10; i++)
+      REQUIRE(channel.publish(Var(i)));
+
+    BroadcastChannel::Message *message;
+    for (int64_t i = 6; i < 10; i++) {
+      REQUIRE(channel.read(*listener, message));
+      CHECK(message->value == Var(i));
+      channel.release(message);
+    }
+    CHECK_FALSE(channel.read(*listener, message));
+    CHECK(listener->dropped == 6);
+    channel.unsubscribe(listener.get());
+  }
+
+  SECTION("Threads") {
+    const int64_t count = 10000;
+    BroadcastChannel channel(false, 16, BroadcastLag::Block);
+    std::vector<std::unique_ptr<BroadcastChannel::Subscriber>> listeners;
+    for (int i = 0; i < 8; i++)
+      listeners.emplace_back(channel.subscribe());
+
+    std::atomic_int errors{0};
+    std::vector<std::thread> threads;
+    for (auto &listener : listeners) {
+      threads.emplace_back([&, subscriber = listener.get()]() {
+        for (int64_t expected = 0; expected < count;) {
+          BroadcastChannel::Message *message;
+          if (!channel.read(*subscriber, message)) {
+            std::this_thread::yield();
+            continue;
+          }
+          if (message->value != Var(expected))
+            errors++;
+          channel.release(message);
+          expected++;
+        }
+      });
+    }
+    for (int64_t i = 0; i < count; i++) {
+      while (!channel.publish(Var(i)))
+        std::this_thread::yield();
+    }
+    for (auto &thread : threads)
+      thread.join();
+    CHECK(errors == 0);
+    for (auto &listener : listeners)
+      channel.unsubscribe(listener.get());
+  }
+}
+
+TEST_CASE("BroadcastChannel-Benchmark", "[.benchmark]") {
+  using namespace shards::channels;
+  const int64_t count = 10000;
+  const int listeners = 64;
+
+  // one producer and 64 listener threads, every listener reads every value
+  auto run = [&](auto publish, auto read) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < listeners; i++) {
+      threads.emplace_back([&, i]() {
+        for (int64_t received = 0; received < count;) {
+          if (read(i))
+            received++;
+          else
+            std::this_thread::yield();
+        }
+      });
+    }
+    for (int64_t i = 0; i < count; i++)
+      publish(Var("a broadcasted string"));
+    for (auto &thread : threads)
+      thread.join();
+    return count;
+  };
+
+  BENCHMARK("1 producer 64 listeners, queue per listener (previous Broadcast)") {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<boost::lockfree::queue<SHVar>>> queues;
+    for (int i = 0; i < listeners; i++)
+      queues.emplace_back(new boost::lockfree::queue<SHVar>(16));
+    return run(
+        [&](const SHVar &value) {
+          std::scoped_lock lock(mutex);
+          for (auto &queue : queues) {
+            SHVar tmp{};
+            cloneVar(tmp, value);
+            queue->push(tmp);
+          }
+        },
+        [&](int i) {
+          SHVar tmp{};
+          if (!queues[i]->pop(tmp))
+            return false;
+          destroyVar(tmp);
+          return true;
+        });
+  };
+
+  BENCHMARK("1 producer 64 listeners, shared ring") {
+    BroadcastChannel channel(false, 64, BroadcastLag::Block);
+    std::vector<std::unique_ptr<BroadcastChannel::Subscriber>> subscribers;
+    for (int i = 0; i < listeners; i++)
+      subscribers.emplace_back(channel.subscribe());
+    auto result = run(
+        [&](const SHVar &value) {
+          while (!channel.publish(value))
+            std::this_thread::yield();
+        },
+        [&](int i) {
+          BroadcastChannel::Message *message;
+          if (!channel.read(*subscribers[i], message))
+            return false;
+          channel.release(message);
+          return true;
+        });
+    for (auto &subscriber : subscribers)
+      channel.unsubscribe(subscriber.get());
+    return result;
+  };
+}
+
+namespace {
+// A headless problem for Evolve: find the factor taking 0.5 to 42, every evaluation burns some cpu
+shards::Wire geneticSubject(const std::vector<Var> &indices) {
+  return shards::Wire("genetic-subject")
+      .let(0.5)
+      .shard("Mutant", Weave().shard("Math.Multiply", 2.0), Var(indices))
+      .shard("Repeat", Weave().shard("Math.Add", 0.0), int64_t(2000));
+}
+
+shards::Wire geneticFitness() {
+  return shards::Wire("genetic-fitness").shard("Math.Subtract", 42.0).shard("Math.Abs").shard("Math.Multiply", -1.0);
+}
+} // namespace
+
+TEST_CASE("Evolve-Benchmark", "[.benchmark]") {
+  // 10 eras per run, generations per second = 10 / mean time
+  const auto cores = int64_t(std::max(1u, std::thread::hardware_concurrency()));
+  for (int64_t islands = 1; islands <= cores; islands *= 2) {
+    BENCHMARK(("population 256 x 10 eras, " + std::to_string(islands) + " islands").c_str()) {
+      const std::vector<Var> indices{Var(int64_t(0))};
+      auto subject = geneticSubject(indices);
+      auto fitness = geneticFitness();
+      auto evolve = shards::Wire("genetic-evolve")
+                        .shard("Repeat",
+                               Weave().shard("Evolve", subject, fitness, int64_t(256), Var::Any, Var::Any, Var::Any, Var::Any,
+                                             islands, Var::Any, islands, int64_t(2)),
+                               int64_t(10));
+      auto mesh = SHMesh::make();
+      mesh->schedule(evolve);
+      while (!mesh->empty())
+        mesh->tick();
+      mesh->terminate();
+      return mesh->empty();
+    };
+  }
+}
+
+#include "../core/shards/compression.hpp"
+
+TEST_CASE("Compression-Benchmark", "[.benchmark]") {
+  using namespace shards::compression;
+
+  // a serialized wire spanning a few blocks, MB/s = size / mean time
+  shards::Wire wire("compression-subject");
+  for (int64_t i = 0; i < 50000; i++)
+    wire.shard("Math.Add", i % 16);
+  std::vector<uint8_t> data;
+  Writer writer{data};
+  Serialization serialization;
+  serialization.serialize(Var(std::shared_ptr<SHWire>(wire)), writer);
+
+  for (auto codec : {Codec::Snappy, Codec::Brotli, Codec::Zstd}) {
+    // codecs are registered by the extra shards
+    if (!available(codec))
+      continue;
+
+    const auto name = std::string(magic_enum::enum_name(codec));
+    Frames encoder;
+    // brotli default quality is far too slow for a wire sized value
+    encoder.configure(codec, codec == Codec::Brotli ? 5 : 0);
+    const auto compressed = encoder.compress(data.data(), data.size());
+    SHLOG_INFO("{}: {} -> {} bytes, ratio {:.2f}", name, data.size(), compressed.size(),
+               double(data.size()) / double(compressed.size()));
+
+    Frames decoder;
+    REQUIRE(decoder.decompress(compressed.data(), compressed.size()) == data);
+
+    BENCHMARK((name + " compress " + std::to_string(data.size()) + " bytes").c_str()) {
+      return encoder.compress(data.data(), data.size()).size();
+    };
+    BENCHMARK((name + " decompress " + std::to_string(data.size()) + " bytes").c_str()) {
+      return decoder.decompress(compressed.data(), compressed.size()).size();
+    };
+  }
+}
+
+#include "../core/shards/bigint.hpp"
+#include <boost/multiprecision/cpp_int.hpp>
+
+namespace {
+using boost::multiprecision::cpp_int;
+
+cpp_int toCppInt(const shards::BigInt::Fixed &fixed) {
+  std::vector<uint8_t> bytes;
+  fixed.store(bytes);
+  cpp_int res;
+  import_bits(res, bytes.begin() + 1, bytes.end());
+  return bytes[0] ? cpp_int(-res) : res;
+}
+
+shards::BigInt::Fixed randomFixed(std::mt19937_64 &rng) {
+  shards::BigInt::U256 magnitude;
+  const auto limbs = int(rng() % 5);
+  for (int i = 0; i < limbs; i++)
+    magnitude.limbs[i] = rng();
+  // uneven sizes exercise the division normalization
+  if (limbs > 0)
+    magnitude.limbs[limbs - 1] >>= rng() % 64;
+  return shards::BigInt::Fixed(rng() % 3 == 0, magnitude);
+}
+} // namespace
+
+TEST_CASE("BigInt-Fixed") {
+  using namespace shards::BigInt;
+  std::mt19937_64 rng(42);
+  const cpp_int limit = cpp_int(1) << 256;
+  for (int i = 0; i < 20000; i++) {
+    const auto a = randomFixed(rng), b = randomFixed(rng), m = randomFixed(rng);
+    const auto ca = toCppInt(a), cb = toCppInt(b), cm = toCppInt(m);
+    Fixed res;
+
+    // results that fit must match, the others must be refused
+    REQUIRE(add(a, b, res) == (abs(ca + cb) < limit));
+    if (add(a, b, res))
+      REQUIRE(toCppInt(res) == ca + cb);
+    REQUIRE(sub(a, b, res));
+    REQUIRE(toCppInt(res) == ca - cb);
+    REQUIRE(mul(a, b, res) == (abs(ca * cb) < limit));
+    if (mul(a, b, res))
+      REQUIRE(toCppInt(res) == ca * cb);
+    REQUIRE(compare(a, b) == (ca < cb ? -1 : ca > cb ? 1 : 0));
+    REQUIRE(a.toString() == ca.str());
+
+    if (cb != 0) {
+      REQUIRE(div(a, b, res));
+      REQUIRE(toCppInt(res) == ca / cb);
+      REQUIRE(mod(a, b, res));
+      REQUIRE(toCppInt(res) == ca % cb);
+    } else {
+      REQUIRE_FALSE(div(a, b, res));
+    }
+
+    if (cm != 0) {
+      U256 r;
+      REQUIRE(mulmod(a.magnitude, b.magnitude, m.magnitude, r));
+      REQUIRE(toCppInt(Fixed(false, r)) == (abs(ca) * abs(cb)) % abs(cm));
+      if (i % 100 == 0) {
+        REQUIRE(powmod(a.magnitude, b.magnitude, m.magnitude, r));
+        REQUIRE(toCppInt(Fixed(false, r)) == powm(cpp_int(abs(ca)), cpp_int(abs(cb)), cpp_int(abs(cm))));
+      }
+    }
+
+    U256 parsed;
+    REQUIRE(U256::fromString(cpp_int(abs(ca)).str(), parsed));
+    REQUIRE(compare(parsed, a.magnitude) == 0);
+
+    // correctly rounded like strtod
+    const int64_t shift = int64_t(rng() % 81) - 40;
+    double value;
+    if (a.toDouble(shift, value))
+      REQUIRE(value == std::strtod((a.toString() + "e" + std::to_string(shift)).c_str(), nullptr));
+  }
+}
+
+TEST_CASE("BigInt-Benchmark", "[.benchmark]") {
+  using namespace shards::BigInt;
+  // the way the shards see values: bytes in, bytes out
+  std::mt19937_64 rng(42);
+  std::vector<std::vector<uint8_t>> values(64);
+  for (auto &value : values) {
+    Fixed fixed(false, U256(rng()));
+    fixed.magnitude.limbs[1] = rng();
+    fixed.magnitude.limbs[2] = rng();
+    fixed.store(value);
+  }
+  std::vector<uint8_t> modulus;
+  Fixed(false, U256(uint64_t(1000000007))).store(modulus);
+
+  auto loadCppInt = [](const std::vector<uint8_t> &bytes) {
+    cpp_int res;
+    import_bits(res, bytes.begin() + 1, bytes.end());
+    return res;
+  };
+  auto storeCppInt = [](const cpp_int &value, std::vector<uint8_t> &bytes) {
+    bytes.clear();
+    bytes.emplace_back(uint8_t(value < 0));
+    export_bits(value, std::back_inserter(bytes), 8);
+  };
+
+  std::vector<uint8_t> output;
+  BENCHMARK("cpp_int add") {
+    for (size_t i = 1; i < values.size(); i++)
+      storeCppInt(loadCppInt(values[i - 1]) + loadCppInt(values[i]), output);
+    return output.size();
+  };
+  BENCHMARK("fixed add") {
+    for (size_t i = 1; i < values.size(); i++) {
+      Fixed a, b, res;
+      Fixed::load(values[i - 1].data(), values[i - 1].size(), a);
+      Fixed::load(values[i].data(), values[i].size(), b);
+      add(a, b, res);
+      res.store(output);
+    }
+    return output.size();
+  };
+  BENCHMARK("cpp_int mulmod") {
+    const auto m = loadCppInt(modulus);
+    for (size_t i = 1; i < values.size(); i++)
+      storeCppInt((loadCppInt(values[i - 1]) * loadCppInt(values[i])) % m, output);
+    return output.size();
+  };
+  BENCHMARK("fixed mulmod") {
+    Fixed m;
+    Fixed::load(modulus.data(), modulus.size(), m);
+    for (size_t i = 1; i < values.size(); i++) {
+      Fixed a, b;
+      U256 res;
+      Fixed::load(values[i - 1].data(), values[i - 1].size(), a);
+      Fixed::load(values[i].data(), values[i].size(), b);
+      mulmod(a.magnitude, b.magnitude, m.magnitude, res);
+      Fixed(false, res).store(output);
+    }
+    return output.size();
+  };
+  BENCHMARK("cpp_int powmod") {
+    const auto m = loadCppInt(modulus);
+    for (size_t i = 1; i < values.size(); i++)
+      storeCppInt(powm(loadCppInt(values[i - 1]), loadCppInt(values[i]), m), output);
+    return output.size();
+  };
+  BENCHMARK("fixed powmod") {
+    Fixed m;
+    Fixed::load(modulus.data(), modulus.size(), m);
+    for (size_t i = 1; i < values.size(); i++) {
+      Fixed a, b;
+      U256 res;
+      Fixed::load(values[i - 1].data(), values[i - 1].size(), a);
+      Fixed::load(values[i].data(), values[i].size(), b);
+      powmod(a.magnitude, b.magnitude, m.magnitude, res);
+      Fixed(false, res).store(output);
+    }
+    return output.size();
+  };
+}
+
+#include "../core/artifact.hpp"
+#include <fstream>
+
+namespace {
+std::shared_ptr<SHWire> artifactSubject(const std::string &name, int64_t adds) {
+  auto inner = shards::Wire(name + "-inner").shard("Math.Multiply", int64_t(2));
+  shards::Wire wire(name);
+  wire.let(int64_t(1));
+  for (int64_t i = 0; i < adds; i++)
+    wire.shard("Math.Add", int64_t(1));
+  wire.shard("Do", Var(inner)).shard("ToString");
+  return wire;
+}
+
+size_t composeSubject(const std::shared_ptr<SHWire> &wire) {
+  SHInstanceData data{};
+  data.wire = wire.get();
+  auto res = composeWire(
+      wire.get(), [](const Shard *errorShard, const char *errorTxt, bool nonfatalWarning, void *userData) {}, nullptr, data);
+  shards::arrayFree(res.exposedInfo);
+  return wire->shards.size();
+}
+} // namespace
+
+TEST_CASE("WireArtifact") {
+  using namespace shards::artifact;
+
+  const std::string path = "test-artifact.shc";
+  const std::string dependency = "test-artifact-dependency.txt";
+  DEFER(std::remove(path.c_str()));
+  DEFER(std::remove(dependency.c_str()));
+  std::ofstream(dependency) << "first";
+
+  const auto source = key("source", "extra");
+  CHECK(source != key("sourceextra"));
+  REQUIRE(store(path, source, artifactSubject("test-wire-artifact", 3), {dependency}));
+
+  SECTION("Roundtrip") {
+    auto wire = load(path, source);
+    REQUIRE(wire);
+    CHECK(wire->name == "test-wire-artifact");
+    auto mesh = SHMesh::make();
+    mesh->schedule(wire);
+    while (!mesh->empty())
+      REQUIRE(mesh->tick());
+    CHECK(wire->finishedOutput == Var("8"));
+  }
+
+  SECTION("Stale") {
+    CHECK_FALSE(load(path, key("source", "other")));
+    CHECK_FALSE(load("test-artifact-missing.shc", source));
+    std::ofstream(dependency) << "second";
+    CHECK_FALSE(load(path, source));
+  }
+
+  SECTION("Corrupted") {
+    {
+      std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(-1, std::ios::end);
+      file.put('x');
+    }
+    CHECK_FALSE(load(path, source));
+  }
+
+  SECTION("Vars") {
+    REQUIRE(storeVar(path, source, Var("forms")));
+    SHVar output{};
+    REQUIRE(loadVar(path, source, output));
+    CHECK(output == Var("forms"));
+    Serialization::varFree(output);
+    // a wire artifact must hold a wire
+    CHECK_FALSE(load(path, source));
+  }
+
+  SECTION("Unwritable") {
+    // the dependency is a file, nothing can be created under it
+    CHECK_FALSE(store(dependency + "/test-artifact.shc", source, artifactSubject("test-wire-artifact", 3)));
+    CHECK_FALSE(load(dependency + "/test-artifact.shc", source));
+  }
+}
+
+TEST_CASE("WireArtifact-Benchmark", "[.benchmark]") {
+  using namespace shards::artifact;
+
+  // cold start of a script sized wire, building it from shards stands for evaluating the script
+  const std::string path = "test-artifact-benchmark.shc";
+  DEFER(std::remove(path.c_str()));
+  const auto source = key("benchmark");
+  REQUIRE(store(path, source, artifactSubject("test-wire-artifact-benchmark", 2000)));
+
+  BENCHMARK("build and compose 2000 shards") { return composeSubject(artifactSubject("test-wire-artifact-benchmark", 2000)); };
+  BENCHMARK("load and compose 2000 shards") { return composeSubject(load(path, source)); };
+}
+
+TEST_CASE("Regex.MatchAny-Backreferences") {
+  auto matchAny = createShard("Regex.MatchAny");
+  DEFER(matchAny->destroy(matchAny));
+
+  // fused into one alternation \1 would refer to the group of another pattern
+  std::vector<Var> patterns{Var("(a)b"), Var("(x)\\1")};
+  Var withBackref(patterns);
+  REQUIRE_THROWS(matchAny->setParam(matchAny, 0, &withBackref));
+
+  std::vector<Var> plain{Var("(a)b"), Var("(x)y")};
+  Var withoutBackref(plain);
+  REQUIRE_NOTHROW(matchAny->setParam(matchAny, 0, &withoutBackref));
+}